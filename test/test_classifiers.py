@@ -1,6 +1,14 @@
 import unittest
+
+import numpy as np
+
 from tmu.models.base import TMBaseModel
 
+try:
+    import tmulibpy
+except ImportError:
+    tmulibpy = None
+
 
 class ClassifierTests(object):
     model: TMBaseModel
@@ -51,6 +59,66 @@ class VanillaClassifierTests(unittest.TestCase, ClassifierTests):
         )
         ClassifierTests.setUp(self)
 
+
+@unittest.skipUnless(tmulibpy, "tmulibpy is not built")
+class VanillaClassifierCPPTests(unittest.TestCase):
+
+    def setUp(self) -> None:
+        from tmu.models.classification.vanilla_classifier import TMClassifier
+        rng = np.random.RandomState(1)
+        self.X = rng.randint(0, 2, size=(2000, 12)).astype(np.uint32)
+        self.Y = (self.X[:, 0] ^ self.X[:, 1]).astype(np.uint32)
+        self.model = TMClassifier(number_of_clauses=20, T=10, s=3.9, platform="CPP", seed=1)
+
+    def test_fit_and_predict(self):
+        for epoch in range(20):
+            self.model.fit(self.X, self.Y)
+        self.assertIsNotNone(self.model.engine)
+
+        y_pred, class_sums = self.model.predict(self.X, return_class_sums=True)
+        self.assertGreater((y_pred == self.Y).mean(), 0.95)
+        np.testing.assert_array_equal(y_pred, class_sums.argmax(axis=1))
+
+    def test_banks_read_engine_memory(self):
+        self.model.fit(self.X, self.Y)
+
+        for the_class in self.model.engine.weight_banks.classes():
+            engine_clause_bank = self.model.engine.clause_banks[the_class]
+            clause_bank = self.model.clause_banks[the_class]
+            engine_weights = self.model.engine.weight_banks[the_class].get_weights()
+            weights = self.model.weight_banks[the_class].get_weights()
+
+            self.assertTrue(np.shares_memory(clause_bank.clause_bank, engine_clause_bank.get_clause_bank()))
+            self.assertTrue(np.shares_memory(weights, engine_weights))
+            for clause in range(self.model.number_of_clauses):
+                # NumPy reads and the CFFI kernels see the engine's TA states
+                self.assertEqual(clause_bank.number_of_include_actions(clause),
+                                 engine_clause_bank.number_of_include_actions(clause))
+                for ta in range(0, clause_bank.number_of_literals, 5):
+                    self.assertEqual(clause_bank.get_ta_state(clause, ta), engine_clause_bank.get_ta_state(clause, ta))
+
+        # Weights changed through the Python banks are used by the engine
+        for the_class in self.model.engine.weight_banks.classes():
+            self.model.weight_banks[the_class].get_weights()[:] = 0
+        _, class_sums = self.model.predict(self.X, return_class_sums=True)
+        self.assertFalse(class_sums.any())
+
+    def test_classes_missing_from_y_take_part_in_argmax(self):
+        # Class 0 never occurs, so the engine has no bank for it and its class sum is 0
+        Y = self.Y + 1
+        self.model.fit(self.X, Y)
+        for the_class in self.model.engine.weight_banks.classes():
+            self.model.weight_banks[the_class].get_weights()[:] = -1
+
+        y_pred, class_sums = self.model.predict(self.X, return_class_sums=True)
+        self.assertEqual(class_sums.shape, (self.X.shape[0], 3))
+        self.assertFalse(class_sums[:, 0].any())
+        np.testing.assert_array_equal(y_pred, class_sums.argmax(axis=1))
+        # Wherever a present class has a clause firing, every present class sum is negative and class 0 wins
+        self.assertTrue((y_pred[(class_sums[:, 1:] < 0).all(axis=1)] == 0).all())
+        self.assertTrue((class_sums[:, 1:] < 0).all(axis=1).any())
+
+
 @unittest.skip("Disabled TMMultiChannelClassifierTests for now.")
 class TMMultiChannelClassifierTests(unittest.TestCase, ClassifierTests):
 
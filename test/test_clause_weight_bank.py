@@ -0,0 +1,118 @@
+import unittest
+
+import numpy as np
+
+from tmu.models.classification.coalesced_classifier import TMCoalescedClassifier
+from tmu.weight_bank import WeightBank
+
+
+def synthetic_dataset(number_of_examples, number_of_features=12, number_of_classes=3, noise=0.05, seed=1):
+    """The class is encoded by which of the first number_of_classes features is set, the rest is noise."""
+    rng = np.random.RandomState(seed)
+    Y = rng.randint(number_of_classes, size=number_of_examples).astype(np.uint32)
+    X = (rng.random_sample((number_of_examples, number_of_features)) < 0.5).astype(np.uint32)
+    X[:, :number_of_classes] = 0
+    X[np.arange(number_of_examples), Y] = 1
+    flip = rng.random_sample(X.shape) < noise
+    X[flip] = 1 - X[flip]
+    return X, Y
+
+
+class ClauseWeightBankFeedbackTests(unittest.TestCase):
+    """cwb_type_i_and_ii_feedback against the per-output clause and weight bank kernels it fuses."""
+
+    number_of_clauses = 20000
+
+    def setUp(self):
+        X, Y = synthetic_dataset(10)
+        self.number_of_features = X.shape[1]
+        self.model = TMCoalescedClassifier(number_of_clauses=self.number_of_clauses, T=10, s=1.0, seed=42)
+        self.model.init(X, Y)
+        self.clause_bank = self.model.clause_bank
+        self.encoded_X = self.clause_bank.prepare_X(np.ones((1, self.number_of_features), dtype=np.uint32))
+        self.clause_active = np.ones(self.number_of_clauses, dtype=np.uint32)
+        self.literal_active = np.full(self.clause_bank.number_of_ta_chunks, 0xffffffff, dtype=np.uint32)
+
+    def fused(self, update_p, type_i_p, type_ii_p, weights, y):
+        weights = np.ascontiguousarray(weights, dtype=np.int32)
+        self.clause_bank.type_i_and_ii_feedback_multi_output(
+            update_p=update_p,
+            type_i_p=type_i_p,
+            type_ii_p=type_ii_p,
+            weights=weights,
+            y=y,
+            clause_active=self.clause_active,
+            literal_active=self.literal_active,
+            encoded_X=self.encoded_X,
+            e=0
+        )
+        return weights
+
+    def changed_clauses(self, before):
+        after = self.clause_bank.clause_bank.reshape(self.number_of_clauses, -1)
+        return (after != before.reshape(self.number_of_clauses, -1)).any(axis=1).mean()
+
+    def test_weight_update_probability_matches_weight_bank(self):
+        # Empty clauses fire on every sample, so every clause is a candidate for the weight update
+        update_p = 0.5
+        weights = self.fused([update_p], 0.0, 0.0, np.zeros((self.number_of_clauses, 1)), [1])
+        fused_rate = (weights[:, 0] == 1).mean()
+
+        weight_bank = WeightBank(np.zeros(self.number_of_clauses, dtype=np.int32))
+        weight_bank.increment(
+            clause_output=np.ones(self.number_of_clauses, dtype=np.uint32),
+            update_p=update_p,
+            clause_active=self.clause_active,
+            positive_weights=True
+        )
+        reference_rate = (weight_bank.get_weights() == 1).mean()
+
+        self.assertAlmostEqual(fused_rate, update_p, delta=0.02)
+        self.assertAlmostEqual(fused_rate, reference_rate, delta=0.03)
+
+    def test_negative_output_decrements_weights(self):
+        weights = self.fused([1.0], 0.0, 0.0, np.zeros((self.number_of_clauses, 1)), [0])
+        self.assertTrue((weights[:, 0] == -1).all())
+
+    def test_type_i_probability_matches_clause_bank(self):
+        type_i_p = 0.25
+        before = self.clause_bank.clause_bank.copy()
+        self.fused([1.0], type_i_p, 1.0, np.zeros((self.number_of_clauses, 1)), [1])
+        fused_rate = self.changed_clauses(before)
+
+        self.clause_bank.clause_bank[:] = before
+        self.clause_bank.type_i_feedback(
+            update_p=type_i_p,
+            clause_active=self.clause_active,
+            literal_active=self.literal_active,
+            encoded_X=self.encoded_X,
+            e=0
+        )
+        reference_rate = self.changed_clauses(before)
+
+        self.assertAlmostEqual(fused_rate, type_i_p, delta=0.02)
+        self.assertAlmostEqual(fused_rate, reference_rate, delta=0.03)
+
+    def test_type_ii_probability_is_scaled(self):
+        # Negative polarity for a target output gives Type II feedback, which only acts on firing clauses
+        type_ii_p = 0.5
+        before = self.clause_bank.clause_bank.copy()
+        self.encoded_X = self.clause_bank.prepare_X(np.zeros((1, self.number_of_features), dtype=np.uint32))
+        self.fused([1.0], 1.0, type_ii_p, np.full((self.number_of_clauses, 1), -5), [1])
+        self.assertAlmostEqual(self.changed_clauses(before), type_ii_p, delta=0.02)
+
+
+class CoalescedFusedUpdateTests(unittest.TestCase):
+
+    def test_fused_update_learns(self):
+        X_train, Y_train = synthetic_dataset(2000)
+        X_test, Y_test = synthetic_dataset(500, seed=2)
+
+        model = TMCoalescedClassifier(number_of_clauses=40, T=20, s=3.0, seed=7)
+        for _ in range(5):
+            model.fit(X_train, Y_train)
+        self.assertGreater((model.predict(X_test) == Y_test).mean(), 0.9)
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,407 @@
+import unittest
+from concurrent.futures import ThreadPoolExecutor
+
+import numpy as np
+
+try:
+    import tmulibpy
+except ImportError:
+    tmulibpy = None
+
+
+def copy_ta_states(native_clause_bank, python_clause_bank, number_of_clauses, number_of_literals):
+    """Writes the TA states of a native TMClauseBankDense into a Python ClauseBank with the same dimensions."""
+    state_bits = python_clause_bank.number_of_state_bits_ta
+    chunks = python_clause_bank.number_of_ta_chunks
+    bank = python_clause_bank.clause_bank.reshape((number_of_clauses, chunks, state_bits))
+    bank[:] = 0
+    for j in range(number_of_clauses):
+        for k in range(number_of_literals):
+            state = native_clause_bank.get_ta_state(j, k)
+            for b in range(state_bits):
+                if state & (1 << b):
+                    bank[j, k // 32, b] |= np.uint32(1 << (k % 32))
+
+
+@unittest.skipUnless(tmulibpy, "tmulibpy is not built")
+class RegressorParityTests(unittest.TestCase):
+
+    def setUp(self):
+        rng = np.random.RandomState(1)
+        self.X = rng.randint(0, 2, size=(400, 12)).astype(np.uint32)
+        self.y = (self.X[:, 0] * 3.0 + self.X[:, 1] * 2.0 + self.X[:, 2]).astype(np.float64)
+        self.args = dict(number_of_clauses=40, T=60, s=2.75, weighted_clauses=True)
+
+    def fitted_native(self, incremental=True):
+        native = tmulibpy.TMVanillaRegressor(incremental=incremental, **self.args)
+        native.fit_epochs(self.X, self.y, epochs=20)
+        return native
+
+    def test_predictions_match_python(self):
+        from tmu.models.regression.vanilla_regressor import TMRegressor
+
+        native = self.fitted_native()
+        model = TMRegressor(platform="CPU", **self.args)
+        model.fit(self.X, self.y)
+
+        copy_ta_states(native.clause_bank, model.clause_bank, self.args["number_of_clauses"], 2 * self.X.shape[1])
+        model.weight_bank.weights[:] = native.weight_bank.get_weights()
+
+        self.assertEqual(native.min_y, model.min_y)
+        self.assertEqual(native.max_y, model.max_y)
+        np.testing.assert_allclose(native.predict(self.X), model.predict(self.X))
+
+    def test_training_error_matches_python(self):
+        from tmu.models.regression.vanilla_regressor import TMRegressor
+
+        native = self.fitted_native()
+        model = TMRegressor(platform="CPU", seed=1, **self.args)
+        for _ in range(20):
+            model.fit(self.X, self.y)
+
+        native_error = np.abs(native.predict(self.X) - self.y).mean()
+        python_error = np.abs(model.predict(self.X) - self.y).mean()
+        self.assertLess(native_error, 1.0)
+        self.assertLess(abs(native_error - python_error), 0.5)
+
+    def test_threaded_predictions_match(self):
+        native = self.fitted_native(incremental=False)
+        np.testing.assert_array_equal(native.predict(self.X, threads=1), native.predict(self.X, threads=4))
+
+    def test_clause_activations_match_predictions(self):
+        native = self.fitted_native(incremental=False)
+        out = native.clause_activations(self.X, sparse=True)
+        offsets = out["offsets"]
+        votes = np.array([out["weights"][offsets[i]:offsets[i + 1]].sum() for i in range(self.X.shape[0])])
+        expected = votes * (native.max_y - native.min_y) / self.args["T"] + native.min_y
+        np.testing.assert_allclose(native.predict(self.X), expected)
+
+
+def multi_output_data():
+    rng = np.random.RandomState(1)
+    X = rng.randint(0, 2, size=(400, 12)).astype(np.uint32)
+    Y = np.stack([X[:, 0] ^ X[:, 1], X[:, 2] & X[:, 3], X[:, 4] | X[:, 5]], axis=1).astype(np.uint32)
+    return X, Y
+
+
+@unittest.skipUnless(tmulibpy, "tmulibpy is not built")
+class MultiOutputParityTests(unittest.TestCase):
+
+    def setUp(self):
+        self.X, self.Y = multi_output_data()
+        self.args = dict(number_of_clauses=40, T=20, s=3.0)
+
+    def fitted_native(self):
+        native = tmulibpy.TMMultiOutputClassifier(seed=1, **self.args)
+        for _ in range(20):
+            native.fit(self.X, self.Y)
+        return native
+
+    def test_class_sums_match_python(self):
+        from tmu.experimental.models.multioutput_classifier import TMCoalesceMultiOuputClassifier
+
+        native = self.fitted_native()
+        model = TMCoalesceMultiOuputClassifier(platform="CPU", weighted_clauses=True, **self.args)
+        model.fit(self.X, self.Y)
+
+        copy_ta_states(native.clause_bank, model.clause_bank, self.args["number_of_clauses"], 2 * self.X.shape[1])
+        for output in range(self.Y.shape[1]):
+            model.weight_banks[output].get_weights()[:] = native.get_weights(output)
+
+        native_pred, native_sums = native.predict(self.X, return_class_sums=True)
+        pred, sums = model.predict(self.X, return_class_sums=True)
+        np.testing.assert_array_equal(native_sums, sums)
+        np.testing.assert_array_equal(native_pred, pred)
+
+    def test_training_accuracy_matches_python(self):
+        from tmu.experimental.models.multioutput_classifier import TMCoalesceMultiOuputClassifier
+
+        native = self.fitted_native()
+        model = TMCoalesceMultiOuputClassifier(platform="CPU", weighted_clauses=True, seed=1, **self.args)
+        for _ in range(20):
+            model.fit(self.X, self.Y)
+
+        native_accuracy = (native.predict(self.X) == self.Y).mean(axis=0)
+        python_accuracy = (model.predict(self.X) == self.Y).mean(axis=0)
+        self.assertTrue(np.all(native_accuracy > 0.95), native_accuracy)
+        self.assertTrue(np.all(np.abs(native_accuracy - python_accuracy) < 0.05), (native_accuracy, python_accuracy))
+
+
+@unittest.skipUnless(tmulibpy, "tmulibpy is not built")
+class MultiTaskParityTests(unittest.TestCase):
+
+    def setUp(self):
+        X, _ = multi_output_data()
+        # Two tasks with their own inputs: x is [task][sample][feature] and y is [task][sample]
+        self.X = np.stack([X, np.ascontiguousarray(X[:, ::-1])]).astype(np.uint32)
+        self.Y = np.stack([X[:, 0] ^ X[:, 1], X[:, 11] & X[:, 10]]).astype(np.uint32)
+        self.args = dict(number_of_clauses=40, T=20, s=3.0)
+
+    def fitted_native(self):
+        native = tmulibpy.TMMultiTaskClassifier(seed=1, **self.args)
+        for _ in range(20):
+            native.fit(self.X, self.Y)
+        return native
+
+    def test_predictions_match_python(self):
+        from tmu.models.classification.multitask_classifier import TMMultiTaskClassifier
+
+        native = self.fitted_native()
+        model = TMMultiTaskClassifier(platform="CPU", weighted_clauses=True, **self.args)
+        model.fit(self.X, self.Y)
+
+        copy_ta_states(native.clause_bank, model.clause_bank, self.args["number_of_clauses"], 2 * self.X.shape[2])
+        for task in range(self.X.shape[0]):
+            model.weight_banks[task].get_weights()[:] = native.get_weights(task)
+
+        native_pred = native.predict(self.X)
+        pred = model.predict(self.X)
+        for task in range(self.X.shape[0]):
+            np.testing.assert_array_equal(native_pred[task], pred[task])
+
+    def test_training_accuracy_matches_python(self):
+        from tmu.models.classification.multitask_classifier import TMMultiTaskClassifier
+
+        native = self.fitted_native()
+        model = TMMultiTaskClassifier(platform="CPU", weighted_clauses=True, seed=1, **self.args)
+        for _ in range(20):
+            model.fit(self.X, self.Y)
+
+        native_pred = native.predict(self.X)
+        pred = model.predict(self.X)
+        for task in range(self.X.shape[0]):
+            native_accuracy = (native_pred[task] == self.Y[task]).mean()
+            python_accuracy = (pred[task] == self.Y[task]).mean()
+            self.assertGreater(native_accuracy, 0.95)
+            self.assertLess(abs(native_accuracy - python_accuracy), 0.05)
+
+
+def multi_class_data():
+    rng = np.random.RandomState(3)
+    X = rng.randint(0, 2, size=(600, 12)).astype(np.uint32)
+    Y = (X[:, 0] + 2 * X[:, 1] + (X[:, 2] & X[:, 3])) % 4
+    return X, Y.astype(np.uint32)
+
+
+@unittest.skipUnless(tmulibpy, "tmulibpy is not built")
+class BranchAndBoundTests(unittest.TestCase):
+    """Branch-and-bound argmax must be identical to the argmax of full evaluation, ties included."""
+
+    number_of_clauses = 40
+
+    def setUp(self):
+        self.X, self.Y = multi_class_data()
+        self.native = self.fitted_native(T=20)
+
+    def fitted_native(self, T):
+        native = tmulibpy.TMVanillaClassifier(
+            T=T, s=3.9, d=200.0, number_of_clauses=self.number_of_clauses, confidence_driven_updating=False,
+            weighted_clauses=True, type_i_feedback=True, type_ii_feedback=True, type_iii_feedback=False,
+            type_i_ii_ratio=1.0, max_included_literals=None, boost_true_positive_feedback=True,
+            reuse_random_feedback=False, number_of_state_bits=8, number_of_state_bits_ind=8, batch_size=100,
+            incremental=False, seed=1
+        )
+        for _ in range(10):
+            native.fit(self.X, self.Y, shuffle=False, metrics=[])
+        return native
+
+    def include_planes(self, the_class):
+        clause_bank = self.native.clause_banks[the_class]
+        bank = clause_bank.get_clause_bank().reshape(
+            (self.number_of_clauses, clause_bank.number_of_ta_chunks, clause_bank.number_of_state_bits))
+        return bank[:, :, -1]
+
+    def assert_matches_full_evaluation(self, X):
+        for clip_class_sum in (False, True):
+            full, _ = self.native.predict(X, clip_class_sum=clip_class_sum)
+            bounded, _ = self.native.predict(X, clip_class_sum=clip_class_sum, use_branch_and_bound=True)
+            np.testing.assert_array_equal(bounded, full, err_msg=f"clip_class_sum={clip_class_sum}")
+
+    def test_trained_model(self):
+        self.assert_matches_full_evaluation(self.X)
+        self.assertLessEqual(self.native.branch_and_bound_evaluated_clauses, self.native.branch_and_bound_total_clauses)
+
+    def test_tied_class_sums(self):
+        # Class 1 becomes a copy of class 0, so their class sums tie on every sample
+        self.native.clause_banks[1].get_clause_bank()[:] = self.native.clause_banks[0].get_clause_bank()
+        self.native.weight_banks[1].get_weights()[:] = self.native.weight_banks[0].get_weights()
+        self.native.invalidate_branch_and_bound()
+
+        _, class_sums = self.native.predict(self.X, clip_class_sum=False, return_class_sum=True)
+        np.testing.assert_array_equal(class_sums[:, 0], class_sums[:, 1])
+        self.assert_matches_full_evaluation(self.X)
+
+    def test_clipped_ties(self):
+        # A small T clips most winning class sums to the same value
+        self.native = self.fitted_native(T=2)
+        _, class_sums = self.native.predict(self.X, clip_class_sum=True, return_class_sum=True)
+        self.assertTrue(np.any((class_sums == class_sums.max(axis=1, keepdims=True)).sum(axis=1) > 1))
+        self.assert_matches_full_evaluation(self.X)
+
+    def test_zero_weight_clauses(self):
+        for the_class in self.native.weight_banks.classes():
+            self.native.weight_banks[the_class].get_weights()[::2] = 0
+        self.native.invalidate_branch_and_bound()
+        self.assert_matches_full_evaluation(self.X)
+
+    def test_clauses_without_literals(self):
+        for the_class in self.native.clause_banks.classes():
+            self.include_planes(the_class)[::3] = 0
+        self.native.invalidate_branch_and_bound()
+        self.assert_matches_full_evaluation(self.X)
+
+    def test_concurrent_predictions(self):
+        # Each call has its own Scratch and shares the order, with the GIL released
+        for the_class in self.native.weight_banks.classes():
+            self.native.weight_banks[the_class].get_weights()[::5] = 0
+            self.include_planes(the_class)[1::7] = 0
+        self.native.invalidate_branch_and_bound()
+
+        chunks = np.array_split(self.X, 8)
+        for clip_class_sum in (False, True):
+            full = [self.native.predict(X, clip_class_sum=clip_class_sum)[0] for X in chunks]
+            with ThreadPoolExecutor(max_workers=4) as executor:
+                bounded = list(executor.map(
+                    lambda X: self.native.predict(X, clip_class_sum=clip_class_sum, use_branch_and_bound=True)[0],
+                    chunks))
+            for b, f in zip(bounded, full):
+                np.testing.assert_array_equal(b, f)
+
+
+@unittest.skipUnless(tmulibpy, "tmulibpy is not built")
+class LiteralTelemetryTests(unittest.TestCase):
+
+    def test_counts_match_clause_banks(self):
+        X, Y = multi_class_data()
+        native = tmulibpy.TMVanillaClassifier(
+            T=20, s=3.9, d=200.0, number_of_clauses=20, confidence_driven_updating=False,
+            weighted_clauses=True, type_i_feedback=True, type_ii_feedback=True, type_iii_feedback=False,
+            type_i_ii_ratio=1.0, max_included_literals=None, boost_true_positive_feedback=True,
+            reuse_random_feedback=False, number_of_state_bits=8, number_of_state_bits_ind=8, batch_size=100,
+            incremental=False, seed=1
+        )
+        native.enable_literal_telemetry()
+        for _ in range(3):
+            native.fit(X, Y, shuffle=False, metrics=[])
+
+        telemetry = native.literal_telemetry()
+        self.assertTrue(telemetry["last_epoch_include_flips"].any())
+        for position, the_class in enumerate(telemetry["classes"]):
+            clause_bank = native.clause_banks[the_class]
+            include_state = 1 << (clause_bank.number_of_state_bits - 1)
+            for k in range(clause_bank.number_of_literals):
+                including = sum(clause_bank.get_ta_state(j, k) >= include_state for j in range(20))
+                self.assertEqual(telemetry["clauses_including"][position, k], including)
+
+
+@unittest.skipUnless(tmulibpy, "tmulibpy is not built")
+class ClauseAnalysisParityTests(unittest.TestCase):
+    """The engine's transposed clause statistics and heatmaps against the per-sample Python kernels, on one model."""
+
+    def setUp(self):
+        from tmu.models.classification.vanilla_classifier import TMClassifier
+
+        rng = np.random.RandomState(2)
+        self.X = rng.randint(0, 2, size=(300, 6, 6)).astype(np.uint32)
+        self.Y = ((self.X[:, :3, :3].sum(axis=(1, 2)) > 4).astype(np.uint32) +
+                  (self.X[:, 3:, 3:].sum(axis=(1, 2)) > 4).astype(np.uint32))
+        self.model = TMClassifier(number_of_clauses=20, T=10, s=3.9, patch_dim=(3, 3), platform="CPP", seed=1)
+        for _ in range(5):
+            self.model.fit(self.X, self.Y)
+        # The Python banks are views of the engine's memory, so both sides evaluate the same clauses
+        self.classes = list(self.model.engine.weight_banks.classes())
+        self.assertEqual(self.classes, list(range(3)))
+
+    def test_clause_statistics_match_python(self):
+        statistics = self.model.engine.clause_statistics(self.X, self.Y)
+        half = self.model.number_of_clauses // 2
+        for position, the_class in enumerate(statistics["classes"]):
+            for polarity in (0, 1):
+                clauses = slice(polarity * half, (polarity + 1) * half)
+                np.testing.assert_allclose(statistics["precision"][position, clauses],
+                                           self.model.clause_precision(the_class, polarity, self.X, self.Y))
+                np.testing.assert_allclose(statistics["recall"][position, clauses],
+                                           self.model.clause_recall(the_class, polarity, self.X, self.Y))
+
+    def test_patch_heatmaps_match_patchwise_outputs(self):
+        heatmaps = self.model.engine.patch_heatmaps(self.X)["heatmaps"]
+        number_of_patches = self.model.clause_banks[0].number_of_patches
+        heatmaps = heatmaps.reshape(self.X.shape[0], len(self.classes), number_of_patches)
+
+        encoded_X = self.model.clause_banks[0].prepare_X(self.X)
+        for the_class in self.classes:
+            clause_bank = self.model.clause_banks[the_class]
+            weights = self.model.weight_banks[the_class].get_weights()
+            # The patchwise kernel matches every patch with a clause that includes no literals, prediction never does
+            empty = np.array([clause_bank.number_of_include_actions(j) == 0
+                              for j in range(self.model.number_of_clauses)])
+            for e in range(self.X.shape[0]):
+                outputs = clause_bank.calculate_clause_outputs_patchwise(encoded_X, e).reshape(
+                    self.model.number_of_clauses, number_of_patches).astype(np.int64)
+                outputs[empty] = 0
+                np.testing.assert_array_equal(heatmaps[e, the_class], weights @ outputs)
+
+
+def topic_data():
+    # Each row belongs to one of 4 topics and mostly contains the first 6 of that topic's 8 words, plus noise
+    rng = np.random.RandomState(1)
+    rows, topics, words = 600, 4, 8
+    topic = rng.randint(topics, size=rows)
+    X = (rng.rand(rows, topics * words) < 0.02).astype(np.uint32)
+    for t in range(topics):
+        X[topic == t, t * words:t * words + 6] = rng.rand((topic == t).sum(), 6) < 0.9
+    output_active = np.arange(0, topics * words, words, dtype=np.uint32)
+    return X, output_active
+
+
+@unittest.skipUnless(tmulibpy, "tmulibpy is not built")
+class AutoEncoderTests(unittest.TestCase):
+
+    def setUp(self):
+        from scipy.sparse import csr_matrix, csc_matrix
+
+        self.X, self.output_active = topic_data()
+        self.X_csr = csr_matrix(self.X)
+        self.X_csc = csc_matrix(self.X).sorted_indices()
+        self.args = dict(number_of_clauses=40, T=20, s=5.0, max_included_literals=8, output_balancing=0.5)
+
+    def fitted_native(self, number_of_threads, seed=1):
+        native = tmulibpy.TMAutoEncoder(output_active=self.output_active.tolist(), number_of_threads=number_of_threads,
+                                        seed=seed, **self.args)
+        for _ in range(5):
+            native.fit(
+                self.X_csr.indptr.astype(np.uint32), self.X_csr.indices.astype(np.uint32),
+                self.X_csc.indptr.astype(np.uint32), self.X_csc.indices.astype(np.uint32),
+                self.X.shape[0], self.X.shape[1], number_of_examples=200
+            )
+        return native
+
+    def native_predict(self, native):
+        return native.predict(self.X_csr.indptr.astype(np.uint32), self.X_csr.indices.astype(np.uint32),
+                              self.X.shape[0])
+
+    def test_deterministic_for_seed_and_threads(self):
+        for number_of_threads in (1, 3):
+            a = self.fitted_native(number_of_threads)
+            b = self.fitted_native(number_of_threads)
+            np.testing.assert_array_equal(a.get_clause_bank(), b.get_clause_bank())
+            np.testing.assert_array_equal(a.get_weights(), b.get_weights())
+            np.testing.assert_array_equal(self.native_predict(a), self.native_predict(b))
+
+    def test_accuracy_matches_python(self):
+        from tmu.models.autoencoder.autoencoder import TMAutoEncoder
+
+        native = self.fitted_native(number_of_threads=2)
+        model = TMAutoEncoder(output_active=self.output_active, platform="CPU", seed=1, **self.args)
+        for _ in range(5):
+            model.fit(self.X, number_of_examples=200)
+
+        Y = self.X[:, self.output_active]
+        native_accuracy = (self.native_predict(native) == Y).mean()
+        python_accuracy = (model.predict(self.X) == Y).mean()
+        self.assertGreater(native_accuracy, 0.9)
+        self.assertLess(abs(native_accuracy - python_accuracy), 0.05)
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,37 @@
+import threading
+import unittest
+
+import numpy as np
+
+from tmu.models.classification.vanilla_classifier import TMClassifier
+from test.test_clause_weight_bank import synthetic_dataset
+
+
+class GeneratorSeedTests(unittest.TestCase):
+    """The generator state set by the seed is shared by the process, not only the thread that built the model."""
+
+    def model(self, X, Y):
+        model = TMClassifier(number_of_clauses=20, T=10, s=3.0, seed=5, platform="CPU")
+        model.init(X, Y)
+        return model
+
+    @staticmethod
+    def clause_banks(model):
+        return np.concatenate([clause_bank.clause_bank.ravel() for _, clause_bank in model.clause_banks.items()])
+
+    def test_fit_on_another_thread_uses_the_seed(self):
+        X, Y = synthetic_dataset(500)
+
+        here = self.model(X, Y)
+        here.fit(X, Y)
+
+        elsewhere = self.model(X, Y)
+        thread = threading.Thread(target=elsewhere.fit, args=(X, Y))
+        thread.start()
+        thread.join()
+
+        np.testing.assert_array_equal(self.clause_banks(here), self.clause_banks(elsewhere))
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -292,6 +292,65 @@ class ClauseBank(BaseClauseBank):
 
         self.incremental_clause_evaluation_initialized = False
 
+    def type_i_and_ii_feedback_multi_output(
+        self,
+        update_p,
+        type_i_p,
+        type_ii_p,
+        weights,
+        y,
+        clause_active,
+        literal_active,
+        encoded_X,
+        e,
+        output_literal_index=None
+    ):
+        """
+        Type I and Type II feedback, and weight updates, for all outputs in one pass over the clauses.
+        weights is a C-contiguous int32 array of shape (number_of_clauses, number_of_outputs), update_p and
+        y hold one entry per output. Type I and Type II feedback are selected with probability update_p
+        scaled by type_i_p and type_ii_p, and weight updates independently with probability update_p.
+        With output_literal_index given, each output hides its own literal from the clauses (autoencoder mode).
+        """
+        number_of_outputs = weights.shape[1]
+        update_p = np.ascontiguousarray(update_p, dtype=np.float32)
+        y = np.ascontiguousarray(y, dtype=np.uint32)
+        autoencoder = output_literal_index is not None
+        if autoencoder:
+            output_literal_index = np.ascontiguousarray(output_literal_index, dtype=np.uint32)
+        else:
+            output_literal_index = np.zeros(number_of_outputs, dtype=np.uint32)
+
+        ptr_xi = ffi.cast("unsigned int *", encoded_X[e, :].ctypes.data)
+        ptr_clause_active = ffi.cast("unsigned int *", clause_active.ctypes.data)
+        ptr_literal_active = ffi.cast("unsigned int *", literal_active.ctypes.data)
+
+        lib.cwb_type_i_and_ii_feedback(
+            self.ptr_ta_state,
+            ffi.cast("int *", weights.ctypes.data),
+            self.ptr_feedback_to_ta,
+            self.ptr_output_one_patches,
+            number_of_outputs,
+            self.number_of_clauses,
+            self.number_of_literals,
+            self.number_of_state_bits_ta,
+            self.number_of_patches,
+            ffi.cast("float *", update_p.ctypes.data),
+            type_i_p,
+            type_ii_p,
+            self.s,
+            self.boost_true_positive_feedback,
+            self.max_included_literals,
+            ptr_clause_active,
+            ptr_literal_active,
+            ptr_xi,
+            ffi.cast("unsigned int *", y.ctypes.data),
+            ffi.cast("unsigned int *", output_literal_index.ctypes.data),
+            int(autoencoder)
+        )
+
+        self.incremental_clause_evaluation_initialized = False
+
 
     def type_iii_feedback(
             self,
@@ -408,7 +467,29 @@ class ClauseBank(BaseClauseBank):
             active_output
     ):
         X = np.ascontiguousarray(np.empty(int(self.number_of_ta_chunks), dtype=np.uint32))
-        return X_csr, X_csc, active_output, X
+
+        # Rows outside the column of each dense output, so that negative examples need no rejection sampling
+        indptr_col = np.ascontiguousarray(X_csc.indptr, dtype=np.uint32)
+        indices_col = np.ascontiguousarray(X_csc.indices, dtype=np.uint32)
+        complement_size = lib.tmu_autoencoder_complement_size(
+            ffi.cast("unsigned int *", active_output.ctypes.data),
+            active_output.shape[0],
+            ffi.cast("unsigned int *", indptr_col.ctypes.data),
+            int(X_csc.shape[0])
+        )
+        indptr_complement = np.zeros(active_output.shape[0] + 1, dtype=np.uint64)
+        indices_complement = np.zeros(max(complement_size, 1), dtype=np.uint32)
+        lib.tmu_autoencoder_complement_index(
+            ffi.cast("unsigned int *", active_output.ctypes.data),
+            active_output.shape[0],
+            ffi.cast("unsigned int *", indptr_col.ctypes.data),
+            ffi.cast("unsigned int *", indices_col.ctypes.data),
+            int(X_csc.shape[0]),
+            ffi.cast("uint64_t *", indptr_complement.ctypes.data),
+            ffi.cast("unsigned int *", indices_complement.ctypes.data)
+        )
+
+        return X_csr, X_csc, active_output, X, indptr_complement, indices_complement
 
     def produce_autoencoder_example(
             self,
@@ -417,20 +498,41 @@ class ClauseBank(BaseClauseBank):
             target_true_p,
             accumulation
     ):
-        (X_csr, X_csc, active_output, X) = encoded_X
-
-        target_value = self.rng.random() <= target_true_p
+        X, target_values = self.produce_autoencoder_examples(
+            encoded_X,
+            np.array([target], dtype=np.uint32),
+            np.array([target_true_p]),
+            accumulation
+        )
+        return X, target_values[0]
 
-        lib.tmu_produce_autoencoder_example(ffi.cast("unsigned int *", active_output.ctypes.data), active_output.shape[0],
+    def produce_autoencoder_examples(
+            self,
+            encoded_X,
+            targets,
+            target_true_p,
+            accumulation
+    ):
+        """One example per entry of targets, an index into the active outputs, in a single call into the library.
+        Returns the examples as rows of packed literals, and whether each is a positive example of its target."""
+        (X_csr, X_csc, active_output, _, indptr_complement, indices_complement) = encoded_X
+
+        targets = np.ascontiguousarray(targets, dtype=np.uint32)
+        target_values = np.ascontiguousarray(self.rng.random(targets.shape[0]) <= target_true_p, dtype=np.uint32)
+        X = np.empty((targets.shape[0], self.number_of_ta_chunks), dtype=np.uint32)
+        lib.tmu_produce_autoencoder_examples(ffi.cast("unsigned int *", active_output.ctypes.data),
                                              ffi.cast("unsigned int *", np.ascontiguousarray(X_csr.indptr).ctypes.data),
                                              ffi.cast("unsigned int *", np.ascontiguousarray(X_csr.indices).ctypes.data),
                                              int(X_csr.shape[0]),
                                              ffi.cast("unsigned int *", np.ascontiguousarray(X_csc.indptr).ctypes.data),
                                              ffi.cast("unsigned int *", np.ascontiguousarray(X_csc.indices).ctypes.data),
                                              int(X_csc.shape[1]),
+                                             ffi.cast("uint64_t *", indptr_complement.ctypes.data),
+                                             ffi.cast("unsigned int *", indices_complement.ctypes.data),
                                              ffi.cast("unsigned int *", X.ctypes.data),
-                                             int(target),
-                                             int(target_value),
+                                             ffi.cast("unsigned int *", targets.ctypes.data),
+                                             ffi.cast("unsigned int *", target_values.ctypes.data),
+                                             targets.shape[0],
                                              int(accumulation))
 
-        return X.reshape((1, -1)), target_value
+        return X, target_values
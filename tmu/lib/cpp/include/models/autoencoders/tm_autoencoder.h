@@ -0,0 +1,480 @@
+#ifndef TUMLIBPP_TM_AUTOENCODER_H
+#define TUMLIBPP_TM_AUTOENCODER_H
+#include <cmath>
+#include <random>
+#include <barrier>
+#include <numeric>
+#include <algorithm>
+#include <stdexcept>
+#include <tcb/span.hpp>
+#include <tl/optional.hpp>
+#include "utils/tm_math.h"
+#include "utils/tm_parallel.h"
+
+extern "C" {
+    #include "ClauseBank.h"
+    #include "WeightBank.h"
+    #include "Tools.h"
+    #include "fast_rand.h"
+}
+
+/*
+ * Sparse binary data in the form tmu_produce_autoencoder_examples reads it: the same matrix as CSR rows and as CSC
+ * columns with sorted row indices. The views are not owned.
+ */
+struct TMAutoEncoderData {
+    tcb::span<const uint32_t> indptr_row;
+    tcb::span<const uint32_t> indices_row;
+    tcb::span<const uint32_t> indptr_col;
+    tcb::span<const uint32_t> indices_col;
+    int number_of_rows;
+    int number_of_cols;
+};
+
+/*
+ * Tsetlin Machine AutoEncoder: one clause bank over all features, and one weight vector per output feature.
+ *
+ * Training uses number_of_threads workers, each owning a contiguous range of clauses. In every round the workers first
+ * generate the examples of a share of the outputs each, and then all workers evaluate and update their clauses for
+ * one output at a time. One barrier per output sums the partial class sums. As no clause is touched by two workers,
+ * the updates need no locks and follow the same algorithm as TMAutoEncoder in Python.
+ */
+template<class Type>
+class TMAutoEncoder {
+
+public:
+    int T;
+    float s;
+    float d;
+    uint32_t number_of_clauses;
+    std::vector<uint32_t> output_active;
+    int accumulation;
+    float type_i_p;
+    float type_ii_p;
+    bool type_iii_feedback;
+    float output_balancing;
+    float upsampling;
+    tl::optional<std::size_t> max_included_literals;
+    bool boost_true_positive_feedback;
+    bool reuse_random_feedback;
+    int32_t number_of_state_bits;
+    int32_t number_of_state_bits_ind;
+    float clause_drop_p;
+    float literal_drop_p;
+    bool feature_negation;
+    bool squared_weight_update_p;
+    std::size_t number_of_threads;
+    int seed;
+
+    std::size_t number_of_features = 0;
+    std::size_t number_of_literals = 0;
+    std::size_t number_of_ta_chunks = 0;
+
+    std::vector<Type> clause_bank;          // [clause][ta_chunk][state_bit]
+    std::vector<Type> clause_bank_ind;      // [clause][ta_chunk][state_bit_ind]
+    std::vector<Type> clause_and_target;    // [clause][ta_chunk]
+    std::vector<int32_t> weights;           // [output][clause]
+    std::vector<float> feature_true_probability; // [feature]
+
+    bool _is_initialized = false;
+
+    TMAutoEncoder(
+            int _T,
+            float _s,
+            float _d,
+            uint32_t _number_of_clauses,
+            std::vector<uint32_t> _output_active,
+            int _accumulation,
+            float _type_i_ii_ratio,
+            bool _type_iii_feedback,
+            float _output_balancing,
+            float _upsampling,
+            tl::optional<std::size_t> _max_included_literals,
+            bool _boost_true_positive_feedback,
+            bool _reuse_random_feedback,
+            int32_t _number_of_state_bits,
+            int32_t _number_of_state_bits_ind,
+            float _clause_drop_p,
+            float _literal_drop_p,
+            bool _feature_negation,
+            bool _squared_weight_update_p,
+            std::size_t _number_of_threads,
+            int _seed
+    )
+    : T(_T)
+    , s(_s)
+    , d(_d)
+    , number_of_clauses(_number_of_clauses)
+    , output_active(std::move(_output_active))
+    , accumulation(_accumulation)
+    , type_i_p(_type_i_ii_ratio >= 1.0f ? 1.0f : _type_i_ii_ratio)
+    , type_ii_p(_type_i_ii_ratio >= 1.0f ? 1.0f / _type_i_ii_ratio : 1.0f)
+    , type_iii_feedback(_type_iii_feedback)
+    , output_balancing(_output_balancing)
+    , upsampling(_upsampling)
+    , max_included_literals(_max_included_literals)
+    , boost_true_positive_feedback(_boost_true_positive_feedback)
+    , reuse_random_feedback(_reuse_random_feedback)
+    , number_of_state_bits(_number_of_state_bits)
+    , number_of_state_bits_ind(_number_of_state_bits_ind)
+    , clause_drop_p(_clause_drop_p)
+    , literal_drop_p(_literal_drop_p)
+    , feature_negation(_feature_negation)
+    , squared_weight_update_p(_squared_weight_update_p)
+    , number_of_threads(_number_of_threads)
+    , seed(_seed)
+    , rng(_seed)
+    {
+        // Training runs every worker at once, as they meet at barriers
+        number_of_threads = std::max<std::size_t>(1, std::min<std::size_t>(
+                TMParallel::resolve_threads(number_of_threads), number_of_clauses));
+    }
+
+    [[nodiscard]] std::size_t number_of_outputs() const {
+        return output_active.size();
+    }
+
+    void init(const TMAutoEncoderData& data){
+        if(_is_initialized){
+            return;
+        }
+        if(data.number_of_rows == 0){
+            throw std::invalid_argument("Cannot initialize an autoencoder without training rows");
+        }
+        for (const auto output : output_active) {
+            if (output >= static_cast<uint32_t>(data.number_of_cols)) {
+                throw std::invalid_argument("Active output " + std::to_string(output) + " is not a feature");
+            }
+        }
+        _is_initialized = true;
+
+        number_of_features = data.number_of_cols;
+        number_of_literals = 2 * number_of_features;
+        number_of_ta_chunks = (number_of_literals - 1) / 32 + 1;
+        if (!max_included_literals.has_value()) {
+            max_included_literals = number_of_literals;
+        }
+
+        // Exclude with the highest exclude state, like TMClauseBankDense
+        clause_bank.assign(number_of_clauses * number_of_ta_chunks * number_of_state_bits, 0);
+        for (std::size_t j = 0; j < number_of_clauses * number_of_ta_chunks; ++j) {
+            for (int b = 0; b < number_of_state_bits - 1; ++b) {
+                clause_bank[j * number_of_state_bits + b] = ~Type(0);
+            }
+        }
+        clause_bank_ind.assign(number_of_clauses * number_of_ta_chunks * number_of_state_bits_ind, ~Type(0));
+        clause_and_target.assign(number_of_clauses * number_of_ta_chunks, 0);
+
+        // Every output starts from the same random polarities
+        std::vector<int32_t> polarity(number_of_clauses);
+        std::uniform_int_distribution<int> coin(0, 1);
+        for (auto& w : polarity) {
+            w = coin(rng) ? 1 : -1;
+        }
+        weights.resize(number_of_outputs() * number_of_clauses);
+        for (std::size_t i = 0; i < number_of_outputs(); ++i) {
+            std::copy(polarity.begin(), polarity.end(), weights.begin() + i * number_of_clauses);
+        }
+
+        feature_true_probability.resize(number_of_features);
+        for (std::size_t k = 0; k < number_of_features; ++k) {
+            if (output_balancing == 0) {
+                const float frequency = static_cast<float>(data.indptr_col[k + 1] - data.indptr_col[k]) / data.number_of_rows;
+                feature_true_probability[k] = std::pow(frequency, 1.0f / upsampling);
+            } else {
+                feature_true_probability[k] = output_balancing;
+            }
+        }
+    }
+
+    std::vector<uint32_t> mechanism_literal_active() const {
+        std::vector<uint32_t> literal_active(number_of_ta_chunks, 0);
+        for (std::size_t k = 0; k < number_of_literals; ++k) {
+            const auto rng = fast_rand() / static_cast<float>(FAST_RAND_MAX);
+            if (rng >= literal_drop_p && (feature_negation || k < number_of_features)) {
+                literal_active[k / 32] |= (1u << (k % 32));
+            }
+        }
+        return literal_active;
+    }
+
+    std::vector<uint32_t> mechanism_clause_active() const {
+        std::vector<uint32_t> clause_active(number_of_clauses, 0);
+        for (std::size_t j = 0; j < number_of_clauses; ++j) {
+            const auto rng = fast_rand() / static_cast<float>(FAST_RAND_MAX);
+            clause_active[j] = static_cast<uint32_t>(rng >= clause_drop_p);
+        }
+        return clause_active;
+    }
+
+    /*
+     * Trains on number_of_examples rounds. Each round visits all outputs in random order with one generated example
+     * each, like TMAutoEncoder.fit in Python.
+     */
+    void fit(const TMAutoEncoderData& data, int number_of_examples){
+        init(data);
+        if (static_cast<std::size_t>(data.number_of_cols) != number_of_features) {
+            throw std::invalid_argument("The autoencoder was initialized with " + std::to_string(number_of_features) + " features");
+        }
+
+        const auto clause_active = mechanism_clause_active();
+        const auto literal_active = mechanism_literal_active();
+
+        const std::size_t number_of_outputs = this->number_of_outputs();
+        std::vector<uint32_t> output_order(number_of_outputs);
+        std::iota(output_order.begin(), output_order.end(), 0);
+
+        // Negative examples of dense outputs are drawn from the rows outside their column
+        std::vector<uint64_t> indptr_complement(number_of_outputs + 1);
+        std::vector<uint32_t> indices_complement(std::max<uint64_t>(1, tmu_autoencoder_complement_size(
+                const_cast<uint32_t*>(output_active.data()),
+                static_cast<int>(number_of_outputs),
+                const_cast<uint32_t*>(data.indptr_col.data()),
+                data.number_of_rows
+        )));
+        tmu_autoencoder_complement_index(
+                const_cast<uint32_t*>(output_active.data()),
+                static_cast<int>(number_of_outputs),
+                const_cast<uint32_t*>(data.indptr_col.data()),
+                const_cast<uint32_t*>(data.indices_col.data()),
+                data.number_of_rows,
+                indptr_complement.data(),
+                indices_complement.data()
+        );
+
+        // Each worker generates the examples of its share of the outputs at the start of a round
+        std::vector<Type> examples(number_of_outputs * number_of_ta_chunks);
+        std::vector<uint32_t> output_index(output_order);
+        std::vector<uint32_t> targets(number_of_outputs);
+        std::vector<uint8_t> type_iii_selection(number_of_outputs);
+        int round = 0;
+
+        auto shuffle_outputs = [&]() noexcept {
+            if (round++ < number_of_examples) {
+                std::shuffle(output_order.begin(), output_order.end(), rng);
+            }
+        };
+
+        const auto workers = static_cast<std::ptrdiff_t>(number_of_threads);
+        std::barrier round_barrier(workers, shuffle_outputs);
+        std::barrier output_barrier(workers);
+
+        // Double buffered, so a worker may start the next output while others still read the previous sums
+        std::vector<int32_t> partial_class_sums(2 * number_of_threads);
+        const uint64_t seed_base = (static_cast<uint64_t>(seed) << 32) ^ (static_cast<uint64_t>(++_fit_calls) << 16);
+
+        auto work = [&](std::size_t t) {
+            const TMParallel::RandomStream random_stream((seed_base + t) * 2 + 1);
+
+            const std::size_t a = number_of_clauses * t / number_of_threads;
+            const std::size_t b = number_of_clauses * (t + 1) / number_of_threads;
+            const int n = static_cast<int>(b - a);
+
+            Type* ta_state = &clause_bank[a * number_of_ta_chunks * number_of_state_bits];
+            Type* ind_state = &clause_bank_ind[a * number_of_ta_chunks * number_of_state_bits_ind];
+            Type* and_target = &clause_and_target[a * number_of_ta_chunks];
+
+            const std::vector<uint32_t> all_literal_active(number_of_ta_chunks, ~0u);
+            std::vector<uint32_t> literal_active_output(literal_active);
+            std::vector<uint32_t> update_clause(n);
+            std::vector<uint32_t> positive(n);
+            std::vector<uint32_t> negative(n);
+            std::vector<uint32_t> clause_output(n);
+            std::vector<uint32_t> feedback_to_ta(number_of_ta_chunks);
+            std::vector<uint32_t> output_one_patches(1);
+
+            const std::size_t first_output = number_of_outputs * t / number_of_threads;
+            const std::size_t last_output = number_of_outputs * (t + 1) / number_of_threads;
+
+            for (int e = 0; e < number_of_examples; ++e) {
+                round_barrier.arrive_and_wait();
+
+                for (std::size_t i = first_output; i < last_output; ++i) {
+                    const auto rng = fast_rand() / static_cast<float>(FAST_RAND_MAX);
+                    targets[i] = rng <= feature_true_probability[output_active[i]];
+                    type_iii_selection[i] = static_cast<uint8_t>(fast_rand() & 1);
+                }
+                tmu_produce_autoencoder_examples(
+                        const_cast<uint32_t*>(output_active.data()),
+                        const_cast<uint32_t*>(data.indptr_row.data()),
+                        const_cast<uint32_t*>(data.indices_row.data()),
+                        data.number_of_rows,
+                        const_cast<uint32_t*>(data.indptr_col.data()),
+                        const_cast<uint32_t*>(data.indices_col.data()),
+                        data.number_of_cols,
+                        indptr_complement.data(),
+                        indices_complement.data(),
+                        &examples[first_output * number_of_ta_chunks],
+                        &output_index[first_output],
+                        &targets[first_output],
+                        static_cast<int>(last_output - first_output),
+                        accumulation
+                );
+
+                // Clauses with large weights on average are updated less often
+                for (std::size_t j = a; j < b; ++j) {
+                    float average_absolute_weight = 0.0f;
+                    for (std::size_t i = 0; i < number_of_outputs; ++i) {
+                        average_absolute_weight += std::abs(weights[i * number_of_clauses + j]);
+                    }
+                    average_absolute_weight /= number_of_outputs;
+                    const float p = (T - std::min(average_absolute_weight, static_cast<float>(T))) / T;
+                    update_clause[j - a] = clause_active[j] && fast_rand() / static_cast<float>(FAST_RAND_MAX) <= p;
+                }
+
+                output_barrier.arrive_and_wait();
+
+                for (std::size_t o = 0; o < number_of_outputs; ++o) {
+                    const auto i = output_order[o];
+                    Type* Xu = &examples[i * number_of_ta_chunks];
+                    int32_t* output_weights = &weights[i * number_of_clauses + a];
+
+                    // The output itself must not be used to predict it
+                    const std::size_t literal = output_active[i];
+                    const std::size_t negated_literal = literal + number_of_features;
+                    literal_active_output[literal / 32] &= ~(1u << (literal % 32));
+                    literal_active_output[negated_literal / 32] &= ~(1u << (negated_literal % 32));
+
+                    cb_calculate_clause_outputs_update(
+                            ta_state, n, static_cast<int>(number_of_literals), number_of_state_bits, 1,
+                            clause_output.data(), const_cast<uint32_t*>(all_literal_active.data()), Xu
+                    );
+
+                    int32_t partial_class_sum = 0;
+                    for (int j = 0; j < n; ++j) {
+                        partial_class_sum += static_cast<int32_t>(update_clause[j] * clause_output[j]) * output_weights[j];
+                        positive[j] = update_clause[j] && output_weights[j] >= 0;
+                        negative[j] = update_clause[j] && output_weights[j] < 0;
+                    }
+                    int32_t* class_sums = &partial_class_sums[(o % 2) * number_of_threads];
+                    class_sums[t] = partial_class_sum;
+
+                    output_barrier.arrive_and_wait();
+
+                    const int32_t class_sum = TMMath::clamp(
+                            std::accumulate(class_sums, class_sums + number_of_threads, 0), -T, T
+                    );
+                    const bool target = targets[i];
+                    float update_p = static_cast<float>(target ? T - class_sum : T + class_sum) / (2 * T);
+                    if (squared_weight_update_p) {
+                        update_p *= update_p;
+                    }
+
+                    // Clauses voting for the target are reinforced, the others are made to reject it
+                    auto& voting_for = target ? positive : negative;
+                    auto& voting_against = target ? negative : positive;
+
+                    cb_type_i_feedback(
+                            ta_state, feedback_to_ta.data(), output_one_patches.data(), n,
+                            static_cast<int>(number_of_literals), number_of_state_bits, 1, update_p * type_i_p, s,
+                            boost_true_positive_feedback, reuse_random_feedback,
+                            static_cast<unsigned int>(max_included_literals.value()),
+                            voting_for.data(), literal_active_output.data(), Xu
+                    );
+                    cb_type_ii_feedback(
+                            ta_state, output_one_patches.data(), n, static_cast<int>(number_of_literals),
+                            number_of_state_bits, 1, update_p * type_ii_p,
+                            voting_against.data(), literal_active_output.data(), Xu
+                    );
+
+                    if (target) {
+                        wb_increment(output_weights, n, clause_output.data(), update_p, update_clause.data(), 1);
+                    } else {
+                        wb_decrement(output_weights, n, clause_output.data(), update_p, update_clause.data(), 1);
+                    }
+
+                    if (type_iii_feedback && type_iii_selection[i] == !target) {
+                        cb_type_iii_feedback(
+                                ta_state, ind_state, and_target, output_one_patches.data(), n,
+                                static_cast<int>(number_of_literals), number_of_state_bits, number_of_state_bits_ind, 1,
+                                update_p, d, voting_for.data(), literal_active_output.data(), Xu, 1
+                        );
+                        cb_type_iii_feedback(
+                                ta_state, ind_state, and_target, output_one_patches.data(), n,
+                                static_cast<int>(number_of_literals), number_of_state_bits, number_of_state_bits_ind, 1,
+                                update_p, d, voting_against.data(), literal_active_output.data(), Xu, 0
+                        );
+                    }
+
+                    literal_active_output[literal / 32] = literal_active[literal / 32];
+                    literal_active_output[negated_literal / 32] = literal_active[negated_literal / 32];
+                }
+            }
+            // Lets the completion step see the end of training
+            round_barrier.arrive_and_wait();
+        };
+
+        // One item per worker, so every worker gets its own thread
+        TMParallel::for_ranges(number_of_threads, number_of_threads, 1, [&](std::size_t t, std::size_t, std::size_t) {
+            work(t);
+        });
+    }
+
+    /*
+     * Reconstructs the active outputs of each CSR row into y_pred[row][output]. Rows are split over the workers.
+     */
+    void predict_batch(
+            const tcb::span<const uint32_t>& indptr_row,
+            const tcb::span<const uint32_t>& indices_row,
+            int number_of_rows,
+            uint32_t* y_pred
+    ) const {
+        if (!_is_initialized) {
+            throw std::runtime_error("The autoencoder must be fitted before predicting");
+        }
+
+        const std::size_t number_of_outputs = this->number_of_outputs();
+
+        TMParallel::for_ranges(number_of_rows, number_of_threads, 1, [&](std::size_t, std::size_t begin, std::size_t end) {
+            std::vector<Type> Xi(number_of_ta_chunks);
+            std::vector<uint32_t> clause_output(number_of_clauses);
+
+            for (std::size_t row = begin; row < end; ++row) {
+                encode_row(indices_row.subspan(indptr_row[row], indptr_row[row + 1] - indptr_row[row]), Xi.data());
+                cb_calculate_clause_outputs_predict(
+                        const_cast<Type*>(clause_bank.data()), static_cast<int>(number_of_clauses),
+                        static_cast<int>(number_of_literals), number_of_state_bits, 1, clause_output.data(), Xi.data()
+                );
+
+                for (std::size_t i = 0; i < number_of_outputs; ++i) {
+                    const int32_t class_sum = std::inner_product(
+                            clause_output.begin(),
+                            clause_output.end(),
+                            weights.begin() + i * number_of_clauses,
+                            0
+                    );
+                    y_pred[row * number_of_outputs + i] = class_sum >= 0;
+                }
+            }
+        });
+    }
+
+    std::vector<uint32_t> predict(
+            const tcb::span<const uint32_t>& indptr_row,
+            const tcb::span<const uint32_t>& indices_row,
+            int number_of_rows
+    ) const {
+        std::vector<uint32_t> y_pred(static_cast<std::size_t>(number_of_rows) * number_of_outputs());
+        predict_batch(indptr_row, indices_row, number_of_rows, y_pred.data());
+        return y_pred;
+    }
+
+private:
+    std::mt19937 rng;
+    uint64_t _fit_calls = 0;
+
+    // A feature is true if the row lists it; its negated literal is true otherwise
+    void encode_row(const tcb::span<const uint32_t>& features, Type* Xi) const {
+        std::fill(Xi, Xi + number_of_ta_chunks, 0);
+        for (std::size_t k = number_of_features; k < number_of_literals; ++k) {
+            Xi[k / 32] |= (1u << (k % 32));
+        }
+        for (const auto k : features) {
+            Xi[k / 32] |= (1u << (k % 32));
+            Xi[(k + number_of_features) / 32] &= ~(1u << ((k + number_of_features) % 32));
+        }
+    }
+
+};
+
+#endif //TUMLIBPP_TM_AUTOENCODER_H
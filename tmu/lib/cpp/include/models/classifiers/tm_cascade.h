@@ -0,0 +1,198 @@
+#ifndef TUMLIBPP_TM_CASCADE_H
+#define TUMLIBPP_TM_CASCADE_H
+#include <memory>
+#include <vector>
+#include <numeric>
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+#include "models/classifiers/tm_vanilla.h"
+#include <tcb/span.hpp>
+
+/*
+ * Two-stage cascade of a small (few clauses) and a large TMVanillaClassifier trained on the same features.
+ *
+ * Every sample is first classified by the small model. Samples whose class sum margin (best minus runner-up) is
+ * below margin_threshold are escalated to the large model, so the average cost approaches that of the small
+ * model when most samples are easy. calibrate() picks the smallest threshold that keeps the cascade in
+ * agreement with the large model on a validation set at a given rate.
+ */
+template<class Type>
+class TMCascadeClassifier {
+
+public:
+    std::shared_ptr<TMVanillaClassifier<Type>> small_model;
+    std::shared_ptr<TMVanillaClassifier<Type>> large_model;
+    int margin_threshold;
+
+    // Samples predicted, and samples escalated to the large model, since construction
+    std::size_t predicted = 0;
+    std::size_t escalated = 0;
+
+    TMCascadeClassifier(
+            std::shared_ptr<TMVanillaClassifier<Type>> _small_model,
+            std::shared_ptr<TMVanillaClassifier<Type>> _large_model,
+            int _margin_threshold = 0
+    )
+    : small_model(std::move(_small_model))
+    , large_model(std::move(_large_model))
+    , margin_threshold(_margin_threshold)
+    {}
+
+    /*
+     * Returns the argmax of each sample, and whether it was escalated to the large model.
+     */
+    std::pair<std::vector<int>, std::vector<uint8_t>> predict(
+            const tcb::span<Type>& x,
+            const std::vector<int32_t>& X_shape,
+            bool clip_class_sum = false
+    ) {
+        const auto encoded_X = encode(x, X_shape);
+        const std::size_t num_items = X_shape.at(0);
+
+        std::vector<int> argmax;
+        std::vector<int> margins;
+        predict_small(encoded_X, num_items, clip_class_sum, argmax, margins);
+
+        std::vector<uint8_t> is_escalated(num_items, 0);
+        std::vector<std::size_t> escalated_indices;
+        for (std::size_t i = 0; i < num_items; ++i) {
+            if (margins[i] < margin_threshold) {
+                is_escalated[i] = 1;
+                escalated_indices.push_back(i);
+            }
+        }
+
+        const auto large_argmax = predict_large(encoded_X, escalated_indices, clip_class_sum);
+        for (std::size_t i = 0; i < escalated_indices.size(); ++i) {
+            argmax[escalated_indices[i]] = large_argmax[i];
+        }
+
+        predicted += num_items;
+        escalated += escalated_indices.size();
+
+        return {std::move(argmax), std::move(is_escalated)};
+    }
+
+    /*
+     * Sets margin_threshold to the smallest margin for which the cascade agrees with the large model on at least
+     * target_agreement of the validation samples, and returns it.
+     */
+    int calibrate(
+            const tcb::span<Type>& x,
+            const std::vector<int32_t>& X_shape,
+            float target_agreement,
+            bool clip_class_sum = false
+    ) {
+        const auto encoded_X = encode(x, X_shape);
+        const std::size_t num_items = X_shape.at(0);
+
+        std::vector<int> small_argmax;
+        std::vector<int> margins;
+        predict_small(encoded_X, num_items, clip_class_sum, small_argmax, margins);
+
+        std::vector<std::size_t> all_indices(num_items);
+        std::iota(all_indices.begin(), all_indices.end(), 0);
+        const auto large_argmax = predict_large(encoded_X, all_indices, clip_class_sum);
+
+        // Only samples where the models disagree can break agreement, and only if they are not escalated
+        std::vector<int> disagreement_margins;
+        for (std::size_t i = 0; i < num_items; ++i) {
+            if (small_argmax[i] != large_argmax[i]) {
+                disagreement_margins.push_back(margins[i]);
+            }
+        }
+        std::sort(disagreement_margins.begin(), disagreement_margins.end(), std::greater<int>());
+
+        const auto allowed = static_cast<std::size_t>(std::max(0.0f, (1.0f - target_agreement)) * num_items);
+        margin_threshold = allowed < disagreement_margins.size() ? disagreement_margins[allowed] + 1 : 0;
+        return margin_threshold;
+    }
+
+private:
+
+    std::vector<uint32_t> encode(const tcb::span<Type>& x, const std::vector<int32_t>& X_shape) {
+        const auto& small_clause_bank = *small_model->clause_banks.begin();
+        const auto& large_clause_bank = *large_model->clause_banks.begin();
+
+        if (small_clause_bank->number_of_ta_chunks != large_clause_bank->number_of_ta_chunks ||
+            small_clause_bank->number_of_patches != large_clause_bank->number_of_patches) {
+            throw std::invalid_argument("The small and large model of a cascade must share their input encoding");
+        }
+
+        return small_clause_bank->prepare_X(x, X_shape);
+    }
+
+    std::size_t encoded_stride() const {
+        const auto& clause_bank = *small_model->clause_banks.begin();
+        return clause_bank->number_of_patches * clause_bank->number_of_ta_chunks;
+    }
+
+    void predict_small(
+            const std::vector<uint32_t>& encoded_X,
+            std::size_t num_items,
+            bool clip_class_sum,
+            std::vector<int>& argmax,
+            std::vector<int>& margins
+    ) {
+        const auto stride = encoded_stride();
+        const auto encoded = tcb::span<Type>(const_cast<Type*>(encoded_X.data()), encoded_X.size());
+
+        argmax.assign(num_items, 0);
+        margins.assign(num_items, 0);
+        for (std::size_t i = 0; i < num_items; ++i) {
+            const auto class_sums = small_model->predict_compute_class_sums(
+                    encoded.subspan(i * stride, stride),
+                    i,
+                    num_items,
+                    clip_class_sum
+            );
+
+            int best = 0;
+            int best_sum = class_sums.empty() ? 0 : class_sums[0];
+            int second_sum = best_sum;
+            for (std::size_t c = 1; c < class_sums.size(); ++c) {
+                if (class_sums[c] > best_sum) {
+                    second_sum = best_sum;
+                    best_sum = class_sums[c];
+                    best = static_cast<int>(c);
+                } else if (c == 1 || class_sums[c] > second_sum) {
+                    second_sum = class_sums[c];
+                }
+            }
+
+            argmax[i] = best;
+            margins[i] = best_sum - second_sum;
+        }
+    }
+
+    std::vector<int> predict_large(
+            const std::vector<uint32_t>& encoded_X,
+            const std::vector<std::size_t>& indices,
+            bool clip_class_sum
+    ) {
+        // Incremental clause evaluation reads batches of consecutive samples, so the subset is made contiguous
+        const auto stride = encoded_stride();
+        std::vector<uint32_t> subset(indices.size() * stride);
+        for (std::size_t i = 0; i < indices.size(); ++i) {
+            std::copy_n(encoded_X.begin() + indices[i] * stride, stride, subset.begin() + i * stride);
+        }
+        const auto encoded = tcb::span<Type>(subset.data(), subset.size());
+
+        std::vector<int> argmax(indices.size(), 0);
+        for (std::size_t i = 0; i < indices.size(); ++i) {
+            const auto class_sums = large_model->predict_compute_class_sums(
+                    encoded.subspan(i * stride, stride),
+                    i,
+                    indices.size(),
+                    clip_class_sum
+            );
+
+            argmax[i] = std::distance(class_sums.begin(), std::max_element(class_sums.begin(), class_sums.end()));
+        }
+        return argmax;
+    }
+
+};
+
+#endif //TUMLIBPP_TM_CASCADE_H
@@ -0,0 +1,699 @@
+#ifndef TUMLIBPP_TM_COALESCED_H
+#define TUMLIBPP_TM_COALESCED_H
+#include <cmath>
+#include <memory>
+#include <numeric>
+#include <set>
+#include "tm_clause_dense.h"
+#include "tm_clause_activations.h"
+#include "tm_clause_statistics.h"
+#include "tm_patch_activations.h"
+#include "tm_memory.h"
+#include "utils/tm_math.h"
+#include <tcb/span.hpp>
+#include <tl/optional.hpp>
+
+extern "C" {
+    #include "fast_rand.h"
+}
+
+/*
+ * Coalesced Tsetlin Machine: a single clause bank shared by all classes, with one weight per clause and class.
+ *
+ * Weights are stored clause-major as [clause][class], with the class dimension padded to a multiple of
+ * WEIGHT_LANES. Computing all class sums of a sample is then a sum of the weight rows of the clauses that
+ * fired, which vectorizes over classes. Predict cost is dominated by the shared clause evaluation and does not
+ * grow with the number of classes.
+ */
+template<class Type>
+class TMCoalescedClassifier {
+
+public:
+    static constexpr std::size_t WEIGHT_LANES = 16;
+
+    int T;
+    float s;
+    float d;
+    uint32_t number_of_clauses;
+    uint32_t number_of_classes = 0;
+    uint32_t number_of_classes_padded = 0;
+
+    bool type_iii_feedback;
+    bool focused_negative_sampling;
+    bool output_balancing;
+    float type_i_ii_ratio;
+    float type_i_p;
+    float type_ii_p;
+    tl::optional<std::size_t> max_positive_clauses;
+    tl::optional<std::size_t> max_included_literals;
+    bool boost_true_positive_feedback;
+    bool reuse_random_feedback;
+    tl::optional<std::vector<int>> patch_dim;
+    int32_t number_of_state_bits;
+    int32_t number_of_state_bits_ind;
+    int32_t batch_size;
+    bool incremental;
+    float clause_drop_p;
+    float literal_drop_p;
+    bool feature_negation;
+    int seed;
+
+    // data views
+    std::vector<uint32_t> encoded_X_train_cached;
+    std::vector<uint32_t> encoded_X_train_shape;
+
+    std::shared_ptr<TMClauseBankDense<Type>> clause_bank;
+    TMMemory<uint32_t> memory;
+
+    // Memory Segments
+    tcb::span<int32_t> weights; // [clause][class (padded)]
+    tcb::span<int32_t> class_sums; // [class (padded)]
+    tcb::span<uint32_t> positive_clause_active;
+    tcb::span<uint32_t> negative_clause_active;
+    tcb::span<uint32_t> fired_clauses;
+    tcb::span<uint32_t> weight_update_draws;
+    std::vector<float> update_ps;
+
+    bool _is_initialized = false;
+
+    TMCoalescedClassifier(
+            int _T,
+            float _s,
+            float _d,
+            uint32_t _number_of_clauses,
+            float _type_i_ii_ratio,
+            bool _type_iii_feedback,
+            bool _focused_negative_sampling,
+            bool _output_balancing,
+            tl::optional<std::size_t> _max_positive_clauses,
+            tl::optional<std::size_t> _max_included_literals,
+            bool _boost_true_positive_feedback,
+            bool _reuse_random_feedback,
+            tl::optional<std::vector<int>> _patch_dim,
+            int32_t _number_of_state_bits,
+            int32_t _number_of_state_bits_ind,
+            int32_t _batch_size,
+            bool _incremental,
+            float _clause_drop_p,
+            float _literal_drop_p,
+            bool _feature_negation,
+            int _seed
+    )
+    : T(_T)
+    , s(_s)
+    , d(_d)
+    , number_of_clauses(_number_of_clauses)
+    , type_iii_feedback(_type_iii_feedback)
+    , focused_negative_sampling(_focused_negative_sampling)
+    , output_balancing(_output_balancing)
+    , type_i_ii_ratio(_type_i_ii_ratio)
+    , max_positive_clauses(_max_positive_clauses)
+    , max_included_literals(_max_included_literals)
+    , boost_true_positive_feedback(_boost_true_positive_feedback)
+    , reuse_random_feedback(_reuse_random_feedback)
+    , patch_dim(_patch_dim)
+    , number_of_state_bits(_number_of_state_bits)
+    , number_of_state_bits_ind(_number_of_state_bits_ind)
+    , batch_size(_batch_size)
+    , incremental(_incremental)
+    , clause_drop_p(_clause_drop_p)
+    , literal_drop_p(_literal_drop_p)
+    , feature_negation(_feature_negation)
+    , seed(_seed)
+    , memory()
+    {
+        if(type_i_ii_ratio >= 1.0){
+            type_i_p = 1.0;
+            type_ii_p = 1.0 / type_i_ii_ratio;
+        }else{
+            type_i_p = type_i_ii_ratio;
+            type_ii_p = 1.0;
+        }
+    }
+
+    std::size_t get_required_memory_size() const {
+        std::size_t mem_size = 0;
+
+        // Weights
+        mem_size += number_of_clauses * number_of_classes_padded;
+
+        // Class sums
+        mem_size += number_of_classes_padded;
+
+        // Positive and negative clause active masks
+        mem_size += 2 * number_of_clauses;
+
+        // Fired clauses and their weight update draws
+        mem_size += 2 * number_of_clauses;
+
+        return mem_size;
+    }
+
+    tcb::span<int32_t> get_weights_row(std::size_t clause) const {
+        return weights.subspan(clause * number_of_classes_padded, number_of_classes_padded);
+    }
+
+    int32_t get_weight(uint32_t the_class, std::size_t clause) const {
+        return weights[clause * number_of_classes_padded + the_class];
+    }
+
+    void set_weight(uint32_t the_class, std::size_t clause, int32_t weight) {
+        weights[clause * number_of_classes_padded + the_class] = weight;
+    }
+
+    std::vector<int32_t> get_weights(uint32_t the_class) const {
+        std::vector<int32_t> class_weights(number_of_clauses);
+        for (std::size_t j = 0; j < number_of_clauses; ++j) {
+            class_weights[j] = get_weight(the_class, j);
+        }
+        return class_weights;
+    }
+
+    void init(
+            const tcb::span<Type>& y,
+            const tcb::span<Type>& x,
+            const std::vector<int32_t>& X_shape
+    ){
+        if(_is_initialized){
+            return;
+        }
+        _is_initialized = true;
+
+        number_of_classes = *std::max_element(y.begin(), y.end()) + 1;
+        number_of_classes_padded = ((number_of_classes + WEIGHT_LANES - 1) / WEIGHT_LANES) * WEIGHT_LANES;
+
+        clause_bank = std::make_shared<TMClauseBankDense<Type>>(
+                s,
+                d,
+                boost_true_positive_feedback,
+                reuse_random_feedback,
+                X_shape,
+                patch_dim,
+                max_included_literals,
+                number_of_clauses,
+                number_of_state_bits,
+                number_of_state_bits_ind,
+                batch_size,
+                incremental,
+                seed
+        );
+
+        if(!max_positive_clauses.has_value()){
+            max_positive_clauses = number_of_clauses;
+        }
+
+        memory.reserve(get_required_memory_size() + clause_bank->getRequiredMemorySize());
+        clause_bank->initialize(memory);
+
+        auto unsigned_weights = memory.getSegment(number_of_clauses * number_of_classes_padded);
+        weights = tcb::span<int32_t>(reinterpret_cast<int32_t*>(unsigned_weights.data()), unsigned_weights.size());
+
+        auto unsigned_class_sums = memory.getSegment(number_of_classes_padded);
+        class_sums = tcb::span<int32_t>(reinterpret_cast<int32_t*>(unsigned_class_sums.data()), unsigned_class_sums.size());
+
+        positive_clause_active = memory.getSegment(number_of_clauses);
+        negative_clause_active = memory.getSegment(number_of_clauses);
+        fired_clauses = memory.getSegment(number_of_clauses);
+        weight_update_draws = memory.getSegment(number_of_clauses);
+
+        update_ps = std::vector<float>(number_of_classes, 0.0);
+
+        // Every class starts from the same random polarity per clause. Padding lanes stay zero.
+        for (std::size_t j = 0; j < number_of_clauses; ++j) {
+            const int32_t polarity = (fast_rand() & 1) ? 1 : -1;
+            auto row = get_weights_row(j);
+            std::fill(row.begin(), row.begin() + number_of_classes, polarity);
+        }
+
+        const auto encoded_x_vector = clause_bank->prepare_X(x, X_shape);
+        encoded_X_train_shape = std::vector<uint32_t>({
+            static_cast<uint32_t>(X_shape.at(0)),
+            static_cast<uint32_t>(clause_bank->number_of_patches * clause_bank->number_of_ta_chunks)
+        });
+        encoded_X_train_cached = encoded_x_vector;
+    }
+
+    std::vector<uint32_t> mechanism_literal_active() const {
+        const auto number_of_literals = clause_bank->number_of_literals;
+        std::vector<uint32_t> literal_active(clause_bank->number_of_ta_chunks, 0);
+
+        for (std::size_t k = 0; k < number_of_literals; ++k) {
+            const auto rng = fast_rand() / static_cast<float>(FAST_RAND_MAX);
+            if (rng >= literal_drop_p) {
+                literal_active[k / 32] |= (1u << (k % 32));
+            }
+        }
+
+        // If feature negation is not applied, clear the corresponding bits for the second half of literals
+        if (!feature_negation) {
+            for (std::size_t k = number_of_literals / 2; k < number_of_literals; ++k) {
+                literal_active[k / 32] &= ~(1u << (k % 32));
+            }
+        }
+
+        return literal_active;
+    }
+
+    std::vector<uint32_t> mechanism_clause_active() const {
+        std::vector<uint32_t> clause_active(number_of_clauses, 0);
+        for (std::size_t j = 0; j < number_of_clauses; ++j) {
+            const auto rng = fast_rand() / static_cast<float>(FAST_RAND_MAX);
+            clause_active[j] = static_cast<uint32_t>(rng >= clause_drop_p);
+        }
+        return clause_active;
+    }
+
+    /*
+     * Computes the class sums of all classes from one clause output vector. Each firing clause adds its whole
+     * weight row, so the inner loop runs over contiguous, padded class lanes.
+     */
+    void compute_class_sums(
+            const tcb::span<const Type>& clause_output,
+            const tcb::span<const uint32_t>& clause_active
+    ){
+        std::fill(class_sums.begin(), class_sums.end(), 0);
+        int32_t* __restrict sums = class_sums.data();
+
+        for (std::size_t j = 0; j < number_of_clauses; ++j) {
+            if (!(clause_output[j] & clause_active[j])) {
+                continue;
+            }
+            const int32_t* __restrict row = weights.data() + j * number_of_classes_padded;
+            for (std::size_t c = 0; c < number_of_classes_padded; ++c) {
+                sums[c] += row[c];
+            }
+        }
+    }
+
+    /*
+     * Splits clause_active into clauses with non-negative and negative weight for the_class. Returns the number
+     * of clauses with non-negative weight, active or not.
+     */
+    std::size_t mechanism_polarity_masks(uint32_t the_class, const tcb::span<const uint32_t>& clause_active){
+        const int32_t* w = weights.data() + the_class;
+        std::size_t number_of_positive_clauses = 0;
+        for (std::size_t j = 0; j < number_of_clauses; ++j) {
+            const uint32_t positive = w[j * number_of_classes_padded] >= 0;
+            positive_clause_active[j] = clause_active[j] & positive;
+            negative_clause_active[j] = clause_active[j] & (positive ^ 1u);
+            number_of_positive_clauses += positive;
+        }
+        return number_of_positive_clauses;
+    }
+
+    static inline uint32_t update_threshold(float update_p){
+        if (update_p >= 1.0f) {
+            return FAST_RAND_MAX;
+        }
+        if (update_p <= 0.0f) {
+            return 0;
+        }
+        return static_cast<uint32_t>(update_p * static_cast<float>(FAST_RAND_MAX));
+    }
+
+    /*
+     * Adds delta to the weight of the_class for every active clause that fired, each with probability update_p.
+     *
+     * Runs in three passes so that only the random draws are sequential: a branch-free compaction of the fired
+     * clauses, one fast_rand() per fired clause into weight_update_draws followed by a vectorized threshold
+     * compare that turns the draws into a selection mask, and a scatter of delta over the selected clauses.
+     * The draws come in clause order, so the random stream is the same as drawing inside a single loop. The
+     * scatter keeps the class-sized stride of the [clause][class] layout, but touches selected clauses only.
+     */
+    void mechanism_update_weights(
+            uint32_t the_class,
+            int32_t delta,
+            float update_p,
+            const tcb::span<const Type>& clause_output,
+            const tcb::span<const uint32_t>& clause_active
+    ){
+        const uint32_t threshold = update_threshold(update_p);
+        if (threshold == 0) {
+            return;
+        }
+
+        uint32_t* fired = fired_clauses.data();
+        std::size_t number_of_fired = 0;
+        for (std::size_t j = 0; j < number_of_clauses; ++j) {
+            fired[number_of_fired] = static_cast<uint32_t>(j);
+            number_of_fired += (clause_output[j] & clause_active[j]) != 0;
+        }
+
+        uint32_t* draws = weight_update_draws.data();
+        for (std::size_t k = 0; k < number_of_fired; ++k) {
+            draws[k] = fast_rand();
+        }
+        for (std::size_t k = 0; k < number_of_fired; ++k) {
+            draws[k] = draws[k] <= threshold;
+        }
+
+        int32_t* w = weights.data() + the_class;
+        for (std::size_t k = 0; k < number_of_fired; ++k) {
+            w[static_cast<std::size_t>(fired[k]) * number_of_classes_padded] += delta * static_cast<int32_t>(draws[k]);
+        }
+    }
+
+    void mechanism_clause_feedback(
+            float update_p,
+            const tcb::span<uint32_t>& type_i_clause_active,
+            const tcb::span<uint32_t>& type_ii_clause_active,
+            const tcb::span<Type>& literal_active,
+            const tcb::span<Type>& encoded_xi,
+            bool apply_type_iii_feedback
+    ){
+        clause_bank->type_i_feedback(
+                update_p * type_i_p,
+                type_i_clause_active,
+                literal_active,
+                encoded_xi
+        );
+
+        clause_bank->type_ii_feedback(
+                update_p * type_ii_p,
+                type_ii_clause_active,
+                literal_active,
+                encoded_xi
+        );
+
+        if (apply_type_iii_feedback) {
+            clause_bank->type_iii_feedback(
+                    update_p,
+                    type_i_clause_active,
+                    literal_active,
+                    encoded_xi,
+                    true
+            );
+
+            clause_bank->type_iii_feedback(
+                    update_p,
+                    type_ii_clause_active,
+                    literal_active,
+                    encoded_xi,
+                    false
+            );
+        }
+    }
+
+    void _fit_sample(
+            uint32_t target,
+            const tcb::span<uint32_t>& clause_active,
+            const tcb::span<Type>& literal_active,
+            const tcb::span<Type>& encoded_xi
+    ){
+        clause_bank->calculate_clause_outputs_update(literal_active, encoded_xi);
+        const tcb::span<const Type> clause_output(clause_bank->clause_output.data(), number_of_clauses);
+        const tcb::span<const uint32_t> clause_active_view(clause_active.data(), clause_active.size());
+
+        // Class sums for every class from a single pass over the clause outputs
+        compute_class_sums(clause_output, clause_active_view);
+
+        const auto class_sum = TMMath::clamp(class_sums[target], -T, T);
+        const float update_p = static_cast<float>(T - class_sum) / (2.0f * T);
+
+        const auto type_iii_feedback_selection = fast_rand() & 1;
+
+        const auto number_of_positive_clauses = mechanism_polarity_masks(target, clause_active_view);
+        mechanism_clause_feedback(
+                update_p,
+                positive_clause_active,
+                negative_clause_active,
+                literal_active,
+                encoded_xi,
+                type_iii_feedback && type_iii_feedback_selection == 0
+        );
+
+        if (number_of_positive_clauses < max_positive_clauses.value()) {
+            mechanism_update_weights(target, 1, update_p, clause_output, clause_active_view);
+        }
+
+        float update_ps_sum = 0.0;
+        for (uint32_t i = 0; i < number_of_classes; ++i) {
+            if (i == target) {
+                update_ps[i] = 0.0;
+                continue;
+            }
+            const auto sum = TMMath::clamp(class_sums[i], -T, T);
+            update_ps[i] = static_cast<float>(T + sum) / (2.0f * T);
+            update_ps_sum += update_ps[i];
+        }
+
+        if (update_ps_sum == 0.0) {
+            return;
+        }
+
+        uint32_t not_target;
+        if (focused_negative_sampling) {
+            const float r = (fast_rand() / static_cast<float>(FAST_RAND_MAX)) * update_ps_sum;
+            float cumulative = 0.0;
+            not_target = number_of_classes - 1;
+            for (uint32_t i = 0; i < number_of_classes; ++i) {
+                cumulative += update_ps[i];
+                if (update_ps[i] > 0.0 && r <= cumulative) {
+                    not_target = i;
+                    break;
+                }
+            }
+        } else {
+            do {
+                not_target = fast_rand() % number_of_classes;
+            } while (not_target == target);
+        }
+        const float update_p_not_target = update_ps[not_target];
+
+        mechanism_polarity_masks(not_target, clause_active_view);
+        mechanism_clause_feedback(
+                update_p_not_target,
+                negative_clause_active,
+                positive_clause_active,
+                literal_active,
+                encoded_xi,
+                type_iii_feedback && type_iii_feedback_selection == 1
+        );
+
+        mechanism_update_weights(not_target, -1, update_p_not_target, clause_output, clause_active_view);
+    }
+
+    void fit(
+            const tcb::span<Type>& y,
+            const tcb::span<Type>& x,
+            const std::vector<int32_t>& X_shape,
+            bool shuffle
+    ){
+        init(y, x, X_shape);
+
+        const auto encoded_X = tcb::span<Type>(encoded_X_train_cached.data(), encoded_X_train_cached.size());
+        const auto num_features = encoded_X_train_shape.at(1);
+        const auto num_samples = encoded_X_train_shape.at(0);
+
+        auto clause_active_vector = mechanism_clause_active();
+        const auto clause_active = tcb::span<uint32_t>(clause_active_vector.data(), clause_active_vector.size());
+
+        auto literal_active_vector = mechanism_literal_active();
+        const auto literal_active = tcb::span<uint32_t>(literal_active_vector.data(), literal_active_vector.size());
+
+        std::vector<int> sample_indices(num_samples);
+        TMMath::aRange(num_samples, shuffle, sample_indices);
+
+        // Samples are presented in rounds of number_of_classes examples. With output balancing, each round holds
+        // one example per class.
+        std::vector<uint32_t> class_observed(number_of_classes, 0);
+        std::vector<uint32_t> example_indexes(number_of_classes, 0);
+        uint32_t example_counter = 0;
+
+        for (const auto e : sample_indices) {
+            const auto target = y[e];
+            if (output_balancing) {
+                if (class_observed[target] == 0) {
+                    example_indexes[target] = e;
+                    class_observed[target] = 1;
+                    example_counter++;
+                }
+            } else {
+                example_indexes[example_counter] = e;
+                example_counter++;
+            }
+
+            if (example_counter != number_of_classes) {
+                continue;
+            }
+            example_counter = 0;
+
+            for (uint32_t i = 0; i < number_of_classes; ++i) {
+                class_observed[i] = 0;
+                const auto batch_example = example_indexes[i];
+
+                _fit_sample(
+                        y[batch_example],
+                        clause_active,
+                        literal_active,
+                        encoded_X.subspan(batch_example * num_features, num_features)
+                );
+            }
+        }
+    }
+
+    const std::pair<std::vector<int>, tl::optional<std::vector<std::vector<int>>>> predict(
+            const tcb::span<Type>& X_test,
+            const std::vector<int32_t>& X_shape,
+            bool clip_class_sum = false,
+            bool return_class_sum = false
+    ){
+        auto encoded_X_test_vector = clause_bank->prepare_X(X_test, X_shape);
+        const auto encoded_X_test = tcb::span<Type>(encoded_X_test_vector.data(), encoded_X_test_vector.size());
+        const std::size_t num_items = X_shape.at(0);
+        const std::size_t num_features = clause_bank->number_of_patches * clause_bank->number_of_ta_chunks;
+
+        const std::vector<uint32_t> all_active(number_of_clauses, 1);
+        const tcb::span<const uint32_t> all_active_view(all_active.data(), all_active.size());
+
+        std::vector<int> argmax_indices(num_items, 0);
+        tl::optional<std::vector<std::vector<int>>> optional_class_sums;
+        if (return_class_sum) {
+            optional_class_sums.emplace(num_items, std::vector<int>(number_of_classes, 0));
+        }
+
+        for (std::size_t sample_index = 0; sample_index < num_items; ++sample_index) {
+            const auto encoded_xi = encoded_X_test.subspan(sample_index * num_features, num_features);
+
+            const auto clause_output = clause_bank->calculate_clause_outputs_predict(
+                    encoded_xi,
+                    sample_index,
+                    num_items
+            );
+
+            compute_class_sums(
+                    tcb::span<const Type>(clause_output.data(), number_of_clauses),
+                    all_active_view
+            );
+
+            if (clip_class_sum) {
+                for (uint32_t i = 0; i < number_of_classes; ++i) {
+                    class_sums[i] = TMMath::clamp(class_sums[i], -T, T);
+                }
+            }
+
+            argmax_indices[sample_index] = std::distance(
+                    class_sums.begin(),
+                    std::max_element(class_sums.begin(), class_sums.begin() + number_of_classes)
+            );
+
+            if (return_class_sum) {
+                std::copy(
+                        class_sums.begin(),
+                        class_sums.begin() + number_of_classes,
+                        (*optional_class_sums)[sample_index].begin()
+                );
+            }
+        }
+
+        return {
+            std::move(argmax_indices),
+            std::move(optional_class_sums)
+        };
+    }
+
+    // Bit-packed activations of every sample, with the shared clause bank as the only bank
+    TMClauseActivations clause_activations(
+            const tcb::span<Type>& x,
+            const std::vector<int32_t>& X_shape,
+            std::size_t threads = 0
+    ){
+        if (!_is_initialized) {
+            throw std::runtime_error("The model must be fitted before clause activations are computed");
+        }
+
+        const auto encoded_X = clause_bank->prepare_X(x, X_shape);
+        const TMTransposedEvaluator<Type> evaluator({clause_bank.get()}, threads);
+        return TMClauseActivations::compute<Type>(evaluator, encoded_X.data(), X_shape.at(0), threads);
+    }
+
+    // Bit-packed per-patch clause matches of every sample, with the shared clause bank as the only bank
+    TMPatchActivations patch_activations(
+            const tcb::span<Type>& x,
+            const std::vector<int32_t>& X_shape,
+            std::size_t threads = 0
+    ){
+        if (!_is_initialized) {
+            throw std::runtime_error("The model must be fitted before patch activations are computed");
+        }
+
+        const auto encoded_X = clause_bank->prepare_X(x, X_shape);
+        const TMTransposedEvaluator<Type> evaluator({clause_bank.get()}, threads);
+        return TMPatchActivations::compute<Type>(evaluator, encoded_X.data(), X_shape.at(0), threads);
+    }
+
+    // Per-patch sums of the weights of the matching clauses for each selected class, all classes when none are selected
+    TMPatchHeatmaps patch_heatmaps(
+            const tcb::span<Type>& x,
+            const std::vector<int32_t>& X_shape,
+            const std::vector<uint32_t>& selected_classes = {},
+            std::size_t threads = 0
+    ){
+        if (!_is_initialized) {
+            throw std::runtime_error("The model must be fitted before heatmaps are computed");
+        }
+
+        std::vector<uint32_t> classes = selected_classes;
+        if (classes.empty()) {
+            for (uint32_t c = 0; c < number_of_classes; ++c) {
+                classes.push_back(c);
+            }
+        }
+        std::vector<int32_t> class_weights;
+        for (const uint32_t c : classes) {
+            if (c >= number_of_classes) {
+                throw std::invalid_argument("Class " + std::to_string(c) + " is out of range");
+            }
+            for (std::size_t j = 0; j < number_of_clauses; ++j) {
+                class_weights.push_back(get_weight(c, j));
+            }
+        }
+
+        const auto encoded_X = clause_bank->prepare_X(x, X_shape);
+        const TMTransposedEvaluator<Type> evaluator({clause_bank.get()}, threads);
+        return TMPatchHeatmaps::compute<Type>(
+                evaluator,
+                encoded_X.data(),
+                X_shape.at(0),
+                std::vector<std::size_t>(classes.size(), 0),
+                class_weights,
+                threads
+        );
+    }
+
+    /*
+     * True and false positives of every clause for every class over a labelled dataset, evaluated 64 samples at a
+     * time with the blocks split across threads. A clause has positive polarity for a class when its weight for the
+     * class is non-negative.
+     */
+    TMClauseStatistics clause_statistics(
+            const tcb::span<Type>& x,
+            const std::vector<int32_t>& X_shape,
+            const tcb::span<Type>& y,
+            std::size_t threads = 0
+    ){
+        if (!_is_initialized) {
+            throw std::runtime_error("The model must be fitted before clause statistics are computed");
+        }
+        if (y.size() != static_cast<std::size_t>(X_shape.at(0))) {
+            throw std::invalid_argument("X and y must have the same number of samples");
+        }
+
+        const auto encoded_X = clause_bank->prepare_X(x, X_shape);
+        const TMTransposedEvaluator<Type> evaluator({clause_bank.get()}, threads);
+        return TMClauseStatistics::compute<Type>(
+                evaluator,
+                encoded_X.data(),
+                y.data(),
+                y.size(),
+                std::vector<std::size_t>(number_of_classes, 0),
+                [this](std::size_t the_class, std::size_t clause) {
+                    return weights[clause * number_of_classes_padded + the_class] >= 0;
+                },
+                threads
+        );
+    }
+
+};
+
+#endif //TUMLIBPP_TM_COALESCED_H
@@ -0,0 +1,399 @@
+#ifndef TUMLIBPP_TM_MULTIOUTPUT_H
+#define TUMLIBPP_TM_MULTIOUTPUT_H
+#include <cmath>
+#include <memory>
+#include <numeric>
+#include <algorithm>
+#include <stdexcept>
+#include "tm_clause_dense.h"
+#include "tm_fused_feedback.h"
+#include "tm_memory.h"
+#include "utils/tm_math.h"
+#include <tcb/span.hpp>
+#include <tl/optional.hpp>
+
+extern "C" {
+    #include "fast_rand.h"
+}
+
+/*
+ * Multi-output Tsetlin Machine: one clause bank shared by binary outputs, with one weight per clause and output,
+ * like TMCoalesceMultiOuputClassifier.
+ *
+ * Each sample is evaluated once, and all class sums come from the weight rows of the clauses that fired. Every
+ * positive output is then updated, and each negative output with probability q / (number_of_outputs - 1). The
+ * updates of all selected outputs are applied in one pass over the clauses by TMFusedFeedback.
+ */
+template<class Type>
+class TMMultiOutputClassifier {
+
+public:
+    static constexpr std::size_t WEIGHT_LANES = 16;
+
+    int T;
+    float s;
+    float d;
+    uint32_t number_of_clauses;
+    uint32_t number_of_outputs = 0;
+    uint32_t number_of_outputs_padded = 0;
+
+    float type_i_ii_ratio;
+    float type_i_p;
+    float type_ii_p;
+    float q;
+    tl::optional<std::size_t> max_positive_clauses;
+    tl::optional<std::size_t> max_included_literals;
+    bool boost_true_positive_feedback;
+    bool reuse_random_feedback;
+    tl::optional<std::vector<int>> patch_dim;
+    int32_t number_of_state_bits;
+    int32_t number_of_state_bits_ind;
+    int32_t batch_size;
+    bool incremental;
+    float clause_drop_p;
+    float literal_drop_p;
+    bool feature_negation;
+    int seed;
+
+    // data views
+    std::vector<uint32_t> encoded_X_train_cached;
+    std::vector<uint32_t> encoded_X_train_shape;
+
+    std::shared_ptr<TMClauseBankDense<Type>> clause_bank;
+    TMMemory<uint32_t> memory;
+
+    // Memory Segments
+    tcb::span<int32_t> weights; // [clause][output (padded)]
+    tcb::span<int32_t> class_sums; // [output (padded)]
+    std::vector<uint32_t> positive_counts; // [output], clauses with non-negative weight
+
+    bool _is_initialized = false;
+
+    TMMultiOutputClassifier(
+            int _T,
+            float _s,
+            float _d,
+            uint32_t _number_of_clauses,
+            float _type_i_ii_ratio,
+            float _q,
+            tl::optional<std::size_t> _max_positive_clauses,
+            tl::optional<std::size_t> _max_included_literals,
+            bool _boost_true_positive_feedback,
+            bool _reuse_random_feedback,
+            tl::optional<std::vector<int>> _patch_dim,
+            int32_t _number_of_state_bits,
+            int32_t _number_of_state_bits_ind,
+            int32_t _batch_size,
+            bool _incremental,
+            float _clause_drop_p,
+            float _literal_drop_p,
+            bool _feature_negation,
+            int _seed
+    )
+    : T(_T)
+    , s(_s)
+    , d(_d)
+    , number_of_clauses(_number_of_clauses)
+    , type_i_ii_ratio(_type_i_ii_ratio)
+    , q(_q)
+    , max_positive_clauses(_max_positive_clauses)
+    , max_included_literals(_max_included_literals)
+    , boost_true_positive_feedback(_boost_true_positive_feedback)
+    , reuse_random_feedback(_reuse_random_feedback)
+    , patch_dim(_patch_dim)
+    , number_of_state_bits(_number_of_state_bits)
+    , number_of_state_bits_ind(_number_of_state_bits_ind)
+    , batch_size(_batch_size)
+    , incremental(_incremental)
+    , clause_drop_p(_clause_drop_p)
+    , literal_drop_p(_literal_drop_p)
+    , feature_negation(_feature_negation)
+    , seed(_seed)
+    , memory()
+    {
+        if(type_i_ii_ratio >= 1.0){
+            type_i_p = 1.0;
+            type_ii_p = 1.0 / type_i_ii_ratio;
+        }else{
+            type_i_p = type_i_ii_ratio;
+            type_ii_p = 1.0;
+        }
+    }
+
+    std::size_t get_required_memory_size() const {
+        // Weights and class sums
+        return number_of_clauses * number_of_outputs_padded + number_of_outputs_padded;
+    }
+
+    std::vector<int32_t> get_weights(uint32_t output) const {
+        std::vector<int32_t> output_weights(number_of_clauses);
+        for (std::size_t j = 0; j < number_of_clauses; ++j) {
+            output_weights[j] = weights[j * number_of_outputs_padded + output];
+        }
+        return output_weights;
+    }
+
+    /*
+     * Y is [sample][output], with 1 where the sample belongs to the output.
+     */
+    void init(
+            const std::vector<int32_t>& Y_shape,
+            const tcb::span<Type>& x,
+            const std::vector<int32_t>& X_shape
+    ){
+        if(_is_initialized){
+            return;
+        }
+        if(Y_shape.size() != 2 || Y_shape.at(0) != X_shape.at(0)){
+            throw std::invalid_argument("Y must be a [sample][output] matrix with one row per sample");
+        }
+        _is_initialized = true;
+
+        number_of_outputs = Y_shape.at(1);
+        number_of_outputs_padded = ((number_of_outputs + WEIGHT_LANES - 1) / WEIGHT_LANES) * WEIGHT_LANES;
+
+        clause_bank = std::make_shared<TMClauseBankDense<Type>>(
+                s,
+                d,
+                boost_true_positive_feedback,
+                reuse_random_feedback,
+                X_shape,
+                patch_dim,
+                max_included_literals,
+                number_of_clauses,
+                number_of_state_bits,
+                number_of_state_bits_ind,
+                batch_size,
+                incremental,
+                seed
+        );
+
+        if(!max_positive_clauses.has_value()){
+            max_positive_clauses = number_of_clauses;
+        }
+
+        memory.reserve(get_required_memory_size() + clause_bank->getRequiredMemorySize());
+        clause_bank->initialize(memory);
+
+        auto unsigned_weights = memory.getSegment(number_of_clauses * number_of_outputs_padded);
+        weights = tcb::span<int32_t>(reinterpret_cast<int32_t*>(unsigned_weights.data()), unsigned_weights.size());
+
+        auto unsigned_class_sums = memory.getSegment(number_of_outputs_padded);
+        class_sums = tcb::span<int32_t>(reinterpret_cast<int32_t*>(unsigned_class_sums.data()), unsigned_class_sums.size());
+
+        // Every output starts from the same random polarity per clause. Padding lanes stay zero.
+        positive_counts.assign(number_of_outputs, 0);
+        for (std::size_t j = 0; j < number_of_clauses; ++j) {
+            const int32_t polarity = (fast_rand() & 1) ? 1 : -1;
+            std::fill_n(weights.begin() + j * number_of_outputs_padded, number_of_outputs, polarity);
+            for (auto& count : positive_counts) {
+                count += polarity > 0;
+            }
+        }
+    }
+
+    void encode_train_data(const tcb::span<Type>& x, const std::vector<int32_t>& X_shape){
+        encoded_X_train_cached = clause_bank->prepare_X(x, X_shape);
+        encoded_X_train_shape = std::vector<uint32_t>({
+            static_cast<uint32_t>(X_shape.at(0)),
+            static_cast<uint32_t>(clause_bank->number_of_patches * clause_bank->number_of_ta_chunks)
+        });
+    }
+
+    std::vector<uint32_t> mechanism_literal_active() const {
+        const auto number_of_literals = clause_bank->number_of_literals;
+        std::vector<uint32_t> literal_active(clause_bank->number_of_ta_chunks, 0);
+
+        for (std::size_t k = 0; k < number_of_literals; ++k) {
+            const auto rng = fast_rand() / static_cast<float>(FAST_RAND_MAX);
+            if (rng >= literal_drop_p && (feature_negation || k < number_of_literals / 2)) {
+                literal_active[k / 32] |= (1u << (k % 32));
+            }
+        }
+        return literal_active;
+    }
+
+    std::vector<uint32_t> mechanism_clause_active() const {
+        std::vector<uint32_t> clause_active(number_of_clauses, 0);
+        for (std::size_t j = 0; j < number_of_clauses; ++j) {
+            const auto rng = fast_rand() / static_cast<float>(FAST_RAND_MAX);
+            clause_active[j] = static_cast<uint32_t>(rng >= clause_drop_p);
+        }
+        return clause_active;
+    }
+
+    // Sum of the weight rows of the clauses that fired, over contiguous output lanes
+    void compute_class_sums(
+            const tcb::span<const Type>& clause_output,
+            const tcb::span<const uint32_t>& clause_active
+    ){
+        std::fill(class_sums.begin(), class_sums.end(), 0);
+        int32_t* __restrict sums = class_sums.data();
+
+        for (std::size_t j = 0; j < number_of_clauses; ++j) {
+            if (!(clause_output[j] & clause_active[j])) {
+                continue;
+            }
+            const int32_t* __restrict row = weights.data() + j * number_of_outputs_padded;
+            for (std::size_t c = 0; c < number_of_outputs_padded; ++c) {
+                sums[c] += row[c];
+            }
+        }
+    }
+
+    void _fit_sample(
+            const tcb::span<const Type>& y,
+            const tcb::span<uint32_t>& clause_active,
+            const tcb::span<Type>& literal_active,
+            const tcb::span<Type>& encoded_xi,
+            std::vector<TMOutputFeedback>& feedback,
+            std::vector<uint32_t>& negative_outputs
+    ){
+        clause_bank->calculate_clause_outputs_update(literal_active, encoded_xi);
+        const tcb::span<const Type> clause_output(clause_bank->clause_output.data(), number_of_clauses);
+        const tcb::span<const uint32_t> clause_active_view(clause_active.data(), clause_active.size());
+        compute_class_sums(clause_output, clause_active_view);
+
+        feedback.clear();
+        negative_outputs.clear();
+        bool any_negative_update = false;
+        for (uint32_t c = 0; c < number_of_outputs; ++c) {
+            const auto class_sum = TMMath::clamp(class_sums[c], -T, T);
+            if (y[c]) {
+                feedback.push_back({
+                    c,
+                    true,
+                    static_cast<float>(T - class_sum) / (2.0f * T),
+                    positive_counts[c] < max_positive_clauses.value(),
+                    false,
+                    clause_output.data(),
+                    encoded_xi.data()
+                });
+            } else {
+                negative_outputs.push_back(c);
+                any_negative_update |= class_sum > -T;
+            }
+        }
+
+        // Negative outputs are sampled, in random order
+        if (any_negative_update) {
+            const float negative_p = q / std::max<uint32_t>(1, number_of_outputs - 1);
+            for (std::size_t i = negative_outputs.size(); i > 1; --i) {
+                std::swap(negative_outputs[i - 1], negative_outputs[fast_rand() % i]);
+            }
+            for (const auto c : negative_outputs) {
+                if (fast_rand() / static_cast<float>(FAST_RAND_MAX) > negative_p) {
+                    continue;
+                }
+                const auto class_sum = TMMath::clamp(class_sums[c], -T, T);
+                feedback.push_back({
+                    c,
+                    false,
+                    static_cast<float>(T + class_sum) / (2.0f * T),
+                    true,
+                    false,
+                    clause_output.data(),
+                    encoded_xi.data()
+                });
+            }
+        }
+
+        TMFusedFeedback<Type>::apply(
+                *clause_bank,
+                weights,
+                number_of_outputs_padded,
+                feedback,
+                clause_active_view,
+                literal_active,
+                type_i_p,
+                type_ii_p,
+                positive_counts.data()
+        );
+    }
+
+    /*
+     * y is [sample][output] with Y_shape {samples, outputs}.
+     */
+    void fit(
+            const tcb::span<Type>& y,
+            const std::vector<int32_t>& Y_shape,
+            const tcb::span<Type>& x,
+            const std::vector<int32_t>& X_shape,
+            bool shuffle
+    ){
+        init(Y_shape, x, X_shape);
+        encode_train_data(x, X_shape);
+
+        const auto encoded_X = tcb::span<Type>(encoded_X_train_cached.data(), encoded_X_train_cached.size());
+        const auto num_features = encoded_X_train_shape.at(1);
+        const auto num_samples = encoded_X_train_shape.at(0);
+
+        auto clause_active_vector = mechanism_clause_active();
+        const auto clause_active = tcb::span<uint32_t>(clause_active_vector.data(), clause_active_vector.size());
+
+        auto literal_active_vector = mechanism_literal_active();
+        const auto literal_active = tcb::span<uint32_t>(literal_active_vector.data(), literal_active_vector.size());
+
+        std::vector<int> sample_indices(num_samples);
+        TMMath::aRange(num_samples, shuffle, sample_indices);
+
+        std::vector<TMOutputFeedback> feedback;
+        std::vector<uint32_t> negative_outputs;
+        feedback.reserve(number_of_outputs);
+        negative_outputs.reserve(number_of_outputs);
+
+        for (const auto e : sample_indices) {
+            _fit_sample(
+                    tcb::span<const Type>(y.data() + e * number_of_outputs, number_of_outputs),
+                    clause_active,
+                    literal_active,
+                    encoded_X.subspan(e * num_features, num_features),
+                    feedback,
+                    negative_outputs
+            );
+        }
+    }
+
+    /*
+     * Writes the class sums ([sample][output]) and the outputs (class sum >= 0) of every sample.
+     */
+    void predict_batch(
+            const tcb::span<Type>& X_test,
+            const std::vector<int32_t>& X_shape,
+            bool clip_class_sum,
+            uint32_t* y_pred,
+            int32_t* class_sums_out
+    ){
+        if (!_is_initialized) {
+            throw std::runtime_error("The classifier must be fitted before predicting");
+        }
+
+        auto encoded_X_test_vector = clause_bank->prepare_X(X_test, X_shape);
+        const auto encoded_X_test = tcb::span<Type>(encoded_X_test_vector.data(), encoded_X_test_vector.size());
+        const std::size_t num_items = X_shape.at(0);
+        const std::size_t num_features = clause_bank->number_of_patches * clause_bank->number_of_ta_chunks;
+
+        const std::vector<uint32_t> all_active(number_of_clauses, 1);
+        const tcb::span<const uint32_t> all_active_view(all_active.data(), all_active.size());
+
+        for (std::size_t sample_index = 0; sample_index < num_items; ++sample_index) {
+            const auto clause_output = clause_bank->calculate_clause_outputs_predict(
+                    encoded_X_test.subspan(sample_index * num_features, num_features),
+                    sample_index,
+                    num_items
+            );
+            compute_class_sums(tcb::span<const Type>(clause_output.data(), number_of_clauses), all_active_view);
+
+            for (uint32_t c = 0; c < number_of_outputs; ++c) {
+                const int32_t class_sum = clip_class_sum ? TMMath::clamp(class_sums[c], -T, T) : class_sums[c];
+                y_pred[sample_index * number_of_outputs + c] = class_sum >= 0;
+                if (class_sums_out) {
+                    class_sums_out[sample_index * number_of_outputs + c] = class_sum;
+                }
+            }
+        }
+    }
+
+};
+
+#endif //TUMLIBPP_TM_MULTIOUTPUT_H
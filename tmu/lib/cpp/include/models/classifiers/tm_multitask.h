@@ -0,0 +1,407 @@
+#ifndef TUMLIBPP_TM_MULTITASK_H
+#define TUMLIBPP_TM_MULTITASK_H
+#include <cmath>
+#include <memory>
+#include <numeric>
+#include <algorithm>
+#include <stdexcept>
+#include "tm_clause_dense.h"
+#include "tm_fused_feedback.h"
+#include "tm_memory.h"
+#include "utils/tm_math.h"
+#include <tcb/span.hpp>
+#include <tl/optional.hpp>
+
+extern "C" {
+    #include "fast_rand.h"
+}
+
+/*
+ * Multi-task Tsetlin Machine: one clause bank shared by binary tasks that each see their own version of a sample,
+ * like TMMultiTaskClassifier. X is [task][sample][...] and Y is [task][sample].
+ *
+ * Every task's input is evaluated against the bank up front, and the class sums are computed from the clause-major
+ * [clause][task] weights in one pass. The feedback of all tasks is then applied in one pass over the clauses by
+ * TMFusedFeedback. Unlike the Python model, later tasks therefore see class sums from before the sample's earlier
+ * task updates.
+ */
+template<class Type>
+class TMMultiTaskClassifier {
+
+public:
+    static constexpr std::size_t WEIGHT_LANES = 16;
+
+    int T;
+    float s;
+    float d;
+    uint32_t number_of_clauses;
+    uint32_t number_of_tasks = 0;
+    uint32_t number_of_tasks_padded = 0;
+
+    bool confidence_driven_updating;
+    float type_i_ii_ratio;
+    float type_i_p;
+    float type_ii_p;
+    bool type_iii_feedback;
+    tl::optional<std::size_t> max_included_literals;
+    bool boost_true_positive_feedback;
+    bool reuse_random_feedback;
+    tl::optional<std::vector<int>> patch_dim;
+    int32_t number_of_state_bits;
+    int32_t number_of_state_bits_ind;
+    float clause_drop_p;
+    float literal_drop_p;
+    bool feature_negation;
+    int seed;
+
+    // data views
+    std::vector<uint32_t> encoded_X_train_cached; // [task][sample][patch][ta_chunk]
+    std::vector<uint32_t> encoded_X_train_shape;  // {tasks, samples, stride}
+
+    std::shared_ptr<TMClauseBankDense<Type>> clause_bank;
+    TMMemory<uint32_t> memory;
+
+    // Memory Segments
+    tcb::span<int32_t> weights; // [clause][task (padded)]
+    tcb::span<int32_t> class_sums; // [task (padded)]
+    tcb::span<uint32_t> task_clause_output; // [task][clause]
+
+    bool _is_initialized = false;
+
+    TMMultiTaskClassifier(
+            int _T,
+            float _s,
+            float _d,
+            uint32_t _number_of_clauses,
+            bool _confidence_driven_updating,
+            float _type_i_ii_ratio,
+            bool _type_iii_feedback,
+            tl::optional<std::size_t> _max_included_literals,
+            bool _boost_true_positive_feedback,
+            bool _reuse_random_feedback,
+            tl::optional<std::vector<int>> _patch_dim,
+            int32_t _number_of_state_bits,
+            int32_t _number_of_state_bits_ind,
+            float _clause_drop_p,
+            float _literal_drop_p,
+            bool _feature_negation,
+            int _seed
+    )
+    : T(_T)
+    , s(_s)
+    , d(_d)
+    , number_of_clauses(_number_of_clauses)
+    , confidence_driven_updating(_confidence_driven_updating)
+    , type_i_ii_ratio(_type_i_ii_ratio)
+    , type_iii_feedback(_type_iii_feedback)
+    , max_included_literals(_max_included_literals)
+    , boost_true_positive_feedback(_boost_true_positive_feedback)
+    , reuse_random_feedback(_reuse_random_feedback)
+    , patch_dim(_patch_dim)
+    , number_of_state_bits(_number_of_state_bits)
+    , number_of_state_bits_ind(_number_of_state_bits_ind)
+    , clause_drop_p(_clause_drop_p)
+    , literal_drop_p(_literal_drop_p)
+    , feature_negation(_feature_negation)
+    , seed(_seed)
+    , memory()
+    {
+        if(type_i_ii_ratio >= 1.0){
+            type_i_p = 1.0;
+            type_ii_p = 1.0 / type_i_ii_ratio;
+        }else{
+            type_i_p = type_i_ii_ratio;
+            type_ii_p = 1.0;
+        }
+    }
+
+    std::size_t get_required_memory_size() const {
+        // Weights, class sums and per task clause outputs
+        return number_of_clauses * number_of_tasks_padded + number_of_tasks_padded + number_of_tasks * number_of_clauses;
+    }
+
+    std::vector<int32_t> get_weights(uint32_t task) const {
+        std::vector<int32_t> task_weights(number_of_clauses);
+        for (std::size_t j = 0; j < number_of_clauses; ++j) {
+            task_weights[j] = weights[j * number_of_tasks_padded + task];
+        }
+        return task_weights;
+    }
+
+    // The shape of one task's samples, {samples, ...}
+    static std::vector<int32_t> task_shape(const std::vector<int32_t>& X_shape){
+        if (X_shape.size() < 3) {
+            throw std::invalid_argument("X must be [task][sample][...]");
+        }
+        return std::vector<int32_t>(X_shape.begin() + 1, X_shape.end());
+    }
+
+    void init(const tcb::span<Type>& x, const std::vector<int32_t>& X_shape){
+        if(_is_initialized){
+            return;
+        }
+        _is_initialized = true;
+
+        number_of_tasks = X_shape.at(0);
+        number_of_tasks_padded = ((number_of_tasks + WEIGHT_LANES - 1) / WEIGHT_LANES) * WEIGHT_LANES;
+
+        // Tasks are evaluated one sample at a time, so the incremental evaluation is not used
+        clause_bank = std::make_shared<TMClauseBankDense<Type>>(
+                s,
+                d,
+                boost_true_positive_feedback,
+                reuse_random_feedback,
+                task_shape(X_shape),
+                patch_dim,
+                max_included_literals,
+                number_of_clauses,
+                number_of_state_bits,
+                number_of_state_bits_ind,
+                1,
+                false,
+                seed
+        );
+
+        memory.reserve(get_required_memory_size() + clause_bank->getRequiredMemorySize());
+        clause_bank->initialize(memory);
+
+        auto unsigned_weights = memory.getSegment(number_of_clauses * number_of_tasks_padded);
+        weights = tcb::span<int32_t>(reinterpret_cast<int32_t*>(unsigned_weights.data()), unsigned_weights.size());
+
+        auto unsigned_class_sums = memory.getSegment(number_of_tasks_padded);
+        class_sums = tcb::span<int32_t>(reinterpret_cast<int32_t*>(unsigned_class_sums.data()), unsigned_class_sums.size());
+
+        task_clause_output = memory.getSegment(number_of_tasks * number_of_clauses);
+
+        // Every task starts from the same random polarity per clause. Padding lanes stay zero.
+        for (std::size_t j = 0; j < number_of_clauses; ++j) {
+            const int32_t polarity = (fast_rand() & 1) ? 1 : -1;
+            std::fill_n(weights.begin() + j * number_of_tasks_padded, number_of_tasks, polarity);
+        }
+    }
+
+    std::vector<uint32_t> encode(const tcb::span<Type>& x, const std::vector<int32_t>& X_shape) const {
+        const auto shape = task_shape(X_shape);
+        const std::size_t task_size = x.size() / number_of_tasks;
+
+        std::vector<uint32_t> encoded_X;
+        for (std::size_t i = 0; i < number_of_tasks; ++i) {
+            const auto encoded_task = clause_bank->prepare_X(x.subspan(i * task_size, task_size), shape);
+            encoded_X.insert(encoded_X.end(), encoded_task.begin(), encoded_task.end());
+        }
+        return encoded_X;
+    }
+
+    void encode_train_data(const tcb::span<Type>& x, const std::vector<int32_t>& X_shape){
+        encoded_X_train_cached = encode(x, X_shape);
+        encoded_X_train_shape = std::vector<uint32_t>({
+            static_cast<uint32_t>(X_shape.at(0)),
+            static_cast<uint32_t>(X_shape.at(1)),
+            static_cast<uint32_t>(clause_bank->number_of_patches * clause_bank->number_of_ta_chunks)
+        });
+    }
+
+    std::vector<uint32_t> mechanism_literal_active() const {
+        const auto number_of_literals = clause_bank->number_of_literals;
+        std::vector<uint32_t> literal_active(clause_bank->number_of_ta_chunks, 0);
+
+        for (std::size_t k = 0; k < number_of_literals; ++k) {
+            const auto rng = fast_rand() / static_cast<float>(FAST_RAND_MAX);
+            if (rng >= literal_drop_p && (feature_negation || k < number_of_literals / 2)) {
+                literal_active[k / 32] |= (1u << (k % 32));
+            }
+        }
+        return literal_active;
+    }
+
+    std::vector<uint32_t> mechanism_clause_active() const {
+        std::vector<uint32_t> clause_active(number_of_clauses, 0);
+        for (std::size_t j = 0; j < number_of_clauses; ++j) {
+            const auto rng = fast_rand() / static_cast<float>(FAST_RAND_MAX);
+            clause_active[j] = static_cast<uint32_t>(rng >= clause_drop_p);
+        }
+        return clause_active;
+    }
+
+    // Class sum of every task over its own clause outputs, in one pass over the weight rows
+    void compute_class_sums(const tcb::span<const uint32_t>& clause_active){
+        std::fill(class_sums.begin(), class_sums.end(), 0);
+        for (std::size_t j = 0; j < number_of_clauses; ++j) {
+            if (!clause_active[j]) {
+                continue;
+            }
+            const int32_t* row = weights.data() + j * number_of_tasks_padded;
+            for (std::size_t i = 0; i < number_of_tasks; ++i) {
+                class_sums[i] += task_clause_output[i * number_of_clauses + j] ? row[i] : 0;
+            }
+        }
+    }
+
+    // Clauses with large weights on average are updated less often
+    void mechanism_update_clause(
+            const tcb::span<const uint32_t>& clause_active,
+            std::vector<uint32_t>& update_clause
+    ) const {
+        for (std::size_t j = 0; j < number_of_clauses; ++j) {
+            const int32_t* row = weights.data() + j * number_of_tasks_padded;
+            float average_absolute_weight = 0.0f;
+            for (std::size_t i = 0; i < number_of_tasks; ++i) {
+                average_absolute_weight += std::abs(row[i]);
+            }
+            average_absolute_weight /= number_of_tasks;
+            const float p = (T - std::min(average_absolute_weight, static_cast<float>(T))) / T;
+            update_clause[j] = clause_active[j] && fast_rand() / static_cast<float>(FAST_RAND_MAX) <= p;
+        }
+    }
+
+    void _fit_sample(
+            const std::vector<uint32_t>& targets,
+            const std::vector<const Type*>& encoded_xi,
+            const tcb::span<const uint32_t>& clause_active,
+            const tcb::span<Type>& literal_active,
+            std::vector<uint32_t>& task_order,
+            std::vector<uint32_t>& update_clause,
+            std::vector<TMOutputFeedback>& feedback
+    ){
+        for (std::size_t i = 0; i < number_of_tasks; ++i) {
+            clause_bank->calculate_clause_outputs_update(
+                    literal_active,
+                    tcb::span<Type>(const_cast<Type*>(encoded_xi[i]), clause_bank->number_of_ta_chunks)
+            );
+            std::copy_n(clause_bank->clause_output.begin(), number_of_clauses, task_clause_output.begin() + i * number_of_clauses);
+        }
+        compute_class_sums(clause_active);
+        mechanism_update_clause(clause_active, update_clause);
+
+        for (std::size_t i = number_of_tasks; i > 1; --i) {
+            std::swap(task_order[i - 1], task_order[fast_rand() % i]);
+        }
+
+        feedback.clear();
+        for (const auto i : task_order) {
+            const auto class_sum = TMMath::clamp(class_sums[i], -T, T);
+            const bool target = targets[i];
+            const auto type_iii_feedback_selection = fast_rand() & 1;
+
+            float update_p;
+            if (confidence_driven_updating) {
+                update_p = static_cast<float>(T - std::abs(class_sum)) / T;
+            } else {
+                update_p = static_cast<float>(target ? T - class_sum : T + class_sum) / (2.0f * T);
+            }
+
+            feedback.push_back({
+                i,
+                target,
+                update_p,
+                true,
+                type_iii_feedback && type_iii_feedback_selection == !target,
+                task_clause_output.data() + i * number_of_clauses,
+                encoded_xi[i]
+            });
+        }
+
+        TMFusedFeedback<Type>::apply(
+                *clause_bank,
+                weights,
+                number_of_tasks_padded,
+                feedback,
+                tcb::span<const uint32_t>(update_clause.data(), update_clause.size()),
+                literal_active,
+                type_i_p,
+                type_ii_p
+        );
+    }
+
+    /*
+     * y is [task][sample].
+     */
+    void fit(
+            const tcb::span<Type>& y,
+            const tcb::span<Type>& x,
+            const std::vector<int32_t>& X_shape,
+            bool shuffle
+    ){
+        init(x, X_shape);
+        encode_train_data(x, X_shape);
+
+        const auto num_samples = encoded_X_train_shape.at(1);
+        const auto num_features = encoded_X_train_shape.at(2);
+        if (y.size() != static_cast<std::size_t>(number_of_tasks) * num_samples) {
+            throw std::invalid_argument("y must hold one label per task and sample");
+        }
+
+        const auto clause_active = mechanism_clause_active();
+        auto literal_active_vector = mechanism_literal_active();
+        const auto literal_active = tcb::span<uint32_t>(literal_active_vector.data(), literal_active_vector.size());
+
+        std::vector<int> sample_indices(num_samples);
+        TMMath::aRange(num_samples, shuffle, sample_indices);
+
+        std::vector<uint32_t> task_order(number_of_tasks);
+        std::iota(task_order.begin(), task_order.end(), 0);
+        std::vector<uint32_t> update_clause(number_of_clauses);
+        std::vector<TMOutputFeedback> feedback;
+        feedback.reserve(number_of_tasks);
+
+        std::vector<uint32_t> targets(number_of_tasks);
+        std::vector<const Type*> encoded_xi(number_of_tasks);
+
+        for (const auto e : sample_indices) {
+            for (std::size_t i = 0; i < number_of_tasks; ++i) {
+                targets[i] = y[i * num_samples + e];
+                encoded_xi[i] = encoded_X_train_cached.data() + (i * num_samples + e) * num_features;
+            }
+
+            _fit_sample(
+                    targets,
+                    encoded_xi,
+                    tcb::span<const uint32_t>(clause_active.data(), clause_active.size()),
+                    literal_active,
+                    task_order,
+                    update_clause,
+                    feedback
+            );
+        }
+    }
+
+    /*
+     * Writes y_pred[task][sample] = (class sum >= 0).
+     */
+    void predict_batch(const tcb::span<Type>& X_test, const std::vector<int32_t>& X_shape, uint32_t* y_pred){
+        if (!_is_initialized) {
+            throw std::runtime_error("The classifier must be fitted before predicting");
+        }
+        if (static_cast<uint32_t>(X_shape.at(0)) != number_of_tasks) {
+            throw std::invalid_argument("X must hold one input per task");
+        }
+
+        const auto encoded_X_test = encode(X_test, X_shape);
+        const std::size_t num_items = X_shape.at(1);
+        const std::size_t num_features = clause_bank->number_of_patches * clause_bank->number_of_ta_chunks;
+        std::vector<uint32_t> clause_output(number_of_clauses);
+
+        for (std::size_t i = 0; i < number_of_tasks; ++i) {
+            for (std::size_t e = 0; e < num_items; ++e) {
+                cb_calculate_clause_outputs_predict(
+                        clause_bank->clause_bank.data(),
+                        number_of_clauses,
+                        clause_bank->number_of_literals,
+                        number_of_state_bits,
+                        clause_bank->number_of_patches,
+                        clause_output.data(),
+                        const_cast<Type*>(encoded_X_test.data() + (i * num_items + e) * num_features)
+                );
+
+                int32_t class_sum = 0;
+                for (std::size_t j = 0; j < number_of_clauses; ++j) {
+                    class_sum += clause_output[j] ? weights[j * number_of_tasks_padded + i] : 0;
+                }
+                y_pred[i * num_items + e] = class_sum >= 0;
+            }
+        }
+    }
+
+};
+
+#endif //TUMLIBPP_TM_MULTITASK_H
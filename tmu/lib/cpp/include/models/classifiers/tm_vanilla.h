@@ -5,10 +5,23 @@
 #ifndef TUMLIBPP_TM_VANILLA_H
 #define TUMLIBPP_TM_VANILLA_H
 #include <cmath>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
 #include "utils/sparse_clause_container.h"
 #include "tm_weight_bank.h"
 #include "tm_clause_dense.h"
+#include "tm_class_bank_arena.h"
+#include "tm_branch_and_bound.h"
+#include "tm_anytime.h"
+#include "tm_clause_activations.h"
+#include "tm_clause_statistics.h"
+#include "tm_patch_activations.h"
 #include "utils/tm_math.h"
+#include "utils/tm_checkpoint.h"
+#include "utils/tm_metrics.h"
 #include <tcb/span.hpp>
 #include <tl/optional.hpp>
 
@@ -38,8 +51,8 @@ public:
     bool type_i_feedback;
     bool type_ii_feedback;
     bool type_iii_feedback;
-    bool type_i_p;
-    bool type_ii_p;
+    float type_i_p;
+    float type_ii_p;
     float type_i_ii_ratio;
     int seed;
     tl::optional<std::size_t> max_included_literals;
@@ -56,14 +69,23 @@ public:
     int32_t number_of_state_bits_ind;
     int32_t batch_size;
     bool incremental;
+    bool dense_storage;
 
 
     SparseClauseContainer<TMClauseBankDense<Type>> clause_banks;
     SparseClauseContainer<TMWeightBank<Type>> weight_banks;
+    TMClassBankArena<Type> class_bank_arena;
+    TMBranchAndBound<Type> branch_and_bound;
+    TMAnytimePredictor<Type> anytime;
+    bool branch_and_bound_current = false;  // Whether branch_and_bound and anytime match the clause banks and weights
+
+    // Serializes the parts of prediction that write model state, so predict_batch can run on several threads
+    std::shared_ptr<std::mutex> prediction_mutex = std::make_shared<std::mutex>();
     TMMemory<uint32_t> memory;
 
 
     bool _is_initialized = false;
+    bool track_literal_telemetry = false;
 
     TMVanillaClassifier(
             int _T,
@@ -84,7 +106,8 @@ public:
             int32_t _number_of_state_bits_ind,
             int32_t _batch_size,
             bool _incremental,
-            int _seed
+            int _seed,
+            bool _dense_storage = false
     )
     : T(_T)
     , s(_s)
@@ -107,6 +130,7 @@ public:
     , number_of_state_bits_ind(_number_of_state_bits_ind)
     , batch_size(_batch_size)
     , incremental(_incremental)
+    , dense_storage(_dense_storage)
     , memory()
 
 
@@ -209,7 +233,7 @@ public:
     float mechanism_compute_update_probabilities(bool is_target, int class_sum) {
         // Confidence-driven updating method
         if (confidence_driven_updating) {
-            return (T - std::abs(class_sum)) / T;
+            return static_cast<float>(T - std::abs(class_sum)) / T;
         }
 
         // Compute based on whether the class is the target or not
@@ -231,6 +255,7 @@ public:
             const tcb::span<Type>& literal_active,
             const tcb::span<Type>& encoded_xi
     ) {
+        invalidate_branch_and_bound();
 
         const auto& clause_a = (is_target) ? positive_clauses : negative_clauses;
         const auto& clause_b = (is_target) ? negative_clauses : positive_clauses;
@@ -253,7 +278,7 @@ public:
                 weight_banks[target]->increment(
                         clause_output, // clause_output
                         update_p, // update_p
-                        clause_active, // clause_active
+                        clause_active_target, // clause_active
                         false // positive_weights
                 );
 
@@ -262,7 +287,7 @@ public:
                 weight_banks[target]->decrement(
                         clause_output, // clause_output
                         update_p, // update_p
-                        clause_active, // clause_active
+                        clause_active_target, // clause_active
                         false // negative_weights
                 );
 
@@ -477,9 +502,19 @@ public:
             auto weight_bank = weight_banks[class_id];
             auto clause_bank = clause_banks[class_id];
 
-            mem_size += weight_bank->getRequiredMemorySize(number_of_clauses);
-            mem_size += clause_bank->getRequiredMemorySize();
+            // With dense storage, the clause bank and weights of each class live in the class bank arena
+            mem_size += weight_bank->getRequiredMemorySize(number_of_clauses, !dense_storage);
+            mem_size += clause_bank->getRequiredMemorySize(!dense_storage);
+
+        }
 
+        if(dense_storage){
+            class_bank_arena = TMClassBankArena<Type>(
+                    num_classes,
+                    number_of_clauses,
+                    clause_banks.begin()->get()->calculateClauseBankSize()
+            );
+            mem_size += class_bank_arena.getRequiredMemorySize();
         }
 
         mem_size += clause_banks.begin()->get()->getEncodedXiSize(X_shape);
@@ -487,29 +522,29 @@ public:
 
         memory.reserve(mem_size);
 
-        auto number_of_ta_chunks = clause_banks.begin()->get()->number_of_ta_chunks;
-        auto encoded_x_vector = clause_banks.begin()->get()->prepare_X(
-                x,
-                X_shape
-        );
+        encode_train_data(x, X_shape);
 
-        // Retrieve memory segment for the dataset
-        //encoded_X_train_cached = memory.getSegment(encoded_x_vector.size()); // TODO not using cache
-        encoded_X_train_shape = std::vector<uint32_t>({
-            static_cast<uint32_t>(X_shape.at(0)),
-            static_cast<uint32_t>(number_of_ta_chunks)
-        });
-        encoded_X_train_cached = std::vector<uint32_t>(encoded_x_vector.size());
 
-        // Copy the encoded_x_vector to the memory
-        std::copy(encoded_x_vector.begin(), encoded_x_vector.end(), encoded_X_train_cached.begin());
+        if(dense_storage){
+            class_bank_arena.initialize(memory);
+        }
 
+        const auto& classes = weight_banks.get_classes();
+        for(std::size_t class_position = 0; class_position < classes.size(); ++class_position){
+            auto clause_bank = clause_banks[classes[class_position]];
+            auto weight_bank = weight_banks[classes[class_position]];
 
-        for(auto class_id : weight_banks.get_classes()){
-            auto clause_bank = clause_banks[class_id];
-            auto weight_bank = weight_banks[class_id];
-            clause_bank->initialize(memory);
-            weight_bank->initialize(memory, number_of_clauses);
+            if(dense_storage){
+                clause_bank->initialize(memory, class_bank_arena.getClauseBank(class_position));
+                weight_bank->initialize(memory, number_of_clauses, class_bank_arena.getWeights(class_position));
+            }else{
+                clause_bank->initialize(memory);
+                weight_bank->initialize(memory, number_of_clauses);
+            }
+
+            if(track_literal_telemetry){
+                clause_bank->enable_literal_telemetry();
+            }
         }
 
         initialize(encoded_X_train_shape);
@@ -518,16 +553,48 @@ public:
     }
 
 
+    void encode_train_data(
+            const tcb::span<Type>& x,
+            const std::vector<int32_t>& X_shape
+    ){
+        const auto& clause_bank = *clause_banks.begin();
+
+        // Samples are number_of_patches * number_of_ta_chunks words apart
+        encoded_X_train_cached = clause_bank->prepare_X(x, X_shape);
+        encoded_X_train_shape = std::vector<uint32_t>({
+            static_cast<uint32_t>(X_shape.at(0)),
+            static_cast<uint32_t>(clause_bank->number_of_patches * clause_bank->number_of_ta_chunks)
+        });
+    }
+
+    // Initializes the model on the first call, and re-encodes x on later ones, as it may be a different dataset
+    void prepare_train_data(
+            const tcb::span<Type>& y,
+            const tcb::span<Type>& x,
+            const std::vector<int32_t>& X_shape
+    ){
+        if(!_is_initialized){
+            init(y, x, X_shape);
+            return;
+        }
+        encode_train_data(x, X_shape);
+    }
+
     void fit(
             const tcb::span<Type>& y,
             const tcb::span<Type>& x,
             const std::vector<int32_t>& X_shape,
             bool shuffle
     ){
+        prepare_train_data(y, x, X_shape);
+        fit_encoded(y, shuffle);
+    }
 
-        init(y, x,X_shape);
-
-
+    // One epoch over the training data last passed to prepare_train_data()
+    void fit_encoded(
+            const tcb::span<Type>& y,
+            bool shuffle
+    ){
         const auto encoded_X = tcb::span<Type>(encoded_X_train_cached.data(), encoded_X_train_cached.size());
         const auto& encoded_X_shape = encoded_X_train_shape;
         const auto num_features = encoded_X_shape.at(1);
@@ -565,6 +632,100 @@ public:
             );
         }
 
+        if(track_literal_telemetry){
+            for (const auto& class_id : weight_banks.get_classes()) {
+                clause_banks[class_id]->telemetry()->begin_epoch();
+            }
+        }
+    }
+
+    /*
+     * Keeps per-literal telemetry in the clause bank of every class, from now on or from initialization. Each call
+     * of fit_encoded() is one epoch.
+     */
+    void enable_literal_telemetry(){
+        track_literal_telemetry = true;
+        if(_is_initialized){
+            for (const auto& class_id : weight_banks.get_classes()) {
+                clause_banks[class_id]->enable_literal_telemetry();
+            }
+        }
+    }
+
+    /*
+     * Per class position and literal: the number of clauses including the literal, and the include and exclude
+     * flips of the last epoch. Each output holds number_of_classes * number_of_literals values.
+     */
+    void literal_telemetry(int32_t* clauses_including, uint64_t* include_flips, uint64_t* exclude_flips) {
+        if(!track_literal_telemetry || !_is_initialized){
+            throw std::runtime_error("Literal telemetry is not enabled, or the model is not initialized");
+        }
+        const auto& classes = weight_banks.get_classes();
+        for(std::size_t class_position = 0; class_position < classes.size(); ++class_position){
+            const auto* telemetry = clause_banks[classes[class_position]]->telemetry();
+            const auto n = telemetry->number_of_literals();
+            std::copy_n(telemetry->literal_clause_count().data(), n, clauses_including + class_position * n);
+            std::copy_n(telemetry->last_epoch_include_flips().data(), n, include_flips + class_position * n);
+            std::copy_n(telemetry->last_epoch_exclude_flips().data(), n, exclude_flips + class_position * n);
+        }
+    }
+
+    /*
+     * Trains for a number of epochs, and evaluates on the validation set after each one. Returns per epoch timings,
+     * accuracy, macro F1 and per class statistics, indexed by class position (see weight_banks.get_classes()).
+     */
+    std::vector<TMEpochResult> fit_epochs(
+            const tcb::span<Type>& y,
+            const tcb::span<Type>& x,
+            const std::vector<int32_t>& X_shape,
+            const tcb::span<Type>& y_val,
+            const tcb::span<Type>& x_val,
+            const std::vector<int32_t>& X_val_shape,
+            int epochs,
+            bool shuffle,
+            bool verbose = false
+    ){
+        prepare_train_data(y, x, X_shape);
+
+        const auto& classes = weight_banks.get_classes();
+        std::vector<int> y_val_positions(y_val.size());
+        for (std::size_t i = 0; i < y_val.size(); ++i) {
+            const auto it = std::find(classes.begin(), classes.end(), static_cast<int>(y_val[i]));
+            if (it == classes.end()) {
+                throw std::invalid_argument("Validation class " + std::to_string(y_val[i]) + " does not occur in the training data");
+            }
+            y_val_positions[i] = static_cast<int>(std::distance(classes.begin(), it));
+        }
+
+        std::vector<TMEpochResult> results;
+        results.reserve(epochs);
+        std::vector<int> y_pred(y_val.size());
+
+        for (int epoch = 0; epoch < epochs; ++epoch) {
+            TMEpochResult result;
+            result.epoch = epoch;
+
+            const auto train_start = std::chrono::steady_clock::now();
+            fit_encoded(y, shuffle);
+            const auto train_end = std::chrono::steady_clock::now();
+            predict_batch(x_val, X_val_shape, false, y_pred.data());
+            const auto predict_end = std::chrono::steady_clock::now();
+
+            result.train_seconds = std::chrono::duration<double>(train_end - train_start).count();
+            result.predict_seconds = std::chrono::duration<double>(predict_end - train_end).count();
+            result.metrics = TMClassificationMetrics::compute(y_val_positions, y_pred, classes.size());
+
+            if (verbose) {
+                std::cout << "Epoch: " << epoch << " | Accuracy: " << result.metrics.accuracy * 100.0 << "% | "
+                          << "Macro F1: " << result.metrics.macro_f1 << " | "
+                          << "Training Time: " << result.train_seconds << "s | "
+                          << "Prediction Time: " << result.predict_seconds << "s\n";
+            }
+
+            results.push_back(std::move(result));
+        }
+
+        return results;
     }
 
     std::vector<int> predict_compute_class_sums(
@@ -572,6 +733,28 @@ public:
             int sample_index,
             int num_items,
             bool clip_class_sum) {
+        if (dense_storage && !incremental) {
+            // All classes are evaluated in one pass over encoded_xi, without per-class lookups
+            const auto& first_clause_bank = *clause_banks.begin();
+            std::vector<int> class_sums(class_bank_arena.number_of_classes);
+
+            class_bank_arena.calculate_class_sums_predict(
+                    encoded_xi,
+                    first_clause_bank->number_of_literals,
+                    first_clause_bank->number_of_state_bits,
+                    first_clause_bank->number_of_patches,
+                    tcb::span<int>(class_sums.data(), class_sums.size())
+            );
+
+            if (clip_class_sum) {
+                for (auto& class_sum : class_sums) {
+                    class_sum = TMMath::clamp(class_sum, -T, T);
+                }
+            }
+
+            return class_sums;
+        }
+
         std::vector<int> class_sums;
         class_sums.reserve(weight_banks.size()); // Assuming weight_banks is accessible and defined.
 
@@ -609,13 +792,8 @@ public:
             const tcb::span<Type>& x,
             const std::vector<int32_t>& X_shape
     ){
-
-        if(encoded_X_test_vector.size() != 0){
-           return tcb::span<Type>(encoded_X_test_vector.data(), encoded_X_test_vector.size());
-        }
-
+        // Always re-encoded: callers may pass a different array, or reuse one with new contents
         auto& clause_bank = *clause_banks.begin();
-        auto number_of_ta_chunks = clause_bank->number_of_ta_chunks;
 
         encoded_X_test_vector = clause_bank->prepare_X(
                 x,
@@ -625,55 +803,403 @@ public:
         encoded_X_test_shape = std::vector<uint32_t>(
         {
             static_cast<uint32_t>(X_shape.at(0)),
-            static_cast<uint32_t>(number_of_ta_chunks)
+            static_cast<uint32_t>(encoded_sample_size())
         });
 
         return tcb::span<Type>(encoded_X_test_vector.data(), encoded_X_test_vector.size());
     }
 
+    // Words per encoded sample
+    std::size_t encoded_sample_size() {
+        const auto& clause_bank = *clause_banks.begin();
+        return clause_bank->number_of_patches * clause_bank->number_of_ta_chunks;
+    }
+
 
-    const std::pair<std::vector<int>, tl::optional<std::vector<std::vector<int>>>> predict(
+    /*
+     * True and false positives of every clause of every class over a labelled dataset, evaluated 64 samples at a
+     * time with the blocks split across threads. Labels are class ids as in fit(); results are indexed by class
+     * position (see weight_banks.get_classes()). The first half of the clauses has positive polarity.
+     */
+    TMClauseStatistics clause_statistics(
+            const tcb::span<Type>& x,
+            const std::vector<int32_t>& X_shape,
+            const tcb::span<Type>& y,
+            std::size_t threads = 0
+    ){
+        if(!_is_initialized){
+            throw std::runtime_error("The model must be fitted before clause statistics are computed");
+        }
+        if(y.size() != static_cast<std::size_t>(X_shape.at(0))){
+            throw std::invalid_argument("X and y must have the same number of samples");
+        }
+
+        const auto& classes = weight_banks.get_classes();
+        std::vector<uint32_t> y_positions(y.size());
+        for (std::size_t i = 0; i < y.size(); ++i) {
+            const auto it = std::find(classes.begin(), classes.end(), static_cast<int>(y[i]));
+            if (it == classes.end()) {
+                throw std::invalid_argument("Class " + std::to_string(y[i]) + " does not occur in the training data");
+            }
+            y_positions[i] = static_cast<uint32_t>(std::distance(classes.begin(), it));
+        }
+
+        std::vector<const TMClauseBankDense<Type>*> banks;
+        std::vector<std::size_t> bank_of_class;
+        for (std::size_t class_position = 0; class_position < classes.size(); ++class_position) {
+            banks.push_back(clause_banks[classes[class_position]].get());
+            bank_of_class.push_back(class_position);
+        }
+
+        const auto encoded_X = clause_banks[classes.front()]->prepare_X(x, X_shape);
+        const TMTransposedEvaluator<Type> evaluator(banks, threads);
+        return TMClauseStatistics::compute<Type>(
+                evaluator,
+                encoded_X.data(),
+                y_positions.data(),
+                y.size(),
+                bank_of_class,
+                [this](std::size_t, std::size_t clause) { return positive_clauses[clause] != 0; },
+                threads
+        );
+    }
+
+    /*
+     * Bit-packed activations of every sample with one bank per selected class, in the order given. No classes selects
+     * all of them, in class position order.
+     */
+    TMClauseActivations clause_activations(
+            const tcb::span<Type>& x,
+            const std::vector<int32_t>& X_shape,
+            const std::vector<int>& selected_classes = {},
+            std::size_t threads = 0
+    ){
+        if(!_is_initialized){
+            throw std::runtime_error("The model must be fitted before clause activations are computed");
+        }
+
+        const auto encoded_X = (*clause_banks.begin())->prepare_X(x, X_shape);
+        const TMTransposedEvaluator<Type> evaluator(selected_clause_banks(selected_classes), threads);
+        return TMClauseActivations::compute<Type>(evaluator, encoded_X.data(), X_shape.at(0), threads);
+    }
+
+    // Banks of the selected classes in the order given, all classes in class position order when none are selected
+    std::vector<const TMClauseBankDense<Type>*> selected_clause_banks(const std::vector<int>& selected_classes){
+        const auto& classes = weight_banks.get_classes();
+        std::vector<const TMClauseBankDense<Type>*> banks;
+        for (const int class_id : selected_classes.empty() ? classes : selected_classes) {
+            if (std::find(classes.begin(), classes.end(), class_id) == classes.end()) {
+                throw std::invalid_argument("Class " + std::to_string(class_id) + " does not occur in the training data");
+            }
+            banks.push_back(clause_banks[class_id].get());
+        }
+        return banks;
+    }
+
+    // Bit-packed per-patch clause matches of every sample, one bank per selected class
+    TMPatchActivations patch_activations(
+            const tcb::span<Type>& x,
+            const std::vector<int32_t>& X_shape,
+            const std::vector<int>& selected_classes = {},
+            std::size_t threads = 0
+    ){
+        if(!_is_initialized){
+            throw std::runtime_error("The model must be fitted before patch activations are computed");
+        }
+
+        const auto encoded_X = (*clause_banks.begin())->prepare_X(x, X_shape);
+        const TMTransposedEvaluator<Type> evaluator(selected_clause_banks(selected_classes), threads);
+        return TMPatchActivations::compute<Type>(evaluator, encoded_X.data(), X_shape.at(0), threads);
+    }
+
+    // Per-patch sums of the weights of the matching clauses of each selected class
+    TMPatchHeatmaps patch_heatmaps(
+            const tcb::span<Type>& x,
+            const std::vector<int32_t>& X_shape,
+            const std::vector<int>& selected_classes = {},
+            std::size_t threads = 0
+    ){
+        if(!_is_initialized){
+            throw std::runtime_error("The model must be fitted before heatmaps are computed");
+        }
+
+        const auto& classes = selected_classes.empty() ? weight_banks.get_classes() : selected_classes;
+        const TMTransposedEvaluator<Type> evaluator(selected_clause_banks(selected_classes), threads);
+        std::vector<std::size_t> bank_of_class;
+        std::vector<int32_t> weights;
+        for (std::size_t class_position = 0; class_position < classes.size(); ++class_position) {
+            const auto class_weights = weight_banks[classes[class_position]]->weights;
+            weights.insert(weights.end(), class_weights.begin(), class_weights.end());
+            bank_of_class.push_back(class_position);
+        }
+
+        const auto encoded_X = (*clause_banks.begin())->prepare_X(x, X_shape);
+        return TMPatchHeatmaps::compute<Type>(evaluator, encoded_X.data(), X_shape.at(0), bank_of_class, weights, threads);
+    }
+
+    TMCheckpoint get_checkpoint() {
+        const auto& first_clause_bank = *clause_banks.begin();
+
+        TMCheckpoint checkpoint;
+        checkpoint.T = T;
+        checkpoint.number_of_classes = weight_banks.size();
+        checkpoint.number_of_clauses = number_of_clauses;
+        checkpoint.number_of_literals = first_clause_bank->number_of_literals;
+        checkpoint.number_of_state_bits = first_clause_bank->number_of_state_bits;
+        checkpoint.number_of_patches = first_clause_bank->number_of_patches;
+        checkpoint.dim[0] = std::get<0>(first_clause_bank->dim);
+        checkpoint.dim[1] = std::get<1>(first_clause_bank->dim);
+        checkpoint.dim[2] = std::get<2>(first_clause_bank->dim);
+        checkpoint.patch_dim[0] = std::get<0>(first_clause_bank->patch_dim);
+        checkpoint.patch_dim[1] = std::get<1>(first_clause_bank->patch_dim);
+
+        for (const auto& class_id : weight_banks.get_classes()) {
+            const auto& clause_bank = clause_banks[class_id]->clause_bank;
+            const auto& weights = weight_banks[class_id]->weights;
+            checkpoint.classes.push_back(class_id);
+            checkpoint.clause_banks.insert(checkpoint.clause_banks.end(), clause_bank.begin(), clause_bank.end());
+            checkpoint.weights.insert(checkpoint.weights.end(), weights.begin(), weights.begin() + number_of_clauses);
+        }
+
+        return checkpoint;
+    }
+
+    void save_checkpoint(const std::string& file_path) {
+        get_checkpoint().write(file_path);
+    }
+
+    /*
+     * Restores the clause banks and weights of a checkpoint into an initialized model with the same classes and
+     * geometry, e.g. the merged model of a data-parallel training round.
+     */
+    void load_checkpoint(const TMCheckpoint& checkpoint) {
+        if(!_is_initialized){
+            throw std::runtime_error("The model must be initialized before a checkpoint is loaded");
+        }
+
+        const auto& classes = weight_banks.get_classes();
+        const auto& first_clause_bank = *clause_banks.begin();
+        if (checkpoint.number_of_classes != classes.size()
+            || !std::equal(classes.begin(), classes.end(), checkpoint.classes.begin(),
+                           [](int a, uint32_t b) { return static_cast<uint32_t>(a) == b; })
+            || checkpoint.number_of_clauses != number_of_clauses
+            || checkpoint.number_of_literals != first_clause_bank->number_of_literals
+            || checkpoint.number_of_state_bits != first_clause_bank->number_of_state_bits
+            || checkpoint.number_of_patches != first_clause_bank->number_of_patches) {
+            throw std::invalid_argument("The checkpoint does not match the classes and geometry of the model");
+        }
+
+        for (std::size_t class_position = 0; class_position < classes.size(); ++class_position) {
+            auto clause_bank = clause_banks[classes[class_position]];
+            auto weights = weight_banks[classes[class_position]]->weights;
+            clause_bank->load_clause_bank(&checkpoint.clause_banks[class_position * checkpoint.clause_bank_size()]);
+            std::copy_n(&checkpoint.weights[class_position * number_of_clauses], number_of_clauses, weights.begin());
+        }
+        invalidate_branch_and_bound();
+    }
+
+    /*
+     * The branch-and-bound and anytime orders are built on first use and kept until the clause banks or weights
+     * change through the model (feedback, load_checkpoint). Callers that change the banks directly must invalidate
+     * them.
+     */
+    void invalidate_branch_and_bound() {
+        branch_and_bound_current = false;
+    }
+
+    TMBranchAndBound<Type>& prepared_branch_and_bound() {
+        std::lock_guard<std::mutex> lock(*prediction_mutex);
+        if (!branch_and_bound_current) {
+            build_branch_and_bound();
+        }
+        return branch_and_bound;
+    }
+
+    // Orders the clauses of every class, and of all classes for anytime prediction, by |weight|
+    void build_branch_and_bound() {
+        const auto& first_clause_bank = *clause_banks.begin();
+        branch_and_bound.reset(first_clause_bank->number_of_literals, first_clause_bank->number_of_patches);
+
+        for (const auto& class_id : weight_banks.get_classes()) {
+            const auto& clause_bank = clause_banks[class_id];
+            branch_and_bound.add_class(
+                    clause_bank->clause_bank,
+                    weight_banks[class_id]->weights,
+                    clause_bank->number_of_state_bits
+            );
+        }
+        anytime.build(branch_and_bound);
+        branch_and_bound_current = true;
+    }
+
+    /*
+     * Deadline-bounded prediction. Each sample gets at most clause_budget clause evaluations and
+     * time_budget_us microseconds, and returns its best-so-far argmax with the margin to the runner-up.
+     */
+    TMAnytimeResult predict_anytime(
             const tcb::span<Type>& X_test,
-            const std::vector<int32_t >& X_shape,
+            const std::vector<int32_t>& X_shape,
             bool clip_class_sum = false,
-            bool return_class_sum = false) {
+            tl::optional<std::size_t> clause_budget = tl::nullopt,
+            tl::optional<double> time_budget_us = tl::nullopt) {
 
+        // Encoded per call, so concurrent calls do not share a buffer
+        auto encoded_X_test_local = (*clause_banks.begin())->prepare_X(X_test, X_shape);
+        const auto encoded_X_test = tcb::span<Type>(encoded_X_test_local.data(), encoded_X_test_local.size());
+        const std::size_t num_items = X_shape.at(0);
+        const std::size_t num_features = encoded_sample_size();
 
-        const auto encoded_X_test = getEncodedTestData(X_test, X_shape);
-        const auto num_items = encoded_X_test_shape.at(0);
-        const auto num_features = encoded_X_test_shape.at(1);
+        const auto& bounds = prepared_branch_and_bound();
+        typename TMAnytimePredictor<Type>::Scratch scratch;
 
-        std::vector<int> argmax_indices(num_items, 0);
-        tl::optional<std::vector<std::vector<int>>> optional_class_sums;
+        TMAnytimeResult result;
+        result.argmax.reserve(num_items);
+        result.margin.reserve(num_items);
+        result.evaluated_clauses.reserve(num_items);
+        result.exact.reserve(num_items);
 
-        if (return_class_sum) {
-            // Initialize class_sums_matrix only if needed
-            optional_class_sums.emplace(num_items, std::vector<int>(weight_banks.size(), 0));
+        for (std::size_t sample_index = 0; sample_index < num_items; ++sample_index) {
+            const auto encoded_xi = encoded_X_test.subspan(sample_index * num_features, num_features);
+
+            tl::optional<std::chrono::steady_clock::time_point> deadline;
+            if (time_budget_us) {
+                deadline = std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                        std::chrono::duration<double, std::micro>(*time_budget_us));
+            }
+
+            anytime.predict(bounds, encoded_xi, clip_class_sum, T, clause_budget, deadline, result, scratch);
+        }
+
+        return result;
+    }
+
+    /*
+     * Predicts into caller-owned buffers: argmax[num_items] and, unless null, class_sums[num_items][num_classes].
+     * Nothing is allocated per sample, so the buffers can be handed to Python without copying.
+     *
+     * Safe to call from several threads at once, as long as no thread trains the model meanwhile. The branch-and-bound
+     * and dense paths keep their state per call; the per-class clause bank path shares the banks' clause output
+     * buffers, and runs under prediction_mutex.
+     */
+    void predict_batch(
+            const tcb::span<Type>& X_test,
+            const std::vector<int32_t>& X_shape,
+            bool clip_class_sum,
+            int32_t* argmax,
+            int32_t* class_sums = nullptr,
+            bool use_branch_and_bound = false) {
+
+        auto encoded_X_test_local = (*clause_banks.begin())->prepare_X(X_test, X_shape);
+        const auto encoded_X_test = tcb::span<Type>(encoded_X_test_local.data(), encoded_X_test_local.size());
+        const std::size_t num_items = X_shape.at(0);
+        const std::size_t num_features = encoded_sample_size();
+        const std::size_t num_classes = weight_banks.size();
+
+        if (use_branch_and_bound && class_sums == nullptr) {
+            // Class sums are only bounded, so this path can only serve argmax requests
+            const auto& bounds = prepared_branch_and_bound();
+            typename TMBranchAndBound<Type>::Scratch scratch;
+
+            for (std::size_t sample_index = 0; sample_index < num_items; ++sample_index) {
+                const auto encoded_xi = encoded_X_test.subspan(sample_index * num_features, num_features);
+                argmax[sample_index] = bounds.predict_argmax(encoded_xi, clip_class_sum, T, scratch);
+            }
+
+            std::lock_guard<std::mutex> lock(*prediction_mutex);
+            branch_and_bound.evaluated_clauses += scratch.evaluated_clauses;
+            branch_and_bound.total_clauses += scratch.total_clauses;
+            return;
         }
 
-        for (int sample_index = 0; sample_index < num_items; ++sample_index) {
+        if (dense_storage && !incremental) {
+            const auto& first_clause_bank = *clause_banks.begin();
+            std::vector<Type> clause_output(class_bank_arena.number_of_classes * class_bank_arena.number_of_clauses);
+            std::vector<int> class_sums_vector(num_classes);
+
+            for (std::size_t sample_index = 0; sample_index < num_items; ++sample_index) {
+                class_bank_arena.calculate_class_sums_predict(
+                        encoded_X_test.subspan(sample_index * num_features, num_features),
+                        first_clause_bank->number_of_literals,
+                        first_clause_bank->number_of_state_bits,
+                        first_clause_bank->number_of_patches,
+                        tcb::span<int>(class_sums_vector.data(), class_sums_vector.size()),
+                        tcb::span<Type>(clause_output.data(), clause_output.size())
+                );
+
+                if (clip_class_sum) {
+                    for (auto& class_sum : class_sums_vector) {
+                        class_sum = TMMath::clamp(class_sum, -T, T);
+                    }
+                }
+
+                store_prediction(class_sums_vector, sample_index, argmax, class_sums);
+            }
+            return;
+        }
+
+        std::lock_guard<std::mutex> lock(*prediction_mutex);
+        for (std::size_t sample_index = 0; sample_index < num_items; ++sample_index) {
             const auto encoded_xi = encoded_X_test.subspan(sample_index * num_features, num_features);
 
             const auto class_sums_vector = predict_compute_class_sums(
                     encoded_xi,
-                    sample_index,
-                    num_items,
+                    static_cast<int>(sample_index),
+                    static_cast<int>(num_items),
                     clip_class_sum
             );
 
-            // Compute argmax
-            int argmax_index = std::distance(
-                    class_sums_vector.begin(),
-                    std::max_element(
-                            class_sums_vector.begin(),
-                            class_sums_vector.end()
-                    )
-            );
-            argmax_indices[sample_index] = argmax_index;
+            store_prediction(class_sums_vector, sample_index, argmax, class_sums);
+        }
+    }
 
-            // Store the class sums if requested
-            if (return_class_sum) {
-                (*optional_class_sums)[sample_index] = std::move(class_sums_vector);
+    void store_prediction(
+            const std::vector<int>& class_sums_vector,
+            std::size_t sample_index,
+            int32_t* argmax,
+            int32_t* class_sums) const {
+        argmax[sample_index] = static_cast<int32_t>(std::distance(
+                class_sums_vector.begin(),
+                std::max_element(
+                        class_sums_vector.begin(),
+                        class_sums_vector.end()
+                )
+        ));
+
+        if (class_sums != nullptr) {
+            std::copy(class_sums_vector.begin(), class_sums_vector.end(), class_sums + sample_index * class_sums_vector.size());
+        }
+    }
+
+    const std::pair<std::vector<int>, tl::optional<std::vector<std::vector<int>>>> predict(
+            const tcb::span<Type>& X_test,
+            const std::vector<int32_t >& X_shape,
+            bool clip_class_sum = false,
+            bool return_class_sum = false,
+            bool use_branch_and_bound = false) {
+
+        const auto num_items = X_shape.at(0);
+        const auto num_classes = weight_banks.size();
+
+        std::vector<int> argmax_indices(num_items, 0);
+        std::vector<int32_t> class_sums_matrix(return_class_sum ? num_items * num_classes : 0);
+
+        predict_batch(
+                X_test,
+                X_shape,
+                clip_class_sum,
+                argmax_indices.data(),
+                return_class_sum ? class_sums_matrix.data() : nullptr,
+                use_branch_and_bound
+        );
+
+        tl::optional<std::vector<std::vector<int>>> optional_class_sums;
+        if (return_class_sum) {
+            optional_class_sums.emplace(num_items);
+            for (int sample_index = 0; sample_index < num_items; ++sample_index) {
+                (*optional_class_sums)[sample_index].assign(
+                        class_sums_matrix.begin() + sample_index * num_classes,
+                        class_sums_matrix.begin() + (sample_index + 1) * num_classes
+                );
             }
         }
 
@@ -0,0 +1,391 @@
+#ifndef TUMLIBPP_TM_VANILLA_REGRESSOR_H
+#define TUMLIBPP_TM_VANILLA_REGRESSOR_H
+#include <cmath>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <algorithm>
+#include <stdexcept>
+#include "tm_clause_dense.h"
+#include "tm_weight_bank.h"
+#include "tm_memory.h"
+#include "tm_clause_activations.h"
+#include "utils/tm_math.h"
+#include "utils/tm_parallel.h"
+#include <tcb/span.hpp>
+#include <tl/optional.hpp>
+
+extern "C" {
+    #include "fast_rand.h"
+}
+
+/*
+ * Regression Tsetlin Machine: one clause bank, and one weight per clause that starts at 1.
+ *
+ * Targets are scaled to [0, T] with the range seen by the first fit. A sample's prediction is the clipped sum of
+ * the weights of the clauses that fire. Clauses receive Type I feedback when the prediction is too low and
+ * Type II feedback when it is too high, both with probability (error / T)^2.
+ */
+template<class Type>
+class TMVanillaRegressor {
+
+public:
+    int T;
+    float s;
+    float d;
+    uint32_t number_of_clauses;
+    bool weighted_clauses;
+    tl::optional<std::size_t> max_included_literals;
+    bool boost_true_positive_feedback;
+    bool reuse_random_feedback;
+    tl::optional<std::vector<int>> patch_dim;
+    int32_t number_of_state_bits;
+    int32_t number_of_state_bits_ind;
+    int32_t batch_size;
+    bool incremental;
+    float clause_drop_p;
+    float literal_drop_p;
+    bool feature_negation;
+    int seed;
+
+    double min_y = 0.0;
+    double max_y = 0.0;
+
+    // data views
+    std::vector<uint32_t> encoded_X_train_cached;
+    std::vector<uint32_t> encoded_X_train_shape;
+    std::vector<int32_t> encoded_y_train;
+
+    std::shared_ptr<TMClauseBankDense<Type>> clause_bank;
+    std::shared_ptr<TMWeightBank<Type>> weight_bank;
+
+    // Serializes incremental prediction, which shares the clause bank's batch buffers, so predict_batch can run on
+    // several threads
+    std::shared_ptr<std::mutex> prediction_mutex = std::make_shared<std::mutex>();
+    TMMemory<uint32_t> memory;
+
+    bool _is_initialized = false;
+
+    TMVanillaRegressor(
+            int _T,
+            float _s,
+            float _d,
+            uint32_t _number_of_clauses,
+            bool _weighted_clauses,
+            tl::optional<std::size_t> _max_included_literals,
+            bool _boost_true_positive_feedback,
+            bool _reuse_random_feedback,
+            tl::optional<std::vector<int>> _patch_dim,
+            int32_t _number_of_state_bits,
+            int32_t _number_of_state_bits_ind,
+            int32_t _batch_size,
+            bool _incremental,
+            float _clause_drop_p,
+            float _literal_drop_p,
+            bool _feature_negation,
+            int _seed
+    )
+    : T(_T)
+    , s(_s)
+    , d(_d)
+    , number_of_clauses(_number_of_clauses)
+    , weighted_clauses(_weighted_clauses)
+    , max_included_literals(_max_included_literals)
+    , boost_true_positive_feedback(_boost_true_positive_feedback)
+    , reuse_random_feedback(_reuse_random_feedback)
+    , patch_dim(_patch_dim)
+    , number_of_state_bits(_number_of_state_bits)
+    , number_of_state_bits_ind(_number_of_state_bits_ind)
+    , batch_size(_batch_size)
+    , incremental(_incremental)
+    , clause_drop_p(_clause_drop_p)
+    , literal_drop_p(_literal_drop_p)
+    , feature_negation(_feature_negation)
+    , seed(_seed)
+    , memory()
+    {}
+
+    // Sizes the clause bank from X_shape and the target range from y
+    void init(
+            const tcb::span<const double>& y,
+            const std::vector<int32_t>& X_shape
+    ){
+        if(_is_initialized){
+            return;
+        }
+        if(y.empty()){
+            throw std::invalid_argument("Cannot initialize a regressor without training samples");
+        }
+        _is_initialized = true;
+
+        const auto [min_it, max_it] = std::minmax_element(y.begin(), y.end());
+        min_y = *min_it;
+        max_y = *max_it;
+
+        clause_bank = std::make_shared<TMClauseBankDense<Type>>(
+                s,
+                d,
+                boost_true_positive_feedback,
+                reuse_random_feedback,
+                X_shape,
+                patch_dim,
+                max_included_literals,
+                number_of_clauses,
+                number_of_state_bits,
+                number_of_state_bits_ind,
+                batch_size,
+                incremental,
+                seed
+        );
+        weight_bank = std::make_shared<TMWeightBank<Type>>();
+
+        memory.reserve(clause_bank->getRequiredMemorySize() + weight_bank->getRequiredMemorySize(number_of_clauses));
+        clause_bank->initialize(memory);
+        weight_bank->initialize(memory, number_of_clauses);
+
+        // Every clause votes for a higher value
+        std::fill(weight_bank->weights.begin(), weight_bank->weights.end(), 1);
+    }
+
+    void encode_train_data(
+            const tcb::span<const double>& y,
+            const tcb::span<Type>& x,
+            const std::vector<int32_t>& X_shape
+    ){
+        encoded_X_train_cached = clause_bank->prepare_X(x, X_shape);
+        encoded_X_train_shape = std::vector<uint32_t>({
+            static_cast<uint32_t>(X_shape.at(0)),
+            static_cast<uint32_t>(clause_bank->number_of_patches * clause_bank->number_of_ta_chunks)
+        });
+
+        encoded_y_train.resize(y.size());
+        const double range = max_y - min_y;
+        for (std::size_t i = 0; i < y.size(); ++i) {
+            encoded_y_train[i] = range == 0.0 ? 0 : static_cast<int32_t>((y[i] - min_y) / range * T);
+        }
+    }
+
+    std::vector<uint32_t> mechanism_literal_active() const {
+        const auto number_of_literals = clause_bank->number_of_literals;
+        std::vector<uint32_t> literal_active(clause_bank->number_of_ta_chunks, 0);
+
+        for (std::size_t k = 0; k < number_of_literals; ++k) {
+            const auto rng = fast_rand() / static_cast<float>(FAST_RAND_MAX);
+            if (rng >= literal_drop_p) {
+                literal_active[k / 32] |= (1u << (k % 32));
+            }
+        }
+
+        // If feature negation is not applied, clear the corresponding bits for the second half of literals
+        if (!feature_negation) {
+            for (std::size_t k = number_of_literals / 2; k < number_of_literals; ++k) {
+                literal_active[k / 32] &= ~(1u << (k % 32));
+            }
+        }
+
+        return literal_active;
+    }
+
+    std::vector<uint32_t> mechanism_clause_active() const {
+        std::vector<uint32_t> clause_active(number_of_clauses, 0);
+        for (std::size_t j = 0; j < number_of_clauses; ++j) {
+            const auto rng = fast_rand() / static_cast<float>(FAST_RAND_MAX);
+            clause_active[j] = static_cast<uint32_t>(rng >= clause_drop_p);
+        }
+        return clause_active;
+    }
+
+    // The clipped weighted vote of the active clauses that fired, in [0, T]
+    int32_t mechanism_prediction(
+            const tcb::span<const Type>& clause_output,
+            const tcb::span<const uint32_t>& clause_active
+    ) const {
+        int32_t pred_y = 0;
+        for (std::size_t j = 0; j < number_of_clauses; ++j) {
+            pred_y += static_cast<int32_t>(clause_output[j] & clause_active[j]) * weight_bank->weights[j];
+        }
+        return TMMath::clamp(pred_y, 0, T);
+    }
+
+    void _fit_sample(
+            int32_t target,
+            const tcb::span<uint32_t>& clause_active,
+            const tcb::span<Type>& literal_active,
+            const tcb::span<Type>& encoded_xi
+    ){
+        clause_bank->calculate_clause_outputs_update(literal_active, encoded_xi);
+        const auto& clause_output = clause_bank->clause_output;
+
+        const auto pred_y = mechanism_prediction(
+                tcb::span<const Type>(clause_output.data(), number_of_clauses),
+                tcb::span<const uint32_t>(clause_active.data(), clause_active.size())
+        );
+
+        const float prediction_error = static_cast<float>(pred_y - target) / T;
+        const float update_p = prediction_error * prediction_error;
+
+        if (pred_y < target) {
+            clause_bank->type_i_feedback(update_p, clause_active, literal_active, encoded_xi);
+            if (weighted_clauses) {
+                weight_bank->increment(clause_output, update_p, clause_active, false);
+            }
+        } else if (pred_y > target) {
+            clause_bank->type_ii_feedback(update_p, clause_active, literal_active, encoded_xi);
+            if (weighted_clauses) {
+                weight_bank->decrement(clause_output, update_p, clause_active, false);
+            }
+        }
+    }
+
+    // Initializes the model on the first call, and encodes x, as it may be a different dataset on later calls
+    void prepare_train_data(
+            const tcb::span<const double>& y,
+            const tcb::span<Type>& x,
+            const std::vector<int32_t>& X_shape
+    ){
+        init(y, X_shape);
+        encode_train_data(y, x, X_shape);
+    }
+
+    void fit(
+            const tcb::span<const double>& y,
+            const tcb::span<Type>& x,
+            const std::vector<int32_t>& X_shape,
+            bool shuffle
+    ){
+        prepare_train_data(y, x, X_shape);
+        fit_encoded(shuffle);
+    }
+
+    // Encodes the training data once, and trains on it for the given number of epochs
+    void fit_epochs(
+            const tcb::span<const double>& y,
+            const tcb::span<Type>& x,
+            const std::vector<int32_t>& X_shape,
+            int epochs,
+            bool shuffle
+    ){
+        prepare_train_data(y, x, X_shape);
+        for (int epoch = 0; epoch < epochs; ++epoch) {
+            fit_encoded(shuffle);
+        }
+    }
+
+    // One epoch over the training data last passed to prepare_train_data()
+    void fit_encoded(bool shuffle){
+        const auto encoded_X = tcb::span<Type>(encoded_X_train_cached.data(), encoded_X_train_cached.size());
+        const auto num_features = encoded_X_train_shape.at(1);
+        const auto num_samples = encoded_X_train_shape.at(0);
+
+        auto clause_active_vector = mechanism_clause_active();
+        const auto clause_active = tcb::span<uint32_t>(clause_active_vector.data(), clause_active_vector.size());
+
+        auto literal_active_vector = mechanism_literal_active();
+        const auto literal_active = tcb::span<uint32_t>(literal_active_vector.data(), literal_active_vector.size());
+
+        std::vector<int> sample_indices(num_samples);
+        TMMath::aRange(num_samples, shuffle, sample_indices);
+
+        for (const auto e : sample_indices) {
+            _fit_sample(
+                    encoded_y_train[e],
+                    clause_active,
+                    literal_active,
+                    encoded_X.subspan(e * num_features, num_features)
+            );
+        }
+    }
+
+    /*
+     * Predicts into a caller-owned buffer y_pred[num_items], in the units of the training targets.
+     *
+     * Safe to call from several threads at once, as long as no thread trains the model meanwhile. Without incremental
+     * evaluation, each call keeps its clause outputs to itself and splits the samples over threads; incremental
+     * evaluation shares the clause bank's batch buffers, and runs serially under prediction_mutex.
+     */
+    void predict_batch(
+            const tcb::span<Type>& X_test,
+            const std::vector<int32_t>& X_shape,
+            double* y_pred,
+            std::size_t threads = 1
+    ){
+        if (!_is_initialized) {
+            throw std::runtime_error("The regressor must be fitted before predicting");
+        }
+
+        auto encoded_X_test_vector = clause_bank->prepare_X(X_test, X_shape);
+        const auto encoded_X_test = tcb::span<Type>(encoded_X_test_vector.data(), encoded_X_test_vector.size());
+        const std::size_t num_items = X_shape.at(0);
+        const std::size_t num_features = clause_bank->number_of_patches * clause_bank->number_of_ta_chunks;
+
+        if (!incremental) {
+            constexpr std::size_t min_samples_per_worker = 64;
+            TMParallel::for_ranges(num_items, threads, min_samples_per_worker,
+                                   [&](std::size_t, std::size_t begin, std::size_t end) {
+                std::vector<Type> clause_output(number_of_clauses);
+                for (std::size_t sample_index = begin; sample_index < end; ++sample_index) {
+                    cb_calculate_clause_outputs_predict(
+                            clause_bank->clause_bank.data(),
+                            static_cast<int>(number_of_clauses),
+                            static_cast<int>(clause_bank->number_of_literals),
+                            static_cast<int>(clause_bank->number_of_state_bits),
+                            static_cast<int>(clause_bank->number_of_patches),
+                            clause_output.data(),
+                            encoded_X_test.data() + sample_index * num_features
+                    );
+                    y_pred[sample_index] = scaled_prediction(clause_output.data());
+                }
+            });
+            return;
+        }
+
+        std::lock_guard<std::mutex> lock(*prediction_mutex);
+        for (std::size_t sample_index = 0; sample_index < num_items; ++sample_index) {
+            const auto clause_output = clause_bank->calculate_clause_outputs_predict(
+                    encoded_X_test.subspan(sample_index * num_features, num_features),
+                    sample_index,
+                    num_items
+            );
+            y_pred[sample_index] = scaled_prediction(clause_output.data());
+        }
+    }
+
+    // The weighted vote of the clauses that fired, in the units of the training targets
+    double scaled_prediction(const Type* clause_output) const {
+        // Not clipped, like TMRegressor.predict
+        const int32_t pred_y = std::inner_product(
+                clause_output,
+                clause_output + number_of_clauses,
+                weight_bank->weights.begin(),
+                0
+        );
+        return static_cast<double>(pred_y) * (max_y - min_y) / T + min_y;
+    }
+
+    // Bit-packed activations of every sample, split over threads
+    TMClauseActivations clause_activations(
+            const tcb::span<Type>& x,
+            const std::vector<int32_t>& X_shape,
+            std::size_t threads = 0
+    ){
+        if (!_is_initialized) {
+            throw std::runtime_error("The regressor must be fitted before clause activations are computed");
+        }
+
+        const auto encoded_X = clause_bank->prepare_X(x, X_shape);
+        const TMTransposedEvaluator<Type> evaluator({clause_bank.get()}, threads);
+        return TMClauseActivations::compute<Type>(evaluator, encoded_X.data(), X_shape.at(0), threads);
+    }
+
+    std::vector<double> predict(
+            const tcb::span<Type>& X_test,
+            const std::vector<int32_t>& X_shape
+    ){
+        std::vector<double> y_pred(X_shape.at(0));
+        predict_batch(X_test, X_shape, y_pred.data());
+        return y_pred;
+    }
+
+};
+
+#endif //TUMLIBPP_TM_VANILLA_REGRESSOR_H
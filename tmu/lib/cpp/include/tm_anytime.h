@@ -0,0 +1,203 @@
+#ifndef TUMLIBPP_TM_ANYTIME_H
+#define TUMLIBPP_TM_ANYTIME_H
+
+#include <cstddef>
+#include <cstdint>
+#include <climits>
+#include <cstdlib>
+#include <chrono>
+#include <vector>
+#include <numeric>
+#include <algorithm>
+#include <tcb/span.hpp>
+#include <tl/optional.hpp>
+#include "tm_branch_and_bound.h"
+
+struct TMAnytimeResult {
+    std::vector<int> argmax;                    // Best-so-far class position
+    std::vector<int> margin;                    // Best minus second best partial class sum
+    std::vector<std::size_t> evaluated_clauses; // Clauses evaluated before stopping
+    std::vector<uint8_t> exact;                 // 1 if argmax is provably that of full evaluation
+};
+
+/*
+ * Deadline-bounded prediction. The clauses of all classes are merged into one evaluation order of decreasing
+ * |weight|, so the clauses that can move a class sum the most are evaluated first. Evaluation stops when the
+ * clause budget or the deadline is reached, or as soon as the bounds of TMBranchAndBound settle the argmax. The
+ * argmax of the partial class sums is returned, together with the margin to the runner-up.
+ *
+ * The order is derived from a built TMBranchAndBound, and must be rebuilt with it. Like TMBranchAndBound, predict
+ * only reads the order, and threads can share a TMAnytimePredictor with a Scratch each.
+ */
+template<class T>
+class TMAnytimePredictor {
+
+public:
+    std::vector<uint32_t> order_class;      // [rank], class position of each clause in the global order
+    std::vector<std::size_t> order_clause;  // [rank], index into the ordered clauses of TMBranchAndBound
+
+    // Number of clauses evaluated between deadline and certainty checks
+    std::size_t check_interval = 32;
+
+    // Per-thread partial class sums and per class ranks of predict
+    struct Scratch {
+        std::vector<int32_t> partial;
+        std::vector<std::size_t> rank;
+    };
+
+    void build(const TMBranchAndBound<T>& bounds) {
+        order_class.clear();
+        order_clause.clear();
+        for (std::size_t c = 0; c < bounds.number_of_classes; ++c) {
+            for (std::size_t clause = bounds.class_offsets[c]; clause < bounds.class_offsets[c + 1]; ++clause) {
+                order_class.push_back(static_cast<uint32_t>(c));
+                order_clause.push_back(clause);
+            }
+        }
+
+        // A stable sort keeps each class' clauses in the TMBranchAndBound order, so per class ranks stay valid
+        std::vector<std::size_t> permutation(order_clause.size());
+        std::iota(permutation.begin(), permutation.end(), 0);
+        std::stable_sort(permutation.begin(), permutation.end(), [&](std::size_t a, std::size_t b) {
+            return std::abs(bounds.ordered_weights[order_clause[a]]) > std::abs(bounds.ordered_weights[order_clause[b]]);
+        });
+
+        std::vector<uint32_t> sorted_class(permutation.size());
+        std::vector<std::size_t> sorted_clause(permutation.size());
+        for (std::size_t i = 0; i < permutation.size(); ++i) {
+            sorted_class[i] = order_class[permutation[i]];
+            sorted_clause[i] = order_clause[permutation[i]];
+        }
+        order_class = std::move(sorted_class);
+        order_clause = std::move(sorted_clause);
+    }
+
+    /*
+     * Evaluates one sample, and appends its outcome to result. deadline is absolute, and checked every
+     * check_interval clauses.
+     */
+    void predict(
+            const TMBranchAndBound<T>& bounds,
+            const tcb::span<T>& encoded_xi,
+            bool clip_class_sum,
+            int threshold,
+            tl::optional<std::size_t> clause_budget,
+            tl::optional<std::chrono::steady_clock::time_point> deadline,
+            TMAnytimeResult& result
+    ) {
+        predict(bounds, encoded_xi, clip_class_sum, threshold, clause_budget, deadline, result, scratch);
+    }
+
+    void predict(
+            const TMBranchAndBound<T>& bounds,
+            const tcb::span<T>& encoded_xi,
+            bool clip_class_sum,
+            int threshold,
+            tl::optional<std::size_t> clause_budget,
+            tl::optional<std::chrono::steady_clock::time_point> deadline,
+            TMAnytimeResult& result,
+            Scratch& scratch
+    ) const {
+        const std::size_t number_of_classes = bounds.number_of_classes;
+        auto& partial = scratch.partial;
+        auto& rank = scratch.rank;
+        partial.assign(number_of_classes, 0);
+        rank.assign(number_of_classes, 0);
+
+        const auto clip = [&](int32_t class_sum) {
+            return clip_class_sum ? std::min(std::max(class_sum, -threshold), threshold) : class_sum;
+        };
+
+        const std::size_t limit = std::min(order_clause.size(), clause_budget.value_or(order_clause.size()));
+        std::size_t evaluated = 0;
+        tl::optional<std::size_t> winner;
+
+        while (evaluated < limit) {
+            const std::size_t stop = std::min(limit, evaluated + check_interval);
+            for (; evaluated < stop; ++evaluated) {
+                const auto c = order_class[evaluated];
+                const auto clause = order_clause[evaluated];
+                if (bounds.clause_output(clause, encoded_xi.data())) {
+                    partial[c] += bounds.ordered_weights[clause];
+                }
+                ++rank[c];
+            }
+
+            winner = certain_winner(bounds, scratch, clip);
+            if (winner) {
+                break;
+            }
+
+            if (deadline && std::chrono::steady_clock::now() >= *deadline) {
+                break;
+            }
+        }
+
+        // Best-so-far argmax and margin on the partial sums, with ties to the lowest class position
+        int best = 0;
+        int32_t best_sum = INT32_MIN;
+        int32_t second_sum = INT32_MIN;
+        for (std::size_t c = 0; c < number_of_classes; ++c) {
+            const int32_t class_sum = clip(partial[c]);
+            if (class_sum > best_sum) {
+                second_sum = best_sum;
+                best_sum = class_sum;
+                best = static_cast<int>(c);
+            } else if (class_sum > second_sum) {
+                second_sum = class_sum;
+            }
+        }
+
+        if (order_clause.empty()) {
+            winner = certain_winner(bounds, scratch, clip);
+        }
+
+        if (winner && static_cast<int>(*winner) != best) {
+            // Equal partial sums, where the bounds already settle the tie
+            best = static_cast<int>(*winner);
+            second_sum = best_sum;
+            best_sum = clip(partial[best]);
+        }
+
+        result.argmax.push_back(best);
+        result.margin.push_back(number_of_classes > 1 ? best_sum - second_sum : 0);
+        result.evaluated_clauses.push_back(evaluated);
+        result.exact.push_back(winner ? 1 : 0);
+    }
+
+private:
+    // Scratch space for the single-threaded predict
+    Scratch scratch;
+
+    // The class whose lower bound beats the upper bound of every other class, if there is one
+    template<class Clip>
+    tl::optional<std::size_t> certain_winner(const TMBranchAndBound<T>& bounds, const Scratch& scratch, const Clip& clip) const {
+        const std::size_t number_of_classes = bounds.number_of_classes;
+        const auto& partial = scratch.partial;
+        const auto& rank = scratch.rank;
+
+        int32_t best_lower = INT32_MIN;
+        std::size_t best = 0;
+        for (std::size_t c = 0; c < number_of_classes; ++c) {
+            const int32_t lower = clip(bounds.lower_bound(c, rank[c], partial[c]));
+            if (lower > best_lower) {
+                best_lower = lower;
+                best = c;
+            }
+        }
+
+        for (std::size_t c = 0; c < number_of_classes; ++c) {
+            if (c == best) {
+                continue;
+            }
+            const int32_t upper = clip(bounds.upper_bound(c, rank[c], partial[c]));
+            if (upper > best_lower || (upper == best_lower && c < best)) {
+                return tl::nullopt;
+            }
+        }
+        return best;
+    }
+
+};
+
+#endif //TUMLIBPP_TM_ANYTIME_H
@@ -0,0 +1,401 @@
+#ifndef TUMLIBPP_TM_ATTENTION_H
+#define TUMLIBPP_TM_ATTENTION_H
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <numeric>
+#include <algorithm>
+#include <stdexcept>
+#include <tcb/span.hpp>
+#include "tm_clause_dense.h"
+
+extern "C" {
+    #include "fast_rand.h"
+}
+
+/*
+ * Attention-ranked literal selection, the native counterpart of Attention.c.
+ *
+ * Instead of a ranking array updated by adjacent swaps, every literal has a saturating score, stored bit-sliced per
+ * ta chunk like the Tsetlin Automata of the clause bank, so a feedback step moves all literals of a chunk with a few
+ * word operations. The rank order is the score order, ties broken by literal index. The attention_span best ranked
+ * literals are found with a radix select over the score bits, which only runs when a feedback has changed the scores
+ * and is then kept as a mask, together with the list of ta chunks it touches.
+ */
+template<class T>
+class TMAttention {
+
+    static constexpr std::size_t bits_per_chunk = sizeof(T) * 8;
+
+    std::vector<T> score;               // [ta_chunk][state_bit]
+    std::vector<T> top_span;            // The attention_span best ranked literals
+    std::vector<T> included;            // Literals included by a clause, which are always attended to
+    std::vector<T> active;              // top_span | included
+    std::vector<uint32_t> active_chunks;
+    std::vector<int32_t> active_chunk_pos;  // Position of a ta chunk in active_chunks, -1 if absent
+    std::vector<T> random_stream;
+    T filter;
+    bool scores_changed = true;
+
+public:
+    std::size_t number_of_literals;
+    std::size_t number_of_ta_chunks;
+    std::size_t number_of_state_bits;
+    std::size_t attention_span;
+    float s;
+
+    TMAttention(
+            std::size_t number_of_literals,
+            std::size_t attention_span,
+            float s,
+            std::size_t number_of_state_bits = 8
+    )
+    : number_of_literals(number_of_literals)
+    , number_of_ta_chunks((number_of_literals - 1) / bits_per_chunk + 1)
+    , number_of_state_bits(number_of_state_bits)
+    , attention_span(std::min(attention_span, number_of_literals))
+    , s(s)
+    {
+        if (number_of_literals == 0) {
+            throw std::invalid_argument("TMAttention needs at least one literal");
+        }
+        if (number_of_state_bits < 2 || number_of_state_bits > 32) {
+            throw std::invalid_argument("number_of_state_bits must be in [2, 32]");
+        }
+
+        filter = (number_of_literals % bits_per_chunk) != 0
+                ? static_cast<T>(~(~T(0) << (number_of_literals % bits_per_chunk)))
+                : ~T(0);
+
+        score.resize(number_of_ta_chunks * number_of_state_bits, 0);
+        top_span.resize(number_of_ta_chunks, 0);
+        included.resize(number_of_ta_chunks, 0);
+        active.resize(number_of_ta_chunks, 0);
+        active_chunk_pos.resize(number_of_ta_chunks, -1);
+        random_stream.resize(number_of_ta_chunks, 0);
+
+        // All literals start in the middle of the range, with random low bits in place of the shuffled ranking
+        for (std::size_t k = 0; k < number_of_ta_chunks; ++k) {
+            T* state = &score[k * number_of_state_bits];
+            state[number_of_state_bits - 1] = chunk_filter(k);
+            state[0] = static_cast<T>(fast_rand()) & chunk_filter(k);
+            state[1] = static_cast<T>(fast_rand()) & chunk_filter(k);
+        }
+    }
+
+    /*
+     * With probability update_p, literals true in xi move up and false literals move down with probability 1/s.
+     */
+    void type_i_feedback(float update_p, const T* xi){
+        if (!draw(update_p)) {
+            return;
+        }
+
+        initialize_random_stream();
+        for (std::size_t k = 0; k < number_of_ta_chunks; ++k) {
+            increment(k, xi[k] & chunk_filter(k));
+            decrement(k, ~xi[k] & random_stream[k] & chunk_filter(k));
+        }
+        scores_changed = true;
+    }
+
+    /*
+     * With probability update_p, literals false in xi move up.
+     */
+    void type_ii_feedback(float update_p, const T* xi){
+        if (!draw(update_p)) {
+            return;
+        }
+
+        for (std::size_t k = 0; k < number_of_ta_chunks; ++k) {
+            increment(k, ~xi[k] & chunk_filter(k));
+        }
+        scores_changed = true;
+    }
+
+    /*
+     * The literals included by at least one clause, e.g. from cb_included_literals. They stay visible beyond the span.
+     */
+    void set_included_literals(const T* included_literals){
+        std::copy(included_literals, included_literals + number_of_ta_chunks, included.begin());
+        update_active();
+    }
+
+    void set_included_literals(const TMClauseBankDense<T>& clause_bank){
+        check_clause_bank(clause_bank);
+
+        std::fill(included.begin(), included.end(), 0);
+        const std::size_t bits = clause_bank.number_of_state_bits;
+        for (std::size_t j = 0; j < clause_bank.number_of_clauses; ++j) {
+            const T* ta_state = &clause_bank.clause_bank[j * number_of_ta_chunks * bits];
+            for (std::size_t k = 0; k < number_of_ta_chunks; ++k) {
+                included[k] |= ta_state[k * bits + bits - 1];
+            }
+        }
+        update_active();
+    }
+
+    /*
+     * Per ta chunk, the attention_span best ranked literals and the included literals.
+     */
+    const std::vector<T>& attention_mask(){
+        if (scores_changed) {
+            select_top_span();
+            update_active();
+            scores_changed = false;
+        }
+        return active;
+    }
+
+    /*
+     * The ta chunks holding an attended literal, in no particular order.
+     */
+    const std::vector<uint32_t>& attended_chunks(){
+        attention_mask();
+        return active_chunks;
+    }
+
+    /*
+     * Clears the literals of xi ([patch][ta_chunk]) that are neither within the span nor included.
+     */
+    void get_attention(T* xi, std::size_t number_of_patches = 1){
+        const auto& mask = attention_mask();
+        for (std::size_t patch = 0; patch < number_of_patches; ++patch) {
+            T* patch_xi = xi + patch * number_of_ta_chunks;
+            for (std::size_t k = 0; k < number_of_ta_chunks; ++k) {
+                patch_xi[k] &= mask[k];
+            }
+        }
+    }
+
+    /*
+     * Evaluates the clauses on the attended literals of xi, visiting only the attended ta chunks. Exact as long as
+     * the included literals are current, since no clause then includes a literal outside the attended chunks. With
+     * predict set, clauses without included literals output 0, as in cb_calculate_clause_outputs_predict.
+     */
+    void calculate_clause_outputs(
+            const TMClauseBankDense<T>& clause_bank,
+            const T* xi,
+            T* clause_output,
+            bool predict = true
+    ){
+        check_clause_bank(clause_bank);
+        attention_mask();
+
+        const std::size_t bits = clause_bank.number_of_state_bits;
+        for (std::size_t j = 0; j < clause_bank.number_of_clauses; ++j) {
+            const T* ta_state = &clause_bank.clause_bank[j * number_of_ta_chunks * bits];
+
+            bool empty = true;
+            for (const uint32_t k : active_chunks) {
+                if (ta_state[k * bits + bits - 1] & active[k]) {
+                    empty = false;
+                    break;
+                }
+            }
+            if (empty) {
+                clause_output[j] = predict ? 0 : 1;
+                continue;
+            }
+
+            clause_output[j] = 0;
+            for (std::size_t patch = 0; patch < clause_bank.number_of_patches; ++patch) {
+                const T* patch_xi = xi + patch * number_of_ta_chunks;
+                bool output = true;
+                for (const uint32_t k : active_chunks) {
+                    const T include = ta_state[k * bits + bits - 1] & active[k];
+                    if ((include & patch_xi[k]) != include) {
+                        output = false;
+                        break;
+                    }
+                }
+                if (output) {
+                    clause_output[j] = 1;
+                    break;
+                }
+            }
+        }
+    }
+
+    /*
+     * The literals by rank, as the ranking array of Attention.c.
+     */
+    std::vector<uint32_t> ranking() const {
+        std::vector<uint32_t> scores(number_of_literals);
+        for (std::size_t literal = 0; literal < number_of_literals; ++literal) {
+            scores[literal] = get_score(literal);
+        }
+
+        std::vector<uint32_t> order(number_of_literals);
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(), [&scores](uint32_t a, uint32_t b) {
+            return scores[a] > scores[b];
+        });
+        return order;
+    }
+
+    [[nodiscard]] uint32_t get_score(std::size_t literal) const {
+        const std::size_t k = literal / bits_per_chunk;
+        const T bit = T(1) << (literal % bits_per_chunk);
+        uint32_t value = 0;
+        for (std::size_t b = 0; b < number_of_state_bits; ++b) {
+            if (score[k * number_of_state_bits + b] & bit) {
+                value |= uint32_t(1) << b;
+            }
+        }
+        return value;
+    }
+
+private:
+
+    [[nodiscard]] T chunk_filter(std::size_t k) const {
+        return k == number_of_ta_chunks - 1 ? filter : ~T(0);
+    }
+
+    static bool draw(float p){
+        return static_cast<float>(fast_rand()) / static_cast<float>(FAST_RAND_MAX) <= p;
+    }
+
+    void check_clause_bank(const TMClauseBankDense<T>& clause_bank) const {
+        if (clause_bank.number_of_literals != number_of_literals) {
+            throw std::invalid_argument("The clause bank has " + std::to_string(clause_bank.number_of_literals) +
+                                        " literals, the attention " + std::to_string(number_of_literals));
+        }
+    }
+
+    // As cb_initialize_random_streams: a binomial number of distinct literals, each drawn with probability 1/s
+    void initialize_random_stream(){
+        std::fill(random_stream.begin(), random_stream.end(), 0);
+
+        const int n = static_cast<int>(number_of_literals);
+        const double p = 1.0 / s;
+        int selected = p >= 1.0 ? n : normal(n * p, n * p * (1 - p));
+        selected = std::clamp(selected, 0, n);
+
+        if (selected == n) {
+            std::fill(random_stream.begin(), random_stream.end(), ~T(0));
+            return;
+        }
+        while (selected--) {
+            uint32_t f = fast_rand() % number_of_literals;
+            while (random_stream[f / bits_per_chunk] & (T(1) << (f % bits_per_chunk))) {
+                f = fast_rand() % number_of_literals;
+            }
+            random_stream[f / bits_per_chunk] |= T(1) << (f % bits_per_chunk);
+        }
+    }
+
+    /*
+     * As cb_inc, except that a literal hitting the top of the range halves all scores. This keeps the order, apart
+     * from new ties, and leaves the leading literals room to move up.
+     */
+    void increment(std::size_t k, T literals){
+        T* state = &score[k * number_of_state_bits];
+        T carry = literals;
+        for (std::size_t b = 0; b < number_of_state_bits && carry; ++b) {
+            const T carry_next = state[b] & carry;
+            state[b] ^= carry;
+            carry = carry_next;
+        }
+
+        if (carry) {
+            for (std::size_t b = 0; b < number_of_state_bits; ++b) {
+                state[b] |= carry;
+            }
+            halve_scores();
+        }
+    }
+
+    // As cb_dec, saturating at zero
+    void decrement(std::size_t k, T literals){
+        T* state = &score[k * number_of_state_bits];
+        T carry = literals;
+        for (std::size_t b = 0; b < number_of_state_bits && carry; ++b) {
+            const T carry_next = (~state[b]) & carry;
+            state[b] ^= carry;
+            carry = carry_next;
+        }
+
+        if (carry) {
+            for (std::size_t b = 0; b < number_of_state_bits; ++b) {
+                state[b] &= ~carry;
+            }
+        }
+    }
+
+    void halve_scores(){
+        for (std::size_t k = 0; k < number_of_ta_chunks; ++k) {
+            T* state = &score[k * number_of_state_bits];
+            for (std::size_t b = 0; b + 1 < number_of_state_bits; ++b) {
+                state[b] = state[b + 1];
+            }
+            state[number_of_state_bits - 1] = 0;
+        }
+    }
+
+    /*
+     * Radix select from the top score bit down: a bit plane with at least the remaining number of candidates set
+     * narrows the candidates to those, otherwise all of them are taken. Remaining ties go by literal index.
+     */
+    void select_top_span(){
+        std::vector<T> candidates(number_of_ta_chunks);
+        for (std::size_t k = 0; k < number_of_ta_chunks; ++k) {
+            candidates[k] = chunk_filter(k);
+        }
+        std::fill(top_span.begin(), top_span.end(), 0);
+
+        std::size_t remaining = attention_span;
+        for (std::size_t b = number_of_state_bits; b-- > 0 && remaining > 0;) {
+            std::size_t count = 0;
+            for (std::size_t k = 0; k < number_of_ta_chunks; ++k) {
+                count += std::popcount(candidates[k] & score[k * number_of_state_bits + b]);
+            }
+
+            if (count >= remaining) {
+                for (std::size_t k = 0; k < number_of_ta_chunks; ++k) {
+                    candidates[k] &= score[k * number_of_state_bits + b];
+                }
+            } else {
+                for (std::size_t k = 0; k < number_of_ta_chunks; ++k) {
+                    top_span[k] |= candidates[k] & score[k * number_of_state_bits + b];
+                    candidates[k] &= ~score[k * number_of_state_bits + b];
+                }
+                remaining -= count;
+            }
+        }
+
+        for (std::size_t k = 0; k < number_of_ta_chunks && remaining > 0; ++k) {
+            T chunk = candidates[k];
+            while (chunk && remaining > 0) {
+                const T lowest = chunk & (~chunk + 1);
+                top_span[k] |= lowest;
+                chunk ^= lowest;
+                --remaining;
+            }
+        }
+    }
+
+    // Recomputes the mask and adds or removes only the ta chunks whose membership changed
+    void update_active(){
+        for (std::size_t k = 0; k < number_of_ta_chunks; ++k) {
+            active[k] = top_span[k] | included[k];
+
+            const bool attended = active[k] != 0;
+            if (attended && active_chunk_pos[k] < 0) {
+                active_chunk_pos[k] = static_cast<int32_t>(active_chunks.size());
+                active_chunks.push_back(static_cast<uint32_t>(k));
+            } else if (!attended && active_chunk_pos[k] >= 0) {
+                const uint32_t last = active_chunks.back();
+                active_chunks[active_chunk_pos[k]] = last;
+                active_chunk_pos[last] = active_chunk_pos[k];
+                active_chunks.pop_back();
+                active_chunk_pos[k] = -1;
+            }
+        }
+    }
+
+};
+
+#endif //TUMLIBPP_TM_ATTENTION_H
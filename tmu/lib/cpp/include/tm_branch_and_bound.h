@@ -0,0 +1,243 @@
+#ifndef TUMLIBPP_TM_BRANCH_AND_BOUND_H
+#define TUMLIBPP_TM_BRANCH_AND_BOUND_H
+
+#include <cstddef>
+#include <cstdint>
+#include <climits>
+#include <cstdlib>
+#include <vector>
+#include <numeric>
+#include <algorithm>
+#include <tcb/span.hpp>
+
+/*
+ * Argmax-only prediction with branch-and-bound early termination.
+ *
+ * Each class' clauses are ordered by decreasing |weight|. While a sample is evaluated, every class sum is bounded by
+ *   partial + (sum of the negative weights left)  <=  class_sum  <=  partial + (sum of the positive weights left),
+ * and a class stops being evaluated as soon as its upper bound falls below the best lower bound of another class.
+ * Ties are resolved towards the lowest class position, as std::max_element does, so the argmax is always identical
+ * to that of full evaluation.
+ *
+ * Clauses with zero weight and clauses without included literals never contribute to a class sum, and are dropped
+ * when the order is built. The order must be rebuilt whenever the clause banks or weights change.
+ *
+ * Prediction only reads the order, so threads can share one TMBranchAndBound with a Scratch each.
+ */
+template<class T>
+class TMBranchAndBound {
+
+public:
+    std::size_t number_of_classes = 0;
+    std::size_t number_of_ta_chunks = 0;
+    std::size_t number_of_patches = 0;
+    T filter = ~T(0);
+
+    std::vector<T> include_masks;               // [class][rank][ta_chunk]
+    std::vector<int32_t> ordered_weights;       // [class][rank]
+    std::vector<int32_t> positive_remaining;    // [class][rank + 1], sum of the positive weights from rank on
+    std::vector<int32_t> negative_remaining;    // [class][rank + 1], sum of the negative weights from rank on
+    std::vector<std::size_t> class_offsets{0};  // [class + 1], into ordered_weights
+
+    // Clauses evaluated, and clauses full evaluation would have evaluated, since the last reset
+    std::size_t evaluated_clauses = 0;
+    std::size_t total_clauses = 0;
+
+    // Per-thread state of predict_argmax, with the clause counts of the samples it predicted
+    struct Scratch {
+        std::vector<int32_t> partial;
+        std::vector<std::size_t> rank;
+        std::vector<uint8_t> alive;
+        std::size_t evaluated_clauses = 0;
+        std::size_t total_clauses = 0;
+    };
+
+    void reset(std::size_t number_of_literals, std::size_t _number_of_patches) {
+        number_of_classes = 0;
+        number_of_ta_chunks = (number_of_literals - 1) / 32 + 1;
+        number_of_patches = _number_of_patches;
+        filter = (number_of_literals % 32) != 0 ? ~(~T(0) << (number_of_literals % 32)) : ~T(0);
+
+        include_masks.clear();
+        ordered_weights.clear();
+        positive_remaining.clear();
+        negative_remaining.clear();
+        class_offsets.assign(1, 0);
+        clause_counts.clear();
+        evaluated_clauses = 0;
+        total_clauses = 0;
+    }
+
+    void add_class(
+            const tcb::span<T>& clause_bank,
+            const tcb::span<int32_t>& weights,
+            std::size_t number_of_state_bits
+    ) {
+        const std::size_t clause_size = number_of_ta_chunks * number_of_state_bits;
+        const std::size_t number_of_clauses = weights.size();
+
+        std::vector<std::size_t> order;
+        order.reserve(number_of_clauses);
+        for (std::size_t j = 0; j < number_of_clauses; ++j) {
+            if (weights[j] == 0) {
+                continue;
+            }
+
+            T included = 0;
+            for (std::size_t k = 0; k < number_of_ta_chunks; ++k) {
+                T mask = clause_bank[j * clause_size + k * number_of_state_bits + number_of_state_bits - 1];
+                included |= k == number_of_ta_chunks - 1 ? mask & filter : mask;
+            }
+
+            if (included != 0) {
+                order.push_back(j);
+            }
+        }
+
+        std::stable_sort(order.begin(), order.end(), [&](std::size_t a, std::size_t b) {
+            return std::abs(weights[a]) > std::abs(weights[b]);
+        });
+
+        for (const auto j : order) {
+            for (std::size_t k = 0; k < number_of_ta_chunks; ++k) {
+                T mask = clause_bank[j * clause_size + k * number_of_state_bits + number_of_state_bits - 1];
+                include_masks.push_back(k == number_of_ta_chunks - 1 ? mask & filter : mask);
+            }
+            ordered_weights.push_back(weights[j]);
+        }
+
+        // Suffix sums, so that the bounds at any rank are a single lookup
+        const std::size_t n = order.size();
+        const std::size_t remaining_offset = positive_remaining.size();
+        positive_remaining.resize(remaining_offset + n + 1, 0);
+        negative_remaining.resize(remaining_offset + n + 1, 0);
+        const int32_t* w = ordered_weights.data() + class_offsets.back();
+        for (std::size_t rank = n; rank-- > 0;) {
+            positive_remaining[remaining_offset + rank] = positive_remaining[remaining_offset + rank + 1] + std::max(w[rank], 0);
+            negative_remaining[remaining_offset + rank] = negative_remaining[remaining_offset + rank + 1] + std::min(w[rank], 0);
+        }
+
+        class_offsets.push_back(class_offsets.back() + n);
+        clause_counts.push_back(number_of_clauses);
+        ++number_of_classes;
+    }
+
+    /*
+     * Returns the class position with the largest (optionally clipped to [-threshold, threshold]) class sum.
+     */
+    int predict_argmax(const tcb::span<T>& encoded_xi, bool clip_class_sum, int threshold) {
+        const int class_position = predict_argmax(encoded_xi, clip_class_sum, threshold, scratch);
+        evaluated_clauses += scratch.evaluated_clauses;
+        total_clauses += scratch.total_clauses;
+        scratch.evaluated_clauses = 0;
+        scratch.total_clauses = 0;
+        return class_position;
+    }
+
+    int predict_argmax(const tcb::span<T>& encoded_xi, bool clip_class_sum, int threshold, Scratch& scratch) const {
+        if (number_of_classes == 0) {
+            return 0;
+        }
+
+        auto& partial = scratch.partial;
+        auto& rank = scratch.rank;
+        auto& alive = scratch.alive;
+        partial.assign(number_of_classes, 0);
+        rank.assign(number_of_classes, 0);
+        alive.assign(number_of_classes, 1);
+        std::size_t number_alive = number_of_classes;
+
+        const auto clip = [&](int32_t class_sum) {
+            return clip_class_sum ? std::min(std::max(class_sum, -threshold), threshold) : class_sum;
+        };
+
+        for (std::size_t c = 0; c < number_of_classes; ++c) {
+            scratch.total_clauses += clause_counts[c];
+        }
+
+        while (true) {
+            // The lowest class position attaining the best lower bound wins ties
+            int32_t best_lower = INT32_MIN;
+            std::size_t best_class = 0;
+            for (std::size_t c = 0; c < number_of_classes; ++c) {
+                if (!alive[c]) {
+                    continue;
+                }
+                const int32_t lower = clip(lower_bound(c, rank[c], partial[c]));
+                if (lower > best_lower) {
+                    best_lower = lower;
+                    best_class = c;
+                }
+            }
+
+            for (std::size_t c = 0; c < number_of_classes; ++c) {
+                if (!alive[c]) {
+                    continue;
+                }
+                const int32_t upper = clip(upper_bound(c, rank[c], partial[c]));
+                if (upper < best_lower || (upper == best_lower && best_class < c)) {
+                    alive[c] = 0;
+                    --number_alive;
+                }
+            }
+
+            if (number_alive == 1) {
+                return static_cast<int>(best_class);
+            }
+
+            bool progressed = false;
+            for (std::size_t c = 0; c < number_of_classes; ++c) {
+                const std::size_t clause = class_offsets[c] + rank[c];
+                if (!alive[c] || clause == class_offsets[c + 1]) {
+                    continue;
+                }
+
+                if (clause_output(clause, encoded_xi.data())) {
+                    partial[c] += ordered_weights[clause];
+                }
+                ++rank[c];
+                ++scratch.evaluated_clauses;
+                progressed = true;
+            }
+
+            if (!progressed) {
+                // Every remaining class is fully evaluated, and so is tied with best_class
+                return static_cast<int>(best_class);
+            }
+        }
+    }
+
+    // Lower and upper bound on the class sum, given the partial sum over the first rank clauses of the class
+    int32_t lower_bound(std::size_t class_position, std::size_t rank, int32_t partial_sum) const {
+        return partial_sum + negative_remaining[class_offsets[class_position] + class_position + rank];
+    }
+
+    int32_t upper_bound(std::size_t class_position, std::size_t rank, int32_t partial_sum) const {
+        return partial_sum + positive_remaining[class_offsets[class_position] + class_position + rank];
+    }
+
+    // Output of an ordered clause, i.e. an index into ordered_weights
+    bool clause_output(std::size_t clause, const T* xi) const {
+        const T* mask = &include_masks[clause * number_of_ta_chunks];
+        for (std::size_t patch = 0; patch < number_of_patches; ++patch) {
+            const T* xi_patch = xi + patch * number_of_ta_chunks;
+            bool output = true;
+            for (std::size_t k = 0; k < number_of_ta_chunks && output; ++k) {
+                output = (mask[k] & xi_patch[k]) == mask[k];
+            }
+            if (output) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+private:
+    std::vector<std::size_t> clause_counts;
+
+    // Scratch space for the single-threaded predict_argmax
+    Scratch scratch;
+
+};
+
+#endif //TUMLIBPP_TM_BRANCH_AND_BOUND_H
@@ -0,0 +1,138 @@
+#ifndef TUMLIBPP_TM_CLASS_BANK_ARENA_H
+#define TUMLIBPP_TM_CLASS_BANK_ARENA_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <numeric>
+#include <tcb/span.hpp>
+#include "tm_memory.h"
+
+extern "C" {
+    #include "ClauseBank.h"
+}
+
+/*
+ * Dense storage of every class' clause bank and weights in one contiguous block of the TMMemory arena.
+ *
+ * Layout (by class position, i.e. the index into get_classes()):
+ *   clause_bank   [class][clause][ta_chunk][state_bit]
+ *   weights       [class][clause]
+ *   clause_output [class][clause]
+ *
+ * Because the class banks are adjacent, the whole model can be evaluated as a single clause bank of
+ * number_of_classes * number_of_clauses clauses, in one pass over the sample.
+ */
+template<class T>
+class TMClassBankArena {
+
+public:
+    std::size_t number_of_classes = 0;
+    std::size_t number_of_clauses = 0;
+    std::size_t clause_bank_size = 0; // Per class
+
+    tcb::span<T> clause_bank;
+    tcb::span<int32_t> weights;
+    tcb::span<T> clause_output;
+
+    TMClassBankArena() = default;
+
+    TMClassBankArena(
+            std::size_t _number_of_classes,
+            std::size_t _number_of_clauses,
+            std::size_t _clause_bank_size
+    )
+    : number_of_classes(_number_of_classes)
+    , number_of_clauses(_number_of_clauses)
+    , clause_bank_size(_clause_bank_size)
+    {}
+
+    std::size_t getRequiredMemorySize() const {
+        return
+            number_of_classes * clause_bank_size + // clause_bank
+            number_of_classes * number_of_clauses + // weights
+            number_of_classes * number_of_clauses; // clause_output
+    }
+
+    bool initialize(TMMemory<T>& memory) {
+        clause_bank = memory.getSegment(number_of_classes * clause_bank_size);
+
+        auto unsigned_weights = memory.getSegment(number_of_classes * number_of_clauses);
+        weights = tcb::span<int32_t>(reinterpret_cast<int32_t*>(unsigned_weights.data()), unsigned_weights.size());
+
+        clause_output = memory.getSegment(number_of_classes * number_of_clauses);
+        return true;
+    }
+
+    tcb::span<T> getClauseBank(std::size_t class_position) const {
+        return clause_bank.subspan(class_position * clause_bank_size, clause_bank_size);
+    }
+
+    tcb::span<int32_t> getWeights(std::size_t class_position) const {
+        return weights.subspan(class_position * number_of_clauses, number_of_clauses);
+    }
+
+    tcb::span<T> getClauseOutput(std::size_t class_position) const {
+        return clause_output.subspan(class_position * number_of_clauses, number_of_clauses);
+    }
+
+    /*
+     * Evaluates the clauses of all classes in a single pass over encoded_xi, and writes one class sum
+     * per class position into class_sums.
+     */
+    void calculate_class_sums_predict(
+            const tcb::span<T>& encoded_xi,
+            std::size_t number_of_literals,
+            std::size_t number_of_state_bits,
+            std::size_t number_of_patches,
+            tcb::span<int> class_sums
+    ){
+        calculate_class_sums_predict(
+                encoded_xi,
+                number_of_literals,
+                number_of_state_bits,
+                number_of_patches,
+                class_sums,
+                clause_output
+        );
+    }
+
+    /*
+     * As above, with the clause outputs written to scratch ([class][clause]) instead of the arena, so that
+     * several threads can predict with the same arena.
+     */
+    void calculate_class_sums_predict(
+            const tcb::span<T>& encoded_xi,
+            std::size_t number_of_literals,
+            std::size_t number_of_state_bits,
+            std::size_t number_of_patches,
+            tcb::span<int> class_sums,
+            tcb::span<T> scratch
+    ) const {
+        cb_calculate_clause_outputs_predict(
+                clause_bank.data(),
+                number_of_classes * number_of_clauses,
+                number_of_literals,
+                number_of_state_bits,
+                number_of_patches,
+                scratch.data(),
+                encoded_xi.data()
+        );
+
+        const int32_t* w = weights.data();
+        const T* co = scratch.data();
+        for (std::size_t c = 0; c < number_of_classes; ++c) {
+            int32_t class_sum = 0;
+            for (std::size_t j = 0; j < number_of_clauses; ++j) {
+                class_sum += w[j] * static_cast<int32_t>(co[j]);
+            }
+            class_sums[c] = class_sum;
+
+            w += number_of_clauses;
+            co += number_of_clauses;
+        }
+    }
+
+};
+
+#endif //TUMLIBPP_TM_CLASS_BANK_ARENA_H
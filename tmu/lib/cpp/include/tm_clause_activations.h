@@ -0,0 +1,110 @@
+#ifndef TUMLIBPP_TM_CLAUSE_ACTIVATIONS_H
+#define TUMLIBPP_TM_CLAUSE_ACTIVATIONS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "tm_transposed_evaluator.h"
+#include "utils/tm_parallel.h"
+
+/*
+ * Which clauses fired for each sample of a dataset, bit-packed as [sample][bank][word]: clause j of a bank is bit
+ * j % 64 of word j / 64. With one bank per class this is the per-class activation matrix; a coalesced bank is one
+ * bank shared by all classes.
+ */
+struct TMClauseActivations {
+    std::size_t number_of_samples = 0;
+    std::size_t number_of_banks = 0;
+    std::size_t number_of_clauses = 0;
+    std::size_t words_per_bank = 0;
+    std::vector<uint64_t> bits;
+
+    [[nodiscard]] std::size_t words_per_sample() const {
+        return number_of_banks * words_per_bank;
+    }
+
+    [[nodiscard]] bool fired(std::size_t sample, std::size_t bank, std::size_t clause) const {
+        const uint64_t word = bits[sample * words_per_sample() + bank * words_per_bank + clause / 64];
+        return (word >> (clause % 64)) & 1;
+    }
+
+    /*
+     * The firing clauses as CSR rows per sample: the firings of sample i are [offsets[i], offsets[i + 1]), ordered by
+     * bank and clause. Rows are counted, then filled, in parallel. Offsets are 64-bit, since the total number of
+     * firings may pass 2^32 although every row fits 32 bits.
+     */
+    void to_sparse(std::vector<uint64_t>& offsets, std::vector<uint32_t>& banks, std::vector<uint32_t>& clauses,
+                   std::size_t threads = 0) const {
+        const std::size_t words = words_per_sample();
+        offsets.assign(number_of_samples + 1, 0);
+        TMParallel::for_ranges(number_of_samples, threads, 256, [&](std::size_t, std::size_t begin, std::size_t end) {
+            for (std::size_t i = begin; i < end; ++i) {
+                uint64_t count = 0;
+                for (std::size_t w = 0; w < words; ++w) {
+                    count += __builtin_popcountll(bits[i * words + w]);
+                }
+                offsets[i + 1] = count;
+            }
+        });
+        for (std::size_t i = 0; i < number_of_samples; ++i) {
+            offsets[i + 1] += offsets[i];
+        }
+
+        banks.resize(offsets.back());
+        clauses.resize(offsets.back());
+        TMParallel::for_ranges(number_of_samples, threads, 256, [&](std::size_t, std::size_t begin, std::size_t end) {
+            for (std::size_t i = begin; i < end; ++i) {
+                std::size_t position = offsets[i];
+                for (std::size_t w = 0; w < words; ++w) {
+                    uint64_t word = bits[i * words + w];
+                    while (word) {
+                        banks[position] = static_cast<uint32_t>(w / words_per_bank);
+                        clauses[position] = static_cast<uint32_t>((w % words_per_bank) * 64 + __builtin_ctzll(word));
+                        position++;
+                        word &= word - 1;
+                    }
+                }
+            }
+        });
+    }
+
+    /*
+     * Evaluates every bank of the evaluator over n_samples encoded samples. Blocks cover disjoint samples, so the
+     * workers write their rows without synchronization.
+     */
+    template<class T>
+    static TMClauseActivations compute(
+            const TMTransposedEvaluator<T>& evaluator,
+            const T* encoded_X,
+            std::size_t n_samples,
+            std::size_t threads = 0
+    ){
+        TMClauseActivations activations;
+        activations.number_of_samples = n_samples;
+        activations.number_of_banks = evaluator.number_of_banks();
+        activations.number_of_clauses = evaluator.number_of_clauses(0);
+        activations.words_per_bank = (activations.number_of_clauses + 63) / 64;
+        activations.bits.assign(n_samples * activations.words_per_sample(), 0);
+
+        const std::size_t words = activations.words_per_sample();
+        evaluator.for_each_block(encoded_X, n_samples, threads,
+                                 [&](std::size_t, const typename TMTransposedEvaluator<T>::Block& block,
+                                     std::size_t begin) {
+            for (std::size_t b = 0; b < activations.number_of_banks; ++b) {
+                for (std::size_t j = 0; j < activations.number_of_clauses; ++j) {
+                    uint64_t output = evaluator.fires(block, b, j);
+                    const std::size_t word = b * activations.words_per_bank + j / 64;
+                    const uint64_t bit = uint64_t(1) << (j % 64);
+                    while (output) {
+                        const std::size_t s = __builtin_ctzll(output);
+                        activations.bits[(begin + s) * words + word] |= bit;
+                        output &= output - 1;
+                    }
+                }
+            }
+        });
+        return activations;
+    }
+};
+
+#endif //TUMLIBPP_TM_CLAUSE_ACTIVATIONS_H
@@ -13,6 +13,9 @@
 #include <memory>
 #include <iostream>
 #include "tm_memory.h"
+#include "tm_instrumentation.h"
+#include "tm_literal_telemetry.h"
+#include "utils/tm_parallel.h"
 
 extern "C" {
     #include "ClauseBank.h"
@@ -63,6 +66,9 @@ public:
     tcb::span<T> actions;
     tcb::span<T> clause_bank_ind;
 
+    // Per-literal statistics, kept by the feedback kernels once enabled
+    tl::optional<TMLiteralTelemetry> literal_telemetry;
+
 private:
 
     int seed;
@@ -148,11 +154,14 @@ public:
     }
 
 
-    std::size_t getRequiredMemorySize() const {
+    std::size_t getRequiredMemorySize(bool include_clause_bank = true) const {
+        if(!include_clause_bank){
+            return calculateTotalMemorySize() - calculateClauseBankSize();
+        }
         return calculateTotalMemorySize();
     }
 
-    bool initialize(TMMemory<T>& memory) {
+    bool initialize(TMMemory<T>& memory, tl::optional<tcb::span<T>> external_clause_bank = tl::nullopt) {
         // Allocate memory segments directly for each data structure.
         clause_output = memory.getSegment(calculateClauseOutputSize());
         clause_output_batch = memory.getSegment(calculateClauseOutputBatchSize());
@@ -166,7 +175,7 @@ public:
         literal_clause_map_pos = memory.getSegment(calculateLiteralClauseMapPosSize());
         false_literals_per_clause = memory.getSegment(calculateFalseLiteralsPerClauseSize());
         previous_xi = memory.getSegment(calculatePreviousXiSize());
-        clause_bank = memory.getSegment(calculateClauseBankSize());
+        clause_bank = external_clause_bank ? *external_clause_bank : memory.getSegment(calculateClauseBankSize());
         actions = memory.getSegment(calculateActionsSize());
         clause_bank_ind = memory.getSegment(calculateClauseTaChunksStateBitsIndSize());
 
@@ -192,6 +201,39 @@ public:
 
         // Sett all bits to 1 for independent clauses
         std::fill(clause_bank_ind.begin(), clause_bank_ind.end(), ~0);
+
+        rebuild_literal_telemetry();
+    }
+
+    /*
+     * Starts per-literal telemetry from the current include actions. Copies of the bank made afterwards keep their
+     * own counts.
+     */
+    void enable_literal_telemetry(){
+        literal_telemetry.emplace(number_of_literals);
+        rebuild_literal_telemetry();
+    }
+
+    void disable_literal_telemetry(){
+        literal_telemetry = tl::nullopt;
+    }
+
+    // Recounts included literals after the bank was written directly, e.g. restored from a checkpoint
+    void rebuild_literal_telemetry(){
+        if (literal_telemetry && !clause_bank.empty()) {
+            literal_telemetry->rebuild(clause_bank.data(), number_of_clauses, number_of_ta_chunks, number_of_state_bits);
+        }
+    }
+
+    // Overwrites all TA states, e.g. with a merged or restored bank of the same geometry
+    void load_clause_bank(const T* states){
+        std::copy(states, states + clause_bank.size(), clause_bank.begin());
+        incremental_clause_evaluation_initialized = false;
+        rebuild_literal_telemetry();
+    }
+
+    TMLiteralTelemetry* telemetry(){
+        return literal_telemetry ? &*literal_telemetry : nullptr;
     }
 
     std::size_t getEncodedXiSize(const std::vector<int32_t>& X_shape) const {
@@ -203,6 +245,7 @@ public:
             const std::vector<int32_t >& X_shape
 
     ){
+        TMU_PHASE(encode);
         std::vector<uint32_t> encoded_X(X_shape.at(0) * number_of_patches * number_of_ta_chunks) ;
 
         tmu_encode(
@@ -231,6 +274,11 @@ public:
         size_t ta_chunk = ta / 32;
         size_t chunk_pos = ta % 32;
         size_t pos = calculatePosition(clause, ta_chunk);
+        if (literal_telemetry && ta < number_of_literals) {
+            const bool was_included = clause_bank[pos + number_of_state_bits - 1] & (1u << chunk_pos);
+            const bool included = state & (1u << (number_of_state_bits - 1));
+            literal_telemetry->adjust(ta, static_cast<int>(included) - static_cast<int>(was_included));
+        }
         for (size_t b = 0; b < number_of_state_bits; ++b) {
             if (state & (1 << b)) {
                 clause_bank[pos + b] |= (1 << chunk_pos);
@@ -281,6 +329,8 @@ public:
             const tcb::span<T>& literal_active,
             const tcb::span<T>& encoded_xi
     ){
+        TMU_PHASE(type_i_feedback);
+        TMLiteralTelemetry::Scope telemetry_scope(telemetry());
 
         cb_type_i_feedback(
                 clause_bank.data(),
@@ -310,6 +360,8 @@ public:
             const tcb::span<T>& literal_active,
             const tcb::span<T>& encoded_xi
     ){
+        TMU_PHASE(type_ii_feedback);
+        TMLiteralTelemetry::Scope telemetry_scope(telemetry());
         cb_type_ii_feedback(
             clause_bank.data(),
             output_one_patches.data(),
@@ -333,6 +385,8 @@ public:
             const tcb::span<T>& encoded_X_train,
             bool target
     ){
+        TMU_PHASE(type_iii_feedback);
+        TMLiteralTelemetry::Scope telemetry_scope(telemetry());
         cb_type_iii_feedback(
                 clause_bank.data(),
                 clause_bank_ind.data(),
@@ -354,10 +408,91 @@ public:
         incremental_clause_evaluation_initialized = false;
     }
 
+    /*
+     * Feedback to a single clause, which the caller has already selected with its update probability. Lets a model
+     * apply the updates of several outputs while visiting each clause once. The random streams of Type I feedback
+     * are drawn per call, so reuse_random_feedback has no effect here.
+     */
+    void clause_type_i_feedback(std::size_t clause, const tcb::span<T>& literal_active, const T* encoded_xi){
+        TMU_PHASE(type_i_feedback);
+        TMLiteralTelemetry::Scope telemetry_scope(telemetry());
+        T active = 1;
+        cb_type_i_feedback(
+                &clause_bank[clause * number_of_ta_chunks * number_of_state_bits],
+                feedback_to_ta.data(),
+                output_one_patches.data(),
+                1,
+                number_of_literals,
+                number_of_state_bits,
+                number_of_patches,
+                1.0,
+                s,
+                boost_true_positive_feedback,
+                reuse_random_feedback,
+                max_included_literals,
+                &active,
+                literal_active.data(),
+                const_cast<T*>(encoded_xi)
+        );
+
+        incremental_clause_evaluation_initialized = false;
+    }
+
+    void clause_type_ii_feedback(std::size_t clause, const tcb::span<T>& literal_active, const T* encoded_xi){
+        TMU_PHASE(type_ii_feedback);
+        TMLiteralTelemetry::Scope telemetry_scope(telemetry());
+        T active = 1;
+        cb_type_ii_feedback(
+                &clause_bank[clause * number_of_ta_chunks * number_of_state_bits],
+                output_one_patches.data(),
+                1,
+                number_of_literals,
+                number_of_state_bits,
+                number_of_patches,
+                1.0,
+                &active,
+                literal_active.data(),
+                const_cast<T*>(encoded_xi)
+        );
+
+        incremental_clause_evaluation_initialized = false;
+    }
+
+    void clause_type_iii_feedback(
+            std::size_t clause,
+            const tcb::span<T>& literal_active,
+            const T* encoded_xi,
+            bool target
+    ){
+        TMU_PHASE(type_iii_feedback);
+        TMLiteralTelemetry::Scope telemetry_scope(telemetry());
+        T active = 1;
+        cb_type_iii_feedback(
+                &clause_bank[clause * number_of_ta_chunks * number_of_state_bits],
+                &clause_bank_ind[clause * number_of_ta_chunks * number_of_state_bits_ind],
+                &clause_and_target[clause * number_of_ta_chunks],
+                output_one_patches.data(),
+                1,
+                number_of_literals,
+                number_of_state_bits,
+                number_of_state_bits_ind,
+                number_of_patches,
+                1.0,
+                d,
+                &active,
+                literal_active.data(),
+                const_cast<T*>(encoded_xi),
+                target
+        );
+
+        incremental_clause_evaluation_initialized = false;
+    }
+
     void calculate_clause_outputs_update(
             const tcb::span<T>& literal_active,
             const tcb::span<T>& encoded_xi
     ){
+        TMU_PHASE(clause_output_update);
         cb_calculate_clause_outputs_update(
                 clause_bank.data(),
                 number_of_clauses,
@@ -370,6 +505,21 @@ public:
         );
 
     }
+
+    // Fills clause_output_patchwise as [clause][patch]. Clauses without included literals match every patch.
+    const tcb::span<T> calculate_clause_outputs_patchwise(const tcb::span<T>& encoded_xi){
+        TMU_PHASE(clause_output_patchwise);
+        cb_calculate_clause_outputs_patchwise(
+                clause_bank.data(),
+                number_of_clauses,
+                number_of_literals,
+                number_of_state_bits,
+                number_of_patches,
+                clause_output_patchwise.data(),
+                encoded_xi.data()
+        );
+        return clause_output_patchwise;
+    }
     
     
     const tcb::span<T> calculate_clause_outputs_predict(
@@ -377,6 +527,7 @@ public:
             std::size_t sample_index,
             std::size_t n_items
     ){
+        TMU_PHASE(clause_output_predict);
 
         if(!incremental){
             cb_calculate_clause_outputs_predict(
@@ -508,25 +659,135 @@ private:
             calculateClauseTaChunksStateBitsIndSize();
     }
 
-    void calculate_literal_clause_frequency(){
-        // clause_active
-        // TODO
+public:
+    /*
+     * The number of active clauses including each literal, into literal_clause_count. Walks the set bits of the
+     * include words, in parallel over clauses with one count per worker. No clause_active counts every clause.
+     */
+    const tcb::span<T> calculate_literal_clause_frequency(const T* clause_active = nullptr, std::size_t threads = 0){
+        constexpr std::size_t min_clauses_per_worker = 1024;
+        const std::size_t workers = TMParallel::workers(number_of_clauses, threads, min_clauses_per_worker);
+        std::vector<std::vector<T>> counts(workers, std::vector<T>(number_of_literals, 0));
+
+        TMParallel::for_ranges(number_of_clauses, threads, min_clauses_per_worker,
+                               [&](std::size_t worker, std::size_t begin, std::size_t end) {
+            T* count = counts[worker].data();
+            for (std::size_t j = begin; j < end; ++j) {
+                if (clause_active && !clause_active[j]) {
+                    continue;
+                }
+                const T* included = &clause_bank[j * number_of_ta_chunks * number_of_state_bits + number_of_state_bits - 1];
+                for (std::size_t k = 0; k < number_of_ta_chunks; ++k) {
+                    for (T word = included[k * number_of_state_bits] & chunk_filter(k); word; word &= word - 1) {
+                        count[k * 32 + __builtin_ctz(word)]++;
+                    }
+                }
+            }
+        });
+
+        std::copy(counts[0].begin(), counts[0].end(), literal_clause_count.begin());
+        for (std::size_t w = 1; w < workers; ++w) {
+            for (std::size_t k = 0; k < number_of_literals; ++k) {
+                literal_clause_count[k] += counts[w][k];
+            }
+        }
+        return literal_clause_count;
     }
 
     void calculate_clause_outputs_predict(){
         // TODO
     }
 
-    void included_literals(){
-        // TODO
+    /*
+     * The literals included by at least one clause, as a bit mask per TA chunk in actions. Workers OR the include
+     * words of their clauses into their own mask, and the masks are merged at the end.
+     */
+    const tcb::span<T> included_literals(std::size_t threads = 0){
+        constexpr std::size_t min_clauses_per_worker = 1024;
+        const std::size_t workers = TMParallel::workers(number_of_clauses, threads, min_clauses_per_worker);
+        std::vector<std::vector<T>> masks(workers, std::vector<T>(number_of_ta_chunks, 0));
+
+        TMParallel::for_ranges(number_of_clauses, threads, min_clauses_per_worker,
+                               [&](std::size_t worker, std::size_t begin, std::size_t end) {
+            T* mask = masks[worker].data();
+            for (std::size_t j = begin; j < end; ++j) {
+                const T* included = &clause_bank[j * number_of_ta_chunks * number_of_state_bits + number_of_state_bits - 1];
+                for (std::size_t k = 0; k < number_of_ta_chunks; ++k) {
+                    mask[k] |= included[k * number_of_state_bits];
+                }
+            }
+        });
+
+        std::copy(masks[0].begin(), masks[0].end(), actions.begin());
+        for (std::size_t w = 1; w < workers; ++w) {
+            for (std::size_t k = 0; k < number_of_ta_chunks; ++k) {
+                actions[k] |= masks[w][k];
+            }
+        }
+        actions[number_of_ta_chunks - 1] &= chunk_filter(number_of_ta_chunks - 1);
+        return actions;
     }
 
-    void get_literals(){
-        // TODO
+    // The ids of the literals included by at least one clause, ascending
+    std::vector<uint32_t> included_literal_ids(std::size_t threads = 0){
+        const auto mask = included_literals(threads);
+        std::vector<uint32_t> ids;
+        for (std::size_t k = 0; k < number_of_ta_chunks; ++k) {
+            for (T word = mask[k]; word; word &= word - 1) {
+                ids.push_back(static_cast<uint32_t>(k * 32 + __builtin_ctz(word)));
+            }
+        }
+        return ids;
+    }
+
+    /*
+     * The included literals of every clause as compressed sparse rows: the ids of clause j are
+     * literals[offsets[j]:offsets[j + 1]], ascending. One popcount pass sizes the rows, then workers fill their
+     * clauses independently.
+     */
+    void get_literals(std::vector<uint64_t>& offsets, std::vector<uint32_t>& literals, std::size_t threads = 0) const {
+        constexpr std::size_t min_clauses_per_worker = 1024;
+        offsets.assign(number_of_clauses + 1, 0);
+
+        TMParallel::for_ranges(number_of_clauses, threads, min_clauses_per_worker,
+                               [&](std::size_t, std::size_t begin, std::size_t end) {
+            for (std::size_t j = begin; j < end; ++j) {
+                offsets[j + 1] = number_of_include_actions(j);
+            }
+        });
+        for (std::size_t j = 0; j < number_of_clauses; ++j) {
+            offsets[j + 1] += offsets[j];
+        }
+
+        literals.resize(offsets[number_of_clauses]);
+        TMParallel::for_ranges(number_of_clauses, threads, min_clauses_per_worker,
+                               [&](std::size_t, std::size_t begin, std::size_t end) {
+            for (std::size_t j = begin; j < end; ++j) {
+                uint32_t* out = literals.data() + offsets[j];
+                const T* included = &clause_bank[j * number_of_ta_chunks * number_of_state_bits + number_of_state_bits - 1];
+                for (std::size_t k = 0; k < number_of_ta_chunks; ++k) {
+                    for (T word = included[k * number_of_state_bits] & chunk_filter(k); word; word &= word - 1) {
+                        *out++ = static_cast<uint32_t>(k * 32 + __builtin_ctz(word));
+                    }
+                }
+            }
+        });
     }
 
-    void number_of_include_actions(){
-        // TODO
+    // Popcount of the include words of a clause
+    [[nodiscard]] std::size_t number_of_include_actions(std::size_t clause) const {
+        const T* included = &clause_bank[clause * number_of_ta_chunks * number_of_state_bits + number_of_state_bits - 1];
+        std::size_t count = 0;
+        for (std::size_t k = 0; k < number_of_ta_chunks; ++k) {
+            count += __builtin_popcount(included[k * number_of_state_bits] & chunk_filter(k));
+        }
+        return count;
+    }
+
+    // Masks the bits past the last literal in the final TA chunk
+    [[nodiscard]] T chunk_filter(std::size_t chunk) const {
+        const std::size_t tail = number_of_literals % 32;
+        return (chunk + 1 == number_of_ta_chunks && tail != 0) ? static_cast<T>(~(~T(0) << tail)) : ~T(0);
     }
 
     void prepare_Xi(){
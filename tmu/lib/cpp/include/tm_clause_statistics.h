@@ -0,0 +1,138 @@
+#ifndef TUMLIBPP_TM_CLAUSE_STATISTICS_H
+#define TUMLIBPP_TM_CLAUSE_STATISTICS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <stdexcept>
+#include <vector>
+#include "tm_transposed_evaluator.h"
+
+/*
+ * Per class and clause true and false positive counts over a labelled dataset, as the Python clause_precision and
+ * clause_recall compute them. A clause with positive polarity for a class is a true positive when it fires for a
+ * sample of that class; one with negative polarity when it fires for a sample of another class.
+ */
+struct TMClauseStatistics {
+    std::size_t number_of_classes = 0;
+    std::size_t number_of_clauses = 0;
+    std::vector<uint64_t> true_positives;  // [class][clause]
+    std::vector<uint64_t> false_positives; // [class][clause]
+    std::vector<uint64_t> class_samples;   // [class]
+    std::vector<uint8_t> positive_polarity; // [class][clause]
+    uint64_t samples = 0;
+
+    [[nodiscard]] std::vector<double> precision() const {
+        std::vector<double> out(true_positives.size(), 0.0);
+        for (std::size_t i = 0; i < out.size(); ++i) {
+            const uint64_t fired = true_positives[i] + false_positives[i];
+            out[i] = fired ? static_cast<double>(true_positives[i]) / fired : 0.0;
+        }
+        return out;
+    }
+
+    // True positives over the samples the clause should fire for: the class, or the other classes
+    [[nodiscard]] std::vector<double> recall() const {
+        std::vector<double> out(true_positives.size(), 0.0);
+        for (std::size_t c = 0; c < number_of_classes; ++c) {
+            for (std::size_t j = 0; j < number_of_clauses; ++j) {
+                const std::size_t i = c * number_of_clauses + j;
+                const uint64_t relevant = positive_polarity[i] ? class_samples[c] : samples - class_samples[c];
+                out[i] = relevant ? static_cast<double>(true_positives[i]) / relevant : 0.0;
+            }
+        }
+        return out;
+    }
+
+    /*
+     * Counts over encoded samples. labels holds class positions in [0, number_of_classes); class c is voted on by
+     * the clauses of evaluator bank bank_of_class[c], with polarity(c, j) telling whether clause j votes for it.
+     * Workers count separate blocks of 64 samples and their counts are summed.
+     */
+    template<class T>
+    static TMClauseStatistics compute(
+            const TMTransposedEvaluator<T>& evaluator,
+            const T* encoded_X,
+            const uint32_t* labels,
+            std::size_t n_samples,
+            const std::vector<std::size_t>& bank_of_class,
+            const std::function<bool(std::size_t, std::size_t)>& polarity,
+            std::size_t threads = 0
+    ){
+        TMClauseStatistics statistics;
+        statistics.number_of_classes = bank_of_class.size();
+        statistics.number_of_clauses = evaluator.number_of_clauses(0);
+        statistics.samples = n_samples;
+        const std::size_t n_classes = statistics.number_of_classes;
+        const std::size_t n_clauses = statistics.number_of_clauses;
+        const std::size_t n_banks = evaluator.number_of_banks();
+
+        statistics.class_samples.assign(n_classes, 0);
+        for (std::size_t i = 0; i < n_samples; ++i) {
+            if (labels[i] >= n_classes) {
+                throw std::invalid_argument("Label out of range");
+            }
+            statistics.class_samples[labels[i]]++;
+        }
+
+        std::vector<std::vector<std::size_t>> classes_of_bank(n_banks);
+        for (std::size_t c = 0; c < n_classes; ++c) {
+            classes_of_bank.at(bank_of_class[c]).push_back(c);
+        }
+
+        // Per worker: fired for samples of the class, and fired at all per bank
+        const std::size_t workers = TMTransposedEvaluator<T>::workers(n_samples, threads);
+        std::vector<std::vector<uint64_t>> fired_in_class(workers, std::vector<uint64_t>(n_classes * n_clauses, 0));
+        std::vector<std::vector<uint64_t>> fired(workers, std::vector<uint64_t>(n_banks * n_clauses, 0));
+
+        evaluator.for_each_block(encoded_X, n_samples, threads,
+                                 [&](std::size_t worker, const typename TMTransposedEvaluator<T>::Block& block,
+                                     std::size_t begin) {
+            std::vector<uint64_t> class_mask(n_classes, 0);
+            for (std::size_t s = 0; s < block.count; ++s) {
+                class_mask[labels[begin + s]] |= uint64_t(1) << s;
+            }
+
+            for (std::size_t b = 0; b < n_banks; ++b) {
+                uint64_t* bank_fired = &fired[worker][b * n_clauses];
+                for (std::size_t j = 0; j < n_clauses; ++j) {
+                    const uint64_t output = evaluator.fires(block, b, j);
+                    if (!output) {
+                        continue;
+                    }
+                    bank_fired[j] += __builtin_popcountll(output);
+                    for (const std::size_t c : classes_of_bank[b]) {
+                        fired_in_class[worker][c * n_clauses + j] += __builtin_popcountll(output & class_mask[c]);
+                    }
+                }
+            }
+        });
+
+        for (std::size_t w = 1; w < workers; ++w) {
+            for (std::size_t i = 0; i < fired_in_class[0].size(); ++i) {
+                fired_in_class[0][i] += fired_in_class[w][i];
+            }
+            for (std::size_t i = 0; i < fired[0].size(); ++i) {
+                fired[0][i] += fired[w][i];
+            }
+        }
+
+        statistics.true_positives.resize(n_classes * n_clauses);
+        statistics.false_positives.resize(n_classes * n_clauses);
+        statistics.positive_polarity.resize(n_classes * n_clauses);
+        for (std::size_t c = 0; c < n_classes; ++c) {
+            for (std::size_t j = 0; j < n_clauses; ++j) {
+                const std::size_t i = c * n_clauses + j;
+                const uint64_t in_class = fired_in_class[0][i];
+                const uint64_t other_classes = fired[0][bank_of_class[c] * n_clauses + j] - in_class;
+                const bool positive = polarity(c, j);
+                statistics.positive_polarity[i] = positive;
+                statistics.true_positives[i] = positive ? in_class : other_classes;
+                statistics.false_positives[i] = positive ? other_classes : in_class;
+            }
+        }
+        return statistics;
+    }
+};
+
+#endif //TUMLIBPP_TM_CLAUSE_STATISTICS_H
@@ -0,0 +1,120 @@
+#ifndef TUMLIBPP_TM_FUSED_FEEDBACK_H
+#define TUMLIBPP_TM_FUSED_FEEDBACK_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <tcb/span.hpp>
+#include "tm_clause_dense.h"
+
+extern "C" {
+    #include "fast_rand.h"
+}
+
+/*
+ * The update one output of a shared clause bank receives for one sample.
+ */
+struct TMOutputFeedback {
+    uint32_t output;                // Column in the [clause][output] weight matrix
+    bool target;                    // Whether the sample belongs to the output
+    float update_p;
+    bool update_weights;            // False to only update clauses, e.g. past max_positive_clauses
+    bool type_iii_feedback;
+    const uint32_t* clause_output;  // [clause], the evaluation the class sum was computed from
+    const uint32_t* encoded_xi;     // The sample as the output sees it
+};
+
+/*
+ * Applies the feedback of several outputs to a shared clause bank in a single pass over the clauses.
+ *
+ * Clauses voting for an output's target get Type I feedback, the others Type II, each with probability update_p.
+ * Every clause only depends on its own state, so visiting each clause once and applying the outputs in order
+ * there is equivalent to applying the outputs one after another over the whole bank. Selection is drawn before a
+ * clause kernel is called, so clauses that are not updated cost one draw per output.
+ */
+template<class Type>
+class TMFusedFeedback {
+
+public:
+
+    static inline uint32_t update_threshold(float update_p){
+        if (update_p >= 1.0f) {
+            return FAST_RAND_MAX;
+        }
+        if (update_p <= 0.0f) {
+            return 0;
+        }
+        return static_cast<uint32_t>(update_p * static_cast<float>(FAST_RAND_MAX));
+    }
+
+    static inline bool draw(uint32_t threshold){
+        return threshold != 0 && fast_rand() <= threshold;
+    }
+
+    /*
+     * weights is [clause][weights_stride]. If given, positive_counts[output] is kept equal to the number of clauses
+     * with non-negative weight for the output.
+     */
+    static void apply(
+            TMClauseBankDense<Type>& clause_bank,
+            const tcb::span<int32_t>& weights,
+            std::size_t weights_stride,
+            const std::vector<TMOutputFeedback>& feedback,
+            const tcb::span<const uint32_t>& clause_active,
+            const tcb::span<Type>& literal_active,
+            float type_i_p,
+            float type_ii_p,
+            uint32_t* positive_counts = nullptr
+    ){
+        if (feedback.empty()) {
+            return;
+        }
+
+        const std::size_t number_of_feedbacks = feedback.size();
+        std::vector<uint32_t> type_i_threshold(number_of_feedbacks);
+        std::vector<uint32_t> type_ii_threshold(number_of_feedbacks);
+        std::vector<uint32_t> weight_threshold(number_of_feedbacks);
+        for (std::size_t f = 0; f < number_of_feedbacks; ++f) {
+            type_i_threshold[f] = update_threshold(feedback[f].update_p * type_i_p);
+            type_ii_threshold[f] = update_threshold(feedback[f].update_p * type_ii_p);
+            weight_threshold[f] = feedback[f].update_weights ? update_threshold(feedback[f].update_p) : 0;
+        }
+
+        for (std::size_t j = 0; j < clause_bank.number_of_clauses; ++j) {
+            if (!clause_active[j]) {
+                continue;
+            }
+            int32_t* row = weights.data() + j * weights_stride;
+
+            for (std::size_t f = 0; f < number_of_feedbacks; ++f) {
+                const auto& fb = feedback[f];
+                int32_t& weight = row[fb.output];
+
+                if ((weight >= 0) == fb.target) {
+                    if (draw(type_i_threshold[f])) {
+                        clause_bank.clause_type_i_feedback(j, literal_active, fb.encoded_xi);
+                    }
+                } else if (draw(type_ii_threshold[f])) {
+                    clause_bank.clause_type_ii_feedback(j, literal_active, fb.encoded_xi);
+                }
+
+                if (fb.clause_output[j] && draw(weight_threshold[f])) {
+                    const bool was_positive = weight >= 0;
+                    weight += fb.target ? 1 : -1;
+                    if (positive_counts && was_positive != (weight >= 0)) {
+                        positive_counts[fb.output] += was_positive ? -1 : 1;
+                    }
+                }
+
+                // Polarity after the weight update, as the per-output models compute it
+                if (fb.type_iii_feedback) {
+                    const bool voting_for = (weight >= 0) == fb.target;
+                    clause_bank.clause_type_iii_feedback(j, literal_active, fb.encoded_xi, voting_for);
+                }
+            }
+        }
+    }
+
+};
+
+#endif //TUMLIBPP_TM_FUSED_FEEDBACK_H
@@ -0,0 +1,164 @@
+#ifndef TUMLIBPP_TM_INFERENCE_MODEL_H
+#define TUMLIBPP_TM_INFERENCE_MODEL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+#include "tm_transposed_evaluator.h"
+#include "utils/tm_checkpoint.h"
+
+extern "C" {
+    #include "Tools.h"
+}
+
+/*
+ * Read-only, thread-safe predictor built from a TMCheckpoint.
+ *
+ * Each clause is reduced to the list of literals it includes, and samples are evaluated in blocks by
+ * TMTransposedEvaluator. Clauses with zero weight or without included literals are dropped, as they never add to a
+ * class sum at prediction time.
+ */
+class TMInferenceModel {
+
+public:
+    static constexpr std::size_t GROUP_SIZE = TMTransposedEvaluator<uint32_t>::block_size;
+
+    int32_t T = 0;
+    std::size_t number_of_classes = 0;
+    std::size_t number_of_literals = 0;
+    std::size_t number_of_ta_chunks = 0;
+    std::size_t number_of_patches = 0;
+    std::size_t number_of_features = 0; // Raw features per sample
+    int32_t dim[3] = {0, 0, 0};
+    int32_t patch_dim[2] = {0, 0};
+    std::vector<uint32_t> classes;
+
+    std::vector<uint32_t> clause_class;  // [clause]
+    std::vector<int32_t> clause_weight;  // [clause]
+    TMTransposedEvaluator<uint32_t> evaluator; // One bank holding the clauses of every class
+
+    explicit TMInferenceModel(const TMCheckpoint& checkpoint)
+    : T(checkpoint.T)
+    , number_of_classes(checkpoint.number_of_classes)
+    , number_of_literals(checkpoint.number_of_literals)
+    , number_of_ta_chunks(checkpoint.number_of_ta_chunks())
+    , number_of_patches(checkpoint.number_of_patches)
+    , number_of_features(static_cast<std::size_t>(checkpoint.dim[0]) * checkpoint.dim[1] * checkpoint.dim[2])
+    , classes(checkpoint.classes)
+    , evaluator(included_literals(checkpoint, clause_class, clause_weight))
+    {
+        std::copy(checkpoint.dim, checkpoint.dim + 3, dim);
+        std::copy(checkpoint.patch_dim, checkpoint.patch_dim + 2, patch_dim);
+    }
+
+    std::size_t encoded_stride() const {
+        return number_of_patches * number_of_ta_chunks;
+    }
+
+    std::vector<uint32_t> encode(uint32_t* x, std::size_t number_of_examples) const {
+        std::vector<uint32_t> encoded_X(number_of_examples * encoded_stride());
+        tmu_encode(
+                x,
+                encoded_X.data(),
+                static_cast<int>(number_of_examples),
+                dim[0],
+                dim[1],
+                dim[2],
+                patch_dim[0],
+                patch_dim[1],
+                1,
+                0
+        );
+        return encoded_X;
+    }
+
+    /*
+     * Class sums ([sample][class]) and argmax class positions of samples [begin, end) of encoded_X. Ranges of
+     * different calls must not overlap, but may run concurrently.
+     */
+    void predict(
+            const uint32_t* encoded_X,
+            std::size_t begin,
+            std::size_t end,
+            bool clip_class_sum,
+            int32_t* class_sums,
+            int32_t* argmax
+    ) const {
+        typename TMTransposedEvaluator<uint32_t>::Block block;
+
+        for (std::size_t group = begin; group < end; group += GROUP_SIZE) {
+            const std::size_t group_size = std::min(GROUP_SIZE, end - group);
+
+            evaluator.load(block, encoded_X, group, group_size);
+            std::fill(class_sums + group * number_of_classes, class_sums + (group + group_size) * number_of_classes, 0);
+
+            for (std::size_t j = 0; j < clause_weight.size(); ++j) {
+                for (uint64_t output = evaluator.fires(block, 0, j); output; output &= output - 1) {
+                    const std::size_t sample = group + __builtin_ctzll(output);
+                    class_sums[sample * number_of_classes + clause_class[j]] += clause_weight[j];
+                }
+            }
+
+            for (std::size_t sample = group; sample < group + group_size; ++sample) {
+                int32_t* sums = class_sums + sample * number_of_classes;
+                if (clip_class_sum) {
+                    for (std::size_t c = 0; c < number_of_classes; ++c) {
+                        sums[c] = std::min(std::max(sums[c], -T), T);
+                    }
+                }
+                argmax[sample] = static_cast<int32_t>(std::max_element(sums, sums + number_of_classes) - sums);
+            }
+        }
+    }
+
+private:
+
+    /*
+     * The included literals of every clause with a nonzero weight and at least one included literal, as one
+     * evaluator bank. Fills in the class and weight of each of those clauses.
+     */
+    static TMTransposedEvaluator<uint32_t> included_literals(
+            const TMCheckpoint& checkpoint,
+            std::vector<uint32_t>& clause_class,
+            std::vector<int32_t>& clause_weight
+    ) {
+        const std::size_t number_of_state_bits = checkpoint.number_of_state_bits;
+        const std::size_t number_of_ta_chunks = checkpoint.number_of_ta_chunks();
+        const std::size_t clause_size = number_of_ta_chunks * number_of_state_bits;
+
+        std::vector<std::vector<uint64_t>> offsets(1, std::vector<uint64_t>(1, 0));
+        std::vector<std::vector<uint32_t>> literals(1);
+        for (std::size_t c = 0; c < checkpoint.number_of_classes; ++c) {
+            const uint32_t* clause_bank = checkpoint.clause_banks.data() + c * checkpoint.clause_bank_size();
+            const int32_t* weights = checkpoint.weights.data() + c * checkpoint.number_of_clauses;
+
+            for (std::size_t j = 0; j < checkpoint.number_of_clauses; ++j) {
+                if (weights[j] == 0) {
+                    continue;
+                }
+
+                const std::size_t first = literals[0].size();
+                for (std::size_t k = 0; k < checkpoint.number_of_literals; ++k) {
+                    const uint32_t include = clause_bank[j * clause_size + (k / 32) * number_of_state_bits + number_of_state_bits - 1];
+                    if (include & (1U << (k % 32))) {
+                        literals[0].push_back(static_cast<uint32_t>(k));
+                    }
+                }
+
+                if (literals[0].size() == first) {
+                    continue;
+                }
+                clause_class.push_back(static_cast<uint32_t>(c));
+                clause_weight.push_back(weights[j]);
+                offsets[0].push_back(literals[0].size());
+            }
+        }
+
+        return TMTransposedEvaluator<uint32_t>(std::move(offsets), literals, checkpoint.number_of_literals,
+                                               checkpoint.number_of_patches, number_of_ta_chunks);
+    }
+
+};
+
+#endif //TUMLIBPP_TM_INFERENCE_MODEL_H
@@ -0,0 +1,334 @@
+#ifndef TUMLIBPP_TM_INSTRUMENTATION_H
+#define TUMLIBPP_TM_INSTRUMENTATION_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+#if defined(TMU_INSTRUMENTATION) && defined(TMU_PERF_EVENTS) && defined(__linux__)
+#define TMU_HAS_PERF_EVENTS 1
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+extern "C" {
+    #include "fast_rand.h"
+}
+
+/*
+ * Engine phases timed by TMU_PHASE. Times are inclusive and summed over all threads.
+ */
+enum class TMPhase : std::size_t {
+    encode,
+    clause_output_update,
+    clause_output_predict,
+    clause_output_patchwise,
+    type_i_feedback,
+    type_ii_feedback,
+    type_iii_feedback,
+    weight_update,
+    count
+};
+
+enum class TMHardwareCounter : std::size_t {
+    cycles,
+    instructions,
+    cache_misses,
+    branch_misses,
+    count
+};
+
+struct TMPhaseStatistics {
+    uint64_t calls = 0;
+    uint64_t ns = 0;
+    std::array<uint64_t, static_cast<std::size_t>(TMHardwareCounter::count)> hardware{};
+};
+
+struct TMInstrumentationSnapshot {
+    bool enabled = false;
+    bool hardware_counters = false;
+    std::array<TMPhaseStatistics, static_cast<std::size_t>(TMPhase::count)> phases{};
+    TMUCounters counters{};
+};
+
+/*
+ * Process-wide totals of the phase timers and the kernel counters. The kernels count into thread-local TMUCounters,
+ * which a thread adds to the totals with flush_thread(); snapshot() flushes the calling thread only. Without
+ * TMU_INSTRUMENTATION every member is a no-op and snapshots are zero.
+ */
+class TMInstrumentation {
+
+public:
+#ifdef TMU_INSTRUMENTATION
+    static constexpr bool enabled = true;
+#else
+    static constexpr bool enabled = false;
+#endif
+
+    static constexpr std::size_t number_of_phases = static_cast<std::size_t>(TMPhase::count);
+    static constexpr std::size_t number_of_hardware_counters = static_cast<std::size_t>(TMHardwareCounter::count);
+    static constexpr std::size_t number_of_counters = sizeof(TMUCounters) / sizeof(uint64_t);
+
+    static const char* phase_name(TMPhase phase){
+        static constexpr const char* names[] = {
+                "encode",
+                "clause_output_update",
+                "clause_output_predict",
+                "clause_output_patchwise",
+                "type_i_feedback",
+                "type_ii_feedback",
+                "type_iii_feedback",
+                "weight_update"
+        };
+        static_assert(sizeof(names) / sizeof(names[0]) == number_of_phases);
+        return names[static_cast<std::size_t>(phase)];
+    }
+
+    static const char* hardware_counter_name(TMHardwareCounter counter){
+        static constexpr const char* names[] = {"cycles", "instructions", "cache_misses", "branch_misses"};
+        return names[static_cast<std::size_t>(counter)];
+    }
+
+    // Names of the TMUCounters fields, in declaration order
+    static const char* counter_name(std::size_t counter){
+        static constexpr const char* names[] = {
+                "clauses_evaluated",
+                "clause_patches_evaluated",
+                "chunks_evaluated",
+                "clauses_updated",
+                "ta_include_flips",
+                "ta_exclude_flips",
+                "rng_draws"
+        };
+        static_assert(sizeof(names) / sizeof(names[0]) == number_of_counters);
+        return names[counter];
+    }
+
+    static void record(TMPhase phase, uint64_t ns, const uint64_t* hardware){
+        auto& stats = totals().phases[static_cast<std::size_t>(phase)];
+        stats.calls.fetch_add(1, std::memory_order_relaxed);
+        stats.ns.fetch_add(ns, std::memory_order_relaxed);
+        if (hardware) {
+            for (std::size_t c = 0; c < number_of_hardware_counters; ++c) {
+                stats.hardware[c].fetch_add(hardware[c], std::memory_order_relaxed);
+            }
+        }
+    }
+
+    static void flush_thread(){
+#ifdef TMU_INSTRUMENTATION
+        auto* local = reinterpret_cast<uint64_t*>(&tmu_counters);
+        for (std::size_t c = 0; c < number_of_counters; ++c) {
+            totals().counters[c].fetch_add(local[c], std::memory_order_relaxed);
+            local[c] = 0;
+        }
+#endif
+    }
+
+    static TMInstrumentationSnapshot snapshot(){
+        TMInstrumentationSnapshot snapshot;
+        snapshot.enabled = enabled;
+        if (!enabled) {
+            return snapshot;
+        }
+
+        flush_thread();
+        auto& all = totals();
+        snapshot.hardware_counters = all.hardware_counters.load(std::memory_order_relaxed);
+        for (std::size_t p = 0; p < number_of_phases; ++p) {
+            snapshot.phases[p].calls = all.phases[p].calls.load(std::memory_order_relaxed);
+            snapshot.phases[p].ns = all.phases[p].ns.load(std::memory_order_relaxed);
+            for (std::size_t c = 0; c < number_of_hardware_counters; ++c) {
+                snapshot.phases[p].hardware[c] = all.phases[p].hardware[c].load(std::memory_order_relaxed);
+            }
+        }
+        auto* counters = reinterpret_cast<uint64_t*>(&snapshot.counters);
+        for (std::size_t c = 0; c < number_of_counters; ++c) {
+            counters[c] = all.counters[c].load(std::memory_order_relaxed);
+        }
+        return snapshot;
+    }
+
+    // Zeroes the totals and the calling thread's counters
+    static void reset(){
+#ifdef TMU_INSTRUMENTATION
+        tmu_counters = TMUCounters{};
+#endif
+        auto& all = totals();
+        for (auto& stats : all.phases) {
+            stats.calls.store(0, std::memory_order_relaxed);
+            stats.ns.store(0, std::memory_order_relaxed);
+            for (auto& value : stats.hardware) {
+                value.store(0, std::memory_order_relaxed);
+            }
+        }
+        for (auto& value : all.counters) {
+            value.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    /*
+     * Turns hardware counters on or off for phases that start afterwards. Returns whether they are on, which needs a
+     * build with TMU_PERF_EVENTS on Linux and a perf_event_paranoid setting that allows counting the own process.
+     */
+    static bool enable_hardware_counters(bool enable){
+#ifdef TMU_HAS_PERF_EVENTS
+        const bool available = enable && thread_perf_events().open();
+        totals().hardware_counters.store(available, std::memory_order_relaxed);
+        return available;
+#else
+        (void)enable;
+        return false;
+#endif
+    }
+
+    static bool hardware_counters_enabled(){
+        return totals().hardware_counters.load(std::memory_order_relaxed);
+    }
+
+#ifdef TMU_HAS_PERF_EVENTS
+    /*
+     * One perf event group per thread, opened on first use and counting user space only.
+     */
+    class PerfEvents {
+        std::array<int, number_of_hardware_counters> fds{};
+        bool opened = false;
+        bool failed = false;
+
+    public:
+        PerfEvents(){
+            fds.fill(-1);
+        }
+
+        ~PerfEvents(){
+            for (const int fd : fds) {
+                if (fd >= 0) {
+                    close(fd);
+                }
+            }
+        }
+
+        bool open(){
+            if (opened || failed) {
+                return opened;
+            }
+
+            static constexpr uint64_t configs[] = {
+                    PERF_COUNT_HW_CPU_CYCLES,
+                    PERF_COUNT_HW_INSTRUCTIONS,
+                    PERF_COUNT_HW_CACHE_MISSES,
+                    PERF_COUNT_HW_BRANCH_MISSES
+            };
+            for (std::size_t c = 0; c < number_of_hardware_counters; ++c) {
+                perf_event_attr attr{};
+                attr.type = PERF_TYPE_HARDWARE;
+                attr.size = sizeof(attr);
+                attr.config = configs[c];
+                attr.disabled = c == 0;
+                attr.exclude_kernel = 1;
+                attr.exclude_hv = 1;
+                attr.read_format = PERF_FORMAT_GROUP;
+                fds[c] = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, c == 0 ? -1 : fds[0], 0));
+                if (fds[c] < 0) {
+                    failed = true;
+                    return false;
+                }
+            }
+            ioctl(fds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+            opened = true;
+            return true;
+        }
+
+        bool read_values(uint64_t* values) const {
+            uint64_t buffer[1 + number_of_hardware_counters];
+            if (!opened || ::read(fds[0], buffer, sizeof(buffer)) != static_cast<ssize_t>(sizeof(buffer))) {
+                return false;
+            }
+            for (std::size_t c = 0; c < number_of_hardware_counters; ++c) {
+                values[c] = buffer[1 + c];
+            }
+            return true;
+        }
+    };
+
+    static PerfEvents& thread_perf_events(){
+        static thread_local PerfEvents events;
+        return events;
+    }
+#endif
+
+private:
+    struct PhaseTotals {
+        std::atomic<uint64_t> calls{0};
+        std::atomic<uint64_t> ns{0};
+        std::array<std::atomic<uint64_t>, number_of_hardware_counters> hardware{};
+    };
+
+    struct Totals {
+        std::array<PhaseTotals, number_of_phases> phases;
+        std::array<std::atomic<uint64_t>, number_of_counters> counters{};
+        std::atomic<bool> hardware_counters{false};
+    };
+
+    static Totals& totals(){
+        static Totals all;
+        return all;
+    }
+};
+
+/*
+ * Times the enclosing scope as one call of a phase, with hardware counters when they are on.
+ */
+class TMPhaseScope {
+    TMPhase phase;
+    std::chrono::steady_clock::time_point begin;
+#ifdef TMU_HAS_PERF_EVENTS
+    std::array<uint64_t, TMInstrumentation::number_of_hardware_counters> hardware_begin{};
+    bool hardware = false;
+#endif
+
+public:
+    explicit TMPhaseScope(TMPhase phase): phase(phase) {
+#ifdef TMU_HAS_PERF_EVENTS
+        if (TMInstrumentation::hardware_counters_enabled()) {
+            auto& events = TMInstrumentation::thread_perf_events();
+            hardware = events.open() && events.read_values(hardware_begin.data());
+        }
+#endif
+        begin = std::chrono::steady_clock::now();
+    }
+
+    ~TMPhaseScope(){
+        const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - begin).count();
+#ifdef TMU_HAS_PERF_EVENTS
+        std::array<uint64_t, TMInstrumentation::number_of_hardware_counters> hardware_end{};
+        if (hardware && TMInstrumentation::thread_perf_events().read_values(hardware_end.data())) {
+            for (std::size_t c = 0; c < hardware_end.size(); ++c) {
+                hardware_end[c] -= hardware_begin[c];
+            }
+            TMInstrumentation::record(phase, ns, hardware_end.data());
+            return;
+        }
+#endif
+        TMInstrumentation::record(phase, ns, nullptr);
+    }
+
+    TMPhaseScope(const TMPhaseScope&) = delete;
+    TMPhaseScope& operator=(const TMPhaseScope&) = delete;
+};
+
+#define TMU_PHASE_CONCAT_(a, b) a##b
+#define TMU_PHASE_CONCAT(a, b) TMU_PHASE_CONCAT_(a, b)
+
+#ifdef TMU_INSTRUMENTATION
+#define TMU_PHASE(phase) TMPhaseScope TMU_PHASE_CONCAT(tmu_phase_scope_, __LINE__)(TMPhase::phase)
+#else
+#define TMU_PHASE(phase) ((void)0)
+#endif
+
+#endif //TUMLIBPP_TM_INSTRUMENTATION_H
@@ -0,0 +1,160 @@
+#ifndef TUMLIBPP_TM_LITERAL_TELEMETRY_H
+#define TUMLIBPP_TM_LITERAL_TELEMETRY_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <tcb/span.hpp>
+
+extern "C" {
+    #include "fast_rand.h"
+}
+
+/*
+ * Per-literal statistics of one clause bank: how many clauses include each literal and how often include actions
+ * flipped, in total and per epoch. The feedback kernels keep them current while the telemetry is installed with
+ * Scope, so every read is O(literals) and never scans the bank.
+ */
+class TMLiteralTelemetry {
+    std::vector<int32_t> clauses_including;
+    std::vector<uint64_t> include_flips;
+    std::vector<uint64_t> exclude_flips;
+
+    // Flip totals at the start of the current epoch, and the flips of the previous epoch
+    std::vector<uint64_t> epoch_include_start;
+    std::vector<uint64_t> epoch_exclude_start;
+    std::vector<uint64_t> previous_epoch_include_flips;
+    std::vector<uint64_t> previous_epoch_exclude_flips;
+    std::size_t number_of_epochs = 0;
+
+public:
+    /*
+     * Installs telemetry for the kernels called on this thread until the scope ends. A null telemetry uninstalls, so
+     * banks without telemetry never report into another bank's counts.
+     */
+    class Scope {
+        TMULiteralTelemetry handle{};
+        TMULiteralTelemetry* previous;
+
+    public:
+        explicit Scope(TMLiteralTelemetry* telemetry): previous(tmu_literal_telemetry) {
+            if (!telemetry) {
+                tmu_literal_telemetry = nullptr;
+                return;
+            }
+            handle.number_of_literals = static_cast<int>(telemetry->clauses_including.size());
+            handle.clauses_including = telemetry->clauses_including.data();
+            handle.include_flips = telemetry->include_flips.data();
+            handle.exclude_flips = telemetry->exclude_flips.data();
+            tmu_literal_telemetry = &handle;
+        }
+
+        ~Scope(){
+            tmu_literal_telemetry = previous;
+        }
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+    };
+
+    explicit TMLiteralTelemetry(std::size_t number_of_literals)
+    : clauses_including(number_of_literals, 0)
+    , include_flips(number_of_literals, 0)
+    , exclude_flips(number_of_literals, 0)
+    , epoch_include_start(number_of_literals, 0)
+    , epoch_exclude_start(number_of_literals, 0)
+    , previous_epoch_include_flips(number_of_literals, 0)
+    , previous_epoch_exclude_flips(number_of_literals, 0)
+    {}
+
+    /*
+     * Recounts the included literals from the top state bits, visiting only the set bits. Needed after the bank is
+     * written other than through the feedback kernels, e.g. when it is initialized or loaded.
+     */
+    void rebuild(const uint32_t* clause_bank, std::size_t number_of_clauses, std::size_t number_of_ta_chunks,
+                 std::size_t number_of_state_bits){
+        std::fill(clauses_including.begin(), clauses_including.end(), 0);
+        const std::size_t number_of_literals = clauses_including.size();
+        for (std::size_t j = 0; j < number_of_clauses; ++j) {
+            const uint32_t* ta_state = &clause_bank[j * number_of_ta_chunks * number_of_state_bits];
+            for (std::size_t k = 0; k < number_of_ta_chunks; ++k) {
+                uint32_t included = ta_state[k * number_of_state_bits + number_of_state_bits - 1];
+                while (included) {
+                    const std::size_t literal = k * 32 + __builtin_ctz(included);
+                    if (literal < number_of_literals) {
+                        clauses_including[literal]++;
+                    }
+                    included &= included - 1;
+                }
+            }
+        }
+    }
+
+    // Include action of a literal set directly, delta is +1 or -1
+    void adjust(std::size_t literal, int delta){
+        clauses_including[literal] += delta;
+        if (delta > 0) {
+            include_flips[literal]++;
+        } else if (delta < 0) {
+            exclude_flips[literal]++;
+        }
+    }
+
+    // Ends the current epoch: its flips become the previous epoch's
+    void begin_epoch(){
+        for (std::size_t i = 0; i < include_flips.size(); ++i) {
+            previous_epoch_include_flips[i] = include_flips[i] - epoch_include_start[i];
+            previous_epoch_exclude_flips[i] = exclude_flips[i] - epoch_exclude_start[i];
+        }
+        epoch_include_start = include_flips;
+        epoch_exclude_start = exclude_flips;
+        number_of_epochs++;
+    }
+
+    void reset_flips(){
+        for (auto* values : {&include_flips, &exclude_flips, &epoch_include_start, &epoch_exclude_start,
+                             &previous_epoch_include_flips, &previous_epoch_exclude_flips}) {
+            std::fill(values->begin(), values->end(), 0);
+        }
+        number_of_epochs = 0;
+    }
+
+    [[nodiscard]] std::size_t number_of_literals() const {
+        return clauses_including.size();
+    }
+
+    [[nodiscard]] std::size_t epochs() const {
+        return number_of_epochs;
+    }
+
+    [[nodiscard]] tcb::span<const int32_t> literal_clause_count() const {
+        return {clauses_including.data(), clauses_including.size()};
+    }
+
+    [[nodiscard]] tcb::span<const uint64_t> total_include_flips() const {
+        return {include_flips.data(), include_flips.size()};
+    }
+
+    [[nodiscard]] tcb::span<const uint64_t> total_exclude_flips() const {
+        return {exclude_flips.data(), exclude_flips.size()};
+    }
+
+    [[nodiscard]] tcb::span<const uint64_t> last_epoch_include_flips() const {
+        return {previous_epoch_include_flips.data(), previous_epoch_include_flips.size()};
+    }
+
+    [[nodiscard]] tcb::span<const uint64_t> last_epoch_exclude_flips() const {
+        return {previous_epoch_exclude_flips.data(), previous_epoch_exclude_flips.size()};
+    }
+
+    // Flips since the current epoch began
+    void epoch_flips(uint64_t* include_out, uint64_t* exclude_out) const {
+        for (std::size_t i = 0; i < include_flips.size(); ++i) {
+            include_out[i] = include_flips[i] - epoch_include_start[i];
+            exclude_out[i] = exclude_flips[i] - epoch_exclude_start[i];
+        }
+    }
+};
+
+#endif //TUMLIBPP_TM_LITERAL_TELEMETRY_H
@@ -0,0 +1,148 @@
+#ifndef TUMLIBPP_TM_PATCH_ACTIVATIONS_H
+#define TUMLIBPP_TM_PATCH_ACTIVATIONS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+#include "tm_transposed_evaluator.h"
+
+/*
+ * Where each clause matched, bit-packed as [sample][bank][clause][word]: patch p is bit p % 64 of word p / 64. Patch
+ * p lies at row p / patches_x, column p % patches_x of the patch grid, in the order the encoder produces them.
+ */
+struct TMPatchActivations {
+    std::size_t number_of_samples = 0;
+    std::size_t number_of_banks = 0;
+    std::size_t number_of_clauses = 0;
+    std::size_t number_of_patches = 0;
+    std::size_t words_per_clause = 0;
+    std::vector<uint64_t> bits;
+
+    [[nodiscard]] bool fired(std::size_t sample, std::size_t bank, std::size_t clause, std::size_t patch) const {
+        const std::size_t row = (sample * number_of_banks + bank) * number_of_clauses + clause;
+        return (bits[row * words_per_clause + patch / 64] >> (patch % 64)) & 1;
+    }
+
+    template<class T>
+    static TMPatchActivations compute(
+            const TMTransposedEvaluator<T>& evaluator,
+            const T* encoded_X,
+            std::size_t n_samples,
+            std::size_t threads = 0
+    ){
+        TMPatchActivations activations;
+        activations.number_of_samples = n_samples;
+        activations.number_of_banks = evaluator.number_of_banks();
+        activations.number_of_clauses = evaluator.number_of_clauses(0);
+        activations.number_of_patches = evaluator.patches();
+        activations.words_per_clause = (activations.number_of_patches + 63) / 64;
+        activations.bits.assign(
+                n_samples * activations.number_of_banks * activations.number_of_clauses * activations.words_per_clause, 0);
+
+        const std::size_t n_banks = activations.number_of_banks;
+        const std::size_t n_clauses = activations.number_of_clauses;
+        const std::size_t n_patches = activations.number_of_patches;
+        const std::size_t words = activations.words_per_clause;
+        evaluator.for_each_block(encoded_X, n_samples, threads,
+                                 [&](std::size_t, const typename TMTransposedEvaluator<T>::Block& block,
+                                     std::size_t begin) {
+            std::vector<uint64_t> outputs(n_patches);
+            for (std::size_t b = 0; b < n_banks; ++b) {
+                for (std::size_t j = 0; j < n_clauses; ++j) {
+                    if (!evaluator.fires_patchwise(block, b, j, outputs.data())) {
+                        continue;
+                    }
+                    for (std::size_t p = 0; p < n_patches; ++p) {
+                        uint64_t output = outputs[p];
+                        while (output) {
+                            const std::size_t s = __builtin_ctzll(output);
+                            const std::size_t row = ((begin + s) * n_banks + b) * n_clauses + j;
+                            activations.bits[row * words + p / 64] |= uint64_t(1) << (p % 64);
+                            output &= output - 1;
+                        }
+                    }
+                }
+            }
+        });
+        return activations;
+    }
+};
+
+/*
+ * Localization maps: for every sample, class and patch, the sum of the weights of the clauses that matched the patch,
+ * stored as [sample][class][patch]. Clauses without included literals match nowhere, as in prediction.
+ */
+struct TMPatchHeatmaps {
+    std::size_t number_of_samples = 0;
+    std::size_t number_of_classes = 0;
+    std::size_t number_of_patches = 0;
+    std::vector<int32_t> values;
+
+    /*
+     * Class c is scored by the clauses of evaluator bank bank_of_class[c], weighted by weights[c * clauses + j].
+     * Zero weights are skipped before evaluation.
+     */
+    template<class T>
+    static TMPatchHeatmaps compute(
+            const TMTransposedEvaluator<T>& evaluator,
+            const T* encoded_X,
+            std::size_t n_samples,
+            const std::vector<std::size_t>& bank_of_class,
+            const std::vector<int32_t>& weights,
+            std::size_t threads = 0
+    ){
+        TMPatchHeatmaps heatmaps;
+        heatmaps.number_of_samples = n_samples;
+        heatmaps.number_of_classes = bank_of_class.size();
+        heatmaps.number_of_patches = evaluator.patches();
+        const std::size_t n_classes = heatmaps.number_of_classes;
+        const std::size_t n_patches = heatmaps.number_of_patches;
+        const std::size_t n_clauses = evaluator.number_of_clauses(0);
+        if (weights.size() != n_classes * n_clauses) {
+            throw std::invalid_argument("weights must hold one weight per class and clause");
+        }
+        heatmaps.values.assign(n_samples * n_classes * n_patches, 0);
+
+        // The non-zero weights of each clause of each bank, as (class, weight)
+        struct Vote {
+            std::size_t the_class;
+            int32_t weight;
+        };
+        std::vector<std::vector<std::vector<Vote>>> votes(
+                evaluator.number_of_banks(), std::vector<std::vector<Vote>>(n_clauses));
+        for (std::size_t c = 0; c < n_classes; ++c) {
+            for (std::size_t j = 0; j < n_clauses; ++j) {
+                if (weights[c * n_clauses + j] != 0) {
+                    votes.at(bank_of_class[c])[j].push_back({c, weights[c * n_clauses + j]});
+                }
+            }
+        }
+
+        evaluator.for_each_block(encoded_X, n_samples, threads,
+                                 [&](std::size_t, const typename TMTransposedEvaluator<T>::Block& block,
+                                     std::size_t begin) {
+            std::vector<uint64_t> outputs(n_patches);
+            for (std::size_t b = 0; b < votes.size(); ++b) {
+                for (std::size_t j = 0; j < n_clauses; ++j) {
+                    if (votes[b][j].empty() || !evaluator.fires_patchwise(block, b, j, outputs.data())) {
+                        continue;
+                    }
+                    for (std::size_t p = 0; p < n_patches; ++p) {
+                        uint64_t output = outputs[p];
+                        while (output) {
+                            int32_t* sample = &heatmaps.values[(begin + __builtin_ctzll(output)) * n_classes * n_patches];
+                            for (const Vote& vote : votes[b][j]) {
+                                sample[vote.the_class * n_patches + p] += vote.weight;
+                            }
+                            output &= output - 1;
+                        }
+                    }
+                }
+            }
+        });
+        return heatmaps;
+    }
+};
+
+#endif //TUMLIBPP_TM_PATCH_ACTIVATIONS_H
@@ -0,0 +1,236 @@
+#ifndef TUMLIBPP_TM_TRANSPOSED_EVALUATOR_H
+#define TUMLIBPP_TM_TRANSPOSED_EVALUATOR_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+#include "tm_clause_dense.h"
+#include "utils/tm_parallel.h"
+
+/*
+ * Evaluates clauses over 64 samples at a time. A block of encoded samples is transposed into one 64-bit mask per
+ * patch and literal, bit s set when the literal is true in sample s, so a clause's outputs for the whole block are
+ * the AND of the masks of its included literals, ORed over patches. Only literals that some clause includes are
+ * transposed, and each clause visits only its own literals.
+ *
+ * Outputs follow prediction: clauses without included literals do not fire. The evaluator copies the include
+ * actions when it is built; rebuild it after training.
+ */
+template<class T>
+class TMTransposedEvaluator {
+
+public:
+    static constexpr std::size_t block_size = 64;
+
+    struct Block {
+        std::vector<uint64_t> masks; // [patch][used literal]
+        std::size_t count = 0;
+        uint64_t valid = 0;
+    };
+
+private:
+    struct BankLiterals {
+        std::vector<uint64_t> offsets;   // CSR rows per clause
+        std::vector<uint32_t> positions; // into used_literals
+    };
+
+    std::size_t number_of_patches;
+    std::size_t number_of_ta_chunks;
+    std::size_t number_of_literals;
+    std::vector<uint32_t> used_literals;
+    std::vector<BankLiterals> banks;
+
+    // Numbers the literals that some clause includes, and points each clause's literals at their masks
+    void index_literals(const std::vector<std::vector<uint32_t>>& literals){
+        std::vector<int32_t> position(number_of_literals, -1);
+        for (const auto& bank_literals : literals) {
+            for (const uint32_t literal : bank_literals) {
+                if (literal >= number_of_literals) {
+                    throw std::invalid_argument("Included literal out of range");
+                }
+                position[literal] = 0;
+            }
+        }
+
+        for (std::size_t literal = 0; literal < number_of_literals; ++literal) {
+            if (position[literal] == 0) {
+                position[literal] = static_cast<int32_t>(used_literals.size());
+                used_literals.push_back(static_cast<uint32_t>(literal));
+            }
+        }
+        for (std::size_t b = 0; b < banks.size(); ++b) {
+            banks[b].positions.resize(literals[b].size());
+            for (std::size_t i = 0; i < literals[b].size(); ++i) {
+                banks[b].positions[i] = static_cast<uint32_t>(position[literals[b][i]]);
+            }
+        }
+    }
+
+public:
+    explicit TMTransposedEvaluator(const std::vector<const TMClauseBankDense<T>*>& clause_banks, std::size_t threads = 0){
+        if (clause_banks.empty()) {
+            throw std::invalid_argument("TMTransposedEvaluator needs at least one clause bank");
+        }
+        number_of_patches = clause_banks.front()->number_of_patches;
+        number_of_ta_chunks = clause_banks.front()->number_of_ta_chunks;
+        number_of_literals = clause_banks.front()->number_of_literals;
+
+        std::vector<std::vector<uint32_t>> literals(clause_banks.size());
+        banks.resize(clause_banks.size());
+        for (std::size_t b = 0; b < clause_banks.size(); ++b) {
+            const auto& bank = *clause_banks[b];
+            if (bank.number_of_literals != number_of_literals || bank.number_of_patches != number_of_patches) {
+                throw std::invalid_argument("All clause banks must share literals and patches");
+            }
+            bank.get_literals(banks[b].offsets, literals[b], threads);
+        }
+        index_literals(literals);
+    }
+
+    /*
+     * Builds the evaluator from the included literals of each bank's clauses, laid out like
+     * TMClauseBankDense::get_literals: clause j of bank b includes literals[b][offsets[b][j]] up to
+     * literals[b][offsets[b][j + 1]].
+     */
+    TMTransposedEvaluator(
+            std::vector<std::vector<uint64_t>> offsets,
+            const std::vector<std::vector<uint32_t>>& literals,
+            std::size_t _number_of_literals,
+            std::size_t _number_of_patches,
+            std::size_t _number_of_ta_chunks
+    )
+    : number_of_patches(_number_of_patches)
+    , number_of_ta_chunks(_number_of_ta_chunks)
+    , number_of_literals(_number_of_literals)
+    {
+        if (offsets.empty() || offsets.size() != literals.size()) {
+            throw std::invalid_argument("TMTransposedEvaluator needs the offsets and literals of at least one bank");
+        }
+        banks.resize(offsets.size());
+        for (std::size_t b = 0; b < offsets.size(); ++b) {
+            if (offsets[b].empty() || offsets[b].back() != literals[b].size()) {
+                throw std::invalid_argument("Clause offsets must end at the number of literals of their bank");
+            }
+            banks[b].offsets = std::move(offsets[b]);
+        }
+        index_literals(literals);
+    }
+
+    [[nodiscard]] std::size_t number_of_banks() const {
+        return banks.size();
+    }
+
+    [[nodiscard]] std::size_t number_of_clauses(std::size_t bank) const {
+        return banks[bank].offsets.size() - 1;
+    }
+
+    // Encoded words per sample, as prepare_X() writes them
+    [[nodiscard]] std::size_t sample_size() const {
+        return number_of_patches * number_of_ta_chunks;
+    }
+
+    [[nodiscard]] std::size_t number_of_used_literals() const {
+        return used_literals.size();
+    }
+
+    void load(Block& block, const T* encoded_X, std::size_t begin, std::size_t count) const {
+        const std::size_t used = used_literals.size();
+        block.masks.assign(number_of_patches * used, 0);
+        block.count = count;
+        block.valid = count >= block_size ? ~uint64_t(0) : (uint64_t(1) << count) - 1;
+
+        for (std::size_t s = 0; s < count; ++s) {
+            const T* xi = &encoded_X[(begin + s) * sample_size()];
+            const uint64_t bit = uint64_t(1) << s;
+            for (std::size_t p = 0; p < number_of_patches; ++p) {
+                const T* patch = &xi[p * number_of_ta_chunks];
+                uint64_t* masks = &block.masks[p * used];
+                for (std::size_t u = 0; u < used; ++u) {
+                    const uint32_t literal = used_literals[u];
+                    if ((patch[literal / 32] >> (literal % 32)) & 1) {
+                        masks[u] |= bit;
+                    }
+                }
+            }
+        }
+    }
+
+    // Bit s is set when the clause fires for sample s of the block
+    [[nodiscard]] uint64_t fires(const Block& block, std::size_t bank, std::size_t clause) const {
+        const auto& rows = banks[bank];
+        const std::size_t begin = rows.offsets[clause];
+        const std::size_t end = rows.offsets[clause + 1];
+        if (begin == end) {
+            return 0;
+        }
+
+        const std::size_t used = used_literals.size();
+        uint64_t output = 0;
+        for (std::size_t p = 0; p < number_of_patches && output != block.valid; ++p) {
+            const uint64_t* masks = &block.masks[p * used];
+            uint64_t patch_output = block.valid & ~output;
+            for (std::size_t i = begin; i < end && patch_output; ++i) {
+                patch_output &= masks[rows.positions[i]];
+            }
+            output |= patch_output;
+        }
+        return output;
+    }
+
+    /*
+     * Outputs per patch: bit s of outputs[p] is set when the clause matches patch p of sample s. Returns the OR over
+     * the patches, like fires(), but never stops early.
+     */
+    uint64_t fires_patchwise(const Block& block, std::size_t bank, std::size_t clause, uint64_t* outputs) const {
+        const auto& rows = banks[bank];
+        const std::size_t begin = rows.offsets[clause];
+        const std::size_t end = rows.offsets[clause + 1];
+        if (begin == end) {
+            std::fill(outputs, outputs + number_of_patches, 0);
+            return 0;
+        }
+
+        const std::size_t used = used_literals.size();
+        uint64_t output = 0;
+        for (std::size_t p = 0; p < number_of_patches; ++p) {
+            const uint64_t* masks = &block.masks[p * used];
+            uint64_t patch_output = block.valid;
+            for (std::size_t i = begin; i < end && patch_output; ++i) {
+                patch_output &= masks[rows.positions[i]];
+            }
+            outputs[p] = patch_output;
+            output |= patch_output;
+        }
+        return output;
+    }
+
+    [[nodiscard]] std::size_t patches() const {
+        return number_of_patches;
+    }
+
+    /*
+     * Calls fn(worker, block, begin) for every block of n_samples encoded samples, with the blocks split across
+     * threads. Returns the number of workers, so fn can index per-worker state sized with workers().
+     */
+    template<class Function>
+    std::size_t for_each_block(const T* encoded_X, std::size_t n_samples, std::size_t threads, Function&& fn) const {
+        const std::size_t n_blocks = (n_samples + block_size - 1) / block_size;
+        return TMParallel::for_ranges(n_blocks, threads, 1, [&](std::size_t worker, std::size_t first, std::size_t last) {
+            Block block;
+            for (std::size_t b = first; b < last; ++b) {
+                const std::size_t begin = b * block_size;
+                load(block, encoded_X, begin, std::min(block_size, n_samples - begin));
+                fn(worker, block, begin);
+            }
+        });
+    }
+
+    [[nodiscard]] static std::size_t workers(std::size_t n_samples, std::size_t threads){
+        return TMParallel::workers((n_samples + block_size - 1) / block_size, threads, 1);
+    }
+};
+
+#endif //TUMLIBPP_TM_TRANSPOSED_EVALUATOR_H
@@ -8,6 +8,7 @@
 #include <span>
 #include "tm_memory.h"
 #include "tm_clause_dense.h"
+#include "tm_instrumentation.h"
 #include <assert.h>
 #include <iostream>
 extern "C" {
@@ -44,17 +45,21 @@ public:
 
     TMWeightBank(){};
 
-    void initialize(TMMemory<T>& memory, std::size_t number_of_clauses) {
+    void initialize(TMMemory<T>& memory, std::size_t number_of_clauses, tl::optional<tcb::span<int32_t>> external_weights = tl::nullopt) {
 
-        tcb::span<uint32_t> originalSpan = memory.getSegment(number_of_clauses);
-        tcb::span<int32_t> reinterpretedSpan(reinterpret_cast<int32_t*>(originalSpan.data()), originalSpan.size());
-        weights = reinterpretedSpan;
+        if(external_weights){
+            weights = *external_weights;
+        }else{
+            tcb::span<uint32_t> originalSpan = memory.getSegment(number_of_clauses);
+            tcb::span<int32_t> reinterpretedSpan(reinterpret_cast<int32_t*>(originalSpan.data()), originalSpan.size());
+            weights = reinterpretedSpan;
+        }
 
         TMWeightBankPresets::positive_one_negative_minus_one(weights, number_of_clauses);
     }
 
-    std::size_t getRequiredMemorySize(std::size_t number_of_clauses) {
-        return number_of_clauses;
+    std::size_t getRequiredMemorySize(std::size_t number_of_clauses, bool include_weights = true) {
+        return include_weights ? number_of_clauses : 0;
     }
 
     void increment(
@@ -63,6 +68,7 @@ public:
             const tcb::span<uint32_t>& clause_active,
             bool positive_weights
     ){
+        TMU_PHASE(weight_update);
 
         wb_increment(
                 weights.data(),
@@ -80,6 +86,7 @@ public:
             const tcb::span<uint32_t>& clause_active,
             bool negative_weights
     ){
+        TMU_PHASE(weight_update);
 
         wb_decrement(
             weights.data(),
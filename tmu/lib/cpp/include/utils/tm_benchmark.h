@@ -0,0 +1,209 @@
+#ifndef TUMLIBPP_TM_BENCHMARK_H
+#define TUMLIBPP_TM_BENCHMARK_H
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+/*
+ * A flat JSON object, written in insertion order. Values are numbers, strings, booleans or already serialized JSON.
+ */
+class TMJsonObject {
+    std::vector<std::pair<std::string, std::string>> fields;
+
+public:
+    static std::string quote(const std::string& value){
+        std::ostringstream out;
+        out << '"';
+        for (const char c : value) {
+            switch (c) {
+                case '"': out << "\\\""; break;
+                case '\\': out << "\\\\"; break;
+                case '\n': out << "\\n"; break;
+                case '\t': out << "\\t"; break;
+                default:
+                    if (static_cast<unsigned char>(c) < 0x20) {
+                        out << "\\u" << std::hex << std::setw(4) << std::setfill('0') << static_cast<int>(c);
+                    } else {
+                        out << c;
+                    }
+            }
+        }
+        out << '"';
+        return out.str();
+    }
+
+    static std::string array(const std::vector<std::string>& values){
+        std::string out = "[";
+        for (std::size_t i = 0; i < values.size(); ++i) {
+            if (i) {
+                out += ", ";
+            }
+            out += values[i];
+        }
+        out += "]";
+        return out;
+    }
+
+    TMJsonObject& add(const std::string& key, double value){
+        // NaN and infinities are not JSON
+        if (!std::isfinite(value)) {
+            return add_raw(key, "null");
+        }
+        std::ostringstream out;
+        out << std::setprecision(std::numeric_limits<double>::max_digits10 - 2) << value;
+        return add_raw(key, out.str());
+    }
+
+    TMJsonObject& add(const std::string& key, std::size_t value){
+        return add_raw(key, std::to_string(value));
+    }
+
+    TMJsonObject& add(const std::string& key, int value){
+        return add_raw(key, std::to_string(value));
+    }
+
+    TMJsonObject& add(const std::string& key, bool value){
+        return add_raw(key, value ? "true" : "false");
+    }
+
+    TMJsonObject& add(const std::string& key, const std::string& value){
+        return add_raw(key, quote(value));
+    }
+
+    TMJsonObject& add(const std::string& key, const char* value){
+        return add_raw(key, quote(value));
+    }
+
+    TMJsonObject& add_raw(const std::string& key, const std::string& json){
+        fields.emplace_back(key, json);
+        return *this;
+    }
+
+    [[nodiscard]] std::string str() const {
+        std::string out = "{";
+        for (std::size_t i = 0; i < fields.size(); ++i) {
+            if (i) {
+                out += ", ";
+            }
+            out += quote(fields[i].first);
+            out += ": ";
+            out += fields[i].second;
+        }
+        out += "}";
+        return out;
+    }
+};
+
+class TMBenchmark {
+
+public:
+    using Clock = std::chrono::steady_clock;
+
+    /*
+     * Calls fn at least min_repetitions times and until min_time_s has passed, up to max_repetitions. Returns the
+     * duration of each call in nanoseconds. One untimed call warms caches and lazily initialized state first.
+     */
+    template<class Function>
+    static std::vector<double> measure(
+            Function&& fn,
+            double min_time_s,
+            std::size_t min_repetitions = 5,
+            std::size_t max_repetitions = 1000000
+    ){
+        fn();
+
+        std::vector<double> durations;
+        const auto started = Clock::now();
+        while (durations.size() < max_repetitions) {
+            const auto begin = Clock::now();
+            fn();
+            const auto end = Clock::now();
+            durations.push_back(std::chrono::duration<double, std::nano>(end - begin).count());
+
+            if (durations.size() >= min_repetitions &&
+                std::chrono::duration<double>(end - started).count() >= min_time_s) {
+                break;
+            }
+        }
+        return durations;
+    }
+
+    // Nearest-rank percentile, p in [0, 100]
+    static double percentile(std::vector<double> values, double p){
+        if (values.empty()) {
+            throw std::invalid_argument("percentile of no values");
+        }
+        std::sort(values.begin(), values.end());
+        const double rank = std::ceil(std::clamp(p, 0.0, 100.0) / 100.0 * static_cast<double>(values.size()));
+        const std::size_t index = rank < 1.0 ? 0 : static_cast<std::size_t>(rank) - 1;
+        return values[std::min(index, values.size() - 1)];
+    }
+
+    // Peak resident set size of the process, 0 where it is not available
+    static std::size_t peak_memory_bytes(){
+#if defined(__APPLE__)
+        rusage usage{};
+        getrusage(RUSAGE_SELF, &usage);
+        return static_cast<std::size_t>(usage.ru_maxrss);
+#elif defined(__unix__)
+        rusage usage{};
+        getrusage(RUSAGE_SELF, &usage);
+        return static_cast<std::size_t>(usage.ru_maxrss) * 1024;
+#else
+        return 0;
+#endif
+    }
+
+    // Current resident set size, from /proc on Linux and 0 elsewhere
+    static std::size_t current_memory_bytes(){
+#if defined(__linux__)
+        std::ifstream statm("/proc/self/statm");
+        std::size_t pages = 0;
+        std::size_t resident = 0;
+        if (statm >> pages >> resident) {
+            return resident * static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+        }
+#endif
+        return 0;
+    }
+
+    // "1,2,3" -> {1, 2, 3}
+    template<class Value>
+    static std::vector<Value> parse_list(const std::string& text){
+        std::vector<Value> values;
+        std::istringstream in(text);
+        std::string item;
+        while (std::getline(in, item, ',')) {
+            if (item.empty()) {
+                continue;
+            }
+            std::istringstream item_in(item);
+            Value value;
+            if (!(item_in >> value) || !item_in.eof()) {
+                throw std::invalid_argument("Could not parse '" + item + "' in '" + text + "'");
+            }
+            values.push_back(value);
+        }
+        if (values.empty()) {
+            throw std::invalid_argument("Empty list '" + text + "'");
+        }
+        return values;
+    }
+};
+
+#endif //TUMLIBPP_TM_BENCHMARK_H
@@ -0,0 +1,206 @@
+#ifndef TUMLIBPP_TM_CHECKPOINT_H
+#define TUMLIBPP_TM_CHECKPOINT_H
+
+#include <algorithm>
+#include <fstream>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <stdexcept>
+
+/*
+ * Binary snapshot of a trained multi-class model: every class' clause bank (all state bits) and weights, plus the
+ * input geometry needed to encode samples the way the model was trained.
+ *
+ * File layout, little endian:
+ *   uint32 magic, uint32 version
+ *   int32 T, uint32 number_of_classes, number_of_clauses, number_of_literals, number_of_state_bits, number_of_patches
+ *   int32 dim[3], int32 patch_dim[2]
+ *   uint32 classes[number_of_classes]
+ *   uint32 clause_banks[number_of_classes][number_of_clauses][number_of_ta_chunks][number_of_state_bits]
+ *   int32 weights[number_of_classes][number_of_clauses]
+ */
+struct TMCheckpoint {
+    static constexpr uint32_t MAGIC = 0x4b434d54; // "TMCK"
+    static constexpr uint32_t VERSION = 1;
+
+    int32_t T = 0;
+    uint32_t number_of_classes = 0;
+    uint32_t number_of_clauses = 0;
+    uint32_t number_of_literals = 0;
+    uint32_t number_of_state_bits = 0;
+    uint32_t number_of_patches = 0;
+    int32_t dim[3] = {0, 0, 0};
+    int32_t patch_dim[2] = {0, 0};
+
+    std::vector<uint32_t> classes;
+    std::vector<uint32_t> clause_banks;
+    std::vector<int32_t> weights;
+
+    [[nodiscard]] uint32_t number_of_ta_chunks() const {
+        return (number_of_literals - 1) / 32 + 1;
+    }
+
+    [[nodiscard]] std::size_t clause_bank_size() const {
+        return static_cast<std::size_t>(number_of_clauses) * number_of_ta_chunks() * number_of_state_bits;
+    }
+
+    // The classes at positions [begin, end) with their clause banks and weights, e.g. one shard of a large model
+    [[nodiscard]] TMCheckpoint select_classes(std::size_t begin, std::size_t end) const {
+        if (begin > end || end > number_of_classes) {
+            throw std::out_of_range("Class range out of bounds");
+        }
+
+        TMCheckpoint selected;
+        selected.T = T;
+        selected.number_of_clauses = number_of_clauses;
+        selected.number_of_literals = number_of_literals;
+        selected.number_of_state_bits = number_of_state_bits;
+        selected.number_of_patches = number_of_patches;
+        std::copy(dim, dim + 3, selected.dim);
+        std::copy(patch_dim, patch_dim + 2, selected.patch_dim);
+        selected.number_of_classes = static_cast<uint32_t>(end - begin);
+        selected.classes.assign(classes.begin() + begin, classes.begin() + end);
+        selected.clause_banks.assign(clause_banks.begin() + begin * clause_bank_size(),
+                                     clause_banks.begin() + end * clause_bank_size());
+        selected.weights.assign(weights.begin() + begin * number_of_clauses, weights.begin() + end * number_of_clauses);
+        return selected;
+    }
+
+    void write(std::ostream& out) const {
+        const uint32_t header[] = {MAGIC, VERSION};
+        out.write(reinterpret_cast<const char*>(header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(&T), sizeof(T));
+        const uint32_t sizes[] = {number_of_classes, number_of_clauses, number_of_literals, number_of_state_bits, number_of_patches};
+        out.write(reinterpret_cast<const char*>(sizes), sizeof(sizes));
+        out.write(reinterpret_cast<const char*>(dim), sizeof(dim));
+        out.write(reinterpret_cast<const char*>(patch_dim), sizeof(patch_dim));
+
+        out.write(reinterpret_cast<const char*>(classes.data()), classes.size() * sizeof(uint32_t));
+        out.write(reinterpret_cast<const char*>(clause_banks.data()), clause_banks.size() * sizeof(uint32_t));
+        out.write(reinterpret_cast<const char*>(weights.data()), weights.size() * sizeof(int32_t));
+    }
+
+    void write(const std::string& file_path) const {
+        std::ofstream file(file_path, std::ios::binary);
+        if (!file.is_open()) {
+            throw std::runtime_error("Could not open file " + file_path);
+        }
+
+        write(file);
+        if (!file) {
+            throw std::runtime_error("Could not write checkpoint " + file_path);
+        }
+    }
+
+    // The file layout in memory, e.g. to send a model to another process
+    [[nodiscard]] std::string serialize() const {
+        std::ostringstream out(std::ios::binary);
+        write(out);
+        return out.str();
+    }
+
+    static TMCheckpoint read(std::istream& in, const std::string& source) {
+        uint32_t header[2] = {0, 0};
+        in.read(reinterpret_cast<char*>(header), sizeof(header));
+        if (!in || header[0] != MAGIC) {
+            throw std::runtime_error(source + " is not a checkpoint");
+        }
+        if (header[1] != VERSION) {
+            throw std::runtime_error("Unsupported checkpoint version " + std::to_string(header[1]));
+        }
+
+        TMCheckpoint checkpoint;
+        in.read(reinterpret_cast<char*>(&checkpoint.T), sizeof(checkpoint.T));
+        uint32_t sizes[5];
+        in.read(reinterpret_cast<char*>(sizes), sizeof(sizes));
+        checkpoint.number_of_classes = sizes[0];
+        checkpoint.number_of_clauses = sizes[1];
+        checkpoint.number_of_literals = sizes[2];
+        checkpoint.number_of_state_bits = sizes[3];
+        checkpoint.number_of_patches = sizes[4];
+        in.read(reinterpret_cast<char*>(checkpoint.dim), sizeof(checkpoint.dim));
+        in.read(reinterpret_cast<char*>(checkpoint.patch_dim), sizeof(checkpoint.patch_dim));
+        if (!in) {
+            throw std::runtime_error("Truncated checkpoint " + source);
+        }
+
+        // The sizes come from the file, so they are checked against what is left of it before anything is allocated
+        if (checkpoint.number_of_literals == 0 || checkpoint.number_of_state_bits == 0
+            || checkpoint.number_of_state_bits > 32 || checkpoint.number_of_patches == 0) {
+            throw std::runtime_error("Invalid sizes in checkpoint " + source);
+        }
+        const std::size_t remaining_words = remaining_bytes(in) / sizeof(uint32_t);
+        const std::size_t payload_words = checked_sum(
+                checked_sum(
+                        checkpoint.number_of_classes,
+                        checked_product(checkpoint.number_of_classes, checkpoint.clause_bank_size_checked(remaining_words), remaining_words),
+                        remaining_words
+                ),
+                checked_product(checkpoint.number_of_classes, checkpoint.number_of_clauses, remaining_words),
+                remaining_words
+        );
+        if (payload_words > remaining_words) {
+            throw std::runtime_error("Truncated checkpoint " + source);
+        }
+
+        checkpoint.classes.resize(checkpoint.number_of_classes);
+        checkpoint.clause_banks.resize(checkpoint.number_of_classes * checkpoint.clause_bank_size());
+        checkpoint.weights.resize(static_cast<std::size_t>(checkpoint.number_of_classes) * checkpoint.number_of_clauses);
+
+        in.read(reinterpret_cast<char*>(checkpoint.classes.data()), checkpoint.classes.size() * sizeof(uint32_t));
+        in.read(reinterpret_cast<char*>(checkpoint.clause_banks.data()), checkpoint.clause_banks.size() * sizeof(uint32_t));
+        in.read(reinterpret_cast<char*>(checkpoint.weights.data()), checkpoint.weights.size() * sizeof(int32_t));
+
+        if (!in) {
+            throw std::runtime_error("Truncated checkpoint " + source);
+        }
+        return checkpoint;
+    }
+
+    static TMCheckpoint read(const std::string& file_path) {
+        std::ifstream file(file_path, std::ios::binary);
+        if (!file.is_open()) {
+            throw std::runtime_error("Could not open file " + file_path);
+        }
+        return read(file, file_path);
+    }
+
+    static TMCheckpoint deserialize(const std::string& bytes) {
+        std::istringstream in(bytes, std::ios::binary);
+        return read(in, "serialized model");
+    }
+
+private:
+    // Bytes from the read position to the end, or no limit for streams that cannot seek
+    static std::size_t remaining_bytes(std::istream& in) {
+        const auto position = in.tellg();
+        if (position < 0) {
+            return std::numeric_limits<std::size_t>::max();
+        }
+        in.seekg(0, std::ios::end);
+        const auto end = in.tellg();
+        in.seekg(position);
+        return end > position ? static_cast<std::size_t>(end - position) : 0;
+    }
+
+    // Size arithmetic on untrusted values, saturating at limit + 1 instead of overflowing
+    static std::size_t checked_product(std::size_t a, std::size_t b, std::size_t limit) {
+        if (a != 0 && b > (limit + 1) / a) {
+            return limit + 1;
+        }
+        return std::min(a * b, limit + 1);
+    }
+
+    static std::size_t checked_sum(std::size_t a, std::size_t b, std::size_t limit) {
+        return a > limit || b > limit - a ? limit + 1 : a + b;
+    }
+
+    [[nodiscard]] std::size_t clause_bank_size_checked(std::size_t limit) const {
+        return checked_product(checked_product(number_of_clauses, number_of_ta_chunks(), limit), number_of_state_bits, limit);
+    }
+};
+
+#endif //TUMLIBPP_TM_CHECKPOINT_H
@@ -0,0 +1,354 @@
+#ifndef TUMLIBPP_TM_CLIENT_SERVER_H
+#define TUMLIBPP_TM_CLIENT_SERVER_H
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <csignal>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "tm_socket.h"
+
+/*
+ * The client side of the inference servers (tmulib_server, tmulib_sharded_server), POSIX only.
+ *
+ * Wire protocol, native byte order, one request/response pair at a time per connection:
+ *   request:  uint32 number_of_samples, uint32 number_of_features, uint32 flags,
+ *             uint8 x[number_of_samples][number_of_features], with number_of_samples at most --max-request
+ *             flags & 1: also return class sums
+ *             flags & 2: return the server counters as JSON instead (number_of_samples = number_of_features = 0)
+ *   response: uint32 status (0 ok, 1 bad request), uint32 number_of_samples, uint32 number_of_classes,
+ *             int32 class[number_of_samples], and with flags & 1, int32 class_sums[number_of_samples][number_of_classes]
+ *             A failed evaluation is answered as a bad request, after which the server closes the connection.
+ *   counters: uint32 status, uint32 length, char json[length]
+ */
+
+// Where clients connect, and how much they may send
+struct TMClientServerOptions {
+    std::string socket_path;
+    int port = 0;
+    std::size_t max_request = 65536; // Samples per request, bounding what a client can make the server allocate
+    std::size_t max_connections = 64; // Clients served at once; further clients wait in the listen backlog
+
+    // Consumes --socket, --port, --max-request and --max-connections; value() returns the argument's value
+    bool parse(const std::string& arg, const std::function<std::string()>& value){
+        if (arg == "--socket") {
+            socket_path = value();
+        } else if (arg == "--port") {
+            port = std::stoi(value());
+        } else if (arg == "--max-request") {
+            max_request = std::stoul(value());
+        } else if (arg == "--max-connections") {
+            max_connections = std::max(1ul, std::stoul(value()));
+        } else {
+            return false;
+        }
+        return true;
+    }
+
+    [[nodiscard]] bool listening() const {
+        return !socket_path.empty() || port != 0;
+    }
+
+    [[nodiscard]] std::string address() const {
+        return socket_path.empty() ? "127.0.0.1:" + std::to_string(port) : socket_path;
+    }
+};
+
+struct TMServerCounters {
+    using Clock = std::chrono::steady_clock;
+
+    std::atomic<uint64_t> requests{0};
+    std::atomic<uint64_t> samples{0};
+    std::atomic<uint64_t> batches{0};
+    std::atomic<uint64_t> bad_requests{0};
+    std::atomic<uint64_t> latency_us_total{0};
+    std::atomic<uint64_t> latency_us_max{0};
+    std::atomic<uint64_t> evaluation_us_total{0};
+    const Clock::time_point started = Clock::now();
+
+    // Appended to the JSON document, e.g. "\"shards\": 4"
+    const std::string extra_fields;
+
+    explicit TMServerCounters(std::string _extra_fields = "")
+    : extra_fields(std::move(_extra_fields))
+    {}
+
+    void record_latency(uint64_t latency_us) {
+        latency_us_total += latency_us;
+        uint64_t previous = latency_us_max.load();
+        while (previous < latency_us && !latency_us_max.compare_exchange_weak(previous, latency_us)) {}
+    }
+
+    [[nodiscard]] std::string to_json() const {
+        const double uptime_s = std::chrono::duration<double>(Clock::now() - started).count();
+        const uint64_t n_requests = requests.load();
+        const uint64_t n_batches = batches.load();
+
+        std::ostringstream out;
+        out << "{\"uptime_s\": " << uptime_s
+            << ", \"requests\": " << n_requests
+            << ", \"samples\": " << samples.load()
+            << ", \"batches\": " << n_batches
+            << ", \"bad_requests\": " << bad_requests.load()
+            << ", \"mean_batch_samples\": " << (n_batches ? static_cast<double>(samples.load()) / n_batches : 0.0)
+            << ", \"mean_latency_us\": " << (n_requests ? static_cast<double>(latency_us_total.load()) / n_requests : 0.0)
+            << ", \"max_latency_us\": " << latency_us_max.load()
+            << ", \"evaluation_us\": " << evaluation_us_total.load()
+            << ", \"samples_per_s\": " << (uptime_s > 0 ? samples.load() / uptime_s : 0.0);
+        if (!extra_fields.empty()) {
+            out << ", " << extra_fields;
+        }
+        out << "}";
+        return out.str();
+    }
+};
+
+// Connection threads, shut down and joined before the state they serve from is destroyed
+class TMConnectionThreads {
+
+public:
+    TMConnectionThreads() = default;
+    TMConnectionThreads(const TMConnectionThreads&) = delete;
+    TMConnectionThreads& operator=(const TMConnectionThreads&) = delete;
+
+    ~TMConnectionThreads() {
+        close_all();
+    }
+
+    void start(int fd, std::function<void(int)> serve) {
+        std::lock_guard<std::mutex> lock(mutex);
+        join_finished();
+
+        auto connection = std::make_unique<Connection>();
+        connection->fd = fd;
+        Connection* started = connection.get();
+        connection->thread = std::thread([this, started, serve = std::move(serve)] {
+            serve(started->fd);
+            // The peer sees the end of the connection now; the descriptor is closed once the thread is joined
+            ::shutdown(started->fd, SHUT_RDWR);
+            {
+                std::lock_guard<std::mutex> finished_lock(mutex);
+                started->finished = true;
+                --active;
+            }
+            slot_freed.notify_all();
+        });
+        connections.push_back(std::move(connection));
+        ++active;
+    }
+
+    /*
+     * Waits up to timeout until fewer than max_connections connections are being served. Returns whether there is
+     * room for another one.
+     */
+    bool wait_for_slot(std::size_t max_connections, std::chrono::milliseconds timeout) {
+        std::unique_lock<std::mutex> lock(mutex);
+        return slot_freed.wait_for(lock, timeout, [&] { return active < max_connections; });
+    }
+
+    // Unblocks every connection, and waits for its thread before closing the socket
+    void close_all() {
+        std::vector<std::unique_ptr<Connection>> closing;
+        {
+            // Finishing threads take the lock, so they are joined without it
+            std::lock_guard<std::mutex> lock(mutex);
+            closing.swap(connections);
+        }
+        for (const auto& connection : closing) {
+            ::shutdown(connection->fd, SHUT_RDWR);
+        }
+        for (const auto& connection : closing) {
+            connection->thread.join();
+            ::close(connection->fd);
+        }
+    }
+
+private:
+    struct Connection {
+        int fd = -1;
+        std::thread thread;
+        bool finished = false; // Guarded by mutex
+    };
+
+    std::mutex mutex;
+    std::condition_variable slot_freed;
+    std::vector<std::unique_ptr<Connection>> connections;
+    std::size_t active = 0; // Connections whose thread has not finished serving
+
+    void join_finished() {
+        auto last = std::remove_if(connections.begin(), connections.end(), [](const auto& connection) {
+            if (!connection->finished) {
+                return false;
+            }
+            connection->thread.join();
+            ::close(connection->fd);
+            return true;
+        });
+        connections.erase(last, connections.end());
+    }
+};
+
+class TMClientServer {
+
+public:
+    static constexpr uint32_t FLAG_CLASS_SUMS = 1;
+    static constexpr uint32_t FLAG_COUNTERS = 2;
+    static constexpr uint32_t STATUS_OK = 0;
+    static constexpr uint32_t STATUS_BAD_REQUEST = 1;
+
+    /*
+     * Evaluates number_of_samples raw samples x[sample][feature] into class_sums[sample][class position] and
+     * argmax[sample], a class position.
+     */
+    using Evaluate = std::function<void(uint32_t* x, std::size_t number_of_samples, int32_t* class_sums, int32_t* argmax)>;
+
+    /*
+     * Serves the requests of one client until it disconnects. Class positions are answered as the ids in classes.
+     * When evaluate throws, the client is answered STATUS_BAD_REQUEST and the connection is closed.
+     */
+    static void serve_connection(
+            int fd,
+            std::size_t number_of_features,
+            const std::vector<uint32_t>& classes,
+            std::size_t max_request,
+            TMServerCounters& counters,
+            const Evaluate& evaluate
+    ){
+        using Clock = TMServerCounters::Clock;
+        const std::size_t number_of_classes = classes.size();
+        std::vector<uint8_t> raw;
+        std::vector<uint32_t> x;
+        std::vector<int32_t> class_sums;
+        std::vector<int32_t> argmax;
+        std::vector<int32_t> class_ids;
+
+        while (true) {
+            uint32_t header[3];
+            if (!TMSocket::read_full(fd, header, sizeof(header))) {
+                break;
+            }
+            const auto started = Clock::now();
+            const uint32_t number_of_samples = header[0];
+            const uint32_t request_features = header[1];
+            const uint32_t flags = header[2];
+
+            if (flags & FLAG_COUNTERS) {
+                const std::string json = counters.to_json();
+                const uint32_t response[2] = {STATUS_OK, static_cast<uint32_t>(json.size())};
+                if (!TMSocket::write_full(fd, response, sizeof(response))
+                    || !TMSocket::write_full(fd, json.data(), json.size())) {
+                    break;
+                }
+                continue;
+            }
+
+            if (request_features != number_of_features || number_of_samples > max_request) {
+                // The payload cannot be skipped reliably, so the connection is closed after replying
+                counters.bad_requests += 1;
+                const uint32_t response[3] = {STATUS_BAD_REQUEST, 0, static_cast<uint32_t>(number_of_classes)};
+                TMSocket::write_full(fd, response, sizeof(response));
+                break;
+            }
+
+            raw.resize(static_cast<std::size_t>(number_of_samples) * number_of_features);
+            if (!TMSocket::read_full(fd, raw.data(), raw.size())) {
+                break;
+            }
+            x.assign(raw.begin(), raw.end());
+
+            class_sums.assign(static_cast<std::size_t>(number_of_samples) * number_of_classes, 0);
+            argmax.assign(number_of_samples, 0);
+            if (number_of_samples > 0) {
+                try {
+                    evaluate(x.data(), number_of_samples, class_sums.data(), argmax.data());
+                } catch (const std::exception& e) {
+                    std::cerr << "Evaluation failed: " << e.what() << std::endl;
+                    counters.bad_requests += 1;
+                    const uint32_t response[3] = {STATUS_BAD_REQUEST, 0, static_cast<uint32_t>(number_of_classes)};
+                    TMSocket::write_full(fd, response, sizeof(response));
+                    break;
+                }
+            }
+
+            class_ids.resize(number_of_samples);
+            for (std::size_t i = 0; i < number_of_samples; ++i) {
+                class_ids[i] = static_cast<int32_t>(classes[argmax[i]]);
+            }
+
+            // Counted before answering, so a client sees its own samples in the counters
+            counters.requests += 1;
+            counters.samples += number_of_samples;
+
+            const uint32_t response[3] = {STATUS_OK, number_of_samples, static_cast<uint32_t>(number_of_classes)};
+            bool ok = TMSocket::write_full(fd, response, sizeof(response))
+                      && TMSocket::write_full(fd, class_ids.data(), class_ids.size() * sizeof(int32_t));
+            if (ok && (flags & FLAG_CLASS_SUMS)) {
+                ok = TMSocket::write_full(fd, class_sums.data(), class_sums.size() * sizeof(int32_t));
+            }
+
+            counters.record_latency(std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - started).count());
+            if (!ok) {
+                break;
+            }
+        }
+    }
+
+    /*
+     * Accepts clients until SIGINT or SIGTERM and serves each on its own thread, at most options.max_connections at
+     * once. Returns once every connection is closed and its thread joined.
+     */
+    static void run(const TMClientServerOptions& options, const std::function<void(int)>& serve){
+        listener_fd = TMSocket::listen(options.socket_path, "127.0.0.1", options.port);
+        std::signal(SIGINT, handle_signal);
+        std::signal(SIGTERM, handle_signal);
+
+        TMConnectionThreads connections;
+        while (true) {
+            const int fd = listener_fd.load();
+            if (fd < 0) {
+                break;
+            }
+            // Polled, so that a signal closing the listener is noticed while all slots are taken
+            if (!connections.wait_for_slot(options.max_connections, std::chrono::milliseconds(100))) {
+                continue;
+            }
+            const int connection = ::accept(fd, nullptr, nullptr);
+            if (connection < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                break;
+            }
+            connections.start(connection, serve);
+        }
+        connections.close_all();
+
+        if (!options.socket_path.empty()) {
+            ::unlink(options.socket_path.c_str());
+        }
+    }
+
+private:
+    static inline std::atomic<int> listener_fd{-1};
+
+    static void handle_signal(int) {
+        const int fd = listener_fd.exchange(-1);
+        if (fd >= 0) {
+            ::shutdown(fd, SHUT_RDWR);
+            ::close(fd);
+        }
+    }
+};
+
+#endif //TUMLIBPP_TM_CLIENT_SERVER_H
@@ -14,6 +14,8 @@
 #include <utility> // for std::pair
 #include <numeric> // for std::accumulate
 #include <random> // for std::random_device, std::mt19937, std::uniform_int_distribution
+#include <algorithm> // for std::shuffle
+#include <stdexcept>
 
 class TMDataset {
 
@@ -92,6 +94,151 @@ public:
         }
     }
 
+    /*
+     * The synthetic generators below are seeded, and write X flat, [sample][feature] or [sample][side][side], with
+     * its shape, as read_dataset_from_txt does. Labels are flipped to another class with probability noise.
+     */
+
+    // Two classes: the parity of the first parity_bits of num_features random features
+    static void generate_parity_dataset(
+            std::vector<uint32_t>& X,
+            std::vector<uint32_t>& y,
+            std::vector<int32_t>& X_shape,
+            int num_samples,
+            int num_features,
+            int parity_bits,
+            float noise,
+            uint32_t seed
+    ) {
+        if (parity_bits < 1 || parity_bits > num_features) {
+            throw std::invalid_argument("parity_bits must be in [1, num_features]");
+        }
+
+        std::mt19937 gen(seed);
+        std::bernoulli_distribution bit(0.5);
+        std::bernoulli_distribution flip(noise);
+
+        X.assign(static_cast<std::size_t>(num_samples) * num_features, 0);
+        y.assign(num_samples, 0);
+        X_shape = {num_samples, num_features};
+
+        for (int i = 0; i < num_samples; ++i) {
+            uint32_t* x = &X[static_cast<std::size_t>(i) * num_features];
+            uint32_t parity = 0;
+            for (int f = 0; f < num_features; ++f) {
+                x[f] = bit(gen);
+                if (f < parity_bits) {
+                    parity ^= x[f];
+                }
+            }
+            y[i] = flip(gen) ? parity ^ 1 : parity;
+        }
+    }
+
+    /*
+     * Two classes of side x side images with background pixels on with probability density: class 0 holds the
+     * 2x2 pattern [[1, 0], [0, 1]] at a random position, class 1 its XOR [[0, 1], [1, 0]]. Only a convolution
+     * finds the pattern independently of its position.
+     */
+    static void generate_xor_dataset(
+            std::vector<uint32_t>& X,
+            std::vector<uint32_t>& y,
+            std::vector<int32_t>& X_shape,
+            int num_samples,
+            int side,
+            float density,
+            float noise,
+            uint32_t seed
+    ) {
+        if (side < 2) {
+            throw std::invalid_argument("side must be at least 2");
+        }
+
+        std::mt19937 gen(seed);
+        std::bernoulli_distribution pixel(density);
+        std::bernoulli_distribution flip(noise);
+        std::uniform_int_distribution<int> position(0, side - 2);
+        std::uniform_int_distribution<uint32_t> label(0, 1);
+
+        const std::size_t image_size = static_cast<std::size_t>(side) * side;
+        X.assign(num_samples * image_size, 0);
+        y.assign(num_samples, 0);
+        X_shape = {num_samples, side, side};
+
+        for (int i = 0; i < num_samples; ++i) {
+            uint32_t* x = &X[i * image_size];
+            for (std::size_t p = 0; p < image_size; ++p) {
+                x[p] = pixel(gen);
+            }
+
+            const uint32_t c = label(gen);
+            const int row = position(gen);
+            const int col = position(gen);
+            x[row * side + col] = c == 0;
+            x[row * side + col + 1] = c == 1;
+            x[(row + 1) * side + col] = c == 1;
+            x[(row + 1) * side + col + 1] = c == 0;
+
+            y[i] = flip(gen) ? c ^ 1 : c;
+        }
+    }
+
+    /*
+     * num_classes classes, each defined by a conjunction of conjunction_size random features that are set in its
+     * samples. The other features are on with probability density, so a low density gives sparse data. Conjunctions
+     * may overlap; a sample gets the label of the class it was generated for.
+     */
+    static void generate_noisy_conjunction_dataset(
+            std::vector<uint32_t>& X,
+            std::vector<uint32_t>& y,
+            std::vector<int32_t>& X_shape,
+            int num_samples,
+            int num_features,
+            int num_classes,
+            int conjunction_size,
+            float density,
+            float noise,
+            uint32_t seed
+    ) {
+        if (num_classes < 2) {
+            throw std::invalid_argument("num_classes must be at least 2");
+        }
+        if (conjunction_size < 1 || conjunction_size > num_features) {
+            throw std::invalid_argument("conjunction_size must be in [1, num_features]");
+        }
+
+        std::mt19937 gen(seed);
+        std::bernoulli_distribution feature(density);
+        std::bernoulli_distribution flip(noise);
+        std::uniform_int_distribution<uint32_t> label(0, num_classes - 1);
+        std::uniform_int_distribution<uint32_t> other_label(1, num_classes - 1);
+
+        std::vector<std::vector<int>> conjunctions(num_classes);
+        std::vector<int> features(num_features);
+        std::iota(features.begin(), features.end(), 0);
+        for (auto& conjunction : conjunctions) {
+            std::shuffle(features.begin(), features.end(), gen);
+            conjunction.assign(features.begin(), features.begin() + conjunction_size);
+        }
+
+        X.assign(static_cast<std::size_t>(num_samples) * num_features, 0);
+        y.assign(num_samples, 0);
+        X_shape = {num_samples, num_features};
+
+        for (int i = 0; i < num_samples; ++i) {
+            uint32_t* x = &X[static_cast<std::size_t>(i) * num_features];
+            for (int f = 0; f < num_features; ++f) {
+                x[f] = feature(gen);
+            }
+
+            const uint32_t c = label(gen);
+            for (const int f : conjunctions[c]) {
+                x[f] = 1;
+            }
+            y[i] = flip(gen) ? (c + other_label(gen)) % num_classes : c;
+        }
+    }
+
 };
 
 
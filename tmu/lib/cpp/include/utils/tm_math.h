@@ -7,6 +7,7 @@
 #include <vector>
 #include <span>
 #include <algorithm>
+#include <random>
 
 class TMMath {
     public:
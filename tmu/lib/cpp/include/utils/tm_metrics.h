@@ -0,0 +1,72 @@
+#ifndef TUMLIBPP_TM_METRICS_H
+#define TUMLIBPP_TM_METRICS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/*
+ * Classification metrics over class positions [0, number_of_classes).
+ */
+struct TMClassificationMetrics {
+    std::size_t number_of_classes = 0;
+    double accuracy = 0.0;
+    double macro_f1 = 0.0;
+
+    // Per class position
+    std::vector<double> precision;
+    std::vector<double> recall;
+    std::vector<double> f1;
+    std::vector<uint32_t> support;
+
+    // [true class][predicted class]
+    std::vector<uint32_t> confusion;
+
+    static TMClassificationMetrics compute(
+            const std::vector<int>& y_true,
+            const std::vector<int>& y_pred,
+            std::size_t number_of_classes
+    ) {
+        TMClassificationMetrics metrics;
+        metrics.number_of_classes = number_of_classes;
+        metrics.confusion.assign(number_of_classes * number_of_classes, 0);
+        metrics.precision.assign(number_of_classes, 0.0);
+        metrics.recall.assign(number_of_classes, 0.0);
+        metrics.f1.assign(number_of_classes, 0.0);
+        metrics.support.assign(number_of_classes, 0);
+
+        std::size_t correct = 0;
+        for (std::size_t i = 0; i < y_true.size(); ++i) {
+            metrics.confusion[y_true[i] * number_of_classes + y_pred[i]] += 1;
+            correct += y_true[i] == y_pred[i];
+        }
+        metrics.accuracy = y_true.empty() ? 0.0 : static_cast<double>(correct) / y_true.size();
+
+        for (std::size_t c = 0; c < number_of_classes; ++c) {
+            uint32_t predicted = 0;
+            for (std::size_t t = 0; t < number_of_classes; ++t) {
+                predicted += metrics.confusion[t * number_of_classes + c];
+                metrics.support[c] += metrics.confusion[c * number_of_classes + t];
+            }
+            const uint32_t true_positives = metrics.confusion[c * number_of_classes + c];
+
+            metrics.precision[c] = predicted ? static_cast<double>(true_positives) / predicted : 0.0;
+            metrics.recall[c] = metrics.support[c] ? static_cast<double>(true_positives) / metrics.support[c] : 0.0;
+            const double sum = metrics.precision[c] + metrics.recall[c];
+            metrics.f1[c] = sum > 0.0 ? 2.0 * metrics.precision[c] * metrics.recall[c] / sum : 0.0;
+            metrics.macro_f1 += metrics.f1[c];
+        }
+        metrics.macro_f1 = number_of_classes ? metrics.macro_f1 / number_of_classes : 0.0;
+
+        return metrics;
+    }
+};
+
+struct TMEpochResult {
+    int epoch = 0;
+    double train_seconds = 0.0;
+    double predict_seconds = 0.0;
+    TMClassificationMetrics metrics;
+};
+
+#endif //TUMLIBPP_TM_METRICS_H
@@ -0,0 +1,157 @@
+#ifndef TUMLIBPP_TM_MODEL_MERGE_H
+#define TUMLIBPP_TM_MODEL_MERGE_H
+
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "tm_checkpoint.h"
+#include "tm_parallel.h"
+
+/*
+ * average: every TA gets the rounded mean of its replica states.
+ * vote:    every TA takes the include action of the majority of the replicas, with the mean state of the replicas in
+ *          the majority. Ties fall back to the mean over all replicas.
+ */
+enum class TMMergeMode {
+    average,
+    vote
+};
+
+/*
+ * Merges replicas of one model trained on different data, as data-parallel training does between rounds. TA states
+ * stay bit-sliced: state bit b of the 32 TAs of a chunk is word b, so one chunk of every replica is decoded, combined
+ * and encoded again at a time. Weights are averaged and rounded.
+ */
+class TMModelMerge {
+
+public:
+    static TMMergeMode parse_mode(const std::string& name){
+        if (name == "average") {
+            return TMMergeMode::average;
+        }
+        if (name == "vote") {
+            return TMMergeMode::vote;
+        }
+        throw std::invalid_argument("Unknown merge mode " + name + ", expected average or vote");
+    }
+
+    /*
+     * Merges number_of_chunks chunks of number_of_state_bits words each, e.g. a whole clause bank, from every replica
+     * into out. out may alias a replica.
+     */
+    static void merge_states(
+            const std::vector<const uint32_t*>& replicas,
+            uint32_t* out,
+            std::size_t number_of_chunks,
+            std::size_t number_of_state_bits,
+            TMMergeMode mode,
+            std::size_t threads = 1
+    ){
+        if (replicas.empty()) {
+            throw std::invalid_argument("Nothing to merge");
+        }
+        if (number_of_state_bits == 0 || number_of_state_bits > 24) {
+            throw std::invalid_argument("Merging needs 1 to 24 state bits");
+        }
+
+        const std::size_t n = replicas.size();
+        const std::size_t top = number_of_state_bits - 1;
+        TMParallel::for_ranges(number_of_chunks, threads, 1024, [&](std::size_t, std::size_t begin, std::size_t end) {
+            std::array<uint32_t, 32> sums{};
+            std::array<uint32_t, 32> counts{};
+            std::array<uint32_t, 32> including{};
+            for (std::size_t chunk = begin; chunk < end; ++chunk) {
+                const std::size_t offset = chunk * number_of_state_bits;
+                including.fill(0);
+                if (mode == TMMergeMode::vote) {
+                    for (const uint32_t* replica : replicas) {
+                        for (uint32_t bits = replica[offset + top]; bits; bits &= bits - 1) {
+                            including[__builtin_ctz(bits)]++;
+                        }
+                    }
+                }
+
+                // Majority per TA: include, exclude, or neither on a tie
+                uint32_t include_majority = 0;
+                uint32_t exclude_majority = 0;
+                if (mode == TMMergeMode::vote) {
+                    for (std::size_t lane = 0; lane < 32; ++lane) {
+                        include_majority |= uint32_t(2 * including[lane] > n) << lane;
+                        exclude_majority |= uint32_t(2 * including[lane] < n) << lane;
+                    }
+                }
+
+                sums.fill(0);
+                counts.fill(0);
+                for (const uint32_t* replica : replicas) {
+                    // Lanes where this replica counts towards the mean
+                    const uint32_t included = replica[offset + top];
+                    const uint32_t lanes = mode == TMMergeMode::average
+                            ? ~uint32_t(0)
+                            : (included & include_majority) | (~included & exclude_majority)
+                              | ~(include_majority | exclude_majority);
+                    for (std::size_t b = 0; b < number_of_state_bits; ++b) {
+                        for (uint32_t bits = replica[offset + b] & lanes; bits; bits &= bits - 1) {
+                            sums[__builtin_ctz(bits)] += uint32_t(1) << b;
+                        }
+                    }
+                    for (uint32_t bits = lanes; bits; bits &= bits - 1) {
+                        counts[__builtin_ctz(bits)]++;
+                    }
+                }
+
+                std::array<uint32_t, 32> states{};
+                for (std::size_t lane = 0; lane < 32; ++lane) {
+                    states[lane] = (sums[lane] + counts[lane] / 2) / counts[lane];
+                }
+                for (std::size_t b = 0; b < number_of_state_bits; ++b) {
+                    uint32_t word = 0;
+                    for (std::size_t lane = 0; lane < 32; ++lane) {
+                        word |= ((states[lane] >> b) & 1) << lane;
+                    }
+                    out[offset + b] = word;
+                }
+            }
+        });
+    }
+
+    static TMCheckpoint merge(const std::vector<TMCheckpoint>& replicas, TMMergeMode mode, std::size_t threads = 1){
+        if (replicas.empty()) {
+            throw std::invalid_argument("Nothing to merge");
+        }
+
+        const TMCheckpoint& first = replicas.front();
+        for (const auto& replica : replicas) {
+            if (replica.classes != first.classes
+                || replica.number_of_clauses != first.number_of_clauses
+                || replica.number_of_literals != first.number_of_literals
+                || replica.number_of_state_bits != first.number_of_state_bits
+                || replica.number_of_patches != first.number_of_patches) {
+                throw std::invalid_argument("Replicas must share classes and clause bank geometry");
+            }
+        }
+
+        TMCheckpoint merged = first;
+        std::vector<const uint32_t*> states;
+        for (const auto& replica : replicas) {
+            states.push_back(replica.clause_banks.data());
+        }
+        merge_states(states, merged.clause_banks.data(), merged.clause_banks.size() / merged.number_of_state_bits,
+                     merged.number_of_state_bits, mode, threads);
+
+        for (std::size_t i = 0; i < merged.weights.size(); ++i) {
+            int64_t sum = 0;
+            for (const auto& replica : replicas) {
+                sum += replica.weights[i];
+            }
+            merged.weights[i] = static_cast<int32_t>(std::lround(static_cast<double>(sum) / replicas.size()));
+        }
+        return merged;
+    }
+};
+
+#endif //TUMLIBPP_TM_MODEL_MERGE_H
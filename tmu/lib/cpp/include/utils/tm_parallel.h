@@ -0,0 +1,98 @@
+#ifndef TUMLIBPP_TM_PARALLEL_H
+#define TUMLIBPP_TM_PARALLEL_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <thread>
+#include <vector>
+#include "tm_instrumentation.h"
+
+extern "C" {
+    #include "fast_rand_seed.h"
+}
+
+class TMParallel {
+
+public:
+    // 0 means one thread per hardware thread
+    static std::size_t resolve_threads(std::size_t threads){
+#ifdef TMU_SINGLE_THREADED
+        (void)threads;
+        return 1;
+#else
+        return threads ? threads : std::max(1u, std::thread::hardware_concurrency());
+#endif
+    }
+
+    /*
+     * Splits [0, n) into contiguous ranges of at least min_chunk items, at most one per thread, and calls
+     * fn(worker, begin, end) for each. Worker 0 runs on the calling thread. Returns the number of workers used, so
+     * callers can size per-worker buffers up front with workers(). An exception in any worker is rethrown.
+     */
+    template<class Function>
+    static std::size_t for_ranges(std::size_t n, std::size_t threads, std::size_t min_chunk, Function&& fn){
+        const std::size_t count = workers(n, threads, min_chunk);
+        if (count <= 1) {
+            fn(std::size_t(0), std::size_t(0), n);
+            return count;
+        }
+
+        const std::size_t chunk = (n + count - 1) / count;
+        std::vector<std::exception_ptr> errors(count);
+        std::vector<std::thread> pool;
+        pool.reserve(count - 1);
+        for (std::size_t w = 1; w < count; ++w) {
+            pool.emplace_back([&, w] {
+                try {
+                    fn(w, std::min(n, w * chunk), std::min(n, (w + 1) * chunk));
+                } catch (...) {
+                    errors[w] = std::current_exception();
+                }
+                TMInstrumentation::flush_thread();
+            });
+        }
+        try {
+            fn(std::size_t(0), std::size_t(0), std::min(n, chunk));
+        } catch (...) {
+            errors[0] = std::current_exception();
+        }
+        for (auto& thread : pool) {
+            thread.join();
+        }
+        for (const auto& error : errors) {
+            if (error) {
+                std::rethrow_exception(error);
+            }
+        }
+        return count;
+    }
+
+    // The number of workers for_ranges() will use
+    static std::size_t workers(std::size_t n, std::size_t threads, std::size_t min_chunk){
+        const std::size_t by_size = std::max<std::size_t>(1, n / std::max<std::size_t>(1, min_chunk));
+        return std::max<std::size_t>(1, std::min(resolve_threads(threads), by_size));
+    }
+
+    /*
+     * Gives the calling thread its own generator stream while in scope, for workers that run kernels concurrently.
+     * Other threads keep drawing from the shared state set by pcg32_seed.
+     */
+    class RandomStream {
+
+    public:
+        explicit RandomStream(uint64_t seed){
+            pcg32_seed_thread(seed);
+        }
+
+        ~RandomStream(){
+            pcg32_share_thread();
+        }
+
+        RandomStream(const RandomStream&) = delete;
+        RandomStream& operator=(const RandomStream&) = delete;
+    };
+};
+
+#endif //TUMLIBPP_TM_PARALLEL_H
@@ -0,0 +1,186 @@
+#ifndef TUMLIBPP_TM_SOCKET_H
+#define TUMLIBPP_TM_SOCKET_H
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+/*
+ * Blocking stream sockets for the multi-process tools (POSIX only): a Unix domain socket when a path is given, TCP
+ * otherwise. Messages are frames of uint32 kind, uint64 size and size payload bytes, in native byte order.
+ */
+class TMSocket {
+
+public:
+    // Default bound on the payload a peer may announce in a frame header
+    static constexpr uint64_t MAX_FRAME_SIZE = uint64_t(1) << 30;
+
+    static bool read_full(int fd, void* buffer, std::size_t size){
+        auto* bytes = static_cast<char*>(buffer);
+        while (size > 0) {
+            const ssize_t n = ::read(fd, bytes, size);
+            if (n <= 0) {
+                if (n < 0 && errno == EINTR) {
+                    continue;
+                }
+                return false;
+            }
+            bytes += n;
+            size -= static_cast<std::size_t>(n);
+        }
+        return true;
+    }
+
+    static bool write_full(int fd, const void* buffer, std::size_t size){
+        const auto* bytes = static_cast<const char*>(buffer);
+        while (size > 0) {
+            const ssize_t n = ::send(fd, bytes, size, MSG_NOSIGNAL);
+            if (n <= 0) {
+                if (n < 0 && errno == EINTR) {
+                    continue;
+                }
+                return false;
+            }
+            bytes += n;
+            size -= static_cast<std::size_t>(n);
+        }
+        return true;
+    }
+
+    static bool send_frame(int fd, uint32_t kind, const void* payload, uint64_t size){
+        const uint32_t header_kind = kind;
+        return write_full(fd, &header_kind, sizeof(header_kind))
+               && write_full(fd, &size, sizeof(size))
+               && write_full(fd, payload, size);
+    }
+
+    static bool send_frame(int fd, uint32_t kind, const std::string& payload){
+        return send_frame(fd, kind, payload.data(), payload.size());
+    }
+
+    // False when the peer closed the connection. Frames larger than max_size are refused before any allocation.
+    static bool receive_frame(int fd, uint32_t& kind, std::string& payload, uint64_t max_size = MAX_FRAME_SIZE){
+        uint64_t size = 0;
+        if (!read_full(fd, &kind, sizeof(kind)) || !read_full(fd, &size, sizeof(size))) {
+            return false;
+        }
+        if (size > max_size) {
+            throw std::runtime_error("Frame of " + std::to_string(size) + " bytes exceeds the limit of "
+                                     + std::to_string(max_size));
+        }
+        payload.resize(size);
+        return read_full(fd, payload.data(), size);
+    }
+
+    // Waits up to timeout_ms for a connection; -1 when none arrived
+    static int accept(int listener, int timeout_ms){
+        pollfd request{listener, POLLIN, 0};
+        const int ready = ::poll(&request, 1, timeout_ms);
+        if (ready < 0 && errno != EINTR) {
+            throw std::runtime_error(std::string("Could not wait for a connection: ") + std::strerror(errno));
+        }
+        if (ready <= 0) {
+            return -1;
+        }
+        const int fd = ::accept(listener, nullptr, nullptr);
+        if (fd < 0 && errno != EINTR && errno != EAGAIN && errno != ECONNABORTED) {
+            throw std::runtime_error(std::string("Could not accept a connection: ") + std::strerror(errno));
+        }
+        return fd;
+    }
+
+    // Makes reads on fd fail after seconds without data, or block again with 0
+    static void set_receive_timeout(int fd, double seconds){
+        timeval timeout{};
+        timeout.tv_sec = static_cast<time_t>(seconds);
+        timeout.tv_usec = static_cast<suseconds_t>((seconds - static_cast<double>(timeout.tv_sec)) * 1e6);
+        ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    }
+
+    // Listens on socket_path, or on host:port when socket_path is empty
+    static int listen(const std::string& socket_path, const std::string& host, int port, int backlog = 128){
+        int fd;
+        if (!socket_path.empty()) {
+            sockaddr_un address = unix_address(socket_path);
+            fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+            ::unlink(socket_path.c_str());
+            if (fd < 0 || ::bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+                throw std::runtime_error("Could not bind " + socket_path + ": " + std::strerror(errno));
+            }
+        } else {
+            sockaddr_in address = inet_address(host, port);
+            fd = ::socket(AF_INET, SOCK_STREAM, 0);
+            const int reuse = 1;
+            ::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+            if (fd < 0 || ::bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+                throw std::runtime_error("Could not bind " + host + ":" + std::to_string(port) + ": " + std::strerror(errno));
+            }
+        }
+
+        if (::listen(fd, backlog) != 0) {
+            throw std::runtime_error(std::string("Could not listen: ") + std::strerror(errno));
+        }
+        return fd;
+    }
+
+    // Connects to socket_path, or to host:port when socket_path is empty, retrying until the peer listens
+    static int connect(const std::string& socket_path, const std::string& host, int port, int attempts = 100){
+        for (int attempt = 0; attempt < attempts; ++attempt) {
+            int fd;
+            int result;
+            if (!socket_path.empty()) {
+                sockaddr_un address = unix_address(socket_path);
+                fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+                result = ::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address));
+            } else {
+                sockaddr_in address = inet_address(host, port);
+                fd = ::socket(AF_INET, SOCK_STREAM, 0);
+                result = ::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address));
+                const int no_delay = 1;
+                ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &no_delay, sizeof(no_delay));
+            }
+            if (result == 0) {
+                return fd;
+            }
+            ::close(fd);
+            ::usleep(50000);
+        }
+        throw std::runtime_error("Could not connect to "
+                                 + (socket_path.empty() ? host + ":" + std::to_string(port) : socket_path)
+                                 + ": " + std::strerror(errno));
+    }
+
+private:
+    static sockaddr_un unix_address(const std::string& socket_path){
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+        if (socket_path.size() >= sizeof(address.sun_path)) {
+            throw std::runtime_error("Socket path too long: " + socket_path);
+        }
+        std::strncpy(address.sun_path, socket_path.c_str(), sizeof(address.sun_path) - 1);
+        return address;
+    }
+
+    static sockaddr_in inet_address(const std::string& host, int port){
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_port = htons(static_cast<uint16_t>(port));
+        if (::inet_pton(AF_INET, host.c_str(), &address.sin_addr) != 1) {
+            throw std::invalid_argument("Not an IPv4 address: " + host);
+        }
+        return address;
+    }
+};
+
+#endif //TUMLIBPP_TM_SOCKET_H
@@ -10,48 +10,6 @@ static_assert(sizeof(uint32_t) == sizeof(unsigned int), "uint32_t is not the sam
 static_assert(std::is_unsigned<uint32_t>::value, "uint32_t is not unsigned");
 
 
-void perform_epoch(
-        TMVanillaClassifier<uint32_t>& classifier,
-        int epoch,
-        const tcb::span<uint32_t>& y_train_span,
-        const tcb::span<uint32_t>& x_train_span,
-        const std::vector<int32_t>& x_train_shape,
-        const tcb::span<uint32_t>& x_test_span,
-        const std::vector<int32_t>& x_test_shape,
-        const tcb::span<uint32_t>& y_test_span
-) {
-    auto timer_train_start = std::chrono::high_resolution_clock::now();
-    classifier.fit(
-            y_train_span,
-            x_train_span,
-            x_train_shape,
-            true
-    );
-    auto timer_train_end = std::chrono::high_resolution_clock::now();
-
-    auto timer_pred_start = std::chrono::high_resolution_clock::now();
-    auto predict_result= classifier.predict(x_test_span, x_test_shape);
-    auto y_pred = std::get<0>(predict_result);
-    auto y_pred_shape = std::get<1>(predict_result);
-
-    std::vector<int> results(y_pred.size());
-    std::transform(y_pred.begin(), y_pred.end(), y_test_span.begin(), results.begin(),
-                   [](int pred, int actual) -> int { return pred == actual ? 1 : 0; });
-
-    int correct = std::accumulate(results.begin(), results.end(), 0);
-
-    double accuracy = static_cast<double>(correct) / static_cast<double>(y_test_span.size()) * 100.0;
-    auto timer_pred_end = std::chrono::high_resolution_clock::now();
-
-    std::chrono::duration<double, std::milli> elapsed_train = timer_train_end - timer_train_start;
-    std::chrono::duration<double, std::milli> elapsed_pred = timer_pred_end - timer_pred_start;
-
-    std::cout << "Epoch: " << epoch << " | Accuracy: " << accuracy << "% | "
-              << "Training Time: " << elapsed_train.count() / 1000 << "s | "
-              << "Prediction Time: " << elapsed_pred.count() / 1000 << "s\n";
-}
-
-
 // Function to perform the training and testing of the TMVanillaClassifier
 void train_and_test_classifier() {
     // Initialize the TMVanillaClassifier with predefined parameters
@@ -103,21 +61,19 @@ void train_and_test_classifier() {
 
 
     // Training and Testing loop
-    for (int epoch = 0; epoch < NUM_EPOCHS; ++epoch) {
-        perform_epoch(
-                classifier,
-                epoch,
-                y_train_span,
-                x_train_span,
-                x_train_shape,
-                x_test_span,
-                x_test_shape,
-                y_test_span
-        );
-    }
+    classifier.fit_epochs(
+            y_train_span,
+            x_train_span,
+            x_train_shape,
+            y_test_span,
+            x_test_span,
+            x_test_shape,
+            NUM_EPOCHS,
+            true,
+            true
+    );
 }
 
-
 int main() {
     try {
         train_and_test_classifier();
@@ -14,11 +14,20 @@
 #include <nanobind/stl/string.h>
 
 #include <iostream>
+#include <memory>
 
 #include "tm_memory.h"
 #include "tm_clause_dense.h"
 #include "tm_weight_bank.h"
 #include "models/classifiers/tm_vanilla.h"
+#include "models/classifiers/tm_coalesced.h"
+#include "models/classifiers/tm_cascade.h"
+#include "models/classifiers/tm_multioutput.h"
+#include "models/classifiers/tm_multitask.h"
+#include "models/regressors/tm_vanilla_regressor.h"
+#include "models/autoencoders/tm_autoencoder.h"
+#include "tm_attention.h"
+#include "tm_instrumentation.h"
 #include "utils/sparse_clause_container.h"
 #include <tl/optional.hpp>
 
@@ -118,6 +127,130 @@ nb::class_<SparseClauseContainer<T>>& bind_sparse_container(const char *name, nb
             .def("populate", &SparseClauseContainer<T>::populate);
 }
 
+// Moves a vector into a NumPy array that owns it
+template <typename T>
+nb::ndarray<nb::numpy, T> to_numpy(std::vector<T>&& values, std::initializer_list<std::size_t> shape){
+    auto* owned = new std::vector<T>(std::move(values));
+    nb::capsule owner(owned, [](void* p) noexcept { delete static_cast<std::vector<T>*>(p); });
+    return nb::ndarray<nb::numpy, T>(owned->data(), shape, owner);
+}
+
+// Copies the per-literal telemetry of a clause bank into NumPy arrays
+nb::dict literal_telemetry_dict(const TMLiteralTelemetry& telemetry){
+    const std::size_t n = telemetry.number_of_literals();
+    const auto copy = [n](auto values) {
+        using Value = std::remove_const_t<typename decltype(values)::element_type>;
+        return to_numpy(std::vector<Value>(values.begin(), values.end()), {n});
+    };
+
+    std::vector<uint64_t> epoch_include(n);
+    std::vector<uint64_t> epoch_exclude(n);
+    telemetry.epoch_flips(epoch_include.data(), epoch_exclude.data());
+
+    nb::dict out;
+    out["clauses_including"] = copy(telemetry.literal_clause_count());
+    out["include_flips"] = copy(telemetry.total_include_flips());
+    out["exclude_flips"] = copy(telemetry.total_exclude_flips());
+    out["last_epoch_include_flips"] = copy(telemetry.last_epoch_include_flips());
+    out["last_epoch_exclude_flips"] = copy(telemetry.last_epoch_exclude_flips());
+    out["epoch_include_flips"] = to_numpy(std::move(epoch_include), {n});
+    out["epoch_exclude_flips"] = to_numpy(std::move(epoch_exclude), {n});
+    out["epochs"] = telemetry.epochs();
+    return out;
+}
+
+/*
+ * Clause activations either bit-packed as [samples, banks, words] uint64 arrays or as CSR rows of firing clauses per
+ * sample. Sparse firings carry weight_columns weights each, which weight(bank, clause, out) writes.
+ */
+template<typename WeightFunction>
+nb::dict clause_activations_dict(TMClauseActivations&& activations, bool sparse, std::size_t weight_columns,
+                                 WeightFunction&& weight, std::size_t threads){
+    nb::dict out;
+    out["number_of_clauses"] = activations.number_of_clauses;
+    if (!sparse) {
+        const std::size_t n_samples = activations.number_of_samples;
+        const std::size_t n_banks = activations.number_of_banks;
+        const std::size_t n_words = activations.words_per_bank;
+        out["bits"] = to_numpy(std::move(activations.bits), {n_samples, n_banks, n_words});
+        return out;
+    }
+
+    std::vector<uint64_t> offsets;
+    std::vector<uint32_t> banks;
+    std::vector<uint32_t> clauses;
+    std::vector<int32_t> weights;
+    {
+        nb::gil_scoped_release release;
+        activations.to_sparse(offsets, banks, clauses, threads);
+        weights.resize(clauses.size() * weight_columns);
+        for (std::size_t i = 0; i < clauses.size(); ++i) {
+            weight(banks[i], clauses[i], &weights[i * weight_columns]);
+        }
+    }
+
+    const std::size_t n_offsets = offsets.size();
+    const std::size_t n_firings = clauses.size();
+    out["offsets"] = to_numpy(std::move(offsets), {n_offsets});
+    out["banks"] = to_numpy(std::move(banks), {n_firings});
+    out["clauses"] = to_numpy(std::move(clauses), {n_firings});
+    out["weights"] = weight_columns == 1
+            ? to_numpy(std::move(weights), {n_firings})
+            : to_numpy(std::move(weights), {n_firings, weight_columns});
+    return out;
+}
+
+// Heatmaps as [samples, classes, patch rows, patch columns], in the patch grid of the clause bank
+nb::dict patch_heatmaps_dict(TMPatchHeatmaps&& heatmaps, const TMClauseBankDense<uint32_t>& clause_bank){
+    const std::size_t patches_x = std::get<0>(clause_bank.dim) - std::get<0>(clause_bank.patch_dim) + 1;
+    const std::size_t patches_y = std::get<1>(clause_bank.dim) - std::get<1>(clause_bank.patch_dim) + 1;
+    const std::size_t n_samples = heatmaps.number_of_samples;
+    const std::size_t n_classes = heatmaps.number_of_classes;
+
+    nb::dict out;
+    out["heatmaps"] = to_numpy(std::move(heatmaps.values), {n_samples, n_classes, patches_y, patches_x});
+    return out;
+}
+
+// Patch matches as [samples, banks, clauses, words] uint64 arrays, patch p being bit p % 64 of word p / 64
+nb::dict patch_activations_dict(TMPatchActivations&& activations, const TMClauseBankDense<uint32_t>& clause_bank){
+    const std::size_t n_samples = activations.number_of_samples;
+    const std::size_t n_banks = activations.number_of_banks;
+    const std::size_t n_clauses = activations.number_of_clauses;
+    const std::size_t n_words = activations.words_per_clause;
+
+    nb::dict out;
+    out["number_of_patches"] = activations.number_of_patches;
+    out["patches_x"] = std::get<0>(clause_bank.dim) - std::get<0>(clause_bank.patch_dim) + 1;
+    out["patches_y"] = std::get<1>(clause_bank.dim) - std::get<1>(clause_bank.patch_dim) + 1;
+    out["bits"] = to_numpy(std::move(activations.bits), {n_samples, n_banks, n_clauses, n_words});
+    return out;
+}
+
+// Per class and clause counts and ratios as [classes, clauses] arrays
+nb::dict clause_statistics_dict(TMClauseStatistics&& statistics){
+    const std::size_t n_classes = statistics.number_of_classes;
+    const std::size_t n_clauses = statistics.number_of_clauses;
+
+    nb::dict out;
+    out["precision"] = to_numpy(statistics.precision(), {n_classes, n_clauses});
+    out["recall"] = to_numpy(statistics.recall(), {n_classes, n_clauses});
+    out["true_positives"] = to_numpy(std::move(statistics.true_positives), {n_classes, n_clauses});
+    out["false_positives"] = to_numpy(std::move(statistics.false_positives), {n_classes, n_clauses});
+    out["positive_polarity"] = to_numpy(std::move(statistics.positive_polarity), {n_classes, n_clauses});
+    out["class_samples"] = to_numpy(std::move(statistics.class_samples), {n_classes});
+    return out;
+}
+
+// The shape of an ndarray, as the models take it
+template <typename... Ts>
+std::vector<int32_t> shape_of(const nb::ndarray<Ts...>& array){
+    std::vector<int32_t> shape(array.ndim());
+    for (std::size_t i = 0; i < array.ndim(); ++i) {
+        shape[i] = static_cast<int32_t>(array.shape(i));
+    }
+    return shape;
+}
 
 
 NB_MODULE(tmulibpy, m) {
@@ -136,6 +269,40 @@ NB_MODULE(tmulibpy, m) {
         .def("push_back", &TMMemory<uint32_t>::push_back)
     ;
 
+    m.attr("instrumentation_enabled") = TMInstrumentation::enabled;
+    m.def("instrumentation_reset", &TMInstrumentation::reset);
+    m.def("instrumentation_enable_hardware_counters", &TMInstrumentation::enable_hardware_counters, "enable"_a = true);
+    m.def("instrumentation_snapshot", []() {
+        const auto snapshot = TMInstrumentation::snapshot();
+
+        nb::dict phases;
+        for (std::size_t p = 0; p < TMInstrumentation::number_of_phases; ++p) {
+            const auto& stats = snapshot.phases[p];
+            nb::dict phase;
+            phase["calls"] = stats.calls;
+            phase["ns"] = stats.ns;
+            if (snapshot.hardware_counters) {
+                for (std::size_t c = 0; c < TMInstrumentation::number_of_hardware_counters; ++c) {
+                    phase[TMInstrumentation::hardware_counter_name(static_cast<TMHardwareCounter>(c))] = stats.hardware[c];
+                }
+            }
+            phases[TMInstrumentation::phase_name(static_cast<TMPhase>(p))] = phase;
+        }
+
+        nb::dict counters;
+        const auto* values = reinterpret_cast<const uint64_t*>(&snapshot.counters);
+        for (std::size_t c = 0; c < TMInstrumentation::number_of_counters; ++c) {
+            counters[TMInstrumentation::counter_name(c)] = values[c];
+        }
+
+        nb::dict out;
+        out["enabled"] = snapshot.enabled;
+        out["hardware_counters"] = snapshot.hardware_counters;
+        out["phases"] = phases;
+        out["counters"] = counters;
+        return out;
+    });
+
     nb::class_<TMVanillaClassifier<uint32_t>>(m, "TMVanillaClassifier")
         .def(nb::init<
             int,
@@ -156,7 +323,8 @@ NB_MODULE(tmulibpy, m) {
             int32_t,
             int32_t,
             bool,
-            int
+            int,
+            bool
         >(),
             "T"_a,
             "s"_a,
@@ -176,7 +344,8 @@ NB_MODULE(tmulibpy, m) {
             "number_of_state_bits_ind"_a,
             "batch_size"_a,
             "incremental"_a,
-            "seed"_a
+            "seed"_a,
+            "dense_storage"_a = false
         )
         .def_ro("memory", &TMVanillaClassifier<uint32_t>::memory)
         .def("get_required_memory_size", &TMVanillaClassifier<uint32_t>::get_required_memory_size)
@@ -185,9 +354,9 @@ NB_MODULE(tmulibpy, m) {
             self.init_after();
         })
         .def("initialize", &TMVanillaClassifier<uint32_t>::initialize)
-        .def("init", [](TMVanillaClassifier<uint32_t>& self, nb::ndarray<uint32_t>& X, nb::ndarray<uint32_t>& Y){
+        .def("init", [](TMVanillaClassifier<uint32_t>& self, nb::ndarray<uint32_t, c_contig>& X, nb::ndarray<uint32_t, c_contig>& Y){
 
-            std::vector<int> X_shape = {static_cast<int>(X.shape(0)), static_cast<int>(X.shape(1))};
+            std::vector<int> X_shape = shape_of(X);
             auto x = tcb::span(X.data(), X.size());
             auto y = tcb::span(Y.data(), Y.size());
 
@@ -242,37 +411,56 @@ NB_MODULE(tmulibpy, m) {
         )
         .def("predict", [](
                 TMVanillaClassifier<uint32_t>& self,
-                nanobind::ndarray<uint32_t, nb::ndim<2>, c_contig>& x_test,
+                nanobind::ndarray<uint32_t, c_contig>& x_test,
                 bool clip_class_sum = false,
-                bool return_class_sum = false) {
+                bool return_class_sum = false,
+                bool use_branch_and_bound = false) {
 
+            // 3D and 4D inputs are kept as is, for convolution with patch_dim
             const auto x_test_span = tcb::span(x_test.data(), x_test.size());
-            const std::vector<int> X_shape = {
-                    static_cast<int>(x_test.shape(0)),
-                    static_cast<int>(x_test.shape(1))
-            };
+            const std::vector<int> X_shape = shape_of(x_test);
+            const std::size_t num_items = x_test.shape(0);
+            const std::size_t num_classes = self.weight_banks.size();
+
+            // The results are written straight into buffers that the returned arrays take ownership of
+            auto* argmax = new std::vector<int32_t>(num_items);
+            nb::capsule argmax_owner(argmax, [](void* p) noexcept { delete static_cast<std::vector<int32_t>*>(p); });
+            auto class_sums = return_class_sum ? std::make_unique<std::vector<int32_t>>(num_items * num_classes) : nullptr;
+
+            {
+                nb::gil_scoped_release release;
+                self.predict_batch(
+                        x_test_span,
+                        X_shape,
+                        clip_class_sum,
+                        argmax->data(),
+                        class_sums ? class_sums->data() : nullptr,
+                        use_branch_and_bound
+                );
+            }
 
-            auto [argmax, class_sums] = self.predict(
-                    x_test_span,
-                    X_shape,
-                    clip_class_sum,
-                    return_class_sum
-            );
+            auto argmax_array = nb::ndarray<nb::numpy, int32_t, nb::ndim<1>>(argmax->data(), {num_items}, argmax_owner);
+            if (!class_sums) {
+                return nb::make_tuple(argmax_array, nb::none());
+            }
 
-            // TODO return class sums
-            return std::make_tuple(argmax, argmax);
+            auto* class_sums_data = class_sums->data();
+            nb::capsule class_sums_owner(class_sums.release(), [](void* p) noexcept { delete static_cast<std::vector<int32_t>*>(p); });
+            auto class_sums_array = nb::ndarray<nb::numpy, int32_t, nb::ndim<2>, nb::c_contig>(
+                    class_sums_data, {num_items, num_classes}, class_sums_owner);
+            return nb::make_tuple(argmax_array, class_sums_array);
         },
         "x"_a,
         "clip_class_sum"_a = true,
         "return_class_sum"_a = false,
-         nb::rv_policy::take_ownership)
+        "use_branch_and_bound"_a = false)
 
 
 
             .def("fit",
         [](
                 TMVanillaClassifier<uint32_t>& self,
-                nanobind::ndarray<uint32_t, nb::ndim<2>, c_contig>& x,
+                nanobind::ndarray<uint32_t, c_contig>& x,
                 nanobind::ndarray<uint32_t, nb::ndim<1>, c_contig>& y,
                 bool shuffle,
                 std::vector<std::string>& metrics
@@ -281,10 +469,7 @@ NB_MODULE(tmulibpy, m) {
             const auto y_span = tcb::span(y.data(), y.size());
             const auto x_train_span = tcb::span(x.data(), x.size());
 
-            const std::vector<int> X_shape = {
-                    static_cast<int>(x.shape(0)),
-                    static_cast<int>(x.shape(1))
-            };
+            const std::vector<int> X_shape = shape_of(x);
             self.fit(
                     y_span,
                     x_train_span,
@@ -301,6 +486,70 @@ NB_MODULE(tmulibpy, m) {
          nb::call_guard<nb::gil_scoped_release>()
         )
 
+        .def("fit_epochs", [](
+                TMVanillaClassifier<uint32_t>& self,
+                nanobind::ndarray<uint32_t, nb::ndim<2>, c_contig>& x,
+                nanobind::ndarray<uint32_t, nb::ndim<1>, c_contig>& y,
+                nanobind::ndarray<uint32_t, nb::ndim<2>, c_contig>& x_val,
+                nanobind::ndarray<uint32_t, nb::ndim<1>, c_contig>& y_val,
+                int epochs,
+                bool shuffle
+        ) {
+            const std::vector<int> X_shape = {static_cast<int>(x.shape(0)), static_cast<int>(x.shape(1))};
+            const std::vector<int> X_val_shape = {static_cast<int>(x_val.shape(0)), static_cast<int>(x_val.shape(1))};
+
+            std::vector<TMEpochResult> results;
+            {
+                nb::gil_scoped_release release;
+                results = self.fit_epochs(
+                        tcb::span(y.data(), y.size()),
+                        tcb::span(x.data(), x.size()),
+                        X_shape,
+                        tcb::span(y_val.data(), y_val.size()),
+                        tcb::span(x_val.data(), x_val.size()),
+                        X_val_shape,
+                        epochs,
+                        shuffle
+                );
+            }
+
+            // Per epoch series, and [epoch][class position] matrices
+            const std::size_t n_epochs = results.size();
+            const std::size_t n_classes = self.weight_banks.size();
+            std::vector<double> train_time, predict_time, accuracy, macro_f1, precision, recall, f1;
+            std::vector<uint32_t> confusion;
+            for (const auto& result : results) {
+                train_time.push_back(result.train_seconds);
+                predict_time.push_back(result.predict_seconds);
+                accuracy.push_back(result.metrics.accuracy);
+                macro_f1.push_back(result.metrics.macro_f1);
+                precision.insert(precision.end(), result.metrics.precision.begin(), result.metrics.precision.end());
+                recall.insert(recall.end(), result.metrics.recall.begin(), result.metrics.recall.end());
+                f1.insert(f1.end(), result.metrics.f1.begin(), result.metrics.f1.end());
+                confusion.insert(confusion.end(), result.metrics.confusion.begin(), result.metrics.confusion.end());
+            }
+            std::vector<uint32_t> support = n_epochs ? results.back().metrics.support : std::vector<uint32_t>(n_classes, 0);
+
+            nb::dict out;
+            out["classes"] = self.weight_banks.get_classes();
+            out["train_time"] = to_numpy(std::move(train_time), {n_epochs});
+            out["predict_time"] = to_numpy(std::move(predict_time), {n_epochs});
+            out["accuracy"] = to_numpy(std::move(accuracy), {n_epochs});
+            out["macro_f1"] = to_numpy(std::move(macro_f1), {n_epochs});
+            out["precision"] = to_numpy(std::move(precision), {n_epochs, n_classes});
+            out["recall"] = to_numpy(std::move(recall), {n_epochs, n_classes});
+            out["f1"] = to_numpy(std::move(f1), {n_epochs, n_classes});
+            out["confusion"] = to_numpy(std::move(confusion), {n_epochs, n_classes, n_classes});
+            out["support"] = to_numpy(std::move(support), {n_classes});
+            return out;
+        },
+        "x"_a,
+        "y"_a,
+        "x_val"_a,
+        "y_val"_a,
+        "epochs"_a,
+        "shuffle"_a = true)
+
         .def("predict_compute_class_sums", [](
                 TMVanillaClassifier<uint32_t>& self,
                 nanobind::ndarray<uint32_t, nb::ndim<2>, c_contig>& encoded_X_test,
@@ -321,6 +570,39 @@ NB_MODULE(tmulibpy, m) {
 
         }, "encoded_X_test"_a, "ith_sample"_a, "clip_class_sum"_a)
 
+        .def("predict_anytime", [](
+                TMVanillaClassifier<uint32_t>& self,
+                nanobind::ndarray<uint32_t, nb::ndim<2>, c_contig>& x_test,
+                bool clip_class_sum,
+                tl::optional<std::size_t> clause_budget,
+                tl::optional<double> time_budget_us) {
+
+            const auto x_test_span = tcb::span(x_test.data(), x_test.size());
+            const std::vector<int> X_shape = {
+                    static_cast<int>(x_test.shape(0)),
+                    static_cast<int>(x_test.shape(1))
+            };
+
+            auto result = self.predict_anytime(
+                    x_test_span,
+                    X_shape,
+                    clip_class_sum,
+                    clause_budget,
+                    time_budget_us
+            );
+
+            return std::make_tuple(
+                    std::move(result.argmax),
+                    std::move(result.margin),
+                    std::move(result.evaluated_clauses),
+                    std::move(result.exact)
+            );
+        },
+        "x"_a,
+        "clip_class_sum"_a = false,
+        "clause_budget"_a = nb::none(),
+        "time_budget_us"_a = nb::none())
+
         .def_prop_ro("positive_clauses", [](TMVanillaClassifier<uint32_t>& self) {
             return nb::ndarray<nb::numpy, uint32_t>(
                     self.positive_clauses.data(),
@@ -339,20 +621,943 @@ NB_MODULE(tmulibpy, m) {
         .def_prop_ro("weight_banks", [](TMVanillaClassifier<uint32_t>& self) {
             return &self.weight_banks;
         }, nb::rv_policy::reference)
+        .def_rw("clause_drop_p", &TMVanillaClassifier<uint32_t>::clause_drop_p)
+        .def_rw("literal_drop_p", &TMVanillaClassifier<uint32_t>::literal_drop_p)
+        .def_rw("feature_negation", &TMVanillaClassifier<uint32_t>::feature_negation)
+        .def("save_checkpoint", &TMVanillaClassifier<uint32_t>::save_checkpoint, "file_path"_a)
+        .def("enable_literal_telemetry", &TMVanillaClassifier<uint32_t>::enable_literal_telemetry)
+        .def("literal_telemetry", [](TMVanillaClassifier<uint32_t>& self) {
+            if (!self._is_initialized) {
+                throw std::runtime_error("The model is not initialized");
+            }
+            const auto& classes = self.weight_banks.get_classes();
+            const std::size_t n_classes = classes.size();
+            const std::size_t n_literals = (*self.clause_banks.begin())->number_of_literals;
+
+            std::vector<int32_t> clauses_including(n_classes * n_literals);
+            std::vector<uint64_t> include_flips(n_classes * n_literals);
+            std::vector<uint64_t> exclude_flips(n_classes * n_literals);
+            self.literal_telemetry(clauses_including.data(), include_flips.data(), exclude_flips.data());
+
+            nb::dict out;
+            out["classes"] = classes;
+            out["clauses_including"] = to_numpy(std::move(clauses_including), {n_classes, n_literals});
+            out["last_epoch_include_flips"] = to_numpy(std::move(include_flips), {n_classes, n_literals});
+            out["last_epoch_exclude_flips"] = to_numpy(std::move(exclude_flips), {n_classes, n_literals});
+            return out;
+        })
+        .def("clause_activations", [](
+                TMVanillaClassifier<uint32_t>& self,
+                nanobind::ndarray<uint32_t, c_contig>& x,
+                tl::optional<std::vector<int>> classes,
+                bool sparse,
+                std::size_t threads) {
+
+            const std::vector<int> X_shape = shape_of(x);
+            const std::vector<int> selected = classes.value_or(self.weight_banks.get_classes());
+            TMClauseActivations activations;
+            {
+                nb::gil_scoped_release release;
+                activations = self.clause_activations(tcb::span(x.data(), x.size()), X_shape, selected, threads);
+            }
+
+            // The weight of a firing clause is its weight for the class of its bank
+            std::vector<const int32_t*> bank_weights;
+            for (const int class_id : selected) {
+                bank_weights.push_back(self.weight_banks[class_id]->weights.data());
+            }
+            auto out = clause_activations_dict(std::move(activations), sparse, 1,
+                                               [&](uint32_t bank, uint32_t clause, int32_t* weight) {
+                *weight = bank_weights[bank][clause];
+            }, threads);
+            out["classes"] = selected;
+            return out;
+        },
+        "x"_a,
+        "classes"_a = nb::none(),
+        "sparse"_a = false,
+        "threads"_a = 0)
+        .def("patch_activations", [](
+                TMVanillaClassifier<uint32_t>& self,
+                nanobind::ndarray<uint32_t, c_contig>& x,
+                tl::optional<std::vector<int>> classes,
+                std::size_t threads) {
+
+            const std::vector<int> X_shape = shape_of(x);
+            const std::vector<int> selected = classes.value_or(self.weight_banks.get_classes());
+            TMPatchActivations activations;
+            {
+                nb::gil_scoped_release release;
+                activations = self.patch_activations(tcb::span(x.data(), x.size()), X_shape, selected, threads);
+            }
+
+            auto out = patch_activations_dict(std::move(activations), **self.clause_banks.begin());
+            out["classes"] = selected;
+            return out;
+        },
+        "x"_a,
+        "classes"_a = nb::none(),
+        "threads"_a = 0)
+        .def("patch_heatmaps", [](
+                TMVanillaClassifier<uint32_t>& self,
+                nanobind::ndarray<uint32_t, c_contig>& x,
+                tl::optional<std::vector<int>> classes,
+                std::size_t threads) {
+
+            const std::vector<int> X_shape = shape_of(x);
+            const std::vector<int> selected = classes.value_or(self.weight_banks.get_classes());
+            TMPatchHeatmaps heatmaps;
+            {
+                nb::gil_scoped_release release;
+                heatmaps = self.patch_heatmaps(tcb::span(x.data(), x.size()), X_shape, selected, threads);
+            }
+
+            auto out = patch_heatmaps_dict(std::move(heatmaps), **self.clause_banks.begin());
+            out["classes"] = selected;
+            return out;
+        },
+        "x"_a,
+        "classes"_a = nb::none(),
+        "threads"_a = 0)
+        .def("clause_statistics", [](
+                TMVanillaClassifier<uint32_t>& self,
+                nanobind::ndarray<uint32_t, c_contig>& x,
+                nanobind::ndarray<uint32_t, nb::ndim<1>, c_contig>& y,
+                std::size_t threads) {
+
+            const std::vector<int> X_shape = shape_of(x);
+            TMClauseStatistics statistics;
+            {
+                nb::gil_scoped_release release;
+                statistics = self.clause_statistics(
+                        tcb::span(x.data(), x.size()),
+                        X_shape,
+                        tcb::span(y.data(), y.size()),
+                        threads
+                );
+            }
+
+            auto out = clause_statistics_dict(std::move(statistics));
+            out["classes"] = self.weight_banks.get_classes();
+            return out;
+        },
+        "x"_a,
+        "y"_a,
+        "threads"_a = 0)
+        .def("invalidate_branch_and_bound", &TMVanillaClassifier<uint32_t>::invalidate_branch_and_bound)
+        .def_prop_ro("branch_and_bound_evaluated_clauses", [](TMVanillaClassifier<uint32_t>& self) {
+            return self.branch_and_bound.evaluated_clauses;
+        })
+        .def_prop_ro("branch_and_bound_total_clauses", [](TMVanillaClassifier<uint32_t>& self) {
+            return self.branch_and_bound.total_clauses;
+        })
+
+        ;
+
+
+    nb::class_<TMCoalescedClassifier<uint32_t>>(m, "TMCoalescedClassifier")
+        .def(nb::init<
+            int,
+            float,
+            float,
+            uint32_t,
+            float,
+            bool,
+            bool,
+            bool,
+            tl::optional<std::size_t>,
+            tl::optional<std::size_t>,
+            bool,
+            bool,
+            tl::optional<std::vector<int>>,
+            int32_t,
+            int32_t,
+            int32_t,
+            bool,
+            float,
+            float,
+            bool,
+            int
+        >(),
+            "T"_a,
+            "s"_a,
+            "d"_a,
+            "number_of_clauses"_a,
+            "type_i_ii_ratio"_a = 1.0,
+            "type_iii_feedback"_a = false,
+            "focused_negative_sampling"_a = false,
+            "output_balancing"_a = false,
+            "max_positive_clauses"_a = std::nullopt,
+            "max_included_literals"_a = std::nullopt,
+            "boost_true_positive_feedback"_a = true,
+            "reuse_random_feedback"_a = false,
+            "patch_dim"_a = std::nullopt,
+            "number_of_state_bits"_a = 8,
+            "number_of_state_bits_ind"_a = 8,
+            "batch_size"_a = 100,
+            "incremental"_a = true,
+            "clause_drop_p"_a = 0.0,
+            "literal_drop_p"_a = 0.0,
+            "feature_negation"_a = true,
+            "seed"_a = 0
+        )
+        .def_ro("number_of_classes", &TMCoalescedClassifier<uint32_t>::number_of_classes)
+        .def_ro("number_of_clauses", &TMCoalescedClassifier<uint32_t>::number_of_clauses)
+        .def("fit", [](
+                TMCoalescedClassifier<uint32_t>& self,
+                nanobind::ndarray<uint32_t, nb::ndim<2>, c_contig>& x,
+                nanobind::ndarray<uint32_t, nb::ndim<1>, c_contig>& y,
+                bool shuffle
+        ) {
+            const auto y_span = tcb::span(y.data(), y.size());
+            const auto x_train_span = tcb::span(x.data(), x.size());
+            const std::vector<int> X_shape = {
+                    static_cast<int>(x.shape(0)),
+                    static_cast<int>(x.shape(1))
+            };
+
+            self.fit(y_span, x_train_span, X_shape, shuffle);
+        },
+        "x"_a,
+        "y"_a,
+        "shuffle"_a = true,
+        nb::call_guard<nb::gil_scoped_release>()
+        )
+        .def("predict", [](
+                TMCoalescedClassifier<uint32_t>& self,
+                nanobind::ndarray<uint32_t, nb::ndim<2>, c_contig>& x_test,
+                bool clip_class_sum,
+                bool return_class_sum) {
+
+            const auto x_test_span = tcb::span(x_test.data(), x_test.size());
+            const std::vector<int> X_shape = {
+                    static_cast<int>(x_test.shape(0)),
+                    static_cast<int>(x_test.shape(1))
+            };
+
+            auto [argmax, class_sums] = self.predict(
+                    x_test_span,
+                    X_shape,
+                    clip_class_sum,
+                    return_class_sum
+            );
+
+            return std::make_tuple(argmax, class_sums);
+        },
+        "x"_a,
+        "clip_class_sum"_a = false,
+        "return_class_sum"_a = false)
+        .def("get_weights", &TMCoalescedClassifier<uint32_t>::get_weights, "the_class"_a)
+        .def("get_weight", &TMCoalescedClassifier<uint32_t>::get_weight, "the_class"_a, "clause"_a)
+        .def("set_weight", &TMCoalescedClassifier<uint32_t>::set_weight, "the_class"_a, "clause"_a, "weight"_a)
+        .def("get_weight_matrix", [](TMCoalescedClassifier<uint32_t>& self) {
+            return nb::ndarray<nb::numpy, int32_t, nb::ndim<2>, nb::c_contig>(
+                    self.weights.data(),
+                    {static_cast<std::size_t>(self.number_of_clauses), static_cast<std::size_t>(self.number_of_classes_padded)}
+            );
+        }, nb::rv_policy::reference_internal)
+        .def("clause_activations", [](
+                TMCoalescedClassifier<uint32_t>& self,
+                nanobind::ndarray<uint32_t, nb::ndim<2>, c_contig>& x,
+                tl::optional<std::vector<uint32_t>> classes,
+                bool sparse,
+                std::size_t threads) {
+
+            const std::vector<int> X_shape = {
+                    static_cast<int>(x.shape(0)),
+                    static_cast<int>(x.shape(1))
+            };
+            std::vector<uint32_t> selected;
+            if (classes) {
+                selected = *classes;
+            } else {
+                for (uint32_t c = 0; c < self.number_of_classes; ++c) {
+                    selected.push_back(c);
+                }
+            }
+            for (const uint32_t c : selected) {
+                if (c >= self.number_of_classes) {
+                    throw std::invalid_argument("Class " + std::to_string(c) + " is out of range");
+                }
+            }
+
+            TMClauseActivations activations;
+            {
+                nb::gil_scoped_release release;
+                activations = self.clause_activations(tcb::span(x.data(), x.size()), X_shape, threads);
+            }
+
+            // A firing clause carries its weight for each selected class
+            auto out = clause_activations_dict(std::move(activations), sparse, selected.size(),
+                                               [&](uint32_t, uint32_t clause, int32_t* weights) {
+                for (std::size_t c = 0; c < selected.size(); ++c) {
+                    weights[c] = self.get_weight(selected[c], clause);
+                }
+            }, threads);
+            out["classes"] = selected;
+            return out;
+        },
+        "x"_a,
+        "classes"_a = nb::none(),
+        "sparse"_a = false,
+        "threads"_a = 0)
+        .def("patch_activations", [](
+                TMCoalescedClassifier<uint32_t>& self,
+                nanobind::ndarray<uint32_t, c_contig>& x,
+                std::size_t threads) {
+
+            const std::vector<int> X_shape = shape_of(x);
+            TMPatchActivations activations;
+            {
+                nb::gil_scoped_release release;
+                activations = self.patch_activations(tcb::span(x.data(), x.size()), X_shape, threads);
+            }
+            return patch_activations_dict(std::move(activations), *self.clause_bank);
+        },
+        "x"_a,
+        "threads"_a = 0)
+        .def("patch_heatmaps", [](
+                TMCoalescedClassifier<uint32_t>& self,
+                nanobind::ndarray<uint32_t, c_contig>& x,
+                tl::optional<std::vector<uint32_t>> classes,
+                std::size_t threads) {
+
+            const std::vector<int> X_shape = shape_of(x);
+            std::vector<uint32_t> selected;
+            if (classes) {
+                selected = *classes;
+            } else {
+                for (uint32_t c = 0; c < self.number_of_classes; ++c) {
+                    selected.push_back(c);
+                }
+            }
+
+            TMPatchHeatmaps heatmaps;
+            {
+                nb::gil_scoped_release release;
+                heatmaps = self.patch_heatmaps(tcb::span(x.data(), x.size()), X_shape, selected, threads);
+            }
+
+            auto out = patch_heatmaps_dict(std::move(heatmaps), *self.clause_bank);
+            out["classes"] = selected;
+            return out;
+        },
+        "x"_a,
+        "classes"_a = nb::none(),
+        "threads"_a = 0)
+        .def("clause_statistics", [](
+                TMCoalescedClassifier<uint32_t>& self,
+                nanobind::ndarray<uint32_t, nb::ndim<2>, c_contig>& x,
+                nanobind::ndarray<uint32_t, nb::ndim<1>, c_contig>& y,
+                std::size_t threads) {
+
+            const std::vector<int> X_shape = {
+                    static_cast<int>(x.shape(0)),
+                    static_cast<int>(x.shape(1))
+            };
+            TMClauseStatistics statistics;
+            {
+                nb::gil_scoped_release release;
+                statistics = self.clause_statistics(
+                        tcb::span(x.data(), x.size()),
+                        X_shape,
+                        tcb::span(y.data(), y.size()),
+                        threads
+                );
+            }
+            return clause_statistics_dict(std::move(statistics));
+        },
+        "x"_a,
+        "y"_a,
+        "threads"_a = 0)
+        .def_prop_ro("clause_bank", [](TMCoalescedClassifier<uint32_t>& self) {
+            return self.clause_bank;
+        })
+        ;
+
+    nb::class_<TMCascadeClassifier<uint32_t>>(m, "TMCascadeClassifier")
+        .def(nb::init<std::shared_ptr<TMVanillaClassifier<uint32_t>>, std::shared_ptr<TMVanillaClassifier<uint32_t>>, int>(),
+             "small_model"_a, "large_model"_a, "margin_threshold"_a = 0)
+        .def("predict", [](
+                TMCascadeClassifier<uint32_t>& self,
+                nanobind::ndarray<uint32_t, nb::ndim<2>, c_contig>& x_test,
+                bool clip_class_sum) {
+
+            const auto x_test_span = tcb::span(x_test.data(), x_test.size());
+            const std::vector<int> X_shape = {
+                    static_cast<int>(x_test.shape(0)),
+                    static_cast<int>(x_test.shape(1))
+            };
+
+            auto [argmax, escalated] = self.predict(x_test_span, X_shape, clip_class_sum);
+            return std::make_tuple(argmax, escalated);
+        },
+        "x"_a,
+        "clip_class_sum"_a = false)
+        .def("calibrate", [](
+                TMCascadeClassifier<uint32_t>& self,
+                nanobind::ndarray<uint32_t, nb::ndim<2>, c_contig>& x_val,
+                float target_agreement,
+                bool clip_class_sum) {
+
+            const auto x_val_span = tcb::span(x_val.data(), x_val.size());
+            const std::vector<int> X_shape = {
+                    static_cast<int>(x_val.shape(0)),
+                    static_cast<int>(x_val.shape(1))
+            };
+
+            return self.calibrate(x_val_span, X_shape, target_agreement, clip_class_sum);
+        },
+        "x"_a,
+        "target_agreement"_a,
+        "clip_class_sum"_a = false)
+        .def_rw("margin_threshold", &TMCascadeClassifier<uint32_t>::margin_threshold)
+        .def_ro("predicted", &TMCascadeClassifier<uint32_t>::predicted)
+        .def_ro("escalated", &TMCascadeClassifier<uint32_t>::escalated)
+        ;
+
+    nb::class_<TMVanillaRegressor<uint32_t>>(m, "TMVanillaRegressor")
+        .def(nb::init<
+                int,
+                float,
+                float,
+                uint32_t,
+                bool,
+                tl::optional<std::size_t>,
+                bool,
+                bool,
+                tl::optional<std::vector<int>>,
+                int32_t,
+                int32_t,
+                int32_t,
+                bool,
+                float,
+                float,
+                bool,
+                int
+        >(),
+             "T"_a,
+             "s"_a,
+             "d"_a = 200.0,
+             "number_of_clauses"_a,
+             "weighted_clauses"_a = false,
+             "max_included_literals"_a = std::nullopt,
+             "boost_true_positive_feedback"_a = true,
+             "reuse_random_feedback"_a = false,
+             "patch_dim"_a = std::nullopt,
+             "number_of_state_bits"_a = 8,
+             "number_of_state_bits_ind"_a = 8,
+             "batch_size"_a = 100,
+             "incremental"_a = true,
+             "clause_drop_p"_a = 0.0,
+             "literal_drop_p"_a = 0.0,
+             "feature_negation"_a = true,
+             "seed"_a = 0
+        )
+        .def("fit", [](
+                TMVanillaRegressor<uint32_t>& self,
+                nanobind::ndarray<uint32_t, c_contig>& x,
+                nanobind::ndarray<double, nb::ndim<1>, c_contig>& y,
+                bool shuffle) {
+
+            const auto X_shape = shape_of(x);
+            self.fit(
+                    tcb::span<const double>(y.data(), y.size()),
+                    tcb::span(x.data(), x.size()),
+                    X_shape,
+                    shuffle
+            );
+        },
+        "x"_a,
+        "y"_a,
+        "shuffle"_a = true,
+        nb::call_guard<nb::gil_scoped_release>())
+        .def("fit_epochs", [](
+                TMVanillaRegressor<uint32_t>& self,
+                nanobind::ndarray<uint32_t, c_contig>& x,
+                nanobind::ndarray<double, nb::ndim<1>, c_contig>& y,
+                int epochs,
+                bool shuffle) {
+
+            const auto X_shape = shape_of(x);
+            self.fit_epochs(
+                    tcb::span<const double>(y.data(), y.size()),
+                    tcb::span(x.data(), x.size()),
+                    X_shape,
+                    epochs,
+                    shuffle
+            );
+        },
+        "x"_a,
+        "y"_a,
+        "epochs"_a,
+        "shuffle"_a = true,
+        nb::call_guard<nb::gil_scoped_release>())
+        .def("predict", [](
+                TMVanillaRegressor<uint32_t>& self,
+                nanobind::ndarray<uint32_t, c_contig>& x_test,
+                std::size_t threads) {
+
+            const auto X_shape = shape_of(x_test);
+            const std::size_t num_items = x_test.shape(0);
+
+            auto* y_pred = new std::vector<double>(num_items);
+            nb::capsule y_pred_owner(y_pred, [](void* p) noexcept { delete static_cast<std::vector<double>*>(p); });
+            {
+                nb::gil_scoped_release release;
+                self.predict_batch(tcb::span(x_test.data(), x_test.size()), X_shape, y_pred->data(), threads);
+            }
+
+            return nb::ndarray<nb::numpy, double, nb::ndim<1>>(y_pred->data(), {num_items}, y_pred_owner);
+        },
+        "x"_a,
+        "threads"_a = 1)
+        .def("clause_activations", [](
+                TMVanillaRegressor<uint32_t>& self,
+                nanobind::ndarray<uint32_t, c_contig>& x,
+                bool sparse,
+                std::size_t threads) {
+
+            const std::vector<int> X_shape = shape_of(x);
+            TMClauseActivations activations;
+            {
+                nb::gil_scoped_release release;
+                activations = self.clause_activations(tcb::span(x.data(), x.size()), X_shape, threads);
+            }
 
+            const int32_t* weights = self.weight_bank->weights.data();
+            return clause_activations_dict(std::move(activations), sparse, 1,
+                                           [&](uint32_t, uint32_t clause, int32_t* weight) {
+                *weight = weights[clause];
+            }, threads);
+        },
+        "x"_a,
+        "sparse"_a = false,
+        "threads"_a = 0)
+        .def_ro("min_y", &TMVanillaRegressor<uint32_t>::min_y)
+        .def_ro("max_y", &TMVanillaRegressor<uint32_t>::max_y)
+        .def_rw("clause_drop_p", &TMVanillaRegressor<uint32_t>::clause_drop_p)
+        .def_rw("literal_drop_p", &TMVanillaRegressor<uint32_t>::literal_drop_p)
+        .def_prop_ro("clause_bank", [](TMVanillaRegressor<uint32_t>& self) {
+            return self.clause_bank;
+        })
+        .def_prop_ro("weight_bank", [](TMVanillaRegressor<uint32_t>& self) {
+            return self.weight_bank;
+        })
+        ;
+
+
+    nb::class_<TMMultiOutputClassifier<uint32_t>>(m, "TMMultiOutputClassifier")
+        .def(nb::init<
+                int,
+                float,
+                float,
+                uint32_t,
+                float,
+                float,
+                tl::optional<std::size_t>,
+                tl::optional<std::size_t>,
+                bool,
+                bool,
+                tl::optional<std::vector<int>>,
+                int32_t,
+                int32_t,
+                int32_t,
+                bool,
+                float,
+                float,
+                bool,
+                int
+        >(),
+             "T"_a,
+             "s"_a,
+             "d"_a = 200.0,
+             "number_of_clauses"_a,
+             "type_i_ii_ratio"_a = 1.0,
+             "q"_a = 1.0,
+             "max_positive_clauses"_a = std::nullopt,
+             "max_included_literals"_a = std::nullopt,
+             "boost_true_positive_feedback"_a = true,
+             "reuse_random_feedback"_a = false,
+             "patch_dim"_a = std::nullopt,
+             "number_of_state_bits"_a = 8,
+             "number_of_state_bits_ind"_a = 8,
+             "batch_size"_a = 100,
+             "incremental"_a = true,
+             "clause_drop_p"_a = 0.0,
+             "literal_drop_p"_a = 0.0,
+             "feature_negation"_a = true,
+             "seed"_a = 0
+        )
+        .def("fit", [](
+                TMMultiOutputClassifier<uint32_t>& self,
+                nanobind::ndarray<uint32_t, c_contig>& x,
+                nanobind::ndarray<uint32_t, nb::ndim<2>, c_contig>& y,
+                bool shuffle) {
+
+            self.fit(
+                    tcb::span(y.data(), y.size()),
+                    shape_of(y),
+                    tcb::span(x.data(), x.size()),
+                    shape_of(x),
+                    shuffle
+            );
+        },
+        "x"_a,
+        "y"_a,
+        "shuffle"_a = true,
+        nb::call_guard<nb::gil_scoped_release>())
+        .def("predict", [](
+                TMMultiOutputClassifier<uint32_t>& self,
+                nanobind::ndarray<uint32_t, c_contig>& x_test,
+                bool clip_class_sum,
+                bool return_class_sums) -> nb::object {
+
+            const std::size_t num_items = x_test.shape(0);
+            const std::size_t number_of_outputs = self.number_of_outputs;
+
+            auto* y_pred = new std::vector<uint32_t>(num_items * number_of_outputs);
+            nb::capsule y_pred_owner(y_pred, [](void* p) noexcept { delete static_cast<std::vector<uint32_t>*>(p); });
+            auto* class_sums = new std::vector<int32_t>(return_class_sums ? num_items * number_of_outputs : 0);
+            nb::capsule class_sums_owner(class_sums, [](void* p) noexcept { delete static_cast<std::vector<int32_t>*>(p); });
+            {
+                nb::gil_scoped_release release;
+                self.predict_batch(
+                        tcb::span(x_test.data(), x_test.size()),
+                        shape_of(x_test),
+                        clip_class_sum,
+                        y_pred->data(),
+                        return_class_sums ? class_sums->data() : nullptr
+                );
+            }
+
+            auto y_pred_array = nb::ndarray<nb::numpy, uint32_t, nb::ndim<2>>(
+                    y_pred->data(), {num_items, number_of_outputs}, y_pred_owner
+            );
+            if (!return_class_sums) {
+                return nb::cast(y_pred_array);
+            }
+            auto class_sums_array = nb::ndarray<nb::numpy, int32_t, nb::ndim<2>>(
+                    class_sums->data(), {num_items, number_of_outputs}, class_sums_owner
+            );
+            return nb::make_tuple(y_pred_array, class_sums_array);
+        },
+        "x"_a,
+        "clip_class_sum"_a = false,
+        "return_class_sums"_a = false)
+        .def("get_weights", &TMMultiOutputClassifier<uint32_t>::get_weights, "output"_a)
+        .def_ro("number_of_outputs", &TMMultiOutputClassifier<uint32_t>::number_of_outputs)
+        .def_rw("q", &TMMultiOutputClassifier<uint32_t>::q)
+        .def_rw("clause_drop_p", &TMMultiOutputClassifier<uint32_t>::clause_drop_p)
+        .def_rw("literal_drop_p", &TMMultiOutputClassifier<uint32_t>::literal_drop_p)
+        .def_prop_ro("clause_bank", [](TMMultiOutputClassifier<uint32_t>& self) {
+            return self.clause_bank;
+        })
+        ;
+
+
+    nb::class_<TMMultiTaskClassifier<uint32_t>>(m, "TMMultiTaskClassifier")
+        .def(nb::init<
+                int,
+                float,
+                float,
+                uint32_t,
+                bool,
+                float,
+                bool,
+                tl::optional<std::size_t>,
+                bool,
+                bool,
+                tl::optional<std::vector<int>>,
+                int32_t,
+                int32_t,
+                float,
+                float,
+                bool,
+                int
+        >(),
+             "T"_a,
+             "s"_a,
+             "d"_a = 200.0,
+             "number_of_clauses"_a,
+             "confidence_driven_updating"_a = false,
+             "type_i_ii_ratio"_a = 1.0,
+             "type_iii_feedback"_a = false,
+             "max_included_literals"_a = std::nullopt,
+             "boost_true_positive_feedback"_a = true,
+             "reuse_random_feedback"_a = false,
+             "patch_dim"_a = std::nullopt,
+             "number_of_state_bits"_a = 8,
+             "number_of_state_bits_ind"_a = 8,
+             "clause_drop_p"_a = 0.0,
+             "literal_drop_p"_a = 0.0,
+             "feature_negation"_a = true,
+             "seed"_a = 0
+        )
+        // x is [task][sample][...], y is [task][sample]
+        .def("fit", [](
+                TMMultiTaskClassifier<uint32_t>& self,
+                nanobind::ndarray<uint32_t, c_contig>& x,
+                nanobind::ndarray<uint32_t, nb::ndim<2>, c_contig>& y,
+                bool shuffle) {
+
+            self.fit(
+                    tcb::span(y.data(), y.size()),
+                    tcb::span(x.data(), x.size()),
+                    shape_of(x),
+                    shuffle
+            );
+        },
+        "x"_a,
+        "y"_a,
+        "shuffle"_a = true,
+        nb::call_guard<nb::gil_scoped_release>())
+        .def("predict", [](
+                TMMultiTaskClassifier<uint32_t>& self,
+                nanobind::ndarray<uint32_t, c_contig>& x_test) {
+
+            const std::size_t number_of_tasks = x_test.shape(0);
+            const std::size_t num_items = x_test.shape(1);
+
+            auto* y_pred = new std::vector<uint32_t>(number_of_tasks * num_items);
+            nb::capsule y_pred_owner(y_pred, [](void* p) noexcept { delete static_cast<std::vector<uint32_t>*>(p); });
+            {
+                nb::gil_scoped_release release;
+                self.predict_batch(tcb::span(x_test.data(), x_test.size()), shape_of(x_test), y_pred->data());
+            }
+
+            return nb::ndarray<nb::numpy, uint32_t, nb::ndim<2>>(y_pred->data(), {number_of_tasks, num_items}, y_pred_owner);
+        },
+        "x"_a)
+        .def("get_weights", &TMMultiTaskClassifier<uint32_t>::get_weights, "task"_a)
+        .def_ro("number_of_tasks", &TMMultiTaskClassifier<uint32_t>::number_of_tasks)
+        .def_rw("clause_drop_p", &TMMultiTaskClassifier<uint32_t>::clause_drop_p)
+        .def_rw("literal_drop_p", &TMMultiTaskClassifier<uint32_t>::literal_drop_p)
+        .def_prop_ro("clause_bank", [](TMMultiTaskClassifier<uint32_t>& self) {
+            return self.clause_bank;
+        })
+        ;
+
+    nb::class_<TMAutoEncoder<uint32_t>>(m, "TMAutoEncoder")
+        .def(nb::init<
+                int,
+                float,
+                float,
+                uint32_t,
+                std::vector<uint32_t>,
+                int,
+                float,
+                bool,
+                float,
+                float,
+                tl::optional<std::size_t>,
+                bool,
+                bool,
+                int32_t,
+                int32_t,
+                float,
+                float,
+                bool,
+                bool,
+                std::size_t,
+                int
+        >(),
+             "T"_a,
+             "s"_a,
+             "d"_a = 200.0,
+             "number_of_clauses"_a,
+             "output_active"_a,
+             "accumulation"_a = 1,
+             "type_i_ii_ratio"_a = 1.0,
+             "type_iii_feedback"_a = false,
+             "output_balancing"_a = 0.0,
+             "upsampling"_a = 1.0,
+             "max_included_literals"_a = std::nullopt,
+             "boost_true_positive_feedback"_a = true,
+             "reuse_random_feedback"_a = false,
+             "number_of_state_bits"_a = 8,
+             "number_of_state_bits_ind"_a = 8,
+             "clause_drop_p"_a = 0.0,
+             "literal_drop_p"_a = 0.0,
+             "feature_negation"_a = true,
+             "squared_weight_update_p"_a = false,
+             "number_of_threads"_a = 0,
+             "seed"_a = 0
+        )
+        // The CSR/CSC arrays of X_csr and X_csc.sorted_indices(), as uint32
+        .def("fit", [](
+                TMAutoEncoder<uint32_t>& self,
+                nanobind::ndarray<uint32_t, nb::ndim<1>, c_contig>& indptr_row,
+                nanobind::ndarray<uint32_t, nb::ndim<1>, c_contig>& indices_row,
+                nanobind::ndarray<uint32_t, nb::ndim<1>, c_contig>& indptr_col,
+                nanobind::ndarray<uint32_t, nb::ndim<1>, c_contig>& indices_col,
+                int number_of_rows,
+                int number_of_cols,
+                int number_of_examples) {
+
+            const TMAutoEncoderData data{
+                    tcb::span<const uint32_t>(indptr_row.data(), indptr_row.size()),
+                    tcb::span<const uint32_t>(indices_row.data(), indices_row.size()),
+                    tcb::span<const uint32_t>(indptr_col.data(), indptr_col.size()),
+                    tcb::span<const uint32_t>(indices_col.data(), indices_col.size()),
+                    number_of_rows,
+                    number_of_cols
+            };
+            self.fit(data, number_of_examples);
+        },
+        "indptr_row"_a,
+        "indices_row"_a,
+        "indptr_col"_a,
+        "indices_col"_a,
+        "number_of_rows"_a,
+        "number_of_cols"_a,
+        "number_of_examples"_a = 2000,
+        nb::call_guard<nb::gil_scoped_release>())
+        .def("predict", [](
+                TMAutoEncoder<uint32_t>& self,
+                nanobind::ndarray<uint32_t, nb::ndim<1>, c_contig>& indptr_row,
+                nanobind::ndarray<uint32_t, nb::ndim<1>, c_contig>& indices_row,
+                int number_of_rows) {
+
+            const std::size_t number_of_outputs = self.number_of_outputs();
+            auto* y_pred = new std::vector<uint32_t>(static_cast<std::size_t>(number_of_rows) * number_of_outputs);
+            nb::capsule y_pred_owner(y_pred, [](void* p) noexcept { delete static_cast<std::vector<uint32_t>*>(p); });
+            {
+                nb::gil_scoped_release release;
+                self.predict_batch(
+                        tcb::span<const uint32_t>(indptr_row.data(), indptr_row.size()),
+                        tcb::span<const uint32_t>(indices_row.data(), indices_row.size()),
+                        number_of_rows,
+                        y_pred->data()
+                );
+            }
+
+            return nb::ndarray<nb::numpy, uint32_t, nb::ndim<2>>(
+                    y_pred->data(),
+                    {static_cast<std::size_t>(number_of_rows), number_of_outputs},
+                    y_pred_owner
+            );
+        },
+        "indptr_row"_a,
+        "indices_row"_a,
+        "number_of_rows"_a)
+        .def("get_weights", [](TMAutoEncoder<uint32_t>& self) {
+            return nb::ndarray<nb::numpy, int32_t, nb::ndim<2>>(
+                    self.weights.data(),
+                    {self.number_of_outputs(), static_cast<std::size_t>(self.number_of_clauses)}
+            );
+        }, nb::rv_policy::reference_internal)
+        .def("get_clause_bank", [](TMAutoEncoder<uint32_t>& self) {
+            return nb::ndarray<nb::numpy, uint32_t, nb::c_contig>(
+                    self.clause_bank.data(),
+                    {self.clause_bank.size()}
+            );
+        }, nb::rv_policy::reference_internal)
+        .def_ro("number_of_literals", &TMAutoEncoder<uint32_t>::number_of_literals)
+        .def_ro("feature_true_probability", &TMAutoEncoder<uint32_t>::feature_true_probability)
+        .def_ro("number_of_threads", &TMAutoEncoder<uint32_t>::number_of_threads)
+        .def_rw("clause_drop_p", &TMAutoEncoder<uint32_t>::clause_drop_p)
+        .def_rw("literal_drop_p", &TMAutoEncoder<uint32_t>::literal_drop_p)
+        ;
+
+    nb::class_<TMAttention<uint32_t>>(m, "TMAttention")
+        .def(nb::init<std::size_t, std::size_t, float, std::size_t>(),
+             "number_of_literals"_a,
+             "attention_span"_a,
+             "s"_a,
+             "number_of_state_bits"_a = 8
+        )
+        .def("type_i_feedback", [](
+                TMAttention<uint32_t>& self,
+                float update_p,
+                nanobind::ndarray<uint32_t, nb::ndim<1>, c_contig>& encoded_xi) {
+            if (encoded_xi.size() < self.number_of_ta_chunks) {
+                throw std::invalid_argument("encoded_xi holds fewer than number_of_ta_chunks words");
+            }
+            self.type_i_feedback(update_p, encoded_xi.data());
+        }, "update_p"_a, "encoded_xi"_a)
+        .def("type_ii_feedback", [](
+                TMAttention<uint32_t>& self,
+                float update_p,
+                nanobind::ndarray<uint32_t, nb::ndim<1>, c_contig>& encoded_xi) {
+            if (encoded_xi.size() < self.number_of_ta_chunks) {
+                throw std::invalid_argument("encoded_xi holds fewer than number_of_ta_chunks words");
+            }
+            self.type_ii_feedback(update_p, encoded_xi.data());
+        }, "update_p"_a, "encoded_xi"_a)
+        .def("set_included_literals", [](
+                TMAttention<uint32_t>& self,
+                nanobind::ndarray<uint32_t, nb::ndim<1>, c_contig>& included_literals) {
+            if (included_literals.size() < self.number_of_ta_chunks) {
+                throw std::invalid_argument("included_literals holds fewer than number_of_ta_chunks words");
+            }
+            self.set_included_literals(included_literals.data());
+        }, "included_literals"_a)
+        .def("set_included_literals_from", [](TMAttention<uint32_t>& self, TMClauseBankDense<uint32_t>& clause_bank) {
+            self.set_included_literals(clause_bank);
+        }, "clause_bank"_a)
+        // Masks every row of encoded_X ([sample][patch * ta_chunk]) in place
+        .def("get_attention", [](
+                TMAttention<uint32_t>& self,
+                nanobind::ndarray<uint32_t, nb::ndim<2>, c_contig>& encoded_X) {
+            if (encoded_X.shape(1) % self.number_of_ta_chunks != 0) {
+                throw std::invalid_argument("encoded_X rows are not a whole number of patches");
+            }
+            const std::size_t number_of_patches = encoded_X.shape(1) / self.number_of_ta_chunks;
+            for (std::size_t e = 0; e < encoded_X.shape(0); ++e) {
+                self.get_attention(&encoded_X(e, 0), number_of_patches);
+            }
+        }, "encoded_X"_a)
+        .def("calculate_clause_outputs", [](
+                TMAttention<uint32_t>& self,
+                TMClauseBankDense<uint32_t>& clause_bank,
+                nanobind::ndarray<uint32_t, nb::ndim<2>, c_contig>& encoded_X,
+                int e,
+                bool predict) {
+            if (encoded_X.shape(1) != clause_bank.number_of_patches * self.number_of_ta_chunks) {
+                throw std::invalid_argument("encoded_X does not match the patches of the clause bank");
+            }
+            if (e < 0 || static_cast<std::size_t>(e) >= encoded_X.shape(0)) {
+                throw std::out_of_range("e is not a row of encoded_X");
+            }
+            std::vector<uint32_t> clause_output(clause_bank.number_of_clauses);
+            self.calculate_clause_outputs(clause_bank, &encoded_X(e, 0), clause_output.data(), predict);
+            return to_numpy(std::move(clause_output), {clause_bank.number_of_clauses});
+        }, "clause_bank"_a, "encoded_X"_a, "e"_a, "predict"_a = true)
+        .def("attention_mask", [](TMAttention<uint32_t>& self) {
+            auto mask = self.attention_mask();
+            return to_numpy(std::move(mask), {self.number_of_ta_chunks});
+        })
+        .def("attended_chunks", [](TMAttention<uint32_t>& self) {
+            auto chunks = self.attended_chunks();
+            const std::size_t size = chunks.size();
+            return to_numpy(std::move(chunks), {size});
+        })
+        .def("ranking", [](TMAttention<uint32_t>& self) {
+            return to_numpy(self.ranking(), {self.number_of_literals});
+        })
+        .def("get_score", &TMAttention<uint32_t>::get_score, "literal"_a)
+        .def_ro("number_of_literals", &TMAttention<uint32_t>::number_of_literals)
+        .def_ro("number_of_ta_chunks", &TMAttention<uint32_t>::number_of_ta_chunks)
+        .def_ro("attention_span", &TMAttention<uint32_t>::attention_span)
+        .def_rw("s", &TMAttention<uint32_t>::s)
         ;
 
 
     nb::class_<TMWeightBank<uint32_t>>(m, "TMWeightBank")
             .def(nb::init<>())
-            .def("initialize", &TMWeightBank<uint32_t>::initialize)
+            .def("initialize", [](TMWeightBank<uint32_t>& self, TMMemory<uint32_t>& memory, std::size_t number_of_clauses) {
+                self.initialize(memory, number_of_clauses);
+            }, "memory"_a, "number_of_clauses"_a)
             .def("get_weights", [](TMWeightBank<uint32_t>& self) {
-                return nb::ndarray<nb::numpy, uint32_t>(
+                return nb::ndarray<nb::numpy, int32_t>(
                         self.weights.data(),
                         {static_cast<unsigned long>(self.weights.size())}
                 );
             }, nb::rv_policy::reference)
-            .def("get_required_memory_size", &TMWeightBank<uint32_t>::getRequiredMemorySize)
+            .def("get_required_memory_size", [](TMWeightBank<uint32_t>& self, std::size_t number_of_clauses) {
+                return self.getRequiredMemorySize(number_of_clauses);
+            }, "number_of_clauses"_a)
             .def("increment", [](
                     TMWeightBank<uint32_t>& self,
                     nb::ndarray<nb::numpy, uint32_t, nb::ndim<1>, c_contig>& clause_output,
@@ -418,9 +1623,51 @@ NB_MODULE(tmulibpy, m) {
              "incremental"_a,
              "seed"_a = 0
         )
-        .def("initialize", &TMClauseBankDense<uint32_t>::initialize)
+        .def("initialize", [](TMClauseBankDense<uint32_t>& self, TMMemory<uint32_t>& memory) {
+            return self.initialize(memory);
+        }, "memory"_a)
         .def("set_ta_state", &TMClauseBankDense<uint32_t>::setTAState)
         .def("get_ta_state", &TMClauseBankDense<uint32_t>::getTAState)
+        .def("enable_literal_telemetry", &TMClauseBankDense<uint32_t>::enable_literal_telemetry)
+        .def("disable_literal_telemetry", &TMClauseBankDense<uint32_t>::disable_literal_telemetry)
+        .def("rebuild_literal_telemetry", &TMClauseBankDense<uint32_t>::rebuild_literal_telemetry)
+        .def("begin_literal_telemetry_epoch", [](TMClauseBankDense<uint32_t>& self) {
+            if (!self.telemetry()) {
+                throw std::runtime_error("Literal telemetry is not enabled");
+            }
+            self.telemetry()->begin_epoch();
+        })
+        .def("literal_telemetry", [](TMClauseBankDense<uint32_t>& self) {
+            if (!self.telemetry()) {
+                throw std::runtime_error("Literal telemetry is not enabled");
+            }
+            return literal_telemetry_dict(*self.telemetry());
+        })
+        .def("get_literals", [](const TMClauseBankDense<uint32_t>& self, std::size_t threads) {
+            std::vector<uint64_t> offsets;
+            std::vector<uint32_t> literals;
+            self.get_literals(offsets, literals, threads);
+            const std::size_t n_offsets = offsets.size();
+            const std::size_t n_literals = literals.size();
+            return nb::make_tuple(to_numpy(std::move(offsets), {n_offsets}), to_numpy(std::move(literals), {n_literals}));
+        }, "threads"_a = 0)
+        .def("included_literals", [](TMClauseBankDense<uint32_t>& self, std::size_t threads) {
+            auto ids = self.included_literal_ids(threads);
+            const std::size_t n = ids.size();
+            return to_numpy(std::move(ids), {n});
+        }, "threads"_a = 0)
+        .def("number_of_include_actions", &TMClauseBankDense<uint32_t>::number_of_include_actions, "clause"_a)
+        .def("calculate_literal_clause_frequency", [](
+                TMClauseBankDense<uint32_t>& self,
+                tl::optional<nb::ndarray<uint32_t, nb::ndim<1>, nb::c_contig>> clause_active,
+                std::size_t threads
+        ) {
+            if (clause_active && clause_active->shape(0) != self.number_of_clauses) {
+                throw std::invalid_argument("clause_active must have one entry per clause");
+            }
+            const auto counts = self.calculate_literal_clause_frequency(clause_active ? clause_active->data() : nullptr, threads);
+            return to_numpy(std::vector<uint32_t>(counts.begin(), counts.end()), {self.number_of_literals});
+        }, "clause_active"_a = nb::none(), "threads"_a = 0)
         .def_ro("clause_output", &TMClauseBankDense<uint32_t>::clause_output)
         .def_ro("clause_output_batch", &TMClauseBankDense<uint32_t>::clause_output_batch)
         .def_ro("clause_and_target", &TMClauseBankDense<uint32_t>::clause_and_target)
@@ -445,6 +1692,7 @@ NB_MODULE(tmulibpy, m) {
         .def_ro("number_of_state_bits_ind", &TMClauseBankDense<uint32_t>::number_of_state_bits_ind)
         .def_ro("batch_size", &TMClauseBankDense<uint32_t>::batch_size)
         .def_ro("number_of_literals", &TMClauseBankDense<uint32_t>::number_of_literals)
+        .def_rw("incremental_clause_evaluation_initialized", &TMClauseBankDense<uint32_t>::incremental_clause_evaluation_initialized)
 
 
         .def("get_clause_bank", [](TMClauseBankDense<uint32_t>& self) {
@@ -489,7 +1737,9 @@ NB_MODULE(tmulibpy, m) {
             );
         }, nb::rv_policy::reference)
 
-        .def("get_required_memory_size", &TMClauseBankDense<uint32_t>::getRequiredMemorySize)
+        .def("get_required_memory_size", [](TMClauseBankDense<uint32_t>& self) {
+            return self.getRequiredMemorySize();
+        })
         .def("prepare_X", [](
                      TMClauseBankDense<uint32_t>& self,
                      nb::ndarray<uint32_t>& x) {
@@ -672,6 +1922,23 @@ NB_MODULE(tmulibpy, m) {
     , "e"_a
     , nb::rv_policy::reference)
 
+    .def("calculate_clause_outputs_patchwise", [](
+                TMClauseBankDense<uint32_t>& self,
+                nanobind::ndarray<uint32_t, nb::ndim<2>, c_contig>& encoded_X,
+                int sample_index) {
+
+        auto encoded_xi = tcb::span(&encoded_X(sample_index, 0), encoded_X.shape(1));
+        auto clause_outputs = self.calculate_clause_outputs_patchwise(encoded_xi);
+
+        return nb::ndarray<nb::numpy, uint32_t, nb::ndim<1>, nb::c_contig>(
+                clause_outputs.data(),
+                {self.number_of_clauses * self.number_of_patches}
+        );
+    }
+    , "encoded_X"_a
+    , "e"_a
+    , nb::rv_policy::reference)
+
 
     ;
 
@@ -0,0 +1,470 @@
+"""
+End-to-end tests of the command line tools in tmu/lib/cpp, run by ctest. The tools are located through environment
+variables (TMULIB_SERVER, ...) that CMake sets to the built targets; tests of tools that are not given are skipped.
+
+Models are random checkpoints written in the TMCheckpoint layout, so the expected predictions can be computed here
+without training.
+"""
+import json
+import os
+import signal
+import socket
+import struct
+import subprocess
+import tempfile
+import threading
+import time
+import unittest
+
+import numpy as np
+
+TMCK_MAGIC = 0x4b434d54
+TMCK_VERSION = 1
+
+FLAG_CLASS_SUMS = 1
+FLAG_COUNTERS = 2
+STATUS_OK = 0
+STATUS_BAD_REQUEST = 1
+
+
+class RandomCheckpoint:
+    """A model over number_of_features plain features, whose clauses each include a few random literals."""
+
+    def __init__(self, number_of_classes=5, number_of_clauses=60, number_of_features=40, seed=1, T=30):
+        rng = np.random.RandomState(seed)
+        self.T = T
+        self.classes = np.arange(10, 10 + number_of_classes, dtype=np.uint32)
+        self.number_of_features = number_of_features
+        self.number_of_literals = 2 * number_of_features
+        self.number_of_state_bits = 8
+        self.number_of_ta_chunks = (self.number_of_literals - 1) // 32 + 1
+
+        # include[class][clause][literal]
+        self.include = np.zeros((number_of_classes, number_of_clauses, self.number_of_literals), dtype=bool)
+        for c in range(number_of_classes):
+            for j in range(number_of_clauses):
+                features = rng.choice(number_of_features, size=rng.randint(1, 4), replace=False)
+                negated = rng.random_sample(features.size) < 0.5
+                self.include[c, j, features + negated * number_of_features] = True
+        self.weights = rng.randint(-20, 21, size=(number_of_classes, number_of_clauses)).astype(np.int32)
+
+    def write(self, path):
+        number_of_classes, number_of_clauses, _ = self.include.shape
+        # Only the most significant state bit decides inclusion
+        clause_banks = np.zeros(
+            (number_of_classes, number_of_clauses, self.number_of_ta_chunks, self.number_of_state_bits), dtype=np.uint32
+        )
+        for k in range(self.number_of_literals):
+            clause_banks[:, :, k // 32, -1] |= self.include[:, :, k].astype(np.uint32) << np.uint32(k % 32)
+
+        with open(path, "wb") as f:
+            f.write(struct.pack(
+                "<IIi5I3i2i",
+                TMCK_MAGIC, TMCK_VERSION, self.T,
+                number_of_classes, number_of_clauses, self.number_of_literals, self.number_of_state_bits, 1,
+                self.number_of_features, 1, 1,
+                self.number_of_features, 1
+            ))
+            f.write(self.classes.tobytes())
+            f.write(clause_banks.tobytes())
+            f.write(self.weights.tobytes())
+
+    def predict(self, X):
+        """Classes and unclipped class sums, with ties to the lowest class position."""
+        literals = np.hstack([X, 1 - X]).astype(bool)
+        # A clause fires when none of its included literals is false
+        fires = ~np.einsum("ncjk->ncj", self.include[None, :, :, :] & ~literals[:, None, None, :]).astype(bool)
+        class_sums = (fires * self.weights[None, :, :]).sum(axis=2).astype(np.int32)
+        return self.classes[class_sums.argmax(axis=1)].astype(np.int32), class_sums
+
+
+def read_exactly(connection, size):
+    data = b""
+    while len(data) < size:
+        chunk = connection.recv(size - len(data))
+        if not chunk:
+            raise ConnectionError("Connection closed")
+        data += chunk
+    return data
+
+
+def request(connection, X, flags=FLAG_CLASS_SUMS):
+    """One request in the tmulib_server wire protocol. Returns status, classes and class sums (or None)."""
+    X = np.ascontiguousarray(X, dtype=np.uint8)
+    connection.sendall(struct.pack("=III", X.shape[0], X.shape[1], flags) + X.tobytes())
+    status, number_of_samples, number_of_classes = struct.unpack("=III", read_exactly(connection, 12))
+    if status != STATUS_OK:
+        return status, None, None
+    classes = np.frombuffer(read_exactly(connection, 4 * number_of_samples), dtype=np.int32)
+    class_sums = None
+    if flags & FLAG_CLASS_SUMS:
+        class_sums = np.frombuffer(
+            read_exactly(connection, 4 * number_of_samples * number_of_classes), dtype=np.int32
+        ).reshape(number_of_samples, number_of_classes)
+    return status, classes, class_sums
+
+
+def counters(connection):
+    connection.sendall(struct.pack("=III", 0, 0, FLAG_COUNTERS))
+    status, length = struct.unpack("=II", read_exactly(connection, 8))
+    return status, read_exactly(connection, length).decode()
+
+
+class Process:
+    """A tool serving on a Unix domain socket, stopped with SIGTERM."""
+
+    def __init__(self, command, socket_path, timeout=20.0):
+        self.socket_path = socket_path
+        self.process = subprocess.Popen(command, stdout=subprocess.PIPE, stderr=subprocess.PIPE)
+        deadline = time.monotonic() + timeout
+        while True:
+            if self.process.poll() is not None:
+                raise RuntimeError("Exited with " + self.process.stderr.read().decode())
+            try:
+                self.connect().close()
+                return
+            except OSError:
+                if time.monotonic() > deadline:
+                    self.process.kill()
+                    raise
+                time.sleep(0.05)
+
+    def connect(self):
+        connection = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+        try:
+            connection.connect(self.socket_path)
+        except OSError:
+            connection.close()
+            raise
+        return connection
+
+    def stop(self, timeout=10.0):
+        self.process.send_signal(signal.SIGTERM)
+        try:
+            return self.process.wait(timeout)
+        finally:
+            if self.process.poll() is None:
+                self.process.kill()
+            self.process.stdout.close()
+            self.process.stderr.close()
+
+
+@unittest.skipUnless(os.environ.get("TMULIB_SERVER"), "TMULIB_SERVER is not set")
+class ServerTests(unittest.TestCase):
+
+    def setUp(self):
+        self.directory = tempfile.TemporaryDirectory()
+        self.model = RandomCheckpoint()
+        self.model_path = os.path.join(self.directory.name, "model.tmck")
+        self.model.write(self.model_path)
+        self.X = np.random.RandomState(2).randint(2, size=(300, self.model.number_of_features))
+
+    def tearDown(self):
+        self.directory.cleanup()
+
+    def start(self, *options, model_path=None):
+        socket_path = os.path.join(self.directory.name, "server.sock")
+        command = [
+            os.environ["TMULIB_SERVER"], "--model", model_path or self.model_path, "--socket", socket_path,
+            "--threads", "2", *options
+        ]
+        return Process(command, socket_path)
+
+    def test_predictions_match_checkpoint(self):
+        expected_classes, expected_class_sums = self.model.predict(self.X)
+        server = self.start()
+        try:
+            with server.connect() as connection:
+                status, classes, class_sums = request(connection, self.X)
+            self.assertEqual(status, STATUS_OK)
+            np.testing.assert_array_equal(classes, expected_classes)
+            np.testing.assert_array_equal(class_sums, expected_class_sums)
+
+            # Small concurrent requests are coalesced into batches, which must not change any answer
+            failures = []
+
+            def client(offset):
+                with server.connect() as connection:
+                    for begin in range(offset, len(self.X), 7 * 8):
+                        _, classes, _ = request(connection, self.X[begin:begin + 7], flags=0)
+                        if not (classes == expected_classes[begin:begin + 7]).all():
+                            failures.append(begin)
+
+            clients = [threading.Thread(target=client, args=(7 * i,)) for i in range(8)]
+            for thread in clients:
+                thread.start()
+            for thread in clients:
+                thread.join()
+            self.assertEqual(failures, [])
+
+            with server.connect() as connection:
+                status, document = counters(connection)
+            self.assertEqual(status, STATUS_OK)
+            self.assertEqual(json.loads(document)["samples"], 600)
+        finally:
+            self.assertEqual(server.stop(), 0)
+
+    def test_oversized_request_is_rejected(self):
+        server = self.start("--max-request", "16")
+        try:
+            with server.connect() as connection:
+                # Only the header is sent: the server must refuse before reading or allocating the payload
+                connection.sendall(struct.pack("=III", 0xffffffff, self.model.number_of_features, 0))
+                status, _, _ = struct.unpack("=III", read_exactly(connection, 12))
+                self.assertEqual(status, STATUS_BAD_REQUEST)
+                self.assertEqual(connection.recv(1), b"")
+
+            with server.connect() as connection:
+                status, classes, _ = request(connection, self.X[:16])
+                self.assertEqual(status, STATUS_OK)
+        finally:
+            self.assertEqual(server.stop(), 0)
+
+    def test_connections_are_capped(self):
+        expected_classes, _ = self.model.predict(self.X[:8])
+        server = self.start("--max-connections", "1")
+        first = server.connect()
+        waiting = server.connect()
+        try:
+            status, _, _ = request(first, self.X[:8])
+            self.assertEqual(status, STATUS_OK)
+
+            # The second client stays in the listen backlog until the first disconnects
+            waiting.settimeout(0.5)
+            waiting.sendall(struct.pack("=III", 8, self.model.number_of_features, 0) + self.X[:8].astype(np.uint8).tobytes())
+            with self.assertRaises(socket.timeout):
+                waiting.recv(1)
+
+            first.close()
+            waiting.settimeout(10.0)
+            status, number_of_samples, _ = struct.unpack("=III", read_exactly(waiting, 12))
+            self.assertEqual(status, STATUS_OK)
+            classes = np.frombuffer(read_exactly(waiting, 4 * number_of_samples), dtype=np.int32)
+            np.testing.assert_array_equal(classes, expected_classes)
+        finally:
+            first.close()
+            waiting.close()
+            self.assertEqual(server.stop(), 0)
+
+    def test_shutdown_with_open_connections(self):
+        server = self.start()
+        idle = [server.connect() for _ in range(4)]
+        busy = server.connect()
+        try:
+            # Half a request, so that its connection thread is blocked reading the payload
+            busy.sendall(struct.pack("=III", 10, self.model.number_of_features, 0) + b"\x01" * 5)
+            time.sleep(0.1)
+            self.assertEqual(server.stop(), 0)
+        finally:
+            for connection in idle + [busy]:
+                connection.close()
+
+    def test_invalid_checkpoints_are_rejected(self):
+        with open(self.model_path, "rb") as f:
+            data = bytearray(f.read())
+
+        truncated = os.path.join(self.directory.name, "truncated.tmck")
+        with open(truncated, "wb") as f:
+            f.write(data[:len(data) // 2])
+
+        # number_of_clauses far beyond the file size
+        oversized = os.path.join(self.directory.name, "oversized.tmck")
+        data[16:20] = struct.pack("<I", 0x7fffffff)
+        with open(oversized, "wb") as f:
+            f.write(data)
+
+        for path in [truncated, oversized]:
+            result = subprocess.run(
+                [os.environ["TMULIB_SERVER"], "--model", path, "--socket", os.path.join(self.directory.name, "x.sock")],
+                capture_output=True, timeout=20
+            )
+            self.assertNotEqual(result.returncode, 0)
+            self.assertIn(b"Truncated checkpoint", result.stderr)
+
+
+@unittest.skipUnless(os.environ.get("TMULIB_SHARDED_SERVER"), "TMULIB_SHARDED_SERVER is not set")
+class ShardedServerTests(unittest.TestCase):
+
+    def setUp(self):
+        self.directory = tempfile.TemporaryDirectory()
+        self.model = RandomCheckpoint(number_of_classes=7)
+        self.model_path = os.path.join(self.directory.name, "model.tmck")
+        self.model.write(self.model_path)
+        self.X = np.random.RandomState(3).randint(2, size=(300, self.model.number_of_features))
+
+    def tearDown(self):
+        self.directory.cleanup()
+
+    def start(self, *options):
+        socket_path = os.path.join(self.directory.name, "sharded.sock")
+        command = [
+            os.environ["TMULIB_SHARDED_SERVER"], "--model", self.model_path, "--socket", socket_path,
+            "--shards", "3", *options
+        ]
+        return Process(command, socket_path)
+
+    def test_predictions_match_checkpoint(self):
+        expected_classes, expected_class_sums = self.model.predict(self.X)
+        server = self.start()
+        try:
+            with server.connect() as connection:
+                status, classes, class_sums = request(connection, self.X)
+                self.assertEqual(status, STATUS_OK)
+                np.testing.assert_array_equal(classes, expected_classes)
+                np.testing.assert_array_equal(class_sums, expected_class_sums)
+
+                status, document = counters(connection)
+                self.assertEqual(status, STATUS_OK)
+                self.assertEqual(json.loads(document)["samples"], len(self.X))
+                self.assertEqual(json.loads(document)["shards"], 3)
+        finally:
+            self.assertEqual(server.stop(), 0)
+
+    @unittest.skipUnless(os.environ.get("TMULIB_SERVER"), "TMULIB_SERVER is not set")
+    def test_matches_server(self):
+        sharded = self.start()
+        socket_path = os.path.join(self.directory.name, "server.sock")
+        server = Process(
+            [os.environ["TMULIB_SERVER"], "--model", self.model_path, "--socket", socket_path, "--threads", "2"],
+            socket_path
+        )
+        try:
+            with sharded.connect() as connection:
+                sharded_answer = request(connection, self.X)
+            with server.connect() as connection:
+                server_answer = request(connection, self.X)
+            self.assertEqual(sharded_answer[0], STATUS_OK)
+            self.assertEqual(server_answer[0], STATUS_OK)
+            np.testing.assert_array_equal(sharded_answer[1], server_answer[1])
+            np.testing.assert_array_equal(sharded_answer[2], server_answer[2])
+        finally:
+            self.assertEqual(server.stop(), 0)
+            self.assertEqual(sharded.stop(), 0)
+
+    def test_oversized_request_is_rejected(self):
+        server = self.start("--max-request", "16")
+        try:
+            with server.connect() as connection:
+                connection.sendall(struct.pack("=III", 0xffffffff, self.model.number_of_features, 0))
+                status, _, _ = struct.unpack("=III", read_exactly(connection, 12))
+                self.assertEqual(status, STATUS_BAD_REQUEST)
+                self.assertEqual(connection.recv(1), b"")
+
+            with server.connect() as connection:
+                status, classes, _ = request(connection, self.X[:16])
+                self.assertEqual(status, STATUS_OK)
+                np.testing.assert_array_equal(classes, self.model.predict(self.X[:16])[0])
+        finally:
+            self.assertEqual(server.stop(), 0)
+
+    def test_shutdown_with_open_connections(self):
+        server = self.start()
+        idle = [server.connect() for _ in range(4)]
+        busy = server.connect()
+        try:
+            busy.sendall(struct.pack("=III", 10, self.model.number_of_features, 0) + b"\x01" * 5)
+            time.sleep(0.1)
+            self.assertEqual(server.stop(), 0)
+        finally:
+            for connection in idle + [busy]:
+                connection.close()
+
+
+
+@unittest.skipUnless(os.environ.get("TMULIB_DISTRIBUTED"), "TMULIB_DISTRIBUTED is not set")
+class DistributedTests(unittest.TestCase):
+
+    def setUp(self):
+        self.directory = tempfile.TemporaryDirectory()
+
+    def tearDown(self):
+        self.directory.cleanup()
+
+    def run_tool(self, *options, timeout=120):
+        return subprocess.run([os.environ["TMULIB_DISTRIBUTED"], *options], capture_output=True, timeout=timeout)
+
+    def test_local_role_trains_with_both_merge_modes(self):
+        for merge in ["average", "vote"]:
+            with self.subTest(merge=merge):
+                output = os.path.join(self.directory.name, merge + ".tmck")
+                result = self.run_tool(
+                    "--role", "local", "--workers", "2", "--merge", merge, "--epochs", "2",
+                    "--samples", "2000", "--test-samples", "500", "--features", "32", "--classes", "3",
+                    "--clauses", "40", "--T", "20", "--s", "3", "--output", output
+                )
+                self.assertEqual(result.returncode, 0, result.stderr.decode())
+
+                document = json.loads(result.stdout)
+                self.assertEqual(document["workers"], 2)
+                self.assertEqual(document["merge"], merge)
+                self.assertEqual(len(document["epochs"]), 2)
+                self.assertGreater(document["epochs"][-1]["accuracy"], 0.8)
+
+                with open(output, "rb") as f:
+                    magic, version, _, number_of_classes, number_of_clauses = struct.unpack("<IIiII", f.read(20))
+                self.assertEqual((magic, version), (TMCK_MAGIC, TMCK_VERSION))
+                self.assertEqual((number_of_classes, number_of_clauses), (3, 40))
+
+    def test_local_role_fails_when_a_worker_dies(self):
+        process = subprocess.Popen(
+            [os.environ["TMULIB_DISTRIBUTED"], "--role", "local", "--workers", "2", "--samples", "200000",
+             "--epochs", "1"],
+            stdout=subprocess.PIPE, stderr=subprocess.PIPE
+        )
+        try:
+            deadline = time.monotonic() + 10
+            children = []
+            while len(children) < 2 and time.monotonic() < deadline:
+                with open("/proc/%d/task/%d/children" % (process.pid, process.pid)) as f:
+                    children = [int(pid) for pid in f.read().split()]
+            os.kill(children[0], signal.SIGKILL)
+
+            _, stderr = process.communicate(timeout=60)
+            self.assertNotEqual(process.returncode, 0)
+            self.assertIn(b"worker", stderr)
+        finally:
+            if process.poll() is None:
+                process.kill()
+                process.communicate()
+
+    def test_coordinator_gives_up_when_workers_do_not_connect(self):
+        result = self.run_tool(
+            "--role", "coordinator", "--workers", "2", "--socket", os.path.join(self.directory.name, "c.sock"),
+            "--samples", "200", "--accept-timeout-s", "1", timeout=30
+        )
+        self.assertNotEqual(result.returncode, 0)
+        self.assertIn(b"did not connect in time", result.stderr)
+
+    def test_coordinator_refuses_oversized_frames(self):
+        socket_path = os.path.join(self.directory.name, "c.sock")
+        process = subprocess.Popen(
+            [os.environ["TMULIB_DISTRIBUTED"], "--role", "coordinator", "--workers", "1", "--socket", socket_path,
+             "--samples", "200", "--accept-timeout-s", "30"],
+            stdout=subprocess.PIPE, stderr=subprocess.PIPE
+        )
+        try:
+            connection = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+            deadline = time.monotonic() + 20
+            while True:
+                try:
+                    connection.connect(socket_path)
+                    break
+                except OSError:
+                    if time.monotonic() > deadline:
+                        raise
+                    time.sleep(0.05)
+
+            # A HELLO frame announcing 1 TiB
+            with connection:
+                connection.sendall(struct.pack("=IQ", 1, 1 << 40))
+                _, stderr = process.communicate(timeout=20)
+            self.assertNotEqual(process.returncode, 0)
+            self.assertIn(b"exceeds the limit", stderr)
+        finally:
+            if process.poll() is None:
+                process.kill()
+                process.communicate()
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,348 @@
+// End-to-end throughput benchmark. Trains and evaluates TMVanillaClassifier on seeded synthetic data from
+// TMDataset, so runs are reproducible without any dataset on disk, and prints one JSON document.
+//
+// Configurations:
+//   vanilla        flat features from --dataset
+//   convolutional  --image-side images of the XOR dataset, --patch-size square patches
+//   incremental    as vanilla, with incremental clause evaluation
+//   sparse         noisy conjunctions with background features on with probability --sparse-density
+//
+// Per configuration: train samples/s (median epoch), batch predict samples/s, single-sample predict latency
+// percentiles, accuracy, the resident memory the model added (without the encoded training data it keeps) and the
+// peak resident memory of the process so far.
+// Builds with TMU_INSTRUMENTATION add the phase timers and kernel counters of each configuration.
+//
+// Usage: tmulib_bench [--configs vanilla,convolutional,incremental,sparse] [--dataset conjunction|parity|xor]
+//                     [--samples 5000] [--test-samples 1000] [--features 128] [--classes 4] [--noise 0.05]
+//                     [--image-side 12] [--patch-size 3] [--sparse-density 0.05] [--clauses 200] [--T 200] [--s 5]
+//                     [--epochs 3] [--batch-size 100] [--latency-samples 500] [--seed 42] [--output results.json]
+//
+
+#include "models/classifiers/tm_vanilla.h"
+#include "tm_instrumentation.h"
+#include "utils/tm_benchmark.h"
+#include "utils/tm_dataset.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct Options {
+    std::vector<std::string> configs = {"vanilla", "convolutional", "incremental", "sparse"};
+    std::string dataset = "conjunction";
+    int samples = 5000;
+    int test_samples = 1000;
+    int features = 128;
+    int classes = 4;
+    float noise = 0.05f;
+    int image_side = 12;
+    int patch_size = 3;
+    float sparse_density = 0.05f;
+    uint32_t clauses = 200;
+    int T = 200;
+    float s = 5.0f;
+    int epochs = 3;
+    int batch_size = 100;
+    int latency_samples = 500;
+    uint32_t seed = 42;
+    std::string output;
+};
+
+struct Dataset {
+    std::string name;
+    std::vector<uint32_t> X;
+    std::vector<uint32_t> y;
+    std::vector<int32_t> X_shape;
+};
+
+// Training and test data come from one draw, so both follow the same conjunctions
+std::pair<Dataset, Dataset> generate(const std::string& name, const Options& options, float density){
+    const int total = options.samples + options.test_samples;
+    Dataset all;
+    all.name = name;
+
+    if (name == "conjunction") {
+        TMDataset::generate_noisy_conjunction_dataset(all.X, all.y, all.X_shape, total, options.features,
+                options.classes, std::min(6, options.features), density, options.noise, options.seed);
+    } else if (name == "parity") {
+        TMDataset::generate_parity_dataset(all.X, all.y, all.X_shape, total, options.features,
+                std::min(3, options.features), options.noise, options.seed);
+    } else if (name == "xor") {
+        TMDataset::generate_xor_dataset(all.X, all.y, all.X_shape, total, options.image_side, 0.02f,
+                options.noise, options.seed);
+    } else {
+        throw std::invalid_argument("Unknown dataset " + name);
+    }
+
+    const std::size_t sample_size = all.X.size() / total;
+    const auto split = [&](int begin, int end) {
+        Dataset part;
+        part.name = name;
+        part.X.assign(all.X.begin() + begin * sample_size, all.X.begin() + end * sample_size);
+        part.y.assign(all.y.begin() + begin, all.y.begin() + end);
+        part.X_shape = all.X_shape;
+        part.X_shape[0] = end - begin;
+        return part;
+    };
+    return {split(0, options.samples), split(options.samples, total)};
+}
+
+std::string instrumentation_json(const TMInstrumentationSnapshot& snapshot){
+    TMJsonObject phases;
+    for (std::size_t p = 0; p < TMInstrumentation::number_of_phases; ++p) {
+        const auto& stats = snapshot.phases[p];
+        TMJsonObject phase;
+        phase.add("calls", static_cast<std::size_t>(stats.calls))
+             .add("ns", static_cast<std::size_t>(stats.ns));
+        if (snapshot.hardware_counters) {
+            for (std::size_t c = 0; c < TMInstrumentation::number_of_hardware_counters; ++c) {
+                phase.add(TMInstrumentation::hardware_counter_name(static_cast<TMHardwareCounter>(c)),
+                          static_cast<std::size_t>(stats.hardware[c]));
+            }
+        }
+        phases.add_raw(TMInstrumentation::phase_name(static_cast<TMPhase>(p)), phase.str());
+    }
+
+    TMJsonObject counters;
+    const auto* values = reinterpret_cast<const uint64_t*>(&snapshot.counters);
+    for (std::size_t c = 0; c < TMInstrumentation::number_of_counters; ++c) {
+        counters.add(TMInstrumentation::counter_name(c), static_cast<std::size_t>(values[c]));
+    }
+
+    TMJsonObject out;
+    out.add("hardware_counters", snapshot.hardware_counters)
+       .add_raw("phases", phases.str())
+       .add_raw("counters", counters.str());
+    return out.str();
+}
+
+std::string run(const std::string& config, const Options& options){
+    const bool convolutional = config == "convolutional";
+    const bool incremental = config == "incremental";
+    const bool sparse = config == "sparse";
+    if (!convolutional && !incremental && !sparse && config != "vanilla") {
+        throw std::invalid_argument("Unknown configuration " + config);
+    }
+
+    const std::string dataset_name = convolutional ? "xor" : sparse ? "conjunction" : options.dataset;
+    auto [train, test] = generate(dataset_name, options, sparse ? options.sparse_density : 0.5f);
+
+    tl::optional<std::vector<int>> patch_dim = tl::nullopt;
+    if (convolutional) {
+        patch_dim = std::vector<int>{options.patch_size, options.patch_size};
+    }
+
+    TMInstrumentation::reset();
+    const std::size_t memory_before = TMBenchmark::current_memory_bytes();
+    TMVanillaClassifier<uint32_t> classifier(
+            options.T,
+            options.s,
+            200.0,
+            options.clauses,
+            false,
+            true,
+            true,
+            true,
+            false,
+            1.0,
+            tl::nullopt,
+            true,
+            false,
+            patch_dim,
+            8,
+            8,
+            options.batch_size,
+            incremental,
+            static_cast<int>(options.seed)
+    );
+
+    const auto x_train = tcb::span<uint32_t>(train.X.data(), train.X.size());
+    const auto y_train = tcb::span<uint32_t>(train.y.data(), train.y.size());
+    const auto x_test = tcb::span<uint32_t>(test.X.data(), test.X.size());
+
+    std::vector<double> epoch_s;
+    for (int epoch = 0; epoch < options.epochs; ++epoch) {
+        const auto begin = TMBenchmark::Clock::now();
+        classifier.fit(y_train, x_train, train.X_shape, true);
+        epoch_s.push_back(std::chrono::duration<double>(TMBenchmark::Clock::now() - begin).count());
+    }
+    const std::size_t memory_after = TMBenchmark::current_memory_bytes();
+    const std::size_t added_bytes = memory_after > memory_before ? memory_after - memory_before : 0;
+
+    // The classifier keeps the encoded training data, which is not part of the model
+    const std::size_t encoded_train_bytes = classifier.encoded_X_train_cached.capacity() * sizeof(uint32_t);
+    const std::size_t model_bytes = added_bytes > encoded_train_bytes ? added_bytes - encoded_train_bytes : 0;
+
+    std::vector<int32_t> y_pred(test.y.size());
+    const auto predict_begin = TMBenchmark::Clock::now();
+    classifier.predict_batch(x_test, test.X_shape, false, y_pred.data());
+    const double predict_s = std::chrono::duration<double>(TMBenchmark::Clock::now() - predict_begin).count();
+
+    // Predictions are class positions, labels are class ids
+    const auto& classes = classifier.weight_banks.get_classes();
+    std::size_t correct = 0;
+    for (std::size_t i = 0; i < y_pred.size(); ++i) {
+        correct += static_cast<uint32_t>(classes[y_pred[i]]) == test.y[i];
+    }
+
+    // One sample per call, as a server would see a single request
+    const std::size_t sample_size = test.X.size() / test.y.size();
+    std::vector<int32_t> single_shape = test.X_shape;
+    single_shape[0] = 1;
+    const std::size_t latency_samples = std::min<std::size_t>(options.latency_samples, test.y.size());
+    std::vector<double> latency_us;
+    latency_us.reserve(latency_samples);
+    for (std::size_t i = 0; i < latency_samples; ++i) {
+        const auto xi = tcb::span<uint32_t>(test.X.data() + i * sample_size, sample_size);
+        int32_t argmax = 0;
+        const auto begin = TMBenchmark::Clock::now();
+        classifier.predict_batch(xi, single_shape, false, &argmax);
+        latency_us.push_back(std::chrono::duration<double, std::micro>(TMBenchmark::Clock::now() - begin).count());
+    }
+
+    std::vector<std::string> epoch_json;
+    for (const double seconds : epoch_s) {
+        std::ostringstream out;
+        out << seconds;
+        epoch_json.push_back(out.str());
+    }
+    const double median_epoch_s = epoch_s.empty() ? NAN : TMBenchmark::percentile(epoch_s, 50);
+
+    TMJsonObject result;
+    result.add("config", config)
+          .add("dataset", dataset_name)
+          .add("train_samples", train.y.size())
+          .add("test_samples", test.y.size())
+          .add("sample_size", sample_size)
+          .add("clauses", static_cast<std::size_t>(options.clauses))
+          .add("patches", convolutional ? static_cast<std::size_t>((options.image_side - options.patch_size + 1) *
+                                                                    (options.image_side - options.patch_size + 1))
+                                        : std::size_t(1))
+          .add("epochs", options.epochs)
+          .add_raw("epoch_s", TMJsonObject::array(epoch_json))
+          .add("train_samples_per_s", median_epoch_s > 0 ? train.y.size() / median_epoch_s : NAN)
+          .add("predict_samples_per_s", predict_s > 0 ? test.y.size() / predict_s : NAN)
+          .add("latency_us_p50", latency_us.empty() ? NAN : TMBenchmark::percentile(latency_us, 50))
+          .add("latency_us_p90", latency_us.empty() ? NAN : TMBenchmark::percentile(latency_us, 90))
+          .add("latency_us_p99", latency_us.empty() ? NAN : TMBenchmark::percentile(latency_us, 99))
+          .add("latency_us_max", latency_us.empty() ? NAN : TMBenchmark::percentile(latency_us, 100))
+          .add("accuracy", test.y.empty() ? NAN : static_cast<double>(correct) / test.y.size())
+          .add("model_rss_bytes", model_bytes)
+          .add("encoded_train_bytes", encoded_train_bytes)
+          .add("peak_rss_bytes", TMBenchmark::peak_memory_bytes());
+    if (TMInstrumentation::enabled) {
+        result.add_raw("instrumentation", instrumentation_json(TMInstrumentation::snapshot()));
+    }
+    return result.str();
+}
+
+Options parse_options(int argc, char** argv) {
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        const auto value = [&]() -> std::string {
+            if (i + 1 >= argc) {
+                throw std::invalid_argument("Missing value for " + arg);
+            }
+            return argv[++i];
+        };
+
+        if (arg == "--configs") {
+            options.configs = TMBenchmark::parse_list<std::string>(value());
+        } else if (arg == "--dataset") {
+            options.dataset = value();
+        } else if (arg == "--samples") {
+            options.samples = std::stoi(value());
+        } else if (arg == "--test-samples") {
+            options.test_samples = std::stoi(value());
+        } else if (arg == "--features") {
+            options.features = std::stoi(value());
+        } else if (arg == "--classes") {
+            options.classes = std::stoi(value());
+        } else if (arg == "--noise") {
+            options.noise = std::stof(value());
+        } else if (arg == "--image-side") {
+            options.image_side = std::stoi(value());
+        } else if (arg == "--patch-size") {
+            options.patch_size = std::stoi(value());
+        } else if (arg == "--sparse-density") {
+            options.sparse_density = std::stof(value());
+        } else if (arg == "--clauses") {
+            options.clauses = static_cast<uint32_t>(std::stoul(value()));
+        } else if (arg == "--T") {
+            options.T = std::stoi(value());
+        } else if (arg == "--s") {
+            options.s = std::stof(value());
+        } else if (arg == "--epochs") {
+            options.epochs = std::stoi(value());
+        } else if (arg == "--batch-size") {
+            options.batch_size = std::max(1, std::stoi(value()));
+        } else if (arg == "--latency-samples") {
+            options.latency_samples = std::max(0, std::stoi(value()));
+        } else if (arg == "--seed") {
+            options.seed = static_cast<uint32_t>(std::stoul(value()));
+        } else if (arg == "--output") {
+            options.output = value();
+        } else {
+            throw std::invalid_argument(
+                    "Usage: tmulib_bench [--configs vanilla,convolutional,incremental,sparse] "
+                    "[--dataset conjunction|parity|xor] [--samples N] [--test-samples N] [--features N] "
+                    "[--classes N] [--noise P] [--image-side N] [--patch-size N] [--sparse-density P] "
+                    "[--clauses N] [--T N] [--s S] [--epochs N] [--batch-size N] [--latency-samples N] [--seed N] "
+                    "[--output results.json]");
+        }
+    }
+
+    if (options.samples < 1 || options.test_samples < 1 || options.features < 1 || options.epochs < 0) {
+        throw std::invalid_argument("--samples, --test-samples and --features must be positive");
+    }
+    if (options.patch_size < 1 || options.patch_size > options.image_side) {
+        throw std::invalid_argument("--patch-size must be in [1, --image-side]");
+    }
+    return options;
+}
+
+} // namespace
+
+
+int main(int argc, char** argv) {
+    try {
+        const auto options = parse_options(argc, argv);
+        // Only takes effect in builds with TMU_PERF_EVENTS
+        TMInstrumentation::enable_hardware_counters(true);
+
+        std::vector<std::string> results;
+        for (const auto& config : options.configs) {
+            results.push_back(run(config, options));
+            std::cerr << "Finished " << config << std::endl;
+        }
+
+        TMJsonObject document;
+        document.add("benchmark", "tmulib_bench")
+                .add("seed", static_cast<std::size_t>(options.seed))
+                .add_raw("results", TMJsonObject::array(results));
+
+        if (options.output.empty()) {
+            std::cout << document.str() << std::endl;
+        } else {
+            std::ofstream out(options.output);
+            if (!out) {
+                throw std::runtime_error("Could not open " + options.output);
+            }
+            out << document.str() << std::endl;
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "An error occurred: " << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
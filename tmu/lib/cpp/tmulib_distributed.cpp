@@ -0,0 +1,494 @@
+// Data-parallel training of TMVanillaClassifier across processes. Every worker trains a replica on its shard of the
+// training data; after every --sync-samples samples per worker the replicas are sent to a coordinator, which merges
+// them with TMModelMerge and sends the merged model back, so all workers continue from the same state.
+//
+// Roles:
+//   local        (default) the coordinator forks --workers worker processes on this machine
+//   coordinator  waits for --workers workers to connect, e.g. from other machines with --host 0.0.0.0
+//   worker       trains shard --rank of --workers and connects to the coordinator
+//
+// All processes generate the same seeded synthetic data from TMDataset, so only models travel over the socket: a
+// Unix domain socket with --socket, TCP on --host:--port otherwise. Frames are uint32 kind, uint64 size, payload:
+//   worker -> coordinator:  HELLO uint32 rank, then one MODEL checkpoint per round
+//   coordinator -> worker:  MERGED checkpoint per round
+//
+// The coordinator evaluates the merged model after every epoch and prints one JSON document. It gives up when not all
+// workers have connected within --accept-timeout-s seconds, or, with the local role, as soon as a worker exits.
+// Frames are bounded by the size of the model, which is the same in every process.
+//
+// Usage: tmulib_distributed [--role local|coordinator|worker] [--workers 4] [--rank 0] [--socket path]
+//                           [--host 127.0.0.1] [--port N] [--merge average|vote] [--sync-samples N] [--epochs 3]
+//                           [--dataset conjunction|parity|xor] [--samples 20000] [--test-samples 2000]
+//                           [--features 128] [--classes 4] [--noise 0.05] [--clauses 200] [--T 200] [--s 5]
+//                           [--batch-size 100] [--merge-threads 0] [--seed 42] [--accept-timeout-s 120]
+//                           [--output model.tmck]
+//
+
+#include "models/classifiers/tm_vanilla.h"
+#include "utils/tm_benchmark.h"
+#include "utils/tm_dataset.h"
+#include "utils/tm_model_merge.h"
+#include "utils/tm_socket.h"
+
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr uint32_t KIND_HELLO = 1;
+constexpr uint32_t KIND_MODEL = 2;
+constexpr uint32_t KIND_MERGED = 3;
+
+struct Options {
+    std::string role = "local";
+    int workers = 4;
+    int rank = 0;
+    std::string socket_path;
+    std::string host = "127.0.0.1";
+    int port = 0;
+    TMMergeMode merge = TMMergeMode::average;
+    std::string merge_name = "average";
+    int sync_samples = 0;
+    int epochs = 3;
+    std::string dataset = "conjunction";
+    int samples = 20000;
+    int test_samples = 2000;
+    int features = 128;
+    int classes = 4;
+    float noise = 0.05f;
+    uint32_t clauses = 200;
+    int T = 200;
+    float s = 5.0f;
+    int batch_size = 100;
+    std::size_t merge_threads = 0;
+    uint32_t seed = 42;
+    double accept_timeout_s = 120;
+    std::string output;
+};
+
+struct Dataset {
+    std::vector<uint32_t> X;
+    std::vector<uint32_t> y;
+    std::vector<int32_t> X_shape;
+
+    [[nodiscard]] std::size_t sample_size() const {
+        return y.empty() ? 0 : X.size() / y.size();
+    }
+
+    [[nodiscard]] Dataset slice(std::size_t begin, std::size_t end) const {
+        Dataset part;
+        part.X.assign(X.begin() + begin * sample_size(), X.begin() + end * sample_size());
+        part.y.assign(y.begin() + begin, y.begin() + end);
+        part.X_shape = X_shape;
+        part.X_shape[0] = static_cast<int32_t>(end - begin);
+        return part;
+    }
+};
+
+// Training and test data come from one draw, identical in every process
+std::pair<Dataset, Dataset> generate(const Options& options){
+    const int total = options.samples + options.test_samples;
+    Dataset all;
+    if (options.dataset == "conjunction") {
+        TMDataset::generate_noisy_conjunction_dataset(all.X, all.y, all.X_shape, total, options.features,
+                options.classes, std::min(6, options.features), 0.5f, options.noise, options.seed);
+    } else if (options.dataset == "parity") {
+        TMDataset::generate_parity_dataset(all.X, all.y, all.X_shape, total, options.features,
+                std::min(3, options.features), options.noise, options.seed);
+    } else if (options.dataset == "xor") {
+        TMDataset::generate_xor_dataset(all.X, all.y, all.X_shape, total, 12, 0.02f, options.noise, options.seed);
+    } else {
+        throw std::invalid_argument("Unknown dataset " + options.dataset);
+    }
+    return {all.slice(0, options.samples), all.slice(options.samples, total)};
+}
+
+TMVanillaClassifier<uint32_t> make_classifier(const Options& options, int seed){
+    return TMVanillaClassifier<uint32_t>(
+            options.T,
+            options.s,
+            200.0,
+            options.clauses,
+            false,
+            true,
+            true,
+            true,
+            false,
+            1.0,
+            tl::nullopt,
+            true,
+            false,
+            tl::nullopt,
+            8,
+            8,
+            options.batch_size,
+            false,
+            seed
+    );
+}
+
+// Initializes on the whole training set, so every replica has every class in the same order
+void initialize(TMVanillaClassifier<uint32_t>& classifier, Dataset& train){
+    classifier.init(
+            tcb::span<uint32_t>(train.y.data(), train.y.size()),
+            tcb::span<uint32_t>(train.X.data(), train.X.size()),
+            train.X_shape
+    );
+}
+
+std::size_t shard_begin(const Options& options, int rank){
+    return static_cast<std::size_t>(options.samples) * rank / options.workers;
+}
+
+// Rounds per epoch follow the largest shard, so all workers take part in every round
+std::size_t rounds_per_epoch(const Options& options){
+    std::size_t largest = 0;
+    for (int rank = 0; rank < options.workers; ++rank) {
+        largest = std::max(largest, shard_begin(options, rank + 1) - shard_begin(options, rank));
+    }
+    const std::size_t sync = options.sync_samples > 0 ? static_cast<std::size_t>(options.sync_samples) : largest;
+    return std::max<std::size_t>(1, (largest + sync - 1) / sync);
+}
+
+void run_worker(const Options& options){
+    auto [train, test] = generate(options);
+    (void)test;
+
+    auto classifier = make_classifier(options, static_cast<int>(options.seed) + 1 + options.rank);
+    initialize(classifier, train);
+
+    const Dataset shard = train.slice(shard_begin(options, options.rank), shard_begin(options, options.rank + 1));
+    const std::size_t rounds = rounds_per_epoch(options);
+    const std::size_t round_samples = (shard.y.size() + rounds - 1) / rounds;
+
+    // One encoded slice per round, reused every epoch
+    std::vector<Dataset> slices;
+    for (std::size_t round = 0; round < rounds; ++round) {
+        const std::size_t begin = std::min(shard.y.size(), round * round_samples);
+        slices.push_back(shard.slice(begin, std::min(shard.y.size(), begin + round_samples)));
+    }
+
+    const int fd = TMSocket::connect(options.socket_path, options.host, options.port);
+    const uint32_t rank = static_cast<uint32_t>(options.rank);
+    if (!TMSocket::send_frame(fd, KIND_HELLO, &rank, sizeof(rank))) {
+        throw std::runtime_error("Lost the coordinator");
+    }
+
+    std::string payload;
+    for (int epoch = 0; epoch < options.epochs; ++epoch) {
+        for (auto& slice : slices) {
+            if (!slice.y.empty()) {
+                classifier.fit(
+                        tcb::span<uint32_t>(slice.y.data(), slice.y.size()),
+                        tcb::span<uint32_t>(slice.X.data(), slice.X.size()),
+                        slice.X_shape,
+                        true
+                );
+            }
+
+            uint32_t kind = 0;
+            const std::string model = classifier.get_checkpoint().serialize();
+            if (!TMSocket::send_frame(fd, KIND_MODEL, model)
+                || !TMSocket::receive_frame(fd, kind, payload, model.size()) || kind != KIND_MERGED) {
+                throw std::runtime_error("Lost the coordinator");
+            }
+            classifier.load_checkpoint(TMCheckpoint::deserialize(payload));
+        }
+    }
+    ::close(fd);
+}
+
+/*
+ * Accepts one connection per rank within --accept-timeout-s. check_workers is called while waiting, and throws when
+ * a worker can no longer connect.
+ */
+std::vector<int> accept_workers(int listener, const Options& options, const std::function<void()>& check_workers){
+    const auto deadline = TMBenchmark::Clock::now() + std::chrono::duration_cast<TMBenchmark::Clock::duration>(
+            std::chrono::duration<double>(options.accept_timeout_s));
+
+    std::vector<int> connections(options.workers, -1);
+    for (int accepted = 0; accepted < options.workers; ++accepted) {
+        int fd = -1;
+        while (fd < 0) {
+            check_workers();
+            if (TMBenchmark::Clock::now() >= deadline) {
+                throw std::runtime_error(std::to_string(options.workers - accepted) + " of "
+                                         + std::to_string(options.workers) + " workers did not connect in time");
+            }
+            fd = TMSocket::accept(listener, 100);
+        }
+
+        // The introduction is one small frame, which a peer must send promptly
+        uint32_t kind = 0;
+        std::string payload;
+        TMSocket::set_receive_timeout(fd, 10);
+        if (!TMSocket::receive_frame(fd, kind, payload, sizeof(uint32_t)) || kind != KIND_HELLO
+            || payload.size() != sizeof(uint32_t)) {
+            throw std::runtime_error("A worker did not introduce itself");
+        }
+        TMSocket::set_receive_timeout(fd, 0);
+        uint32_t rank = 0;
+        std::memcpy(&rank, payload.data(), sizeof(rank));
+        if (rank >= connections.size() || connections[rank] >= 0) {
+            throw std::runtime_error("Unexpected worker rank " + std::to_string(rank));
+        }
+        connections[rank] = fd;
+    }
+    return connections;
+}
+
+std::string run_coordinator(int listener, const Options& options, const std::function<void()>& check_workers){
+    auto [train, test] = generate(options);
+    auto evaluator = make_classifier(options, static_cast<int>(options.seed));
+    initialize(evaluator, train);
+    const std::size_t max_model_bytes = evaluator.get_checkpoint().serialize().size();
+
+    const auto connections = accept_workers(listener, options, check_workers);
+    const std::size_t rounds = rounds_per_epoch(options);
+    const auto started = TMBenchmark::Clock::now();
+
+    std::vector<std::string> epochs;
+    std::vector<TMCheckpoint> replicas(options.workers);
+    std::string payload;
+    std::size_t model_bytes = 0;
+    for (int epoch = 0; epoch < options.epochs; ++epoch) {
+        const auto epoch_started = TMBenchmark::Clock::now();
+        double merge_s = 0;
+        for (std::size_t round = 0; round < rounds; ++round) {
+            for (int rank = 0; rank < options.workers; ++rank) {
+                uint32_t kind = 0;
+                if (!TMSocket::receive_frame(connections[rank], kind, payload, max_model_bytes) || kind != KIND_MODEL) {
+                    throw std::runtime_error("Lost worker " + std::to_string(rank));
+                }
+                replicas[rank] = TMCheckpoint::deserialize(payload);
+                model_bytes = payload.size();
+            }
+
+            const auto merge_started = TMBenchmark::Clock::now();
+            const std::string merged = TMModelMerge::merge(replicas, options.merge, options.merge_threads).serialize();
+            merge_s += std::chrono::duration<double>(TMBenchmark::Clock::now() - merge_started).count();
+
+            for (int rank = 0; rank < options.workers; ++rank) {
+                if (!TMSocket::send_frame(connections[rank], KIND_MERGED, merged)) {
+                    throw std::runtime_error("Lost worker " + std::to_string(rank));
+                }
+            }
+            if (round + 1 == rounds) {
+                evaluator.load_checkpoint(TMCheckpoint::deserialize(merged));
+            }
+        }
+        const double epoch_s = std::chrono::duration<double>(TMBenchmark::Clock::now() - epoch_started).count();
+
+        std::vector<int32_t> y_pred(test.y.size());
+        evaluator.predict_batch(tcb::span<uint32_t>(test.X.data(), test.X.size()), test.X_shape, false, y_pred.data());
+        std::size_t correct = 0;
+        for (std::size_t i = 0; i < y_pred.size(); ++i) {
+            correct += static_cast<uint32_t>(y_pred[i]) == test.y[i];
+        }
+
+        TMJsonObject result;
+        result.add("epoch", epoch)
+              .add("seconds", epoch_s)
+              .add("merge_seconds", merge_s)
+              .add("train_samples_per_s", epoch_s > 0 ? options.samples / epoch_s : NAN)
+              .add("accuracy", test.y.empty() ? NAN : static_cast<double>(correct) / test.y.size());
+        epochs.push_back(result.str());
+        std::cerr << "Epoch " << epoch << ": " << result.str() << std::endl;
+    }
+
+    for (const int fd : connections) {
+        ::close(fd);
+    }
+    if (!options.output.empty()) {
+        evaluator.save_checkpoint(options.output);
+    }
+
+    TMJsonObject document;
+    document.add("tool", "tmulib_distributed")
+            .add("workers", options.workers)
+            .add("merge", options.merge_name)
+            .add("dataset", options.dataset)
+            .add("train_samples", static_cast<std::size_t>(options.samples))
+            .add("rounds_per_epoch", rounds)
+            .add("model_bytes", model_bytes)
+            .add("seconds", std::chrono::duration<double>(TMBenchmark::Clock::now() - started).count())
+            .add_raw("epochs", TMJsonObject::array(epochs));
+    return document.str();
+}
+
+Options parse_options(int argc, char** argv) {
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        const auto value = [&]() -> std::string {
+            if (i + 1 >= argc) {
+                throw std::invalid_argument("Missing value for " + arg);
+            }
+            return argv[++i];
+        };
+
+        if (arg == "--role") {
+            options.role = value();
+        } else if (arg == "--workers") {
+            options.workers = std::stoi(value());
+        } else if (arg == "--rank") {
+            options.rank = std::stoi(value());
+        } else if (arg == "--socket") {
+            options.socket_path = value();
+        } else if (arg == "--host") {
+            options.host = value();
+        } else if (arg == "--port") {
+            options.port = std::stoi(value());
+        } else if (arg == "--merge") {
+            options.merge_name = value();
+            options.merge = TMModelMerge::parse_mode(options.merge_name);
+        } else if (arg == "--sync-samples") {
+            options.sync_samples = std::stoi(value());
+        } else if (arg == "--epochs") {
+            options.epochs = std::stoi(value());
+        } else if (arg == "--dataset") {
+            options.dataset = value();
+        } else if (arg == "--samples") {
+            options.samples = std::stoi(value());
+        } else if (arg == "--test-samples") {
+            options.test_samples = std::stoi(value());
+        } else if (arg == "--features") {
+            options.features = std::stoi(value());
+        } else if (arg == "--classes") {
+            options.classes = std::stoi(value());
+        } else if (arg == "--noise") {
+            options.noise = std::stof(value());
+        } else if (arg == "--clauses") {
+            options.clauses = static_cast<uint32_t>(std::stoul(value()));
+        } else if (arg == "--T") {
+            options.T = std::stoi(value());
+        } else if (arg == "--s") {
+            options.s = std::stof(value());
+        } else if (arg == "--batch-size") {
+            options.batch_size = std::max(1, std::stoi(value()));
+        } else if (arg == "--merge-threads") {
+            options.merge_threads = std::stoul(value());
+        } else if (arg == "--seed") {
+            options.seed = static_cast<uint32_t>(std::stoul(value()));
+        } else if (arg == "--accept-timeout-s") {
+            options.accept_timeout_s = std::stod(value());
+        } else if (arg == "--output") {
+            options.output = value();
+        } else {
+            throw std::invalid_argument(
+                    "Usage: tmulib_distributed [--role local|coordinator|worker] [--workers N] [--rank N] "
+                    "[--socket path] [--host address] [--port N] [--merge average|vote] [--sync-samples N] "
+                    "[--epochs N] [--dataset conjunction|parity|xor] [--samples N] [--test-samples N] "
+                    "[--features N] [--classes N] [--noise P] [--clauses N] [--T N] [--s S] [--batch-size N] "
+                    "[--merge-threads N] [--seed N] [--accept-timeout-s S] [--output model.tmck]");
+        }
+    }
+
+    if (options.role != "local" && options.role != "coordinator" && options.role != "worker") {
+        throw std::invalid_argument("Unknown role " + options.role);
+    }
+    if (options.workers < 1 || options.rank < 0 || options.rank >= options.workers) {
+        throw std::invalid_argument("--workers must be positive and --rank in [0, --workers)");
+    }
+    if (options.samples < options.workers || options.test_samples < 1 || options.epochs < 0) {
+        throw std::invalid_argument("--samples must be at least --workers and --test-samples positive");
+    }
+    if (options.role != "local" && options.socket_path.empty() && options.port == 0) {
+        throw std::invalid_argument("--socket or --port is required for the coordinator and worker roles");
+    }
+    if (options.role == "local" && options.socket_path.empty() && options.port == 0) {
+        options.socket_path = "/tmp/tmulib_distributed." + std::to_string(::getpid()) + ".sock";
+    }
+    return options;
+}
+
+} // namespace
+
+
+int main(int argc, char** argv) {
+    try {
+        const auto options = parse_options(argc, argv);
+        if (options.role == "worker") {
+            run_worker(options);
+            return 0;
+        }
+
+        const int listener = TMSocket::listen(options.socket_path, options.host, options.port);
+        std::vector<pid_t> children;
+        if (options.role == "local") {
+            for (int rank = 0; rank < options.workers; ++rank) {
+                const pid_t pid = ::fork();
+                if (pid < 0) {
+                    throw std::runtime_error(std::string("Could not fork: ") + std::strerror(errno));
+                }
+                if (pid == 0) {
+                    ::close(listener);
+                    int status = 0;
+                    try {
+                        Options worker = options;
+                        worker.rank = rank;
+                        run_worker(worker);
+                    } catch (const std::exception& e) {
+                        std::cerr << "Worker " << rank << ": An error occurred: " << e.what() << std::endl;
+                        status = 1;
+                    }
+                    std::cout.flush();
+                    ::_exit(status);
+                }
+                children.push_back(pid);
+            }
+        }
+
+        // Forked workers that exit before the run ends can never connect or send their model again
+        const auto check_workers = [&children]() {
+            for (const pid_t pid : children) {
+                int status = 0;
+                if (::waitpid(pid, &status, WNOHANG) == pid) {
+                    throw std::runtime_error("A worker exited before the run ended");
+                }
+            }
+        };
+
+        std::string document;
+        try {
+            document = run_coordinator(listener, options, check_workers);
+        } catch (...) {
+            for (const pid_t pid : children) {
+                ::kill(pid, SIGTERM);
+                ::waitpid(pid, nullptr, 0);
+            }
+            if (!options.socket_path.empty()) {
+                ::unlink(options.socket_path.c_str());
+            }
+            throw;
+        }
+        ::close(listener);
+        if (!options.socket_path.empty()) {
+            ::unlink(options.socket_path.c_str());
+        }
+
+        for (const pid_t pid : children) {
+            int status = 0;
+            ::waitpid(pid, &status, 0);
+            if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+                throw std::runtime_error("A worker failed");
+            }
+        }
+        std::cout << document << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "An error occurred: " << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
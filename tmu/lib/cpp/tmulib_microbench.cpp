@@ -0,0 +1,586 @@
+// Microbenchmarks for the C kernels: every cb_*, cbs_* and wb_* function, the cwb_* functions that are more than a
+// call of their cb_* counterpart, and tmu_encode, run on synthetic clause banks swept across clauses, features, state
+// bits, patches and include densities. Prints one JSON document.
+//
+// Per kernel and configuration:
+//   ns_per_call      median duration of one call, also p10/p90
+//   ns_per_clause    ns_per_call / number_of_clauses, for kernels that visit every clause
+//   gb_per_s         bytes of the arrays the kernel is handed, per call, over the median duration. Kernels that
+//                    exit early read less than that, so compare it between runs of the same kernel only.
+//   samples_per_s    for kernels that process samples, null for bank-wide ones
+//
+// Every kernel starts from its own copy of the synthetic bank, so include_density is the density it starts from.
+// Feedback kernels update their copy as they run, cycling through a fixed set of samples, so the bank drifts towards
+// them over a run, as it would in training.
+//
+// Usage: tmulib_microbench [--clauses 128,1024] [--features 64,784] [--state-bits 8] [--patches 1,16]
+//                          [--densities 0.02,0.2] [--min-time-ms 50] [--kernels substring] [--seed 42]
+//                          [--output results.json]
+//
+
+#include "utils/tm_benchmark.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+extern "C" {
+    #include "ClauseBank.h"
+    #include "ClauseBankSparse.h"
+    #include "ClauseWeightBank.h"
+    #include "WeightBank.h"
+    #include "Tools.h"
+    #include "fast_rand_seed.h"
+}
+
+namespace {
+
+constexpr std::size_t number_of_samples = 32;   // Samples cycled through, and the batch of the batched kernels
+constexpr std::size_t number_of_outputs = 4;    // Outputs sharing the bank in the cwb_* kernels
+
+struct Options {
+    std::vector<std::size_t> clauses = {128, 1024};
+    std::vector<std::size_t> features = {64, 784};
+    std::vector<std::size_t> state_bits = {8};
+    std::vector<std::size_t> patches = {1, 16};
+    std::vector<double> densities = {0.02, 0.2};
+    double min_time_ms = 50;
+    std::string kernels;
+    uint32_t seed = 42;
+    std::string output;
+};
+
+struct Config {
+    std::size_t clauses;
+    std::size_t features;
+    std::size_t state_bits;
+    std::size_t patches;
+    double density;
+
+    [[nodiscard]] std::size_t literals() const { return 2 * features; }
+    [[nodiscard]] std::size_t ta_chunks() const { return (literals() - 1) / 32 + 1; }
+};
+
+/*
+ * A dense bank with each literal included with probability density, and the same clauses as sparse include and
+ * exclude lists. Samples are random features with their negations, per patch, both encoded and as CSR.
+ */
+struct SyntheticBank {
+    Config config;
+    std::size_t ta_chunks;
+
+    std::vector<uint32_t> ta_state;             // [clause][ta_chunk][state_bit]
+    std::vector<uint32_t> ind_state;            // [clause][ta_chunk][state_bit]
+    std::vector<uint32_t> clause_and_target;    // [clause][ta_chunk]
+    std::vector<uint32_t> Xi;                   // [sample][patch][ta_chunk]
+    std::vector<uint32_t> literal_active;
+    std::vector<uint32_t> clause_active;
+    std::vector<int> clause_active_int;
+    std::vector<uint32_t> feedback_to_ta;
+    std::vector<uint32_t> output_one_patches;
+    std::vector<uint32_t> clause_output;        // [sample][clause][patch], large enough for every kernel
+    std::vector<uint32_t> actions;
+    std::vector<uint32_t> literal_count;
+    std::vector<uint32_t> literal_clause_map;
+    std::vector<uint32_t> literal_clause_map_pos;
+    std::vector<uint32_t> false_literals_per_clause;
+    std::vector<uint32_t> previous_Xi;
+    std::vector<uint32_t> literals;             // [clause][literal]
+    std::vector<int32_t> weights;
+    std::vector<int> output_weights;            // [clause][output]
+    std::vector<float> output_update_p;
+    std::vector<uint32_t> y;                    // [sample][output]
+    std::vector<uint32_t> output_literal_index;
+
+    // Sparse bank, [clause][literal][literal, state] lists as in ClauseBankSparse.c
+    std::vector<uint32_t> included;
+    std::vector<uint32_t> included_length;
+    std::vector<uint32_t> excluded;
+    std::vector<uint32_t> excluded_length;
+    std::vector<uint32_t> unallocated;
+    std::vector<uint32_t> unallocated_length;
+    std::vector<int> indptr;                    // CSR of the true features of patch 0 of each sample
+    std::vector<int> indices;
+    std::vector<uint32_t> sparse_Xi;            // All features false, as cbs_prepare_Xi expects
+    std::vector<uint32_t> packed_X;
+
+    std::vector<uint32_t> X;                    // [sample][feature], the input of tmu_encode
+    std::vector<uint32_t> encoded_X;
+
+    SyntheticBank(const Config& config, uint32_t seed)
+    : config(config)
+    , ta_chunks(config.ta_chunks())
+    {
+        std::mt19937 rng(seed);
+        std::bernoulli_distribution include(config.density);
+        std::bernoulli_distribution coin(0.5);
+        std::uniform_int_distribution<uint32_t> word;
+
+        const std::size_t bits = config.state_bits;
+        const std::size_t literals_count = config.literals();
+        const uint32_t number_of_states = 1u << std::min<std::size_t>(bits, 16);
+
+        ta_state.resize(config.clauses * ta_chunks * bits);
+        ind_state.assign(config.clauses * ta_chunks * bits, ~0u);
+        clause_and_target.assign(config.clauses * ta_chunks, 0);
+        included.resize(config.clauses * literals_count * 2);
+        included_length.resize(config.clauses);
+        excluded.resize(config.clauses * literals_count * 2);
+        excluded_length.resize(config.clauses);
+        unallocated.resize(config.clauses * literals_count);
+        unallocated_length.assign(config.clauses, 0);
+
+        for (std::size_t j = 0; j < config.clauses; ++j) {
+            uint32_t* clause = &ta_state[j * ta_chunks * bits];
+            for (std::size_t k = 0; k < ta_chunks; ++k) {
+                for (std::size_t b = 0; b + 1 < bits; ++b) {
+                    clause[k * bits + b] = word(rng);
+                }
+                clause[k * bits + bits - 1] = 0;
+            }
+
+            for (std::size_t literal = 0; literal < literals_count; ++literal) {
+                if (include(rng)) {
+                    clause[(literal / 32) * bits + bits - 1] |= 1u << (literal % 32);
+                    const std::size_t pos = j * literals_count * 2 + included_length[j]++ * 2;
+                    included[pos] = literal;
+                    included[pos + 1] = number_of_states / 2;
+                } else {
+                    const std::size_t pos = j * literals_count * 2 + excluded_length[j]++ * 2;
+                    excluded[pos] = literal;
+                    excluded[pos + 1] = number_of_states / 2 - 1;
+                }
+            }
+        }
+
+        const std::size_t patches = config.patches;
+        Xi.assign(number_of_samples * patches * ta_chunks, 0);
+        indptr.push_back(0);
+        for (std::size_t e = 0; e < number_of_samples; ++e) {
+            for (std::size_t patch = 0; patch < patches; ++patch) {
+                uint32_t* xi = &Xi[(e * patches + patch) * ta_chunks];
+                for (std::size_t f = 0; f < config.features; ++f) {
+                    const std::size_t literal = coin(rng) ? f : f + config.features;
+                    xi[literal / 32] |= 1u << (literal % 32);
+                    if (patch == 0 && literal == f) {
+                        indices.push_back(static_cast<int>(f));
+                    }
+                }
+            }
+            indptr.push_back(static_cast<int>(indices.size()));
+        }
+
+        sparse_Xi.assign(ta_chunks, 0);
+        for (std::size_t f = config.features; f < literals_count; ++f) {
+            sparse_Xi[f / 32] |= 1u << (f % 32);
+        }
+        packed_X.resize(literals_count);
+
+        literal_active.assign(ta_chunks, ~0u);
+        clause_active.assign(config.clauses, 1);
+        clause_active_int.assign(config.clauses, 1);
+        feedback_to_ta.resize(ta_chunks);
+        output_one_patches.resize(patches);
+        clause_output.resize(number_of_samples * config.clauses * patches);
+        actions.resize(ta_chunks);
+        literal_count.resize(literals_count);
+        literal_clause_map.resize(config.clauses * literals_count);
+        literal_clause_map_pos.resize(literals_count);
+        false_literals_per_clause.resize(config.clauses * patches);
+        previous_Xi.resize(ta_chunks * patches);
+        literals.resize(config.clauses * literals_count);
+
+        weights.resize(config.clauses);
+        for (auto& w : weights) {
+            w = coin(rng) ? 1 : -1;
+        }
+        for (std::size_t j = 0; j < config.clauses; ++j) {
+            clause_output[j] = coin(rng);
+        }
+
+        output_weights.resize(config.clauses * number_of_outputs);
+        for (auto& w : output_weights) {
+            w = coin(rng) ? 1 : -1;
+        }
+        output_update_p.assign(number_of_outputs, 1.0f);
+        y.resize(number_of_samples * number_of_outputs);
+        for (auto& v : y) {
+            v = coin(rng);
+        }
+        output_literal_index.assign(number_of_outputs, 0);
+
+        // tmu_encode input with the same features and patches: dim (features, 1, 1), patch dim (features - patches + 1, 1)
+        X.resize(number_of_samples * config.features);
+        for (auto& x : X) {
+            x = coin(rng);
+        }
+        encoded_X.resize(number_of_samples * patches * ta_chunks);
+    }
+
+    uint32_t* sample(std::size_t e) {
+        return &Xi[(e % number_of_samples) * config.patches * ta_chunks];
+    }
+
+    uint32_t* targets(std::size_t e) {
+        return &y[(e % number_of_samples) * number_of_outputs];
+    }
+};
+
+struct Kernel {
+    std::string name;
+    bool patchwise_input;           // Runs on [patch][ta_chunk] samples, otherwise only with a single patch
+    bool per_clause;                // Visits every clause per call
+    std::size_t samples_per_call;   // 0 for kernels on the bank alone
+    std::function<std::size_t(const SyntheticBank&)> bytes_per_call;
+    std::function<void(SyntheticBank&, std::size_t)> run;   // Bank and call counter
+};
+
+std::vector<Kernel> kernels(){
+    using B = const SyntheticBank&;
+    constexpr std::size_t w = sizeof(uint32_t);
+
+    const auto state_bytes = [](B b) { return b.ta_state.size() * w; };
+    const auto include_bytes = [](B b) { return b.config.clauses * b.ta_chunks * w; };
+    const auto xi_bytes = [](B b) { return b.config.patches * b.ta_chunks * w; };
+    const auto sparse_bytes = [](B b) {
+        std::size_t included = 0;
+        for (const auto length : b.included_length) {
+            included += length;
+        }
+        return (included * 2 + b.config.clauses) * w;
+    };
+
+    return {
+        {"cb_calculate_clause_outputs_predict", true, true, 1,
+         [=](B b) { return include_bytes(b) + xi_bytes(b) + b.config.clauses * w; },
+         [](SyntheticBank& b, std::size_t i) {
+             cb_calculate_clause_outputs_predict(b.ta_state.data(), b.config.clauses, b.config.literals(),
+                     b.config.state_bits, b.config.patches, b.clause_output.data(), b.sample(i));
+         }},
+        {"cb_calculate_clause_outputs_update", true, true, 1,
+         [=](B b) { return include_bytes(b) + xi_bytes(b) + b.ta_chunks * w + b.config.clauses * w; },
+         [](SyntheticBank& b, std::size_t i) {
+             cb_calculate_clause_outputs_update(b.ta_state.data(), b.config.clauses, b.config.literals(),
+                     b.config.state_bits, b.config.patches, b.clause_output.data(), b.literal_active.data(),
+                     b.sample(i));
+         }},
+        {"cb_calculate_clause_outputs_patchwise", true, true, 1,
+         [=](B b) { return include_bytes(b) + xi_bytes(b) + b.config.clauses * b.config.patches * w; },
+         [](SyntheticBank& b, std::size_t i) {
+             cb_calculate_clause_outputs_patchwise(b.ta_state.data(), b.config.clauses, b.config.literals(),
+                     b.config.state_bits, b.config.patches, b.clause_output.data(), b.sample(i));
+         }},
+        {"cb_type_i_feedback", true, true, 1,
+         [=](B b) { return 2 * state_bytes(b) + xi_bytes(b) + b.config.clauses * w; },
+         [](SyntheticBank& b, std::size_t i) {
+             cb_type_i_feedback(b.ta_state.data(), b.feedback_to_ta.data(), b.output_one_patches.data(),
+                     b.config.clauses, b.config.literals(), b.config.state_bits, b.config.patches, 1.0, 10.0, 1, 0,
+                     b.config.literals(), b.clause_active.data(), b.literal_active.data(), b.sample(i));
+         }},
+        {"cb_type_ii_feedback", true, true, 1,
+         [=](B b) { return 2 * state_bytes(b) + xi_bytes(b) + b.config.clauses * w; },
+         [](SyntheticBank& b, std::size_t i) {
+             cb_type_ii_feedback(b.ta_state.data(), b.output_one_patches.data(), b.config.clauses,
+                     b.config.literals(), b.config.state_bits, b.config.patches, 1.0, b.clause_active.data(),
+                     b.literal_active.data(), b.sample(i));
+         }},
+        {"cb_type_iii_feedback", true, true, 1,
+         [=](B b) { return 2 * (state_bytes(b) + b.ind_state.size() * w + b.clause_and_target.size() * w) + xi_bytes(b); },
+         [](SyntheticBank& b, std::size_t i) {
+             cb_type_iii_feedback(b.ta_state.data(), b.ind_state.data(), b.clause_and_target.data(),
+                     b.output_one_patches.data(), b.config.clauses, b.config.literals(), b.config.state_bits,
+                     b.config.state_bits, b.config.patches, 1.0, 200.0, b.clause_active.data(),
+                     b.literal_active.data(), b.sample(i), i % 2);
+         }},
+        {"cb_included_literals", true, true, 0,
+         [=](B b) { return include_bytes(b) + b.ta_chunks * w; },
+         [](SyntheticBank& b, std::size_t) {
+             cb_included_literals(b.ta_state.data(), b.config.clauses, b.config.literals(), b.config.state_bits,
+                     b.actions.data());
+         }},
+        {"cb_calculate_literal_frequency", true, true, 0,
+         [=](B b) { return include_bytes(b) + b.config.clauses * w + b.config.literals() * w; },
+         [](SyntheticBank& b, std::size_t) {
+             cb_calculate_literal_frequency(b.ta_state.data(), b.config.clauses, b.config.literals(),
+                     b.config.state_bits, b.clause_active.data(), b.literal_count.data());
+         }},
+        {"cb_number_of_include_actions", true, true, 0,
+         [=](B b) { return include_bytes(b); },
+         [](SyntheticBank& b, std::size_t) {
+             int total = 0;
+             for (std::size_t j = 0; j < b.config.clauses; ++j) {
+                 total += cb_number_of_include_actions(b.ta_state.data(), j, b.config.literals(), b.config.state_bits);
+             }
+             b.actions[0] = total;
+         }},
+        {"cb_get_literals", true, true, 0,
+         [=](B b) { return include_bytes(b) + b.literals.size() * w; },
+         [](SyntheticBank& b, std::size_t) {
+             cb_get_literals(b.ta_state.data(), b.config.clauses, b.config.literals(), b.config.state_bits,
+                     b.literals.data());
+         }},
+        {"cb_initialize_incremental_clause_calculation", true, true, 0,
+         [=](B b) { return include_bytes(b) + b.literal_clause_map_pos.size() * w + b.config.clauses * w; },
+         [](SyntheticBank& b, std::size_t) {
+             cb_initialize_incremental_clause_calculation(b.ta_state.data(), b.literal_clause_map.data(),
+                     b.literal_clause_map_pos.data(), b.false_literals_per_clause.data(), b.config.clauses,
+                     b.config.literals(), b.config.state_bits, b.previous_Xi.data());
+         }},
+        {"cb_calculate_clause_outputs_incremental_batch", true, true, number_of_samples,
+         [=](B b) { return number_of_samples * (xi_bytes(b) + b.config.clauses * w) + b.literal_clause_map_pos.size() * w; },
+         [](SyntheticBank& b, std::size_t) {
+             cb_calculate_clause_outputs_incremental_batch(b.literal_clause_map.data(),
+                     b.literal_clause_map_pos.data(), b.false_literals_per_clause.data(), b.config.clauses,
+                     b.config.literals(), b.config.patches, b.clause_output.data(), b.previous_Xi.data(),
+                     b.Xi.data(), number_of_samples);
+         }},
+        {"cb_calculate_clause_outputs_incremental", false, false, 1,
+         [=](B b) { return 2 * b.ta_chunks * w + b.literal_clause_map_pos.size() * w; },
+         [](SyntheticBank& b, std::size_t i) {
+             cb_calculate_clause_outputs_incremental(b.literal_clause_map.data(), b.literal_clause_map_pos.data(),
+                     b.false_literals_per_clause.data(), b.config.clauses, b.config.literals(),
+                     b.previous_Xi.data(), b.sample(i));
+         }},
+        {"cbs_prepare_restore_Xi", false, false, 1,
+         [](B b) { return b.ta_chunks * w + b.indices.size() / number_of_samples * sizeof(int); },
+         [](SyntheticBank& b, std::size_t i) {
+             const std::size_t e = i % number_of_samples;
+             auto* sample_indices = reinterpret_cast<unsigned int*>(&b.indices[b.indptr[e]]);
+             const int length = b.indptr[e + 1] - b.indptr[e];
+             cbs_prepare_Xi(sample_indices, length, b.sparse_Xi.data(), b.config.features);
+             cbs_restore_Xi(sample_indices, length, b.sparse_Xi.data(), b.config.features);
+         }},
+        {"cbs_calculate_clause_outputs_predict", false, true, 1,
+         [=](B b) { return sparse_bytes(b) + xi_bytes(b) + b.config.clauses * w; },
+         [](SyntheticBank& b, std::size_t i) {
+             cbs_calculate_clause_outputs_predict(b.sample(i), b.config.clauses, b.config.literals(),
+                     b.clause_output.data(), b.included.data(), b.included_length.data());
+         }},
+        {"cbs_calculate_clause_outputs_update", false, true, 1,
+         [=](B b) { return sparse_bytes(b) + xi_bytes(b) + b.ta_chunks * w + b.config.clauses * w; },
+         [](SyntheticBank& b, std::size_t i) {
+             cbs_calculate_clause_outputs_update(b.literal_active.data(), b.sample(i), b.config.clauses,
+                     b.config.literals(), b.clause_output.data(), b.included.data(), b.included_length.data());
+         }},
+        {"cbs_pack_X", false, false, number_of_samples,
+         [](B b) { return b.indices.size() * sizeof(int) + b.packed_X.size() * w; },
+         [](SyntheticBank& b, std::size_t) {
+             cbs_pack_X(b.indptr.data(), b.indices.data(), number_of_samples, 0, b.packed_X.data(),
+                     b.config.literals());
+         }},
+        {"cbs_calculate_clause_outputs_predict_packed_X", false, true, number_of_samples,
+         [=](B b) { return sparse_bytes(b) + b.packed_X.size() * w + b.config.clauses * w; },
+         [](SyntheticBank& b, std::size_t) {
+             cbs_calculate_clause_outputs_predict_packed_X(b.packed_X.data(), b.config.clauses, b.config.literals(),
+                     b.clause_output.data(), b.included.data(), b.included_length.data());
+         }},
+        {"cbs_unpack_clause_output", false, true, 1,
+         [](B b) { return 2 * b.config.clauses * w; },
+         [](SyntheticBank& b, std::size_t i) {
+             cbs_unpack_clause_output(i % number_of_samples, b.clause_output.data() + b.config.clauses,
+                     b.clause_output.data(), b.config.clauses);
+         }},
+        {"cbs_type_i_feedback", false, true, 1,
+         [=](B b) { return 2 * (sparse_bytes(b) + b.excluded.size() / 2 * w) + xi_bytes(b); },
+         [](SyntheticBank& b, std::size_t i) {
+             cbs_type_i_feedback(1.0, 10.0, 1, b.config.literals(), -1, 1, -1, b.clause_active_int.data(),
+                     b.literal_active.data(), b.sample(i), b.config.clauses, b.config.literals(),
+                     1 << std::min<std::size_t>(b.config.state_bits, 16), b.included.data(),
+                     b.included_length.data(), b.excluded.data(), b.excluded_length.data(), b.unallocated.data(),
+                     b.unallocated_length.data());
+         }},
+        {"cbs_type_ii_feedback", false, true, 1,
+         [=](B b) { return 2 * (sparse_bytes(b) + b.excluded.size() / 2 * w) + xi_bytes(b); },
+         [](SyntheticBank& b, std::size_t i) {
+             cbs_type_ii_feedback(1.0, 1, b.clause_active_int.data(), b.literal_active.data(), b.sample(i),
+                     b.config.clauses, b.config.literals(), 1 << std::min<std::size_t>(b.config.state_bits, 16),
+                     b.included.data(), b.included_length.data(), b.excluded.data(), b.excluded_length.data());
+         }},
+        {"cwb_type_i_and_ii_feedback", true, true, 1,
+         [=](B b) {
+             return 2 * state_bytes(b) + xi_bytes(b) + b.config.clauses * w + 2 * b.output_weights.size() * sizeof(int);
+         },
+         [](SyntheticBank& b, std::size_t i) {
+             cwb_type_i_and_ii_feedback(b.ta_state.data(), b.output_weights.data(), b.feedback_to_ta.data(),
+                     b.output_one_patches.data(), number_of_outputs, b.config.clauses, b.config.literals(),
+                     b.config.state_bits, b.config.patches, b.output_update_p.data(), 1.0, 1.0, 10.0, 1,
+                     b.config.literals(), b.clause_active.data(), b.literal_active.data(), b.sample(i),
+                     b.targets(i), b.output_literal_index.data(), 0);
+         }},
+        {"cwb_initialize_incremental_clause_calculation", true, true, 0,
+         [=](B b) { return include_bytes(b) + b.literal_clause_map_pos.size() * w + b.config.clauses * w; },
+         [](SyntheticBank& b, std::size_t i) {
+             // Alternates between starting over and resuming from previous_Xi
+             cwb_initialize_incremental_clause_calculation(b.ta_state.data(), b.literal_clause_map.data(),
+                     b.literal_clause_map_pos.data(), b.false_literals_per_clause.data(), b.config.clauses,
+                     b.config.literals(), b.config.state_bits, b.previous_Xi.data(), static_cast<int>(i % 2));
+         }},
+        {"wb_increment", true, true, 1,
+         [](B b) { return 2 * b.weights.size() * sizeof(int32_t) + 2 * b.config.clauses * w; },
+         [](SyntheticBank& b, std::size_t) {
+             wb_increment(b.weights.data(), b.config.clauses, b.clause_output.data(), 1.0, b.clause_active.data(), 0);
+         }},
+        {"wb_decrement", true, true, 1,
+         [](B b) { return 2 * b.weights.size() * sizeof(int32_t) + 2 * b.config.clauses * w; },
+         [](SyntheticBank& b, std::size_t) {
+             wb_decrement(b.weights.data(), b.config.clauses, b.clause_output.data(), 1.0, b.clause_active.data(), 0);
+         }},
+        {"tmu_encode", true, false, number_of_samples,
+         [](B b) { return b.X.size() * w + b.encoded_X.size() * w; },
+         [](SyntheticBank& b, std::size_t) {
+             tmu_encode(b.X.data(), b.encoded_X.data(), number_of_samples, b.config.features, 1, 1,
+                     b.config.features - b.config.patches + 1, 1, 1, 0);
+         }},
+    };
+}
+
+Options parse_options(int argc, char** argv) {
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        const auto value = [&]() -> std::string {
+            if (i + 1 >= argc) {
+                throw std::invalid_argument("Missing value for " + arg);
+            }
+            return argv[++i];
+        };
+
+        if (arg == "--clauses") {
+            options.clauses = TMBenchmark::parse_list<std::size_t>(value());
+        } else if (arg == "--features") {
+            options.features = TMBenchmark::parse_list<std::size_t>(value());
+        } else if (arg == "--state-bits") {
+            options.state_bits = TMBenchmark::parse_list<std::size_t>(value());
+        } else if (arg == "--patches") {
+            options.patches = TMBenchmark::parse_list<std::size_t>(value());
+        } else if (arg == "--densities") {
+            options.densities = TMBenchmark::parse_list<double>(value());
+        } else if (arg == "--min-time-ms") {
+            options.min_time_ms = std::stod(value());
+        } else if (arg == "--kernels") {
+            options.kernels = value();
+        } else if (arg == "--seed") {
+            options.seed = static_cast<uint32_t>(std::stoul(value()));
+        } else if (arg == "--output") {
+            options.output = value();
+        } else {
+            throw std::invalid_argument(
+                    "Usage: tmulib_microbench [--clauses 128,1024] [--features 64,784] [--state-bits 8] "
+                    "[--patches 1,16] [--densities 0.02,0.2] [--min-time-ms 50] [--kernels substring] [--seed 42] "
+                    "[--output results.json]");
+        }
+    }
+
+    for (const auto bits : options.state_bits) {
+        if (bits < 2 || bits > 32) {
+            throw std::invalid_argument("--state-bits must be in [2, 32]");
+        }
+    }
+    for (const auto density : options.densities) {
+        if (density < 0.0 || density > 1.0) {
+            throw std::invalid_argument("--densities must be in [0, 1]");
+        }
+    }
+    return options;
+}
+
+} // namespace
+
+
+int main(int argc, char** argv) {
+    try {
+        const auto options = parse_options(argc, argv);
+        const auto all_kernels = kernels();
+
+        std::vector<std::string> results;
+        for (const auto clauses : options.clauses) {
+            for (const auto features : options.features) {
+                for (const auto state_bits : options.state_bits) {
+                    for (const auto patches : options.patches) {
+                        if (patches == 0 || patches > features) {
+                            std::cerr << "Skipping " << patches << " patches of " << features << " features" << std::endl;
+                            continue;
+                        }
+                        for (const auto density : options.densities) {
+                            const Config config{clauses, features, state_bits, patches, density};
+                            SyntheticBank initial_bank(config, options.seed);
+
+                            // The incremental kernels need the literal clause map
+                            cb_initialize_incremental_clause_calculation(initial_bank.ta_state.data(),
+                                    initial_bank.literal_clause_map.data(), initial_bank.literal_clause_map_pos.data(),
+                                    initial_bank.false_literals_per_clause.data(), clauses, config.literals(),
+                                    state_bits, initial_bank.previous_Xi.data());
+
+                            for (const auto& kernel : all_kernels) {
+                                if (!options.kernels.empty() && kernel.name.find(options.kernels) == std::string::npos) {
+                                    continue;
+                                }
+                                if (!kernel.patchwise_input && patches != 1) {
+                                    continue;
+                                }
+
+                                // Kernels that update the bank must not change what the kernels after them see
+                                SyntheticBank bank = initial_bank;
+                                pcg32_seed(options.seed);
+                                const std::size_t bytes = kernel.bytes_per_call(bank);
+                                std::size_t call = 0;
+                                const auto durations = TMBenchmark::measure(
+                                        [&]() { kernel.run(bank, call++); },
+                                        options.min_time_ms / 1000.0
+                                );
+
+                                const double median = TMBenchmark::percentile(durations, 50);
+                                TMJsonObject result;
+                                result.add("kernel", kernel.name)
+                                      .add("clauses", clauses)
+                                      .add("features", features)
+                                      .add("literals", config.literals())
+                                      .add("state_bits", state_bits)
+                                      .add("patches", patches)
+                                      .add("include_density", density)
+                                      .add("repetitions", durations.size())
+                                      .add("ns_per_call", median)
+                                      .add("ns_per_call_p10", TMBenchmark::percentile(durations, 10))
+                                      .add("ns_per_call_p90", TMBenchmark::percentile(durations, 90))
+                                      .add("ns_per_clause", kernel.per_clause ? median / clauses : NAN)
+                                      .add("bytes_per_call", bytes)
+                                      .add("gb_per_s", bytes / median)
+                                      .add("samples_per_s", kernel.samples_per_call
+                                                            ? kernel.samples_per_call * 1e9 / median : NAN);
+                                results.push_back(result.str());
+                            }
+                        }
+                    }
+                }
+            }
+        }
+
+        TMJsonObject document;
+        document.add("benchmark", "tmulib_microbench")
+                .add("seed", static_cast<std::size_t>(options.seed))
+                .add("min_time_ms", options.min_time_ms)
+                .add("samples", number_of_samples)
+                .add_raw("results", TMJsonObject::array(results));
+
+        if (options.output.empty()) {
+            std::cout << document.str() << std::endl;
+        } else {
+            std::ofstream out(options.output);
+            if (!out) {
+                throw std::runtime_error("Could not open " + options.output);
+            }
+            out << document.str() << std::endl;
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "An error occurred: " << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,327 @@
+// Local inference server. Loads a checkpoint written by TMVanillaClassifier::save_checkpoint and serves
+// predictions over a Unix domain socket or a TCP port on 127.0.0.1.
+//
+// Requests that arrive within --window-us of each other are coalesced into one batch, which is evaluated
+// bit-transposed by TMInferenceModel and split over --threads worker threads.
+//
+// Clients speak the wire protocol described in utils/tm_client_server.h.
+//
+
+#include "tm_inference_model.h"
+#include "utils/tm_checkpoint.h"
+#include "utils/tm_client_server.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <iostream>
+#include <latch>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct ServerOptions {
+    TMClientServerOptions client;
+    std::string model_path;
+    std::size_t threads = std::max(1u, std::thread::hardware_concurrency());
+    std::size_t window_us = 200;
+    std::size_t max_batch = 4096;
+};
+
+struct Request {
+    std::vector<uint32_t> encoded_X;
+    std::size_t number_of_samples = 0;
+    std::vector<int32_t> class_sums;
+    std::vector<int32_t> argmax;
+    std::promise<void> done;
+};
+
+// Fixed set of threads that evaluates one batch at a time, split into contiguous ranges. The first exception a job
+// throws is rethrown by run_all once every job has finished.
+class WorkerPool {
+
+public:
+    explicit WorkerPool(std::size_t number_of_threads) {
+        for (std::size_t i = 0; i < number_of_threads; ++i) {
+            threads.emplace_back([this] { run(); });
+        }
+    }
+
+    ~WorkerPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        cv.notify_all();
+        for (auto& thread : threads) {
+            thread.join();
+        }
+    }
+
+    std::size_t size() const {
+        return threads.size();
+    }
+
+    void run_all(std::vector<std::function<void()>>& jobs) {
+        std::latch finished(static_cast<std::ptrdiff_t>(jobs.size()));
+        std::exception_ptr error;
+        std::mutex error_mutex;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (auto& job : jobs) {
+                queue.emplace_back([&job, &finished, &error, &error_mutex] {
+                    try {
+                        job();
+                    } catch (...) {
+                        std::lock_guard<std::mutex> error_lock(error_mutex);
+                        if (!error) {
+                            error = std::current_exception();
+                        }
+                    }
+                    finished.count_down();
+                });
+            }
+        }
+        cv.notify_all();
+        finished.wait();
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+
+private:
+    std::vector<std::thread> threads;
+    std::deque<std::function<void()>> queue;
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool stopping = false;
+
+    void run() {
+        while (true) {
+            std::function<void()> job;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                cv.wait(lock, [this] { return stopping || !queue.empty(); });
+                if (stopping && queue.empty()) {
+                    return;
+                }
+                job = std::move(queue.front());
+                queue.pop_front();
+            }
+            job();
+        }
+    }
+};
+
+// Coalesces requests that arrive within the batching window, and evaluates them as one batch
+class MicroBatcher {
+
+public:
+    MicroBatcher(const TMInferenceModel& _model, const ServerOptions& _options, TMServerCounters& _counters)
+    : model(_model)
+    , options(_options)
+    , counters(_counters)
+    , pool(_options.threads)
+    , dispatcher([this] { run(); })
+    {}
+
+    ~MicroBatcher() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        cv.notify_all();
+        dispatcher.join();
+    }
+
+    void submit(const std::shared_ptr<Request>& request) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            pending.push_back(request);
+        }
+        cv.notify_one();
+    }
+
+private:
+    const TMInferenceModel& model;
+    const ServerOptions& options;
+    TMServerCounters& counters;
+    WorkerPool pool;
+
+    std::deque<std::shared_ptr<Request>> pending;
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool stopping = false;
+    std::thread dispatcher;
+
+    void run() {
+        while (true) {
+            std::vector<std::shared_ptr<Request>> batch;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                cv.wait(lock, [this] { return stopping || !pending.empty(); });
+                if (stopping && pending.empty()) {
+                    return;
+                }
+
+                // Wait for more requests until the window closes or the batch is full
+                const auto window_end = Clock::now() + std::chrono::microseconds(options.window_us);
+                cv.wait_until(lock, window_end, [this] { return stopping || queued_samples() >= options.max_batch; });
+
+                std::size_t batch_samples = 0;
+                while (!pending.empty() && (batch.empty() || batch_samples + pending.front()->number_of_samples <= options.max_batch)) {
+                    batch_samples += pending.front()->number_of_samples;
+                    batch.push_back(std::move(pending.front()));
+                    pending.pop_front();
+                }
+            }
+
+            try {
+                evaluate(batch);
+            } catch (...) {
+                // evaluate sets the promises only after everything that can throw, so no request has an answer yet
+                const auto error = std::current_exception();
+                for (const auto& request : batch) {
+                    request->done.set_exception(error);
+                }
+            }
+        }
+    }
+
+    std::size_t queued_samples() const {
+        std::size_t samples = 0;
+        for (const auto& request : pending) {
+            samples += request->number_of_samples;
+        }
+        return samples;
+    }
+
+    void evaluate(std::vector<std::shared_ptr<Request>>& batch) {
+        const auto started = Clock::now();
+        const std::size_t stride = model.encoded_stride();
+
+        std::size_t number_of_samples = 0;
+        for (const auto& request : batch) {
+            number_of_samples += request->number_of_samples;
+        }
+
+        std::vector<uint32_t> encoded_X;
+        encoded_X.reserve(number_of_samples * stride);
+        for (const auto& request : batch) {
+            encoded_X.insert(encoded_X.end(), request->encoded_X.begin(), request->encoded_X.end());
+        }
+
+        std::vector<int32_t> class_sums(number_of_samples * model.number_of_classes);
+        std::vector<int32_t> argmax(number_of_samples);
+
+        // Ranges are whole groups of bit-transposed samples
+        const std::size_t groups = (number_of_samples + TMInferenceModel::GROUP_SIZE - 1) / TMInferenceModel::GROUP_SIZE;
+        const std::size_t groups_per_job = std::max<std::size_t>(1, (groups + pool.size() - 1) / pool.size());
+        std::vector<std::function<void()>> jobs;
+        for (std::size_t group = 0; group < groups; group += groups_per_job) {
+            const std::size_t begin = group * TMInferenceModel::GROUP_SIZE;
+            const std::size_t end = std::min(number_of_samples, (group + groups_per_job) * TMInferenceModel::GROUP_SIZE);
+            jobs.emplace_back([&, begin, end] {
+                model.predict(encoded_X.data(), begin, end, false, class_sums.data(), argmax.data());
+            });
+        }
+        pool.run_all(jobs);
+
+        counters.batches += 1;
+        counters.evaluation_us_total += std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - started).count();
+
+        std::size_t offset = 0;
+        for (const auto& request : batch) {
+            const std::size_t n = request->number_of_samples;
+            request->argmax.assign(argmax.begin() + offset, argmax.begin() + offset + n);
+            request->class_sums.assign(
+                    class_sums.begin() + offset * model.number_of_classes,
+                    class_sums.begin() + (offset + n) * model.number_of_classes
+            );
+            offset += n;
+        }
+        for (const auto& request : batch) {
+            request->done.set_value();
+        }
+    }
+};
+
+ServerOptions parse_options(int argc, char** argv) {
+    ServerOptions options;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        const auto value = [&]() -> std::string {
+            if (i + 1 >= argc) {
+                throw std::invalid_argument("Missing value for " + arg);
+            }
+            return argv[++i];
+        };
+
+        if (arg == "--model") {
+            options.model_path = value();
+        } else if (arg == "--threads") {
+            options.threads = std::max(1, std::stoi(value()));
+        } else if (arg == "--window-us") {
+            options.window_us = std::stoul(value());
+        } else if (arg == "--max-batch") {
+            options.max_batch = std::max(1ul, std::stoul(value()));
+        } else if (!options.client.parse(arg, value)) {
+            throw std::invalid_argument("Unknown option " + arg);
+        }
+    }
+
+    if (options.model_path.empty() || !options.client.listening()) {
+        throw std::invalid_argument(
+                "Usage: tmulib_server --model <checkpoint> (--socket <path> | --port <port>) "
+                "[--threads N] [--window-us N] [--max-batch N] [--max-request N] [--max-connections N]");
+    }
+    return options;
+}
+
+} // namespace
+
+
+int main(int argc, char** argv) {
+    try {
+        const auto options = parse_options(argc, argv);
+        const TMInferenceModel model(TMCheckpoint::read(options.model_path));
+        TMServerCounters counters;
+        MicroBatcher batcher(model, options, counters);
+
+        std::cerr << "Serving " << options.model_path << " (" << model.number_of_classes << " classes, "
+                  << model.clause_weight.size() << " active clauses) on " << options.client.address() << std::endl;
+
+        const TMClientServer::Evaluate evaluate = [&](uint32_t* x, std::size_t number_of_samples, int32_t* class_sums, int32_t* argmax) {
+            auto request = std::make_shared<Request>();
+            request->number_of_samples = number_of_samples;
+            request->encoded_X = model.encode(x, number_of_samples);
+            auto done = request->done.get_future();
+            batcher.submit(request);
+            done.get();
+            std::copy(request->class_sums.begin(), request->class_sums.end(), class_sums);
+            std::copy(request->argmax.begin(), request->argmax.end(), argmax);
+        };
+        TMClientServer::run(options.client, [&](int fd) {
+            TMClientServer::serve_connection(fd, model.number_of_features, model.classes, options.client.max_request,
+                                             counters, evaluate);
+        });
+
+        std::cerr << counters.to_json() << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "An error occurred: " << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
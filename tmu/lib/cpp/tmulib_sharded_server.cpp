@@ -0,0 +1,355 @@
+// Class-sharded inference for models with many classes. The classes of a checkpoint written by
+// TMVanillaClassifier::save_checkpoint are split into --shards contiguous ranges, each served by its own shard
+// process that holds only the clause banks and weights of its classes. A front end encodes every request once,
+// scatters the encoded samples to all shards, gathers their partial class sums and reduces them to the argmax.
+//
+// Roles:
+//   local  (default) forks the shards on this machine, connects to them over Unix domain sockets and serves clients
+//   front  serves clients with already running shards, given by --shard-sockets path,path,...
+//   shard  serves class range --shard of --shards on --shard-socket
+//
+// Clients use the wire protocol of tmulib_server (utils/tm_client_server.h) on --socket or 127.0.0.1:--port, so the
+// two are interchangeable.
+// Between front end and shards, frames are uint32 kind, uint64 size, payload (TMSocket):
+//   HELLO    -> CLASSES   uint32 first class position, uint32 number of classes
+//   EVALUATE uint32 number_of_samples, uint32 clip_class_sum, uint32 encoded_X[number_of_samples][stride]
+//            -> SUMS      int32 class_sums[number_of_samples][number of classes]
+//
+// Every client connection gets its own connection to every shard, so requests proceed in parallel.
+//
+// Usage: tmulib_sharded_server --model <checkpoint> (--socket <path> | --port <port>) [--role local|front|shard]
+//                              [--shards 4] [--shard N] [--shard-socket path] [--shard-sockets a,b,...]
+//                              [--threads N] [--max-request N] [--max-connections N]
+//
+
+#include "tm_inference_model.h"
+#include "utils/tm_benchmark.h"
+#include "utils/tm_checkpoint.h"
+#include "utils/tm_client_server.h"
+#include "utils/tm_parallel.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr uint32_t KIND_HELLO = 1;
+constexpr uint32_t KIND_CLASSES = 2;
+constexpr uint32_t KIND_EVALUATE = 3;
+constexpr uint32_t KIND_SUMS = 4;
+
+struct Options {
+    TMClientServerOptions client;
+    std::string role = "local";
+    std::string model_path;
+    int shards = 4;
+    int shard = 0;
+    std::string shard_socket;
+    std::vector<std::string> shard_sockets;
+    std::size_t threads = 1;
+};
+
+// Contiguous class positions of a shard
+std::pair<std::size_t, std::size_t> shard_classes(std::size_t number_of_classes, int shards, int shard){
+    return {number_of_classes * shard / shards, number_of_classes * (shard + 1) / shards};
+}
+
+std::string shard_socket_path(const Options& options, int shard){
+    const std::string base = options.client.socket_path.empty()
+            ? "/tmp/tmulib_sharded_server." + std::to_string(::getpid())
+            : options.client.socket_path;
+    return base + ".shard" + std::to_string(shard);
+}
+
+/*
+ * Shard side of one front end connection. Groups of samples are split over --threads threads. Frames are limited to
+ * the largest request a client may send.
+ */
+void serve_shard_connection(int fd, const TMInferenceModel& model, std::size_t first_class, std::size_t threads,
+                            std::size_t max_frame){
+    std::string payload;
+    std::vector<int32_t> class_sums;
+    std::vector<int32_t> argmax;
+    uint32_t kind = 0;
+    while (TMSocket::receive_frame(fd, kind, payload, max_frame)) {
+        if (kind == KIND_HELLO) {
+            const uint32_t range[2] = {static_cast<uint32_t>(first_class), static_cast<uint32_t>(model.number_of_classes)};
+            if (!TMSocket::send_frame(fd, KIND_CLASSES, range, sizeof(range))) {
+                break;
+            }
+            continue;
+        }
+
+        uint32_t header[2] = {0, 0};
+        if (kind != KIND_EVALUATE || payload.size() < sizeof(header)) {
+            break;
+        }
+        std::memcpy(header, payload.data(), sizeof(header));
+        const std::size_t number_of_samples = header[0];
+        if (payload.size() != sizeof(header) + number_of_samples * model.encoded_stride() * sizeof(uint32_t)) {
+            break;
+        }
+        const auto* encoded_X = reinterpret_cast<const uint32_t*>(payload.data() + sizeof(header));
+
+        class_sums.assign(number_of_samples * model.number_of_classes, 0);
+        argmax.assign(number_of_samples, 0);
+        const std::size_t groups = (number_of_samples + TMInferenceModel::GROUP_SIZE - 1) / TMInferenceModel::GROUP_SIZE;
+        TMParallel::for_ranges(groups, threads, 1, [&](std::size_t, std::size_t begin, std::size_t end) {
+            model.predict(encoded_X, begin * TMInferenceModel::GROUP_SIZE,
+                          std::min(number_of_samples, end * TMInferenceModel::GROUP_SIZE),
+                          header[1] != 0, class_sums.data(), argmax.data());
+        });
+
+        if (!TMSocket::send_frame(fd, KIND_SUMS, class_sums.data(), class_sums.size() * sizeof(int32_t))) {
+            break;
+        }
+    }
+}
+
+// Serves the front ends until SIGINT or SIGTERM
+void run_shard(const Options& options, const TMCheckpoint& checkpoint){
+    const auto [first, last] = shard_classes(checkpoint.number_of_classes, options.shards, options.shard);
+    const TMInferenceModel model(checkpoint.select_classes(first, last));
+    const std::size_t max_frame = 2 * sizeof(uint32_t) + options.client.max_request * model.encoded_stride() * sizeof(uint32_t);
+
+    TMClientServerOptions shard_listener;
+    shard_listener.socket_path = options.shard_socket;
+    // Every client of the front end holds one connection to each shard
+    shard_listener.max_connections = options.client.max_connections;
+    TMClientServer::run(shard_listener, [&](int fd) {
+        try {
+            serve_shard_connection(fd, model, first, options.threads, max_frame);
+        } catch (const std::exception& e) {
+            std::cerr << "Shard " << options.shard << ": Connection closed: " << e.what() << std::endl;
+        }
+    });
+}
+
+/*
+ * The connections of one client to all shards, with the class range of each.
+ */
+class ShardConnections {
+
+public:
+    ShardConnections(const std::vector<std::string>& sockets, std::size_t number_of_classes) {
+        std::vector<bool> covered(number_of_classes, false);
+        for (const auto& path : sockets) {
+            const int fd = TMSocket::connect(path, "", 0);
+            fds.push_back(fd);
+
+            uint32_t kind = 0;
+            std::string payload;
+            uint32_t range[2] = {0, 0};
+            if (!TMSocket::send_frame(fd, KIND_HELLO, "", 0) || !TMSocket::receive_frame(fd, kind, payload, sizeof(range))
+                || kind != KIND_CLASSES || payload.size() != sizeof(range)) {
+                throw std::runtime_error("Shard " + path + " did not answer");
+            }
+            std::memcpy(range, payload.data(), sizeof(range));
+            if (range[0] + range[1] > number_of_classes) {
+                throw std::runtime_error("Shard " + path + " serves classes outside the model");
+            }
+            std::fill(covered.begin() + range[0], covered.begin() + range[0] + range[1], true);
+            first_class.push_back(range[0]);
+            number_of_classes_of.push_back(range[1]);
+        }
+        if (!std::all_of(covered.begin(), covered.end(), [](bool c) { return c; })) {
+            throw std::runtime_error("The shards do not cover all classes");
+        }
+    }
+
+    ~ShardConnections() {
+        for (const int fd : fds) {
+            ::close(fd);
+        }
+    }
+
+    ShardConnections(const ShardConnections&) = delete;
+    ShardConnections& operator=(const ShardConnections&) = delete;
+
+    /*
+     * Sends the samples to every shard before reading any reply, so the shards evaluate concurrently, and writes the
+     * partial sums into class_sums ([sample][class] of the whole model).
+     */
+    void evaluate(const std::vector<uint32_t>& encoded_X, std::size_t number_of_samples, bool clip_class_sum,
+                  std::size_t number_of_classes, int32_t* class_sums) {
+        const uint32_t header[2] = {static_cast<uint32_t>(number_of_samples), clip_class_sum ? 1u : 0u};
+        request.assign(reinterpret_cast<const char*>(header), sizeof(header));
+        request.append(reinterpret_cast<const char*>(encoded_X.data()), encoded_X.size() * sizeof(uint32_t));
+        for (const int fd : fds) {
+            if (!TMSocket::send_frame(fd, KIND_EVALUATE, request)) {
+                throw std::runtime_error("Lost a shard");
+            }
+        }
+
+        for (std::size_t s = 0; s < fds.size(); ++s) {
+            uint32_t kind = 0;
+            const std::size_t shard_classes = number_of_classes_of[s];
+            const std::size_t reply_size = number_of_samples * shard_classes * sizeof(int32_t);
+            if (!TMSocket::receive_frame(fds[s], kind, reply, reply_size) || kind != KIND_SUMS || reply.size() != reply_size) {
+                throw std::runtime_error("Lost a shard");
+            }
+            const auto* sums = reinterpret_cast<const int32_t*>(reply.data());
+            for (std::size_t i = 0; i < number_of_samples; ++i) {
+                std::copy_n(&sums[i * shard_classes], shard_classes, &class_sums[i * number_of_classes + first_class[s]]);
+            }
+        }
+    }
+
+    [[nodiscard]] std::size_t size() const {
+        return fds.size();
+    }
+
+private:
+    std::vector<int> fds;
+    std::vector<std::size_t> first_class;
+    std::vector<std::size_t> number_of_classes_of;
+    std::string request;
+    std::string reply;
+};
+
+// Serves one client with its own connections to every shard
+void serve_client(int fd, const TMInferenceModel& encoder, const std::vector<uint32_t>& class_ids,
+                  const Options& options, TMServerCounters& counters){
+    try {
+        const std::size_t number_of_classes = class_ids.size();
+        ShardConnections shards(options.shard_sockets, number_of_classes);
+        TMClientServer::serve_connection(fd, encoder.number_of_features, class_ids, options.client.max_request, counters,
+                                         [&](uint32_t* x, std::size_t number_of_samples, int32_t* class_sums, int32_t* argmax) {
+            const auto started = TMServerCounters::Clock::now();
+            shards.evaluate(encoder.encode(x, number_of_samples), number_of_samples, false, number_of_classes, class_sums);
+            for (std::size_t i = 0; i < number_of_samples; ++i) {
+                const int32_t* sums = &class_sums[i * number_of_classes];
+                argmax[i] = static_cast<int32_t>(std::max_element(sums, sums + number_of_classes) - sums);
+            }
+            counters.batches += 1;
+            counters.evaluation_us_total += std::chrono::duration_cast<std::chrono::microseconds>(
+                    TMServerCounters::Clock::now() - started).count();
+        });
+    } catch (const std::exception& e) {
+        std::cerr << "Connection closed: " << e.what() << std::endl;
+    }
+}
+
+Options parse_options(int argc, char** argv) {
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        const auto value = [&]() -> std::string {
+            if (i + 1 >= argc) {
+                throw std::invalid_argument("Missing value for " + arg);
+            }
+            return argv[++i];
+        };
+
+        if (arg == "--role") {
+            options.role = value();
+        } else if (arg == "--model") {
+            options.model_path = value();
+        } else if (arg == "--shards") {
+            options.shards = std::stoi(value());
+        } else if (arg == "--shard") {
+            options.shard = std::stoi(value());
+        } else if (arg == "--shard-socket") {
+            options.shard_socket = value();
+        } else if (arg == "--shard-sockets") {
+            options.shard_sockets = TMBenchmark::parse_list<std::string>(value());
+        } else if (arg == "--threads") {
+            options.threads = std::max(1, std::stoi(value()));
+        } else if (!options.client.parse(arg, value)) {
+            throw std::invalid_argument("Unknown option " + arg);
+        }
+    }
+
+    const bool shard = options.role == "shard";
+    if (options.role != "local" && options.role != "front" && !shard) {
+        throw std::invalid_argument("Unknown role " + options.role);
+    }
+    if (options.model_path.empty()
+        || (shard ? options.shard_socket.empty() : !options.client.listening())
+        || (options.role == "front" && options.shard_sockets.empty())
+        || options.shards < 1 || options.shard < 0 || options.shard >= options.shards) {
+        throw std::invalid_argument(
+                "Usage: tmulib_sharded_server --model <checkpoint> (--socket <path> | --port <port>) "
+                "[--role local|front|shard] [--shards N] [--shard N] [--shard-socket path] "
+                "[--shard-sockets a,b,...] [--threads N] [--max-request N] [--max-connections N]");
+    }
+    return options;
+}
+
+} // namespace
+
+
+int main(int argc, char** argv) {
+    try {
+        auto options = parse_options(argc, argv);
+        const TMCheckpoint checkpoint = TMCheckpoint::read(options.model_path);
+        if (options.role == "shard") {
+            run_shard(options, checkpoint);
+            return 0;
+        }
+
+        std::vector<pid_t> children;
+        if (options.role == "local") {
+            options.shards = static_cast<int>(std::min<std::size_t>(options.shards, checkpoint.number_of_classes));
+            for (int shard = 0; shard < options.shards; ++shard) {
+                Options shard_options = options;
+                shard_options.shard = shard;
+                shard_options.shard_socket = shard_socket_path(options, shard);
+                options.shard_sockets.push_back(shard_options.shard_socket);
+
+                const pid_t pid = ::fork();
+                if (pid < 0) {
+                    throw std::runtime_error(std::string("Could not fork: ") + std::strerror(errno));
+                }
+                if (pid == 0) {
+                    try {
+                        run_shard(shard_options, checkpoint);
+                        ::_exit(0);
+                    } catch (const std::exception& e) {
+                        std::cerr << "Shard " << shard << ": An error occurred: " << e.what() << std::endl;
+                    }
+                    ::_exit(1);
+                }
+                children.push_back(pid);
+            }
+        }
+
+        // The front end only encodes, so it keeps the geometry but no clauses
+        const TMInferenceModel encoder(checkpoint.select_classes(0, 0));
+        TMServerCounters counters("\"shards\": " + std::to_string(options.shard_sockets.size()));
+
+        std::cerr << "Serving " << options.model_path << " (" << checkpoint.number_of_classes << " classes on "
+                  << options.shard_sockets.size() << " shards) on " << options.client.address() << std::endl;
+
+        TMClientServer::run(options.client, [&](int fd) {
+            serve_client(fd, encoder, checkpoint.classes, options, counters);
+        });
+
+        for (const pid_t pid : children) {
+            ::kill(pid, SIGTERM);
+            ::waitpid(pid, nullptr, 0);
+        }
+        for (const auto& path : options.shard_sockets) {
+            if (options.role == "local") {
+                ::unlink(path.c_str());
+            }
+        }
+        std::cerr << counters.to_json() << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "An error occurred: " << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
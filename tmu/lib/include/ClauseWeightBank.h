@@ -36,6 +36,8 @@ void cwb_type_i_and_ii_feedback(
     int number_of_state_bits,
     int number_of_patches,
     float *update_p,
+    float type_i_p,
+    float type_ii_p,
     float s,
     unsigned int boost_true_positive_feedback,
     unsigned int max_included_literals,
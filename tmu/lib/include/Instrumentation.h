@@ -0,0 +1,54 @@
+#ifndef C_BITWISE_TSETLIN_MACHINE_INSTRUMENTATION_H
+#define C_BITWISE_TSETLIN_MACHINE_INSTRUMENTATION_H
+#include <stdint.h>
+
+/*
+ * Event counters of the kernels, kept per thread (TMU_THREAD_LOCAL comes from fast_rand.h).
+ * Kernels count through TMU_COUNT, which compiles to nothing unless TMU_INSTRUMENTATION is defined.
+ *
+ * The average early-exit depth of clause evaluation is chunks_evaluated / clause_patches_evaluated.
+ */
+struct TMUCounters {
+    uint64_t clauses_evaluated;
+    uint64_t clause_patches_evaluated;
+    uint64_t chunks_evaluated;
+    uint64_t clauses_updated;
+    uint64_t ta_include_flips;
+    uint64_t ta_exclude_flips;
+    uint64_t rng_draws;
+};
+
+extern TMU_THREAD_LOCAL struct TMUCounters tmu_counters;
+
+#ifdef TMU_INSTRUMENTATION
+#define TMU_COUNT(counter, n) ((void)(tmu_counters.counter += (uint64_t)(n)))
+#else
+#define TMU_COUNT(counter, n) ((void)0)
+#endif
+
+/*
+ * Per-literal statistics kept up to date by the feedback kernels, which report every change of a clause TA's include
+ * action (its top state bit) to the telemetry installed for the calling thread. The reports are always compiled: a
+ * chunk whose include actions did not change costs one comparison, and the installed telemetry is only looked up
+ * when one did.
+ */
+struct TMULiteralTelemetry {
+    int number_of_literals;
+    int32_t *clauses_including; // Clauses whose TA of the literal is in an include state
+    uint64_t *include_flips;
+    uint64_t *exclude_flips;
+};
+
+extern TMU_THREAD_LOCAL struct TMULiteralTelemetry *tmu_literal_telemetry;
+
+// Records the literals of a TA chunk that became included and excluded
+void tmu_literal_telemetry_record(struct TMULiteralTelemetry *telemetry, int chunk, uint32_t included, uint32_t excluded);
+
+static inline void tmu_report_include_changes(uint32_t included_before, uint32_t included_after, int chunk)
+{
+	if (included_before != included_after && tmu_literal_telemetry) {
+		tmu_literal_telemetry_record(tmu_literal_telemetry, chunk, included_after & ~included_before, included_before & ~included_after);
+	}
+}
+
+#endif //C_BITWISE_TSETLIN_MACHINE_INSTRUMENTATION_H
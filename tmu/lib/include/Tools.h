@@ -27,7 +27,6 @@ https://arxiv.org/abs/1905.09688
 
 void tmu_produce_autoencoder_example(
     unsigned int *active_output,
-    int number_of_active_outputs,
     unsigned int *indptr_row,
     unsigned int *indices_row,
     int number_of_rows,
@@ -40,6 +39,43 @@ void tmu_produce_autoencoder_example(
     int accumulation
 );
 
+// Number of entries tmu_autoencoder_complement_index writes to indices_complement, up to rows times outputs
+uint64_t tmu_autoencoder_complement_size(
+    unsigned int *active_output,
+    int number_of_active_outputs,
+    unsigned int *indptr_col,
+    int number_of_rows
+);
+
+// For each active output whose column holds more than half of the rows, the sorted rows outside the column
+void tmu_autoencoder_complement_index(
+    unsigned int *active_output,
+    int number_of_active_outputs,
+    unsigned int *indptr_col,
+    unsigned int *indices_col,
+    int number_of_rows,
+    uint64_t *indptr_complement,
+    unsigned int *indices_complement
+);
+
+// Produces number_of_examples examples for targets[e] with target_values[e] into X[e][number_of_literal_chunks]
+void tmu_produce_autoencoder_examples(
+    unsigned int *active_output,
+    unsigned int *indptr_row,
+    unsigned int *indices_row,
+    int number_of_rows,
+    unsigned int *indptr_col,
+    unsigned int *indices_col,
+    int number_of_cols,
+    uint64_t *indptr_complement,
+    unsigned int *indices_complement,
+    unsigned int *X,
+    unsigned int *targets,
+    unsigned int *target_values,
+    int number_of_examples,
+    int accumulation
+);
+
 void tmu_encode(
     unsigned int *X,
     unsigned int *encoded_X,
@@ -5,8 +5,25 @@
 
 #define FAST_RAND_MAX UINT32_MAX
 
+// Thread-local storage for state that threads running kernels concurrently must not share
+#if defined(TMU_SINGLE_THREADED)
+#define TMU_THREAD_LOCAL
+#elif defined(__cplusplus)
+#define TMU_THREAD_LOCAL thread_local
+#elif defined(_MSC_VER)
+#define TMU_THREAD_LOCAL __declspec(thread)
+#else
+#define TMU_THREAD_LOCAL _Thread_local
+#endif
+
+#include "Instrumentation.h"
+
+#ifdef TMU_INSTRUMENTATION
+#define fast_rand() (TMU_COUNT(rng_draws, 1), pcg32_fast())
+#else
 #define fast_rand() pcg32_fast()
-//#define fast_rand() xorshift128p_fast()
+#endif
+//#define fast_rand() xorshift128p_fast() // Has no per-thread streams, see pcg32_seed_thread
 
 uint32_t xorshift128p_fast();
 uint32_t pcg32_fast();
@@ -1,3 +1,8 @@
 
 void xorshift128p_seed(uint64_t seed);
 void pcg32_seed(uint64_t seed);
+
+// The calling thread draws from its own stream until pcg32_share_thread, so threads running kernels on disjoint
+// clauses do not share state. All other threads share the state set by pcg32_seed.
+void pcg32_seed_thread(uint64_t seed);
+void pcg32_share_thread();
@@ -28,6 +28,7 @@ https://arxiv.org/abs/1905.09688
 #ifdef _MSC_VER
 #  include <intrin.h>
 #  define __builtin_popcount __popcnt
+#  define __builtin_ctz _tzcnt_u32
 #endif
 
 #include <stdio.h>
@@ -63,6 +64,9 @@ static inline void cb_initialize_random_streams(unsigned int *feedback_to_ta, in
 static inline void cb_inc(unsigned int *ta_state, unsigned int active, int number_of_state_bits)
 {
 	unsigned int carry, carry_next;
+#ifdef TMU_INSTRUMENTATION
+	unsigned int include_before = ta_state[number_of_state_bits-1];
+#endif
 
 	carry = active;
 	for (int b = 0; b < number_of_state_bits; ++b) {
@@ -77,6 +81,8 @@ static inline void cb_inc(unsigned int *ta_state, unsigned int active, int numbe
 			ta_state[b] |= carry;
 		}
 	} 	
+
+	TMU_COUNT(ta_include_flips, __builtin_popcount(~include_before & ta_state[number_of_state_bits-1]));
 }
 
 // Decrement the states of each of those 32 Tsetlin Automata flagged in the active bit vector.
@@ -87,6 +93,9 @@ static inline void cb_dec(
 ){
 	unsigned int carry, carry_next;
     unsigned int ta_val;
+#ifdef TMU_INSTRUMENTATION
+	unsigned int include_before = ta_state[number_of_state_bits-1];
+#endif
 
 	carry = active;
 	for (int b = 0; b < number_of_state_bits; ++b) {
@@ -103,15 +112,20 @@ static inline void cb_dec(
 			ta_state[b] &= ~carry;
 		}
 	}
+
+	TMU_COUNT(ta_exclude_flips, __builtin_popcount(include_before & ~ta_state[number_of_state_bits-1]));
 }
 
 /* Calculate the output of each clause using the actions of each Tsetline Automaton. */
 static inline void cb_calculate_clause_output_feedback(unsigned int *ta_state, unsigned int *output_one_patches, unsigned int *clause_output, unsigned int *clause_patch, int number_of_ta_chunks, int number_of_state_bits, unsigned int filter, int number_of_patches, unsigned int *literal_active, unsigned int *Xi)
 {
+	TMU_COUNT(clauses_evaluated, 1);
+
 	int output_one_patches_count = 0;
 	for (int patch = 0; patch < number_of_patches; ++patch) {
 		unsigned int output = 1;
-		for (int k = 0; k < number_of_ta_chunks-1; k++) {
+		int k;
+		for (k = 0; k < number_of_ta_chunks-1; k++) {
 			unsigned int pos = k*number_of_state_bits + number_of_state_bits-1;
 			output = output && (ta_state[pos] & (Xi[patch*number_of_ta_chunks + k] | (~literal_active[k]))) == ta_state[pos];
 
@@ -119,6 +133,8 @@ static inline void cb_calculate_clause_output_feedback(unsigned int *ta_state, u
 				break;
 			}
 		}
+		TMU_COUNT(clause_patches_evaluated, 1);
+		TMU_COUNT(chunks_evaluated, k + 1);
 
 		unsigned int pos = (number_of_ta_chunks-1)*number_of_state_bits + number_of_state_bits-1;
 		output = output &&
@@ -198,9 +214,12 @@ static inline int cb_calculate_clause_output_single_false_literal(unsigned int *
 
 static inline unsigned int cb_calculate_clause_output_update(unsigned int *ta_state, int number_of_ta_chunks, int number_of_state_bits, unsigned int filter, int number_of_patches, unsigned int *literal_active, unsigned int *Xi)
 {
+	TMU_COUNT(clauses_evaluated, 1);
+
 	for (int patch = 0; patch < number_of_patches; ++patch) {
 		unsigned int output = 1;
-		for (int k = 0; k < number_of_ta_chunks-1; k++) {
+		int k;
+		for (k = 0; k < number_of_ta_chunks-1; k++) {
 			unsigned int pos = k*number_of_state_bits + number_of_state_bits-1;
 			output = output && (ta_state[pos] & (Xi[patch*number_of_ta_chunks + k] | (~literal_active[k]))) == ta_state[pos];
 
@@ -208,6 +227,8 @@ static inline unsigned int cb_calculate_clause_output_update(unsigned int *ta_st
 				break;
 			}
 		}
+		TMU_COUNT(clause_patches_evaluated, 1);
+		TMU_COUNT(chunks_evaluated, k + 1);
 
 		unsigned int pos = (number_of_ta_chunks-1)*number_of_state_bits + number_of_state_bits-1;
 		output = output &&
@@ -246,10 +267,13 @@ static inline void cb_calculate_clause_output_patchwise(unsigned int *ta_state,
 
 static inline unsigned int cb_calculate_clause_output_predict(unsigned int *ta_state, int number_of_ta_chunks, int number_of_state_bits, unsigned int filter, int number_of_patches, unsigned int *Xi)
 {
+	TMU_COUNT(clauses_evaluated, 1);
+
 	for (int patch = 0; patch < number_of_patches; ++patch) {
 		unsigned int output = 1;
 		unsigned int all_exclude = 1;
-		for (int k = 0; k < number_of_ta_chunks-1; k++) {
+		int k;
+		for (k = 0; k < number_of_ta_chunks-1; k++) {
 			unsigned int pos = k*number_of_state_bits + number_of_state_bits-1;
 			output = output && (ta_state[pos] & Xi[patch*number_of_ta_chunks + k]) == ta_state[pos];
 
@@ -258,6 +282,8 @@ static inline unsigned int cb_calculate_clause_output_predict(unsigned int *ta_s
 			}
 			all_exclude = all_exclude && (ta_state[pos] == 0);
 		}
+		TMU_COUNT(clause_patches_evaluated, 1);
+		TMU_COUNT(chunks_evaluated, k + 1);
 
 		unsigned int pos = (number_of_ta_chunks-1)*number_of_state_bits + number_of_state_bits-1;
 		output = output &&
@@ -310,6 +336,7 @@ void cb_type_i_feedback(
 		if ((((float)fast_rand())/((float)FAST_RAND_MAX) > update_p) || (!clause_active[j])) {
 			continue;
 		}
+		TMU_COUNT(clauses_updated, 1);
 
 		unsigned int clause_pos = j*number_of_ta_chunks*number_of_state_bits;
 
@@ -326,6 +353,7 @@ void cb_type_i_feedback(
 			// Type Ia Feedback
 			for (int k = 0; k < number_of_ta_chunks; ++k) {
 				unsigned int ta_pos = k*number_of_state_bits;
+				unsigned int included = ta_state[clause_pos + ta_pos + number_of_state_bits - 1];
 
 				if (boost_true_positive_feedback == 1) {
 	 				cb_inc(&ta_state[clause_pos + ta_pos], literal_active[k] & Xi[clause_patch*number_of_ta_chunks + k], number_of_state_bits);
@@ -338,18 +366,23 @@ void cb_type_i_feedback(
 		 		} else {
 		 			cb_dec(&ta_state[clause_pos + ta_pos], literal_active[k] & (~Xi[clause_patch*number_of_ta_chunks + k]), number_of_state_bits);
 		 		}
+
+				tmu_report_include_changes(included, ta_state[clause_pos + ta_pos + number_of_state_bits - 1], k);
 			}
 		} else {
 			// Type Ib Feedback
 				
 			for (int k = 0; k < number_of_ta_chunks; ++k) {
 				unsigned int ta_pos = k*number_of_state_bits;
+				unsigned int included = ta_state[clause_pos + ta_pos + number_of_state_bits - 1];
 
 				if (s > 1.0) {
 					cb_dec(&ta_state[clause_pos + ta_pos], literal_active[k] & feedback_to_ta[k], number_of_state_bits);
 				} else {
 					cb_dec(&ta_state[clause_pos + ta_pos], literal_active[k], number_of_state_bits);
 				}
+
+				tmu_report_include_changes(included, ta_state[clause_pos + ta_pos + number_of_state_bits - 1], k);
 			}
 		}
 	}
@@ -380,6 +413,7 @@ void cb_type_ii_feedback(
 		if ((((float)fast_rand())/((float)FAST_RAND_MAX) > update_p) || (!clause_active[j])) {
 			continue;
 		}
+		TMU_COUNT(clauses_updated, 1);
 
 		unsigned int clause_pos = j*number_of_ta_chunks*number_of_state_bits;
 
@@ -390,7 +424,9 @@ void cb_type_ii_feedback(
 		if (clause_output) {				
 			for (int k = 0; k < number_of_ta_chunks; ++k) {
 				unsigned int ta_pos = k*number_of_state_bits;
+				unsigned int included = ta_state[clause_pos + ta_pos + number_of_state_bits - 1];
 				cb_inc(&ta_state[clause_pos + ta_pos], literal_active[k] & (~Xi[clause_patch*number_of_ta_chunks + k]), number_of_state_bits);
+				tmu_report_include_changes(included, ta_state[clause_pos + ta_pos + number_of_state_bits - 1], k);
 			}
 		}
 	}
@@ -501,16 +537,19 @@ void cb_type_iii_feedback(
 		if ((((float)fast_rand())/((float)FAST_RAND_MAX) > update_p) || (!clause_active[j])) {
 			continue;
 		}
+		TMU_COUNT(clauses_updated, 1);
 
 		for (int k = 0; k < number_of_ta_chunks; ++k) {
 			unsigned int ta_pos = k*number_of_state_bits_ta;
 			unsigned int ind_pos = k*number_of_state_bits_ind;
+			unsigned int included = ta_state[clause_pos_ta + ta_pos + number_of_state_bits_ta - 1];
 
 			cb_dec(
 			    &ta_state[clause_pos_ta + ta_pos],
 			    literal_active[k] & (~ind_state[clause_pos_ind + ind_pos + number_of_state_bits_ind - 1]),
 			    number_of_state_bits_ta
             );
+			tmu_report_include_changes(included, ta_state[clause_pos_ta + ta_pos + number_of_state_bits_ta - 1], k);
 		}
 
 
@@ -620,21 +659,15 @@ void cb_get_literals(
 
     // Iterate through all the clauses.
     for (unsigned int j = 0; j < number_of_clauses; j++) {
-        // Iterate through all the literals.
-        for (unsigned int k = 0; k < number_of_literals; k++) {
-
-            // Determine which chunk the literal is in and its position within the chunk.
-            unsigned int ta_chunk = k / 32;
-            unsigned int chunk_pos = k % 32;
-
-            // Calculate the position of the literal in the TA state array.
+        // Visit only the included literals of each chunk, lowest bit first.
+        for (unsigned int ta_chunk = 0; ta_chunk < number_of_ta_chunks; ta_chunk++) {
             unsigned int pos = j * number_of_ta_chunks * number_of_state_bits + ta_chunk * number_of_state_bits + number_of_state_bits-1;
 
-            // Check if the literal is present (bit is set) in the TA state array.
-            if ((ta_state[pos] & (1 << chunk_pos)) > 0) {
-                // Increment the count of the literal in the result array.
-                unsigned int result_pos = j * number_of_literals + k;
-                result[result_pos] = 1;
+            for (unsigned int included = ta_state[pos]; included; included &= included - 1) {
+                unsigned int k = ta_chunk * 32 + __builtin_ctz(included);
+                if (k < number_of_literals) {
+                    result[j * number_of_literals + k] = 1;
+                }
             }
         }
     }
@@ -796,12 +829,13 @@ void cb_calculate_literal_frequency(
 			continue;
 		}
 
-		for (int k = 0; k < number_of_literals; k++) {
-			unsigned int ta_chunk = k / 32;
-			unsigned int chunk_pos = k % 32;
+		for (unsigned int ta_chunk = 0; ta_chunk < number_of_ta_chunks; ta_chunk++) {
 			unsigned int pos = j * number_of_ta_chunks * number_of_state_bits + ta_chunk * number_of_state_bits + number_of_state_bits-1;
-			if ((ta_state[pos] & (1 << chunk_pos)) > 0) {
-				literal_count[k] += 1;
+			for (unsigned int included = ta_state[pos]; included; included &= included - 1) {
+				int k = ta_chunk * 32 + __builtin_ctz(included);
+				if (k < number_of_literals) {
+					literal_count[k] += 1;
+				}
 			}
 		}
 	}
@@ -0,0 +1,520 @@
+/*
+
+Copyright (c) 2023 Ole-Christoffer Granmo
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+This code implements the Convolutional Tsetlin Machine from paper arXiv:1905.09688
+https://arxiv.org/abs/1905.09688
+
+*/
+
+#ifdef _MSC_VER
+#  include <intrin.h>
+#  define __builtin_popcount __popcnt
+#  define __builtin_ctz _tzcnt_u32
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <math.h>
+#include <string.h>
+#include "fast_rand.h"
+
+#include "ClauseBank.h"
+#include "ClauseWeightBank.h"
+
+static inline void cwb_initialize_random_streams(unsigned int *feedback_to_ta, int number_of_literals, int number_of_ta_chunks, float s)
+{
+	// Initialize all bits to zero
+	memset(feedback_to_ta, 0, number_of_ta_chunks*sizeof(unsigned int));
+
+	int n = number_of_literals;
+	float p = 1.0 / s;
+
+	int active = normal(n * p, n * p * (1 - p));
+	active = active >= n ? n : active;
+	active = active < 0 ? 0 : active;
+	while (active--) {
+		int f = fast_rand() % (number_of_literals);
+		while (feedback_to_ta[f / 32] & (1 << (f % 32))) {
+			f = fast_rand() % (number_of_literals);
+		}
+		feedback_to_ta[f / 32] |= 1 << (f % 32);
+	}
+}
+
+// Increment the states of each of those 32 Tsetlin Automata flagged in the active bit vector.
+static inline void cwb_inc(unsigned int *ta_state, unsigned int active, int number_of_state_bits)
+{
+	unsigned int carry, carry_next;
+
+	carry = active;
+	for (int b = 0; b < number_of_state_bits; ++b) {
+		carry_next = ta_state[b] & carry; // Sets carry bits (overflow) passing on to next bit
+		ta_state[b] = ta_state[b] ^ carry; // Performs increments with XOR
+		carry = carry_next;
+	}
+
+	if (carry > 0) {
+		for (int b = 0; b < number_of_state_bits; ++b) {
+			ta_state[b] |= carry;
+		}
+	}
+}
+
+// Decrement the states of each of those 32 Tsetlin Automata flagged in the active bit vector.
+static inline void cwb_dec(unsigned int *ta_state, unsigned int active, int number_of_state_bits)
+{
+	unsigned int carry, carry_next;
+
+	carry = active;
+	for (int b = 0; b < number_of_state_bits; ++b) {
+		carry_next = (~ta_state[b]) & carry; // Sets carry bits (overflow) passing on to next bit
+		ta_state[b] = ta_state[b] ^ carry; // Performs increments with XOR
+		carry = carry_next;
+	}
+
+	if (carry > 0) {
+		for (int b = 0; b < number_of_state_bits; ++b) {
+			ta_state[b] &= ~carry;
+		}
+	}
+}
+
+static inline unsigned int cwb_filter(int number_of_literals)
+{
+	if (((number_of_literals) % 32) != 0) {
+		return (~(0xffffffff << ((number_of_literals) % 32)));
+	}
+	return 0xffffffff;
+}
+
+// Literal mask of chunk k with the output literal and its negation removed (autoencoder mode)
+static inline unsigned int cwb_output_literal_active(unsigned int *literal_active, int k, int output_literal, int number_of_features)
+{
+	unsigned int active = literal_active[k];
+	if (output_literal >= 0) {
+		if (output_literal / 32 == k) {
+			active &= ~(1U << (output_literal % 32));
+		}
+		if ((output_literal + number_of_features) / 32 == k) {
+			active &= ~(1U << ((output_literal + number_of_features) % 32));
+		}
+	}
+	return active;
+}
+
+/*
+Finds the literals that make a clause false in a single patch. Returns the number of offending literals,
+capped at 3, and stores the first two offending literal ids.
+*/
+static inline int cwb_offending_literals(unsigned int *ta_state, int number_of_ta_chunks, int number_of_state_bits, unsigned int filter, unsigned int *literal_active, unsigned int *Xi, int *offending)
+{
+	int count = 0;
+	for (int k = 0; k < number_of_ta_chunks; ++k) {
+		unsigned int pos = k*number_of_state_bits + number_of_state_bits-1;
+		unsigned int included = k == number_of_ta_chunks - 1 ? ta_state[pos] & filter : ta_state[pos];
+		unsigned int offending_literals = included & literal_active[k] & (~Xi[k]);
+
+		while (offending_literals) {
+			if (count == 2) {
+				return 3;
+			}
+			offending[count++] = k*32 + __builtin_ctz(offending_literals);
+			offending_literals &= offending_literals - 1;
+		}
+	}
+	return count;
+}
+
+/*
+Evaluates a clause for feedback. Without autoencoder, clause_output tells whether the clause matches a patch and
+clause_patch is a random matching patch. With autoencoder, the offending literals of the first patch are kept, so
+that each output can tell whether only its own hidden literal made the clause false.
+*/
+static inline void cwb_evaluate_clause(unsigned int *ta_state, unsigned int *output_one_patches, int number_of_ta_chunks, int number_of_state_bits, unsigned int filter, int number_of_patches, unsigned int *literal_active, unsigned int *Xi, int autoencoder, unsigned int *clause_output, unsigned int *clause_patch, int *offending_count, int *offending)
+{
+	*clause_output = 0;
+	*clause_patch = 0;
+	*offending_count = 0;
+
+	if (autoencoder) {
+		*offending_count = cwb_offending_literals(ta_state, number_of_ta_chunks, number_of_state_bits, filter, literal_active, Xi, offending);
+		return;
+	}
+
+	int output_one_patches_count = 0;
+	for (int patch = 0; patch < number_of_patches; ++patch) {
+		int patch_offending[2];
+		if (cwb_offending_literals(ta_state, number_of_ta_chunks, number_of_state_bits, filter, literal_active, &Xi[patch*number_of_ta_chunks], patch_offending) == 0) {
+			output_one_patches[output_one_patches_count++] = patch;
+		}
+	}
+	if (output_one_patches_count > 0) {
+		*clause_output = 1;
+		*clause_patch = output_one_patches[fast_rand() % output_one_patches_count];
+	}
+}
+
+// The clause output as output o sees it. In autoencoder mode, true if every offending literal is hidden from the output.
+static inline unsigned int cwb_output_clause_output(unsigned int clause_output, int offending_count, int *offending, int output_literal, int number_of_features, int autoencoder)
+{
+	if (!autoencoder) {
+		return clause_output;
+	}
+	if (offending_count > 2) {
+		return 0;
+	}
+	for (int i = 0; i < offending_count; ++i) {
+		if (offending[i] != output_literal && offending[i] != output_literal + number_of_features) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+/*
+Type I and Type II feedback plus weight updates for every output of a multi-output model, in one pass over
+the clauses. weights is laid out [clause][output]. y holds the target value of each output, and update_p the
+update probability of each output.
+
+As in the per-output models, Type I feedback is selected with probability update_p*type_i_p, Type II feedback
+with probability update_p*type_ii_p, and the weight update independently with probability update_p. Weights
+are updated from the clause outputs before any feedback, as the class sums were computed. A clause changed by
+the feedback of one output is evaluated again before the next, so applying all outputs to one clause before
+moving on is equivalent to applying the outputs one after another over the whole bank.
+
+With autoencoder set, the literal output_literal_index[o] and its negation are hidden from output o, both
+when evaluating the clause and when giving feedback. The clause is then evaluated on the first patch only.
+*/
+void cwb_type_i_and_ii_feedback(
+        unsigned int *ta_state,
+        int *weights,
+        unsigned int *feedback_to_ta,
+        unsigned int *output_one_patches,
+        int number_of_outputs,
+        int number_of_clauses,
+        int number_of_literals,
+        int number_of_state_bits,
+        int number_of_patches,
+        float *update_p,
+        float type_i_p,
+        float type_ii_p,
+        float s,
+        unsigned int boost_true_positive_feedback,
+        unsigned int max_included_literals,
+        unsigned int *clause_active,
+        unsigned int *literal_active,
+        unsigned int *Xi,
+        unsigned int *y,
+        unsigned int *output_literal_index,
+        int autoencoder
+)
+{
+	unsigned int filter = cwb_filter(number_of_literals);
+	int number_of_ta_chunks = (number_of_literals-1)/32 + 1;
+	int number_of_features = number_of_literals / 2;
+
+	for (int j = 0; j < number_of_clauses; ++j) {
+		if (!clause_active[j]) {
+			continue;
+		}
+
+		unsigned int clause_pos = j*number_of_ta_chunks*number_of_state_bits;
+		int *clause_weights = &weights[j*number_of_outputs];
+
+		unsigned int clause_output;
+		unsigned int clause_patch;
+		int offending_count;
+		int offending[2] = {0, 0};
+		cwb_evaluate_clause(&ta_state[clause_pos], output_one_patches, number_of_ta_chunks, number_of_state_bits, filter, number_of_patches, literal_active, Xi, autoencoder, &clause_output, &clause_patch, &offending_count, offending);
+
+		// The evaluation before feedback, for the weight updates
+		unsigned int evaluated_output = clause_output;
+		int evaluated_offending_count = offending_count;
+		int evaluated_offending[2] = {offending[0], offending[1]};
+
+		for (int o = 0; o < number_of_outputs; ++o) {
+			int output_literal = autoencoder ? (int) output_literal_index[o] : -1;
+			unsigned int output_clause_output = cwb_output_clause_output(clause_output, offending_count, offending, output_literal, number_of_features, autoencoder);
+			unsigned int *Xi_patch = &Xi[clause_patch*number_of_ta_chunks];
+
+			int positive_polarity = clause_weights[o] >= 0;
+			int type_i = (y[o] != 0) == positive_polarity;
+			int changed = 0;
+
+			if (type_i) {
+				if (((float)fast_rand())/((float)FAST_RAND_MAX) <= update_p[o]*type_i_p) {
+					if (s > 1.0) {
+						cwb_initialize_random_streams(feedback_to_ta, number_of_literals, number_of_ta_chunks, s);
+					}
+
+					if (output_clause_output && (unsigned int) cb_number_of_include_actions(ta_state, j, number_of_literals, number_of_state_bits) <= max_included_literals) {
+						// Type Ia Feedback
+						for (int k = 0; k < number_of_ta_chunks; ++k) {
+							unsigned int ta_pos = k*number_of_state_bits;
+							unsigned int active = cwb_output_literal_active(literal_active, k, output_literal, number_of_features);
+							unsigned int included = ta_state[clause_pos + ta_pos + number_of_state_bits - 1];
+
+							if (boost_true_positive_feedback == 1) {
+								cwb_inc(&ta_state[clause_pos + ta_pos], active & Xi_patch[k], number_of_state_bits);
+							} else {
+								cwb_inc(&ta_state[clause_pos + ta_pos], active & Xi_patch[k] & (~feedback_to_ta[k]), number_of_state_bits);
+							}
+
+							if (s > 1.0) {
+								cwb_dec(&ta_state[clause_pos + ta_pos], active & (~Xi_patch[k]) & feedback_to_ta[k], number_of_state_bits);
+							} else {
+								cwb_dec(&ta_state[clause_pos + ta_pos], active & (~Xi_patch[k]), number_of_state_bits);
+							}
+
+							tmu_report_include_changes(included, ta_state[clause_pos + ta_pos + number_of_state_bits - 1], k);
+						}
+					} else {
+						// Type Ib Feedback
+						for (int k = 0; k < number_of_ta_chunks; ++k) {
+							unsigned int ta_pos = k*number_of_state_bits;
+							unsigned int active = cwb_output_literal_active(literal_active, k, output_literal, number_of_features);
+							unsigned int included = ta_state[clause_pos + ta_pos + number_of_state_bits - 1];
+
+							if (s > 1.0) {
+								cwb_dec(&ta_state[clause_pos + ta_pos], active & feedback_to_ta[k], number_of_state_bits);
+							} else {
+								cwb_dec(&ta_state[clause_pos + ta_pos], active, number_of_state_bits);
+							}
+
+							tmu_report_include_changes(included, ta_state[clause_pos + ta_pos + number_of_state_bits - 1], k);
+						}
+					}
+					changed = 1;
+				}
+			} else if (((float)fast_rand())/((float)FAST_RAND_MAX) <= update_p[o]*type_ii_p && output_clause_output) {
+				// Type II Feedback
+				for (int k = 0; k < number_of_ta_chunks; ++k) {
+					unsigned int ta_pos = k*number_of_state_bits;
+					unsigned int active = cwb_output_literal_active(literal_active, k, output_literal, number_of_features);
+					unsigned int included = ta_state[clause_pos + ta_pos + number_of_state_bits - 1];
+					cwb_inc(&ta_state[clause_pos + ta_pos], active & (~Xi_patch[k]), number_of_state_bits);
+					tmu_report_include_changes(included, ta_state[clause_pos + ta_pos + number_of_state_bits - 1], k);
+				}
+				changed = 1;
+			}
+
+			// Weight update, reinforcing clauses that voted for (y = 1) or against (y = 0) the output
+			if (cwb_output_clause_output(evaluated_output, evaluated_offending_count, evaluated_offending, output_literal, number_of_features, autoencoder) && ((float)fast_rand())/((float)FAST_RAND_MAX) <= update_p[o]) {
+				if (y[o]) {
+					clause_weights[o]++;
+				} else {
+					clause_weights[o]--;
+				}
+			}
+
+			if (changed && o + 1 < number_of_outputs) {
+				cwb_evaluate_clause(&ta_state[clause_pos], output_one_patches, number_of_ta_chunks, number_of_state_bits, filter, number_of_patches, literal_active, Xi, autoencoder, &clause_output, &clause_patch, &offending_count, offending);
+			}
+		}
+	}
+}
+
+void cwb_type_iii_feedback(
+        unsigned int *ta_state,
+        unsigned int *ind_state,
+        unsigned int *clause_and_target,
+        unsigned int *output_one_patches,
+        int number_of_clauses,
+        int number_of_literals,
+        int number_of_state_bits_ta,
+        int number_of_state_bits_ind,
+        int number_of_patches,
+        float update_p,
+        float d,
+        unsigned int *clause_active,
+        unsigned int *literal_active,
+        unsigned int *Xi,
+        int target
+)
+{
+	cb_type_iii_feedback(
+		ta_state,
+		ind_state,
+		clause_and_target,
+		output_one_patches,
+		number_of_clauses,
+		number_of_literals,
+		number_of_state_bits_ta,
+		number_of_state_bits_ind,
+		number_of_patches,
+		update_p,
+		d,
+		clause_active,
+		literal_active,
+		Xi,
+		target
+	);
+}
+
+void cwb_calculate_clause_outputs_predict(
+        unsigned int *ta_state,
+        int number_of_clauses,
+        int number_of_literals,
+        int number_of_state_bits,
+        int number_of_patches,
+        unsigned int *clause_output,
+        unsigned int *Xi
+)
+{
+	cb_calculate_clause_outputs_predict(ta_state, number_of_clauses, number_of_literals, number_of_state_bits, number_of_patches, clause_output, Xi);
+}
+
+void cwb_calculate_clause_outputs_update(
+        unsigned int *ta_state,
+        int number_of_clauses,
+        int number_of_literals,
+        int number_of_state_bits,
+        int number_of_patches,
+        unsigned int *clause_output,
+        unsigned int *literal_active,
+        unsigned int *Xi
+)
+{
+	cb_calculate_clause_outputs_update(ta_state, number_of_clauses, number_of_literals, number_of_state_bits, number_of_patches, clause_output, literal_active, Xi);
+}
+
+void cwb_calculate_clause_outputs_patchwise(
+        unsigned int *ta_state,
+        int number_of_clauses,
+        int number_of_literals,
+        int number_of_state_bits,
+        int number_of_patches,
+        unsigned int *clause_output,
+        unsigned int *Xi
+)
+{
+	cb_calculate_clause_outputs_patchwise(ta_state, number_of_clauses, number_of_literals, number_of_state_bits, number_of_patches, clause_output, Xi);
+}
+
+void cwb_calculate_literal_frequency(
+        unsigned int *ta_state,
+        int number_of_clauses,
+        int number_of_literals,
+        int number_of_state_bits,
+        unsigned int *clause_active,
+        unsigned int *literal_count
+)
+{
+	cb_calculate_literal_frequency(ta_state, number_of_clauses, number_of_literals, number_of_state_bits, clause_active, literal_count);
+}
+
+int cwb_number_of_include_actions(
+        unsigned int *ta_state,
+        int clause,
+        int number_of_literals,
+        int number_of_state_bits
+)
+{
+	return cb_number_of_include_actions(ta_state, clause, number_of_literals, number_of_state_bits);
+}
+
+/*
+Builds the literal clause map for incremental clause evaluation. With update set, the false literal counters
+are computed against the current previous_Xi instead of resetting it, so incremental evaluation can resume
+from the last example seen after the clauses have been changed by feedback.
+*/
+void cwb_initialize_incremental_clause_calculation(
+        unsigned int *ta_state,
+        unsigned int *literal_clause_map,
+        unsigned int *literal_clause_map_pos,
+        unsigned int *false_literals_per_clause,
+        int number_of_clauses,
+        int number_of_literals,
+        int number_of_state_bits,
+        unsigned int *previous_Xi,
+        int update
+)
+{
+	int number_of_ta_chunks = (number_of_literals-1)/32 + 1;
+
+	if (!update) {
+		// Initialize all literals as false for the previous example
+		for (int k = 0; k < number_of_ta_chunks; ++k) {
+			previous_Xi[k] = 0;
+		}
+	}
+
+	for (int j = 0; j < number_of_clauses; ++j) {
+		false_literals_per_clause[j] = 0;
+	}
+
+	// Build the literal clause map, and count the included literals that are false in previous_Xi
+	unsigned int pos = 0;
+	for (int k = 0; k < number_of_literals; ++k) {
+		unsigned int ta_chunk = k / 32;
+		unsigned int chunk_pos = k % 32;
+		unsigned int literal_false = !(previous_Xi[ta_chunk] & (1U << chunk_pos));
+
+		for (int j = 0; j < number_of_clauses; ++j) {
+			unsigned int clause_ta_chunk = j * number_of_ta_chunks * number_of_state_bits + ta_chunk * number_of_state_bits + number_of_state_bits - 1;
+			if (ta_state[clause_ta_chunk] & (1U << chunk_pos)) {
+				literal_clause_map[pos] = j;
+				false_literals_per_clause[j] += literal_false;
+				++pos;
+			}
+		}
+		literal_clause_map_pos[k] = pos;
+	}
+
+	// Make empty clauses false
+	for (int j = 0; j < number_of_clauses; ++j) {
+		unsigned int clause_pos = j * number_of_ta_chunks * number_of_state_bits;
+		if (cb_number_of_include_actions(&ta_state[clause_pos], 0, number_of_literals, number_of_state_bits) == 0) {
+			false_literals_per_clause[j] = 1;
+		}
+	}
+}
+
+void cwb_calculate_clause_outputs_incremental_batch(
+        unsigned int * literal_clause_map,
+        unsigned int *literal_clause_map_pos,
+        unsigned int *false_literals_per_clause,
+        int number_of_clauses,
+        int number_of_literals,
+        int number_of_patches,
+        unsigned int *clause_output,
+        unsigned int *previous_Xi,
+        unsigned int *Xi,
+        int batch_size
+)
+{
+	cb_calculate_clause_outputs_incremental_batch(literal_clause_map, literal_clause_map_pos, false_literals_per_clause, number_of_clauses, number_of_literals, number_of_patches, clause_output, previous_Xi, Xi, batch_size);
+}
+
+void cwb_calculate_clause_outputs_incremental(
+        unsigned int * literal_clause_map,
+        unsigned int *literal_clause_map_pos,
+        unsigned int *false_literals_per_clause,
+        int number_of_clauses,
+        int number_of_literals,
+        unsigned int *previous_Xi,
+        unsigned int *Xi
+)
+{
+	cb_calculate_clause_outputs_incremental(literal_clause_map, literal_clause_map_pos, false_literals_per_clause, number_of_clauses, number_of_literals, previous_Xi, Xi);
+}
@@ -0,0 +1,35 @@
+#ifdef _MSC_VER
+#  include <intrin.h>
+#  define __builtin_ctz _tzcnt_u32
+#endif
+
+#include "fast_rand.h"
+
+// Always defined, so objects built with and without TMU_INSTRUMENTATION link against the same library
+TMU_THREAD_LOCAL struct TMUCounters tmu_counters;
+
+TMU_THREAD_LOCAL struct TMULiteralTelemetry *tmu_literal_telemetry = 0;
+
+void tmu_literal_telemetry_record(struct TMULiteralTelemetry *telemetry, int chunk, uint32_t included, uint32_t excluded)
+{
+	// Bits are visited in ascending order, so the padding bits of the last chunk come last
+	while (included) {
+		int literal = chunk*32 + __builtin_ctz(included);
+		if (literal >= telemetry->number_of_literals) {
+			break;
+		}
+		telemetry->clauses_including[literal]++;
+		telemetry->include_flips[literal]++;
+		included &= included - 1;
+	}
+
+	while (excluded) {
+		int literal = chunk*32 + __builtin_ctz(excluded);
+		if (literal >= telemetry->number_of_literals) {
+			break;
+		}
+		telemetry->clauses_including[literal]--;
+		telemetry->exclude_flips[literal]++;
+		excluded &= excluded - 1;
+	}
+}
@@ -27,6 +27,8 @@ https://arxiv.org/abs/1905.09688
 
 #include <string.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include "fast_rand.h"
 
 int compareints(const void *a, const void *b) {
     const unsigned int *ia = (const unsigned int *)a;
@@ -36,88 +38,191 @@ int compareints(const void *a, const void *b) {
     return 0;
 }
 
+// Uniform in [0, n) from one fast_rand() draw, without the modulo
+static inline unsigned int random_below(unsigned int n)
+{
+	return (unsigned int)(((uint64_t)fast_rand() * n) >> 32);
+}
 
-void tmu_produce_autoencoder_example(
+// A column is dense if more than half of the rows contain it. Negatives of dense outputs come from the complement index.
+static inline int dense_column(const unsigned int *indptr_col, unsigned int col, int number_of_rows)
+{
+	return 2*(indptr_col[col+1] - indptr_col[col]) > (unsigned int)number_of_rows;
+}
+
+static void add_row(
+        const unsigned int *indptr_row,
+        const unsigned int *indices_row,
+        int number_of_features,
+        int row,
+        unsigned int *X
+)
+{
+	for (unsigned int k = indptr_row[row]; k < indptr_row[row+1]; ++k) {
+		unsigned int feature = indices_row[k];
+		X[feature / 32] |= (1U << (feature % 32));
+
+		unsigned int negated = feature + number_of_features;
+		X[negated / 32] &= ~(1U << (negated % 32));
+	}
+}
+
+static void produce_example(
         const unsigned int *active_output,
-        int number_of_active_outputs,
         const unsigned int *indptr_row,
         const unsigned int *indices_row,
         int number_of_rows,
-        unsigned int *indptr_col,
-        unsigned int *indices_col,
+        const unsigned int *indptr_col,
+        const unsigned int *indices_col,
         int number_of_cols,
+        const uint64_t *indptr_complement,
+        const unsigned int *indices_complement,
         unsigned int *X,
         int target,
         int target_value,
         int accumulation
 )
 {
-	int row;
-
 	int number_of_features = number_of_cols;
 	int number_of_literals = 2*number_of_features;
-
 	unsigned int number_of_literal_chunks = (number_of_literals-1)/32 + 1;
 
-	// Initialize example vector X
+	// All features false, so all negated features true
 	memset(X, 0, number_of_literal_chunks * sizeof(unsigned int));
-	for (int k = number_of_features; k < number_of_literals; ++k) {
-		int chunk_nr = k / 32;
-		int chunk_pos = k % 32;
-		X[chunk_nr] |= (1U << chunk_pos);
+	for (int k = number_of_features; k < number_of_literals;) {
+		if (k % 32 == 0 && k + 32 <= number_of_literals) {
+			X[k / 32] = ~0U;
+			k += 32;
+		} else {
+			X[k / 32] |= (1U << (k % 32));
+			k++;
+		}
 	}
-	
-	if ((indptr_col[active_output[target]+1] - indptr_col[active_output[target]] == 0) || (indptr_col[active_output[target]+1] - indptr_col[active_output[target]] == number_of_rows)) {
+
+	unsigned int col = active_output[target];
+	unsigned int col_begin = indptr_col[col];
+	unsigned int col_size = indptr_col[col+1] - col_begin;
+
+	if (col_size == 0 || col_size == (unsigned int)number_of_rows) {
 		// If no positive/negative examples, produce a random example
 		for (int a = 0; a < accumulation; ++a) {
-			row = rand() % number_of_rows;
-			for (int k = indptr_row[row]; k < indptr_row[row+1]; ++k) {
-				int chunk_nr = indices_row[k] / 32;
-				int chunk_pos = indices_row[k] % 32;
-				X[chunk_nr] |= (1U << chunk_pos);
-
-				chunk_nr = (indices_row[k] + number_of_features) / 32;
-				chunk_pos = (indices_row[k] + number_of_features) % 32;
-				X[chunk_nr] &= ~(1U << chunk_pos);
-			}
+			add_row(indptr_row, indices_row, number_of_features, random_below(number_of_rows), X);
 		}
 		return;
 	}
 
 	if (target_value) {
+		// Pick example randomly among positive examples
 		for (int a = 0; a < accumulation; ++a) {
-			// Pick example randomly among positive examples
-			int random_index = indptr_col[active_output[target]] + (rand() % (indptr_col[active_output[target]+1] - indptr_col[active_output[target]]));
-			row = indices_col[random_index];
-			
-			for (int k = indptr_row[row]; k < indptr_row[row+1]; ++k) {
-				int chunk_nr = indices_row[k] / 32;
-				int chunk_pos = indices_row[k] % 32;
-				X[chunk_nr] |= (1U << chunk_pos);
-
-				chunk_nr = (indices_row[k] + number_of_features) / 32;
-				chunk_pos = (indices_row[k] + number_of_features) % 32;
-				X[chunk_nr] &= ~(1U << chunk_pos);
-			}
+			add_row(indptr_row, indices_row, number_of_features, indices_col[col_begin + random_below(col_size)], X);
+		}
+	} else if (indices_complement && dense_column(indptr_col, col, number_of_rows)) {
+		// Pick example randomly among the rows listed as negative
+		uint64_t complement_begin = indptr_complement[target];
+		unsigned int complement_size = (unsigned int)(indptr_complement[target+1] - complement_begin);
+		for (int a = 0; a < accumulation; ++a) {
+			add_row(indptr_row, indices_row, number_of_features, indices_complement[complement_begin + random_below(complement_size)], X);
 		}
 	} else {
+		// Rejection sampling, at most two draws per example on average when a complement index is given
 		int a = 0;
 		while (a < accumulation) {
-			row = rand() % number_of_rows;
+			unsigned int row = random_below(number_of_rows);
+			if (bsearch(&row, &indices_col[col_begin], col_size, sizeof(unsigned int), compareints) == NULL) {
+				add_row(indptr_row, indices_row, number_of_features, row, X);
+				a++;
+			}
+		}
+	}
+}
+
+void tmu_produce_autoencoder_example(
+        const unsigned int *active_output,
+        const unsigned int *indptr_row,
+        const unsigned int *indices_row,
+        int number_of_rows,
+        unsigned int *indptr_col,
+        unsigned int *indices_col,
+        int number_of_cols,
+        unsigned int *X,
+        int target,
+        int target_value,
+        int accumulation
+)
+{
+	produce_example(active_output, indptr_row, indices_row, number_of_rows, indptr_col, indices_col, number_of_cols,
+	                NULL, NULL, X, target, target_value, accumulation);
+}
 
-			if (bsearch(&row, &indices_col[indptr_col[active_output[target]]], indptr_col[active_output[target]+1] - indptr_col[active_output[target]], sizeof(unsigned int), compareints) == NULL) {
-				for (int k = indptr_row[row]; k < indptr_row[row+1]; ++k) {
-					int chunk_nr = indices_row[k] / 32;
-					int chunk_pos = indices_row[k] % 32;
-					X[chunk_nr] |= (1U << chunk_pos);
+uint64_t tmu_autoencoder_complement_size(
+        unsigned int *active_output,
+        int number_of_active_outputs,
+        unsigned int *indptr_col,
+        int number_of_rows
+)
+{
+	uint64_t size = 0;
+	for (int i = 0; i < number_of_active_outputs; ++i) {
+		unsigned int col = active_output[i];
+		if (dense_column(indptr_col, col, number_of_rows)) {
+			size += number_of_rows - (indptr_col[col+1] - indptr_col[col]);
+		}
+	}
+	return size;
+}
 
-					chunk_nr = (indices_row[k] + number_of_features) / 32;
-					chunk_pos = (indices_row[k] + number_of_features) % 32;
-					X[chunk_nr] &= ~(1U << chunk_pos);
+void tmu_autoencoder_complement_index(
+        unsigned int *active_output,
+        int number_of_active_outputs,
+        unsigned int *indptr_col,
+        unsigned int *indices_col,
+        int number_of_rows,
+        uint64_t *indptr_complement,
+        unsigned int *indices_complement
+)
+{
+	// Merges each sorted column against 0..number_of_rows-1
+	indptr_complement[0] = 0;
+	for (int i = 0; i < number_of_active_outputs; ++i) {
+		unsigned int col = active_output[i];
+		uint64_t pos = indptr_complement[i];
+		if (dense_column(indptr_col, col, number_of_rows)) {
+			unsigned int k = indptr_col[col];
+			for (unsigned int row = 0; row < (unsigned int)number_of_rows; ++row) {
+				if (k < indptr_col[col+1] && indices_col[k] == row) {
+					k++;
+				} else {
+					indices_complement[pos++] = row;
 				}
-				a++;
 			}
 		}
+		indptr_complement[i+1] = pos;
+	}
+}
+
+void tmu_produce_autoencoder_examples(
+        unsigned int *active_output,
+        unsigned int *indptr_row,
+        unsigned int *indices_row,
+        int number_of_rows,
+        unsigned int *indptr_col,
+        unsigned int *indices_col,
+        int number_of_cols,
+        uint64_t *indptr_complement,
+        unsigned int *indices_complement,
+        unsigned int *X,
+        unsigned int *targets,
+        unsigned int *target_values,
+        int number_of_examples,
+        int accumulation
+)
+{
+	unsigned int number_of_literal_chunks = (2*number_of_cols-1)/32 + 1;
+
+	for (int e = 0; e < number_of_examples; ++e) {
+		produce_example(active_output, indptr_row, indices_row, number_of_rows, indptr_col, indices_col, number_of_cols,
+		                indptr_complement, indices_complement, &X[(size_t)e*number_of_literal_chunks], targets[e],
+		                target_values[e], accumulation);
 	}
 }
 
@@ -1,16 +1,68 @@
 #include "fast_rand.h"
 
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif !defined(TMU_SINGLE_THREADED)
+#include <stdatomic.h>
+#endif
+
 static uint64_t const multiplier = 6364136223846793005u;
+
+// Shared by every thread without a stream of its own, which includes all callers of the C API
 static uint64_t mcg_state = 0xcafef00dd15ea5e5u;
 
+#ifndef TMU_SINGLE_THREADED
+// Threads that called pcg32_seed_thread draw from their own state. While there are none, a draw does not touch
+// thread-local storage, which in a shared library costs a __tls_get_addr call per draw (about 5.5 against 3.4 ns
+// per draw, gcc -O3 -fPIC on x86-64).
+static TMU_THREAD_LOCAL uint64_t mcg_thread_state;
+static TMU_THREAD_LOCAL int mcg_thread_owned = 0;
+#if defined(_MSC_VER)
+static volatile long mcg_thread_streams = 0;
+#define MCG_THREAD_STREAMS() mcg_thread_streams
+#define MCG_ADD_THREAD_STREAMS(n) _InterlockedExchangeAdd(&mcg_thread_streams, n)
+#else
+static atomic_int mcg_thread_streams = 0;
+#define MCG_THREAD_STREAMS() atomic_load_explicit(&mcg_thread_streams, memory_order_relaxed)
+#define MCG_ADD_THREAD_STREAMS(n) atomic_fetch_add_explicit(&mcg_thread_streams, n, memory_order_relaxed)
+#endif
+#endif
+
 void pcg32_seed(uint64_t seed) {
     mcg_state = seed;
 }
 
+void pcg32_seed_thread(uint64_t seed) {
+#ifdef TMU_SINGLE_THREADED
+    mcg_state = seed;
+#else
+    mcg_thread_state = seed;
+    if (!mcg_thread_owned) {
+        mcg_thread_owned = 1;
+        MCG_ADD_THREAD_STREAMS(1);
+    }
+#endif
+}
+
+void pcg32_share_thread() {
+#ifndef TMU_SINGLE_THREADED
+    if (mcg_thread_owned) {
+        mcg_thread_owned = 0;
+        MCG_ADD_THREAD_STREAMS(-1);
+    }
+#endif
+}
+
 uint32_t pcg32_fast() {
-    uint64_t x = mcg_state;
+    uint64_t *state = &mcg_state;
+#ifndef TMU_SINGLE_THREADED
+    if (MCG_THREAD_STREAMS() != 0 && mcg_thread_owned) {
+        state = &mcg_thread_state;
+    }
+#endif
+    uint64_t x = *state;
     unsigned int count = (unsigned int)(x >> 61);	// 61 = 64 - 3
-    mcg_state = x * multiplier;
+    *state = x * multiplier;
     return (uint32_t)((x ^ x >> 22) >> (22 + count));	// 22 = 32 - 3 - 7
 }
 
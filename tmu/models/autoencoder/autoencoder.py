@@ -269,13 +269,17 @@ class TMAutoEncoder(TMBaseModel, SingleClauseBankMixin, MultiWeightBankMixin):
             update_clause = self.rng.random(self.number_of_clauses) <= (
                     self.T - np.clip(average_absolute_weights, 0, self.T)) / self.T
 
-            for i in class_index:
-                Xu, Yu = self.clause_bank.produce_autoencoder_example(
-                    encoded_X=self.encoded_X_train,
-                    target=i,
-                    target_true_p=self.feature_true_probability[self.output_active[i]],
-                    accumulation=self.accumulation
-                )
+            # The examples of the round do not depend on the updates, so they are produced in one call
+            examples, targets = self.clause_bank.produce_autoencoder_examples(
+                encoded_X=self.encoded_X_train,
+                targets=class_index,
+                target_true_p=self.feature_true_probability[self.output_active[class_index]],
+                accumulation=self.accumulation
+            )
+
+            for n, i in enumerate(class_index):
+                Xu = examples[n:n + 1]
+                Yu = targets[n]
 
                 ta_chunk = self.output_active[i] // 32
                 chunk_pos = self.output_active[i] % 32
@@ -348,13 +352,15 @@ class TMAutoEncoder(TMBaseModel, SingleClauseBankMixin, MultiWeightBankMixin):
         clause_active = self.activate_clauses()
         literal_active = self.activate_literals()
 
+        examples, targets = self.clause_bank.produce_autoencoder_examples(
+            encoded_X=self.encoded_X_test,
+            targets=np.full(number_of_examples, the_class, dtype=np.uint32),
+            target_true_p=self.feature_true_probability[self.output_active[the_class]],
+            accumulation=self.accumulation
+        )
         for e in range(number_of_examples):
-            Xu, Yu = self.clause_bank.produce_autoencoder_example(
-                encoded_X=self.encoded_X_test,
-                target=the_class,
-                target_true_p=self.feature_true_probability[self.output_active[the_class]],
-                accumulation=self.accumulation
-            )
+            Xu = examples[e:e + 1]
+            Yu = targets[e]
             clause_outputs = self.clause_bank.calculate_clause_outputs_predict(Xu, 0)
 
             if positive_polarity:
@@ -383,13 +389,15 @@ class TMAutoEncoder(TMBaseModel, SingleClauseBankMixin, MultiWeightBankMixin):
 
         weights = self.weight_banks[the_class].get_weights()
 
+        examples, targets = self.clause_bank.produce_autoencoder_examples(
+            encoded_X=self.encoded_X_test,
+            targets=np.full(number_of_examples, the_class, dtype=np.uint32),
+            target_true_p=self.feature_true_probability[self.output_active[the_class]],
+            accumulation=self.accumulation
+        )
         for e in range(number_of_examples):
-            Xu, Yu = self.clause_bank.produce_autoencoder_example(
-                encoded_X=self.encoded_X_test,
-                target=the_class,
-                target_true_p=self.feature_true_probability[self.output_active[the_class]],
-                accumulation=self.accumulation
-            )
+            Xu = examples[e:e + 1]
+            Yu = targets[e]
 
             clause_outputs = self.clause_bank.calculate_clause_outputs_predict(Xu, 0)
 
@@ -284,6 +284,16 @@ class TMBaseModel:
         )
         return clause_bank_type, clause_bank_args
 
+    def _build_cpp_bank(self, X: np.ndarray):
+        # The C++ engine trains in place on the memory of regular CPU clause banks, so the accessors keep working
+        try:
+            import tmulibpy
+        except ImportError:
+            _LOGGER.warning("tmulibpy not installed, using CPU clause bank")
+            self.platform = "CPU"
+
+        return self._build_cpu_bank(X=X)
+
     def build_clause_bank(self, X: np.ndarray):
         if self.platform == "CPU":
             clause_bank_type, clause_bank_args = self._build_cpu_bank(X=X)
@@ -291,6 +301,8 @@ class TMBaseModel:
             clause_bank_type, clause_bank_args = self._build_gpu_bank(X=X)
         elif self.platform == "CPU_sparse":
             clause_bank_type, clause_bank_args = self._build_cpu_sparse_bank(X=X)
+        elif self.platform == "CPP":
+            clause_bank_type, clause_bank_args = self._build_cpp_bank(X=X)
         else:
             raise NotImplementedError(f"Could not find platform of type {self.platform}.")
 
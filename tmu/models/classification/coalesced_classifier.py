@@ -98,6 +98,61 @@ class TMCoalescedClassifier(TMBaseModel, SingleClauseBankMixin, MultiWeightBankM
         if self.max_positive_clauses is None:
             self.max_positive_clauses = self.number_of_clauses
 
+    def select_not_target(self, target, clause_outputs):
+        """Draws the class that receives negative feedback, with its update probability, or None."""
+        for i in range(self.number_of_classes):
+            if i == target:
+                self.update_ps[i] = 0.0
+            else:
+                self.update_ps[i] = np.dot(self.clause_active * self.weight_banks[i].get_weights(),
+                                           clause_outputs).astype(np.int32)
+                self.update_ps[i] = np.clip(self.update_ps[i], -self.T, self.T)
+                self.update_ps[i] = 1.0 * (self.T + self.update_ps[i]) / (2 * self.T)
+
+        if self.update_ps.sum() == 0:
+            return None
+
+        if self.focused_negative_sampling:
+            not_target = self.rng.choice(self.number_of_classes, p=self.update_ps / self.update_ps.sum())
+        else:
+            not_target = self.rng.randint(self.number_of_classes)
+            while not_target == target:
+                not_target = self.rng.randint(self.number_of_classes)
+        return not_target, self.update_ps[not_target]
+
+    def update_fused(self, target, e, encoded_X_train, clause_outputs, update_p):
+        """
+        The update of the target and the sampled negative class in one pass over the clauses, for models without
+        Type III feedback. The weights of the two classes are updated as the weight banks would, and the target
+        keeps its weights once max_positive_clauses is reached.
+        """
+        outputs = [target]
+        update_ps = [update_p]
+        selected = self.select_not_target(target, clause_outputs)
+        if selected is not None:
+            outputs.append(selected[0])
+            update_ps.append(selected[1])
+
+        update_target_weights = (self.weight_banks[target].get_weights() >= 0).sum() < self.max_positive_clauses
+        weights = np.ascontiguousarray(
+            np.stack([self.weight_banks[i].get_weights() for i in outputs], axis=1), dtype=np.int32)
+
+        self.clause_bank.type_i_and_ii_feedback_multi_output(
+            update_p=update_ps,
+            type_i_p=self.type_i_p,
+            type_ii_p=self.type_ii_p,
+            weights=weights,
+            y=[1, 0][:len(outputs)],
+            clause_active=self.clause_active,
+            literal_active=self.literal_active,
+            encoded_X=encoded_X_train,
+            e=e
+        )
+
+        for column, i in enumerate(outputs):
+            if i != target or update_target_weights:
+                self.weight_banks[i].get_weights()[:] = weights[:, column]
+
     def update(self, target, e, encoded_X_train):
         clause_outputs = self.clause_bank.calculate_clause_outputs_update(self.literal_active, encoded_X_train, e)
 
@@ -106,6 +161,11 @@ class TMCoalescedClassifier(TMBaseModel, SingleClauseBankMixin, MultiWeightBankM
         class_sum = np.clip(class_sum, -self.T, self.T)
         update_p = (self.T - class_sum) / (2 * self.T)
 
+        if not self.type_iii_feedback and not self.reuse_random_feedback and hasattr(
+                self.clause_bank, "type_i_and_ii_feedback_multi_output"):
+            self.update_fused(target, e, encoded_X_train, clause_outputs, update_p)
+            return
+
         type_iii_feedback_selection = self.rng.choice(2)
 
         self.clause_bank.type_i_feedback(
@@ -151,26 +211,10 @@ class TMCoalescedClassifier(TMBaseModel, SingleClauseBankMixin, MultiWeightBankM
                 target=0
             )
 
-        for i in range(self.number_of_classes):
-            if i == target:
-                self.update_ps[i] = 0.0
-            else:
-                self.update_ps[i] = np.dot(self.clause_active * self.weight_banks[i].get_weights(),
-                                           clause_outputs).astype(np.int32)
-                self.update_ps[i] = np.clip(self.update_ps[i], -self.T, self.T)
-                self.update_ps[i] = 1.0 * (self.T + self.update_ps[i]) / (2 * self.T)
-
-        if self.update_ps.sum() == 0:
+        selected = self.select_not_target(target, clause_outputs)
+        if selected is None:
             return
-
-        if self.focused_negative_sampling:
-            not_target = self.rng.choice(self.number_of_classes, p=self.update_ps / self.update_ps.sum())
-            update_p = self.update_ps[not_target]
-        else:
-            not_target = self.rng.randint(self.number_of_classes)
-            while not_target == target:
-                not_target = self.rng.randint(self.number_of_classes)
-            update_p = self.update_ps[not_target]
+        not_target, update_p = selected
 
         self.clause_bank.type_i_feedback(
             update_p=update_p * self.type_i_p,
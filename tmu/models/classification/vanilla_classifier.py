@@ -104,6 +104,9 @@ class TMClassifier(TMBaseModel, MultiClauseBankMixin, MultiWeightBankMixin):
 
         self.metrics = MetricRecorder()
 
+        # tmulibpy.TMVanillaClassifier doing fit and predict when platform="CPP"
+        self.engine = None
+
     def init_clause_bank(self, X: np.ndarray, Y: np.ndarray):
         clause_bank_type, clause_bank_args = self.build_clause_bank(X=X)
         self.clause_banks.set_clause_init(clause_bank_type, clause_bank_args)
@@ -128,6 +131,52 @@ class TMClassifier(TMBaseModel, MultiClauseBankMixin, MultiWeightBankMixin):
         self.negative_clauses = np.concatenate((np.zeros(self.number_of_clauses // 2, dtype=np.int32),
                                                 np.ones(self.number_of_clauses // 2, dtype=np.int32)))
 
+        if self.platform == "CPP":
+            self.init_engine(X, Y)
+
+    def init_engine(self, X: np.ndarray, Y: np.ndarray):
+        import tmulibpy
+
+        if self.type_ia_ii_feedback_ratio > 0:
+            raise NotImplementedError("type_ia_ii_feedback_ratio is not supported on platform CPP")
+
+        self.engine = tmulibpy.TMVanillaClassifier(
+            T=self.T,
+            s=self.s,
+            d=self.d,
+            number_of_clauses=self.number_of_clauses,
+            confidence_driven_updating=self.confidence_driven_updating,
+            weighted_clauses=self.weighted_clauses,
+            type_i_feedback=self.type_i_feedback,
+            type_ii_feedback=self.type_ii_feedback,
+            type_iii_feedback=self.type_iii_feedback,
+            type_i_ii_ratio=self.type_i_ii_ratio,
+            max_included_literals=self.max_included_literals,
+            boost_true_positive_feedback=bool(self.boost_true_positive_feedback),
+            reuse_random_feedback=bool(self.reuse_random_feedback),
+            patch_dim=list(self.patch_dim) if self.patch_dim is not None else None,
+            number_of_state_bits=self.number_of_state_bits_ta,
+            number_of_state_bits_ind=self.number_of_state_bits_ind,
+            batch_size=self.batch_size,
+            incremental=self.incremental,
+            seed=self.seed if self.seed is not None else int(self.rng.randint(2 ** 31 - 1)),
+        )
+        self.engine.clause_drop_p = self.clause_drop_p
+        self.engine.literal_drop_p = self.literal_drop_p
+        self.engine.feature_negation = self.feature_negation
+        self.engine.init(np.ascontiguousarray(X, dtype=np.uint32), np.ascontiguousarray(Y, dtype=np.uint32))
+
+        # The engine only has banks for the classes present in Y. Their clause banks and weights replace the
+        # arrays of the Python banks, which from here on are views of the engine's memory.
+        for the_class in self.engine.weight_banks.classes():
+            clause_bank = self.clause_banks[the_class]
+            clause_bank.clause_bank = self.engine.clause_banks[the_class].get_clause_bank()
+            clause_bank._cffi_init()
+
+            weight_bank = self.weight_banks[the_class]
+            weight_bank.weights = self.engine.weight_banks[the_class].get_weights()
+            weight_bank._cffi_init()
+
     def init_num_classes(self, X: np.ndarray, Y: np.ndarray):
         return int(np.max(Y) + 1)
 
@@ -385,6 +434,9 @@ class TMClassifier(TMBaseModel, MultiClauseBankMixin, MultiWeightBankMixin):
         self.init(X, Y)
         self.metrics.clear()
 
+        if self.engine is not None:
+            return self._fit_engine(X, Y, shuffle)
+
         encoded_X_train: np.ndarray = self.train_encoder_cache.get_encoded_data(
             data=X,
             encoder_func=lambda x: self.clause_banks[0].prepare_X(x)
@@ -420,6 +472,48 @@ class TMClassifier(TMBaseModel, MultiClauseBankMixin, MultiWeightBankMixin):
             std=True
         )
 
+    def _fit_engine(self, X: np.ndarray, Y: np.ndarray, shuffle: bool):
+        # The TA states may have been changed through the Python banks since the last call
+        for the_class in self.engine.clause_banks.classes():
+            self.engine.clause_banks[the_class].incremental_clause_evaluation_initialized = False
+
+        self.engine.fit(
+            np.ascontiguousarray(X, dtype=np.uint32),
+            np.ascontiguousarray(Y, dtype=np.uint32),
+            shuffle=shuffle,
+            metrics=[]
+        )
+
+        for the_class in self.engine.clause_banks.classes():
+            self.clause_banks[the_class].incremental_clause_evaluation_initialized = False
+
+        return self.metrics.export(
+            mean=True,
+            std=True
+        )
+
+    def _predict_engine(self, X: np.ndarray, clip_class_sum: bool, return_class_sums: bool):
+        for the_class in self.engine.clause_banks.classes():
+            self.engine.clause_banks[the_class].incremental_clause_evaluation_initialized = False
+
+        _, engine_class_sums = self.engine.predict(
+            np.ascontiguousarray(X, dtype=np.uint32),
+            clip_class_sum=clip_class_sum,
+            return_class_sum=True
+        )
+
+        # The engine only has the classes present in Y, indexed by position in its class list. The others have class
+        # sum 0, and take part in the argmax as they do on the other platforms.
+        classes = np.asarray(self.engine.weight_banks.classes())
+        class_sums = np.zeros((X.shape[0], self.number_of_classes), dtype=np.int32)
+        class_sums[:, classes] = engine_class_sums
+        max_classes = np.argmax(class_sums, axis=1)
+
+        if return_class_sums:
+            return max_classes, class_sums
+        else:
+            return max_classes
+
     def predict(
             self,
             X: np.ndarray,
@@ -427,6 +521,8 @@ class TMClassifier(TMBaseModel, MultiClauseBankMixin, MultiWeightBankMixin):
             return_class_sums: bool = False,
             **kwargs
     ):
+        if self.engine is not None:
+            return self._predict_engine(X, clip_class_sum, return_class_sums)
 
         encoded_X_test = self.test_encoder_cache.get_encoded_data(
             data=X,